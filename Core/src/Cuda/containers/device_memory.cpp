@@ -127,7 +127,7 @@ void DeviceMemory::copyTo(DeviceMemory& other) const
     {    
         other.create(sizeBytes_);    
         cudaSafeCall( cudaMemcpy(other.data_, data_, sizeBytes_, cudaMemcpyDeviceToDevice) );
-        cudaSafeCall( cudaDeviceSynchronize() );
+        cudaSafeCall( cudaStreamSynchronize(cudaStreamPerThread) );
     }
 }
 
@@ -147,13 +147,13 @@ void DeviceMemory::upload(const void *host_ptr_arg, size_t sizeBytes_arg)
 {
     create(sizeBytes_arg);
     cudaSafeCall( cudaMemcpy(data_, host_ptr_arg, sizeBytes_, cudaMemcpyHostToDevice) );
-    cudaSafeCall( cudaDeviceSynchronize() );
+    cudaSafeCall( cudaStreamSynchronize(cudaStreamPerThread) );
 }
 
 void DeviceMemory::download(void *host_ptr_arg) const
 {    
     cudaSafeCall( cudaMemcpy(host_ptr_arg, data_, sizeBytes_, cudaMemcpyDeviceToHost) );
-    cudaSafeCall( cudaDeviceSynchronize() );
+    cudaSafeCall( cudaStreamSynchronize(cudaStreamPerThread) );
 }          
 
 void DeviceMemory::swap(DeviceMemory& other_arg)
@@ -251,7 +251,7 @@ void DeviceMemory2D::copyTo(DeviceMemory2D& other) const
     {
         other.create(rows_, colsBytes_);    
         cudaSafeCall( cudaMemcpy2D(other.data_, other.step_, data_, step_, colsBytes_, rows_, cudaMemcpyDeviceToDevice) );
-        cudaSafeCall( cudaDeviceSynchronize() );
+        cudaSafeCall( cudaStreamSynchronize(cudaStreamPerThread) );
     }
 }
 
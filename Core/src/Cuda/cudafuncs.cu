@@ -430,7 +430,7 @@ void resizeMap(const DeviceArray2D<float>& input, DeviceArray2D<float>& output)
     dim3 grid (getGridDim (out_cols, block.x), getGridDim (out_rows, block.y));
     resizeMapKernel<normalize><< < grid, block>>>(out_rows, out_cols, in_rows, input, output);
     cudaSafeCall ( cudaGetLastError () );
-    cudaSafeCall (cudaDeviceSynchronize ());
+    cudaSafeCall (cudaStreamSynchronize(cudaStreamPerThread));
 }
 
 void resizeVMap(const DeviceArray2D<float>& input, DeviceArray2D<float>& output)
@@ -623,7 +623,7 @@ void computeDerivativeImages(DeviceArray2D<unsigned char>& src, DeviceArray2D<sh
         cudaMemcpyToSymbol(gsobel_y3x3, gsy3x3, sizeof(float) * 9);
 
         cudaSafeCall(cudaGetLastError());
-        cudaSafeCall(cudaDeviceSynchronize());
+        cudaSafeCall(cudaStreamSynchronize(cudaStreamPerThread));
 
         once = true;
     }
@@ -634,7 +634,7 @@ void computeDerivativeImages(DeviceArray2D<unsigned char>& src, DeviceArray2D<sh
     applyKernel<<<grid, block>>>(src, dx, dy);
 
     cudaSafeCall(cudaGetLastError());
-    cudaSafeCall(cudaDeviceSynchronize());
+    cudaSafeCall(cudaStreamSynchronize(cudaStreamPerThread));
 }
 
 __global__ void projectPointsKernel(const PtrStepSz<float> depth,
@@ -669,5 +669,5 @@ void projectToPointCloud(const DeviceArray2D<float> & depth,
 
     projectPointsKernel<<<grid, block>>>(depth, cloud, 1.0f / intrinsicsLevel.fx, 1.0f / intrinsicsLevel.fy, intrinsicsLevel.cx, intrinsicsLevel.cy);
     cudaSafeCall ( cudaGetLastError () );
-    cudaSafeCall (cudaDeviceSynchronize ());
+    cudaSafeCall (cudaStreamSynchronize(cudaStreamPerThread));
 }
@@ -467,7 +467,7 @@ void icpStep(const mat33& Rcurr,
     reduceSum<<<1, MAX_THREADS>>>(sum, out, blocks);
 
     cudaSafeCall(cudaGetLastError());
-    cudaSafeCall(cudaDeviceSynchronize());
+    cudaSafeCall(cudaStreamSynchronize(cudaStreamPerThread));
 
     float host_data[32];
     out.download((JtJJtrSE3 *)&host_data[0]);
@@ -658,7 +658,7 @@ void rgbStep(const DeviceArray2D<DataTerm> & corresImg,
     reduceSum<<<1, MAX_THREADS>>>(sum, out, blocks);
 
     cudaSafeCall(cudaGetLastError());
-    cudaSafeCall(cudaDeviceSynchronize());
+    cudaSafeCall(cudaStreamSynchronize(cudaStreamPerThread));
 
     float host_data[32];
     out.download((JtJJtrSE3 *)&host_data[0]);
@@ -925,7 +925,7 @@ void computeRgbResidual(const float & minScale,
     reduceSum<<<1, MAX_THREADS>>>(sumResidual, out, blocks);
 
     cudaSafeCall(cudaGetLastError());
-    cudaSafeCall(cudaDeviceSynchronize());
+    cudaSafeCall(cudaStreamSynchronize(cudaStreamPerThread));
 
     cudaMemcpy(&out_host, out, sizeof(int2), cudaMemcpyDeviceToHost);
     cudaFree(out);
@@ -1117,7 +1117,7 @@ void so3Step(const DeviceArray2D<unsigned char> & lastImage,
     reduceSum<<<1, MAX_THREADS>>>(sum, out, blocks);
 
     cudaSafeCall(cudaGetLastError());
-    cudaSafeCall(cudaDeviceSynchronize());
+    cudaSafeCall(cudaStreamSynchronize(cudaStreamPerThread));
 
     float host_data[11];
     out.download((JtJJtrSO3 *)&host_data[0]);
@@ -27,7 +27,9 @@ Deformation::Deformation()
    count(0),
    vertices(new Eigen::Vector4f[bufferSize]),
    graphPosePoints(new std::vector<Eigen::Vector3f>),
-   lastDeformTime(0)
+   lastDeformTime(0),
+   backgroundDone(false),
+   backgroundRunning(false)
 {
     //x, y, z and init time
     memset(&vertices[0], 0, bufferSize);
@@ -54,6 +56,11 @@ Deformation::Deformation()
 
 Deformation::~Deformation()
 {
+    if(backgroundRunning)
+    {
+        backgroundThread.join();
+    }
+
     delete [] vertices;
     glDeleteTransformFeedbacks(1, &fid);
     glDeleteBuffers(1, &vbo);
@@ -96,9 +103,11 @@ bool Deformation::constrain(std::vector<Ferns::Frame*> & ferns,
 {
     if(def.isInit())
     {
-        std::vector<unsigned long long int> times;
-        std::vector<Eigen::Matrix4f> poses;
-        std::vector<Eigen::Matrix4f*> rawPoses;
+        std::vector<unsigned long long int> & times = poseTimes;
+
+        times.clear();
+        poses.clear();
+        rawPoses.clear();
 
         //Deform the set of ferns
         for(size_t i = 0; i < ferns.size(); i++)
@@ -184,19 +193,7 @@ bool Deformation::constrain(std::vector<Ferns::Frame*> & ferns,
                 }
             }
 
-            std::vector<GraphNode*> & graphNodes = def.getGraph();
-            std::vector<unsigned long long int> graphTimes = def.getGraphTimes();
-
-            //16 floats per node...
-            rawGraph.resize(graphNodes.size() * 16);
-
-            for(size_t i = 0; i < graphNodes.size(); i++)
-            {
-                memcpy(&rawGraph.at(i * 16), graphNodes.at(i)->position.data(), sizeof(float) * 3);
-                memcpy(&rawGraph.at(i * 16 + 3), graphNodes.at(i)->rotation.data(), sizeof(float) * 9);
-                memcpy(&rawGraph.at(i * 16 + 12), graphNodes.at(i)->translation.data(), sizeof(float) * 3);
-                rawGraph.at(i * 16 + 15) = (float)graphTimes.at(i);
-            }
+            getRawGraph(def, rawGraph);
 
             if(!fernMatch && !relaxGraph)
             {
@@ -217,6 +214,265 @@ bool Deformation::constrain(std::vector<Ferns::Frame*> & ferns,
     return false;
 }
 
+void Deformation::getRawGraph(DeformationGraph & graph, std::vector<float> & rawGraph)
+{
+    std::vector<GraphNode*> & graphNodes = graph.getGraph();
+    std::vector<unsigned long long int> & graphTimes = graph.getGraphTimes();
+
+    //16 floats per node...
+    rawGraph.resize(graphNodes.size() * 16);
+
+    for(size_t i = 0; i < graphNodes.size(); i++)
+    {
+        memcpy(&rawGraph.at(i * 16), graphNodes.at(i)->position.data(), sizeof(float) * 3);
+        memcpy(&rawGraph.at(i * 16 + 3), graphNodes.at(i)->rotation.data(), sizeof(float) * 9);
+        memcpy(&rawGraph.at(i * 16 + 12), graphNodes.at(i)->translation.data(), sizeof(float) * 3);
+        rawGraph.at(i * 16 + 15) = (float)graphTimes.at(i);
+    }
+}
+
+bool Deformation::constrainBackground(std::vector<Ferns::Frame*> & ferns,
+                                      std::vector<std::pair<unsigned long long int, Eigen::Matrix4f> > & poseGraph)
+{
+    if(!def.isInit() || backgroundRunning)
+    {
+        constraints.clear();
+        return false;
+    }
+
+    std::vector<GraphNode*> & graphNodes = def.getGraph();
+
+    background.graphPoints.clear();
+
+    for(size_t i = 0; i < graphNodes.size(); i++)
+    {
+        background.graphPoints.push_back(graphNodes.at(i)->position);
+    }
+
+    background.graphTimes = def.getGraphTimes();
+
+    background.poseTimes.clear();
+    background.poses.clear();
+
+    for(size_t i = 0; i < ferns.size(); i++)
+    {
+        background.poseTimes.push_back(ferns.at(i)->srcTime);
+        background.poses.push_back(ferns.at(i)->pose);
+    }
+
+    for(size_t i = 0; i < poseGraph.size(); i++)
+    {
+        background.poseTimes.push_back(poseGraph.at(i).first);
+        background.poses.push_back(poseGraph.at(i).second);
+    }
+
+    background.snapshot = background.poses;
+    background.numFerns = ferns.size();
+    background.numPoses = poseGraph.size();
+    background.constraints.swap(constraints);
+    background.rawGraph.clear();
+    background.accepted = false;
+
+    constraints.clear();
+
+    backgroundDone = false;
+    backgroundRunning = true;
+
+    backgroundThread = std::thread(&Deformation::solveBackground, this);
+
+    return true;
+}
+
+void Deformation::solveBackground()
+{
+    //Fern matches always optimise the whole graph, so a fresh graph over the snapshot is equivalent
+    std::vector<Eigen::Vector3f> points;
+    std::vector<unsigned long long int> times;
+
+    DeformationGraph graph(def.k, &points, "optBackground");
+
+    graph.initialiseGraph(&background.graphPoints, &background.graphTimes);
+
+    graph.setPosesSeq(&background.poseTimes, background.poses);
+
+    std::vector<Constraint> & cons = background.constraints;
+
+    for(size_t i = 0; i < cons.size(); i++)
+    {
+        points.push_back(cons.at(i).src);
+        times.push_back(cons.at(i).srcTime);
+        cons.at(i).srcPointPoolId = points.size() - 1;
+
+        if(cons.at(i).relative)
+        {
+            points.push_back(cons.at(i).target);
+            times.push_back(cons.at(i).targetTime);
+            cons.at(i).tarPointPoolId = points.size() - 1;
+        }
+    }
+
+    graph.appendVertices(&times, 0);
+
+    for(size_t i = 0; i < cons.size(); i++)
+    {
+        if(cons.at(i).relative)
+        {
+            graph.addRelativeConstraint(cons.at(i).srcPointPoolId, cons.at(i).tarPointPoolId);
+        }
+        else
+        {
+            Eigen::Vector3f targetPoint = cons.at(i).target;
+            graph.addConstraint(cons.at(i).srcPointPoolId, targetPoint);
+        }
+    }
+
+    float error = 0;
+    float meanConsError = 0;
+    bool optimised = graph.optimiseGraphSparse(error, meanConsError, true, 0);
+
+    if(optimised && meanConsError < 0.0003 && error < 0.12)
+    {
+        std::vector<Eigen::Matrix4f*> rawPoses;
+
+        for(size_t i = 0; i < background.poses.size(); i++)
+        {
+            rawPoses.push_back(&background.poses.at(i));
+        }
+
+        graph.applyGraphToPoses(rawPoses);
+
+        getRawGraph(graph, background.rawGraph);
+
+        background.accepted = true;
+    }
+
+    backgroundDone = true;
+}
+
+bool Deformation::backgroundPending()
+{
+    return backgroundRunning;
+}
+
+bool Deformation::backgroundReady()
+{
+    return backgroundRunning && backgroundDone;
+}
+
+bool Deformation::applyBackground(std::vector<Ferns::Frame*> & ferns,
+                                  std::vector<float> & rawGraph,
+                                  std::vector<std::pair<unsigned long long int, Eigen::Matrix4f> > & poseGraph,
+                                  const Eigen::Matrix4f & correction)
+{
+    assert(backgroundReady());
+
+    backgroundThread.join();
+
+    backgroundRunning = false;
+    backgroundDone = false;
+
+    if(!background.accepted)
+    {
+        return false;
+    }
+
+    assert(ferns.size() >= background.numFerns && poseGraph.size() >= background.numPoses);
+
+    for(size_t i = 0; i < ferns.size(); i++)
+    {
+        if(i < background.numFerns)
+        {
+            ferns.at(i)->pose = background.poses.at(i) * background.snapshot.at(i).inverse() * ferns.at(i)->pose;
+        }
+        else
+        {
+            ferns.at(i)->pose = correction * ferns.at(i)->pose;
+        }
+    }
+
+    for(size_t i = 0; i < poseGraph.size(); i++)
+    {
+        if(i < background.numPoses)
+        {
+            const size_t j = background.numFerns + i;
+
+            poseGraph.at(i).second = background.poses.at(j) * background.snapshot.at(j).inverse() * poseGraph.at(i).second;
+        }
+        else
+        {
+            poseGraph.at(i).second = correction * poseGraph.at(i).second;
+        }
+    }
+
+    rawGraph.swap(background.rawGraph);
+
+    return true;
+}
+
+void Deformation::save(CheckpointWriter & writer)
+{
+    std::vector<GraphNode*> & graphNodes = def.getGraph();
+
+    writer.write<uint64_t>(graphNodes.size());
+
+    for(size_t i = 0; i < graphNodes.size(); i++)
+    {
+        writer.write(graphNodes.at(i)->position);
+    }
+
+    writer.write(def.getGraphTimes());
+
+    writer.write<uint32_t>(count);
+    writer.write(vertices, count);
+
+    writer.write(pointPool);
+    writer.write(vertexTimes);
+    writer.write(constraints);
+    writer.write<int32_t>(lastDeformTime);
+}
+
+bool Deformation::stage(CheckpointReader & reader, Staged & staged)
+{
+    staged.numNodes = 0;
+    staged.numVertices = 0;
+    staged.nodes = 0;
+    staged.vertices = 0;
+    staged.deformTime = 0;
+
+    return reader.read(staged.numNodes) && reader.read(staged.nodes, staged.numNodes) &&
+           reader.read(staged.graphTimes) && staged.graphTimes.size() == staged.numNodes &&
+           reader.read(staged.numVertices) && (int)staged.numVertices <= bufferSize && reader.read(staged.vertices, staged.numVertices) &&
+           reader.read(staged.pointPool) && reader.read(staged.vertexTimes) && reader.read(staged.constraints) && reader.read(staged.deformTime);
+}
+
+void Deformation::commit(Staged & staged)
+{
+    if(backgroundRunning)
+    {
+        backgroundThread.join();
+        backgroundRunning = false;
+    }
+
+    memcpy(vertices, staged.vertices, staged.numVertices * sizeof(Eigen::Vector4f));
+    count = staged.numVertices;
+    lastDeformTime = staged.deformTime;
+
+    pointPool.swap(staged.pointPool);
+    vertexTimes.swap(staged.vertexTimes);
+    constraints.swap(staged.constraints);
+
+    if(staged.numNodes > 0)
+    {
+        graphPosePoints->assign(staged.nodes, staged.nodes + staged.numNodes);
+        graphPoseTimes.swap(staged.graphTimes);
+
+        def.initialiseGraph(graphPosePoints, &graphPoseTimes);
+
+        graphPosePoints->clear();
+        graphPoseTimes.clear();
+    }
+}
+
 void Deformation::sampleGraphFrom(Deformation & other)
 {
     Eigen::Vector4f * otherVerts = other.getVertices();
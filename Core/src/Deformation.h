@@ -26,10 +26,13 @@
 #include "GPUTexture.h"
 #include "Utils/Resolution.h"
 #include "Utils/Intrinsics.h"
+#include "Utils/Checkpoint.h"
 #include "Ferns.h"
 #include "Defines.h"
 
 #include <pangolin/gl/gl.h>
+#include <thread>
+#include <atomic>
 
 class Deformation
 {
@@ -90,6 +93,67 @@ class Deformation
                        const bool relaxGraph,
                        std::vector<Constraint> * newRelativeCons = 0);
 
+        /**
+         * Starts a global (fern) solve on a worker thread against a snapshot of the current graph,
+         * the ferns and the pose graph. Consumes the constraints added so far.
+         * @return false if a previous background solve hasn't been applied yet
+         */
+        bool constrainBackground(std::vector<Ferns::Frame*> & ferns,
+                                 std::vector<std::pair<unsigned long long int, Eigen::Matrix4f> > & poseGraph);
+
+        /**
+         * A background solve is either running or waiting to be applied
+         */
+        bool backgroundPending();
+
+        /**
+         * A background solve has finished and can be applied
+         */
+        bool backgroundReady();
+
+        /**
+         * Applies a finished background solve to the ferns and the pose graph. Each snapshotted pose is moved by
+         * what the solve did to it, so local deformations made while it ran are kept. Anything added after the
+         * snapshot was taken is moved rigidly by correction instead
+         * @return true if the solve was accepted, in which case rawGraph holds the graph to deform the model with
+         */
+        bool applyBackground(std::vector<Ferns::Frame*> & ferns,
+                             std::vector<float> & rawGraph,
+                             std::vector<std::pair<unsigned long long int, Eigen::Matrix4f> > & poseGraph,
+                             const Eigen::Matrix4f & correction);
+
+        /**
+         * Writes the graph samples, pending constraints and point pool into a checkpoint
+         */
+        void save(CheckpointWriter & writer);
+
+        /**
+         * A checkpoint's graph, read and checked but not in use yet. The arrays point into the reader
+         */
+        class Staged
+        {
+            public:
+                uint64_t numNodes;
+                const Eigen::Vector3f * nodes;
+                std::vector<unsigned long long int> graphTimes;
+                uint32_t numVertices;
+                const Eigen::Vector4f * vertices;
+                std::vector<Eigen::Vector3f> pointPool;
+                std::vector<unsigned long long int> vertexTimes;
+                std::vector<Constraint> constraints;
+                int32_t deformTime;
+        };
+
+        /**
+         * Reads the graph out of a checkpoint without touching the current one
+         */
+        bool stage(CheckpointReader & reader, Staged & staged);
+
+        /**
+         * Swaps in what stage read, an unapplied background solve is thrown away
+         */
+        void commit(Staged & staged);
+
         Eigen::Vector4f * getVertices()
         {
             return vertices;
@@ -110,6 +174,10 @@ class Deformation
 
         std::vector<unsigned long long int> vertexTimes;
         std::vector<Eigen::Vector3f> pointPool;
+
+        std::vector<unsigned long long int> poseTimes;
+        std::vector<Eigen::Matrix4f> poses;
+        std::vector<Eigen::Matrix4f*> rawPoses;
         int originalPointPool;
         int firstGraphNode;
 
@@ -127,6 +195,33 @@ class Deformation
 
         std::vector<Constraint> constraints;
         int lastDeformTime;
+
+        static void getRawGraph(DeformationGraph & graph, std::vector<float> & rawGraph);
+
+        void solveBackground();
+
+        //Everything the worker thread needs, copied on the tracking thread
+        class BackgroundSolve
+        {
+            public:
+                std::vector<Eigen::Vector3f> graphPoints;
+                std::vector<unsigned long long int> graphTimes;
+                std::vector<unsigned long long int> poseTimes;
+                std::vector<Eigen::Matrix4f> poses;
+
+                //The poses as they were when the snapshot was taken, poses is solved in place
+                std::vector<Eigen::Matrix4f> snapshot;
+                std::vector<Constraint> constraints;
+                size_t numFerns;
+                size_t numPoses;
+                std::vector<float> rawGraph;
+                bool accepted;
+        };
+
+        BackgroundSolve background;
+        std::thread backgroundThread;
+        std::atomic<bool> backgroundDone;
+        bool backgroundRunning;
 };
 
 #endif /* DEFORMATION_H_ */
@@ -64,12 +64,25 @@ ElasticFusion::ElasticFusion(const int timeDelta,
    imageBuff(Resolution::getInstance().rows() / consSample, Resolution::getInstance().cols() / consSample),
    consBuff(Resolution::getInstance().rows() / consSample, Resolution::getInstance().cols() / consSample),
    timesBuff(Resolution::getInstance().rows() / consSample, Resolution::getInstance().cols() / consSample),
+   consRawBuff(Resolution::getInstance().rows() / consSample, Resolution::getInstance().cols() / consSample),
+   consModelBuff(Resolution::getInstance().rows() / consSample, Resolution::getInstance().cols() / consSample),
+   journalRewrite(0),
+   pageDistance(0),
    closeLoops(closeLoops),
    iclnuim(iclnuim),
    reloc(reloc),
    lost(false),
    lastFrameRecovery(false),
+   backgroundLoops(false),
+   backgroundFern(-1),
+   queuedFern(-1),
+   queuedTime(0),
+   asyncFerns(false),
+   localisationOnly(false),
+   frameAllocations(0),
+   frameFrees(0),
    trackingCount(0),
+   trackingStart(0),
    maxDepthProcessed(20.0f),
    rgbOnly(false),
    icpWeight(icpThresh),
@@ -213,6 +226,16 @@ void ElasticFusion::createCompute()
 
     computePacks[ComputePack::METRIC_FILTERED] = new ComputePack(loadProgramFromFile("empty.vert", "depth_metric.frag", "quad.geom"),
                                                                  textures[GPUTexture::DEPTH_METRIC_FILTERED]->texture);
+
+    //Values are filled in per frame, names are only built once
+    normUniforms.push_back(Uniform("maxVal", 0.0f));
+    normUniforms.push_back(Uniform("minVal", 0.0f));
+
+    filterUniforms.push_back(Uniform("cols", (float)Resolution::getInstance().cols()));
+    filterUniforms.push_back(Uniform("rows", (float)Resolution::getInstance().rows()));
+    filterUniforms.push_back(Uniform("maxD", depthCutoff));
+
+    metricUniforms.push_back(Uniform("maxD", depthCutoff));
 }
 
 void ElasticFusion::createFeedbackBuffers()
@@ -238,17 +261,24 @@ void ElasticFusion::computeFeedbackBuffers()
 
 bool ElasticFusion::denseEnough(const Img<Eigen::Matrix<unsigned char, 3, 1>> & img)
 {
-    int sum = 0;
-
-    for(int i = 0; i < img.rows; i++)
+    int sum = ThreadPool::getInstance().parallelReduce(0, img.rows, 8, 0,
+    [&](const int start, const int end)
     {
-        for(int j = 0; j < img.cols; j++)
+        int count = 0;
+
+        for(int i = start; i < end; i++)
         {
-            sum += img.at<Eigen::Matrix<unsigned char, 3, 1>>(i, j)(0) > 0 &&
-                   img.at<Eigen::Matrix<unsigned char, 3, 1>>(i, j)(1) > 0 &&
-                   img.at<Eigen::Matrix<unsigned char, 3, 1>>(i, j)(2) > 0;
+            const Eigen::Matrix<unsigned char, 3, 1> * pix = img.row<Eigen::Matrix<unsigned char, 3, 1>>(i);
+
+            for(int j = 0; j < img.cols; j++)
+            {
+                count += pix[j](0) > 0 && pix[j](1) > 0 && pix[j](2) > 0;
+            }
         }
-    }
+
+        return count;
+    },
+    [](const int a, const int b) { return a + b; });
 
     return float(sum) / float(img.rows * img.cols) > 0.75f;
 }
@@ -260,6 +290,13 @@ void ElasticFusion::processFrame(const unsigned char * rgb,
                                  const float weightMultiplier,
                                  const bool bootstrap)
 {
+    const unsigned long long int allocations = AllocationCounter::get();
+    const unsigned long long int frees = AllocationCounter::getFrees();
+    const int lastDeforms = deforms;
+    const int lastFernDeforms = fernDeforms;
+
+    governor.beginFrame();
+
     TICK("Run");
 
     textures[GPUTexture::DEPTH_RAW]->texture->Upload(depth, GL_LUMINANCE_INTEGER_EXT, GL_UNSIGNED_SHORT);
@@ -314,23 +351,28 @@ void ElasticFusion::processFrame(const unsigned char * rgb,
             Eigen::Vector3f trans = currPose.topRightCorner(3, 1);
             Eigen::Matrix<float, 3, 3, Eigen::RowMajor> rot = currPose.topLeftCorner(3, 3);
 
+            const unsigned long long int odomStart = Stopwatch::getCurrentSystemTime();
+
             TICK("odom");
             frameToModel.getIncrementalTransformation(trans,
                                                       rot,
                                                       rgbOnly,
                                                       icpWeight,
                                                       pyramid,
-                                                      fastOdom,
-                                                      so3);
+                                                      fastOdom || governor.fastOdom(),
+                                                      so3,
+                                                      governor.coarseOdom());
             TOCK("odom");
 
+            governor.addTiming(FrameGovernor::ODOM, (Stopwatch::getCurrentSystemTime() - odomStart) / 1000.0f);
+
             trackingOk = !reloc || frameToModel.lastICPError < 1e-04;
 
             if(reloc)
             {
                 if(!lost)
                 {
-                    Eigen::MatrixXd covariance = frameToModel.getCovariance();
+                    Eigen::Matrix<double, 6, 6> covariance = frameToModel.getCovariance();
 
                     for(int i = 0; i < 6; i++)
                     {
@@ -348,6 +390,7 @@ void ElasticFusion::processFrame(const unsigned char * rgb,
                         if(trackingCount > 10)
                         {
                             lost = true;
+                            trackingStart = tick;
                         }
                     }
                     else
@@ -357,7 +400,7 @@ void ElasticFusion::processFrame(const unsigned char * rgb,
                 }
                 else if(lastFrameRecovery)
                 {
-                    Eigen::MatrixXd covariance = frameToModel.getCovariance();
+                    Eigen::Matrix<double, 6, 6> covariance = frameToModel.getCovariance();
 
                     for(int i = 0; i < 6; i++)
                     {
@@ -372,6 +415,7 @@ void ElasticFusion::processFrame(const unsigned char * rgb,
                     {
                         lost = false;
                         trackingCount = 0;
+                        trackingStart = tick;
                     }
 
                     lastFrameRecovery = false;
@@ -404,45 +448,114 @@ void ElasticFusion::processFrame(const unsigned char * rgb,
 
         weighting = std::max(1.0f - (weighting / largest), minWeight) * weightMultiplier;
 
-        std::vector<Ferns::SurfaceConstraint> constraints;
+        std::vector<Ferns::SurfaceConstraint> & constraints = surfaceConsBuff;
+
+        constraints.clear();
 
         predict();
 
         Eigen::Matrix4f recoveryPose = currPose;
 
-        if(closeLoops)
+        int fernTime = tick;
+
+        //Against a frozen map the ferns are only there to relocalise
+        if(closeLoops && (!localisationOnly || lost) && !governor.findFerns(lost))
+        {
+            //Nothing found rather than last time's match
+            ferns.lastClosest = -1;
+        }
+        else if(closeLoops && (!localisationOnly || lost))
         {
             lastFrameRecovery = false;
 
+            const unsigned long long int fernStart = Stopwatch::getCurrentSystemTime();
+
             TICK("Ferns::findFrame");
-            recoveryPose = ferns.findFrame(constraints,
-                                           currPose,
-                                           &fillIn.vertexTexture,
-                                           &fillIn.normalTexture,
-                                           &fillIn.imageTexture,
-                                           tick,
-                                           lost);
+            if(asyncFerns)
+            {
+                Eigen::Matrix4f queryPose;
+
+                //Result of a frame from a few ticks ago, carry the recovered pose forward to now
+                if(ferns.getFrameResult(constraints, recoveryPose, queryPose, fernTime) && ferns.lastClosest != -1)
+                {
+                    //Only if what's been tracked since is one unbroken stretch, otherwise queryPose isn't comparable to currPose
+                    if(fernTime <= trackingStart || tick - fernTime > MAX_LOOKUP_AGE)
+                    {
+                        ferns.lastClosest = -1;
+                        constraints.clear();
+                        recoveryPose = currPose;
+                    }
+                    else
+                    {
+                        recoveryPose = recoveryPose * queryPose.inverse() * currPose;
+                    }
+                }
+
+                ferns.findFrameAsync(currPose,
+                                     &fillIn.vertexTexture,
+                                     &fillIn.normalTexture,
+                                     &fillIn.imageTexture,
+                                     tick,
+                                     lost);
+            }
+            else
+            {
+                recoveryPose = ferns.findFrame(constraints,
+                                               currPose,
+                                               &fillIn.vertexTexture,
+                                               &fillIn.normalTexture,
+                                               &fillIn.imageTexture,
+                                               tick,
+                                               lost);
+            }
             TOCK("Ferns::findFrame");
+
+            governor.addTiming(FrameGovernor::FERN_FIND, (Stopwatch::getCurrentSystemTime() - fernStart) / 1000.0f);
         }
 
-        std::vector<float> rawGraph;
+        std::vector<float> & rawGraph = rawGraphBuff;
+
+        rawGraph.clear();
 
         bool fernAccepted = false;
 
         if(closeLoops && ferns.lastClosest != -1)
         {
+            //Whatever we've been relocalised against might not be resident
+            if(mapPager)
+            {
+                mapPager->request(recoveryPose.topRightCorner(3, 1), pageDistance - mapPager->getBlockSize());
+            }
+
             if(lost)
             {
                 currPose = recoveryPose;
                 lastFrameRecovery = true;
+                trackingStart = tick;
             }
-            else
+            else if(!localisationOnly && backgroundLoops)
+            {
+                if(globalDeformation.backgroundPending())
+                {
+                    //Started once the running solve is applied, a newer match replaces an older one
+                    queuedFern = ferns.lastClosest;
+                    queuedTime = fernTime;
+                    queuedRecoveryPose = recoveryPose;
+                    queuedTrackedPose = currPose;
+                    queuedConstraints = constraints;
+                }
+                else
+                {
+                    startBackgroundLoop(ferns.lastClosest, fernTime, recoveryPose, currPose, constraints);
+                }
+            }
+            else if(!localisationOnly)
             {
                 for(size_t i = 0; i < constraints.size(); i++)
                 {
                     globalDeformation.addConstraint(constraints.at(i).sourcePoint,
                                                     constraints.at(i).targetPoint,
-                                                    tick,
+                                                    fernTime,
                                                     ferns.frames.at(ferns.lastClosest)->srcTime,
                                                     true);
                 }
@@ -455,6 +568,7 @@ void ElasticFusion::processFrame(const unsigned char * rgb,
                 if(globalDeformation.constrain(ferns.frames, rawGraph, tick, true, poseGraph, true))
                 {
                     currPose = recoveryPose;
+                    trackingStart = tick;
 
                     poseMatches.push_back(PoseMatch(ferns.lastClosest, ferns.frames.size(), ferns.frames.at(ferns.lastClosest)->pose, currPose, constraints, true));
 
@@ -465,8 +579,50 @@ void ElasticFusion::processFrame(const unsigned char * rgb,
             }
         }
 
-        //If we didn't match to a fern
-        if(!lost && closeLoops && rawGraph.size() == 0)
+        if(backgroundLoops && !localisationOnly && !lost && rawGraph.size() == 0 && globalDeformation.backgroundReady())
+        {
+            //Whatever we've tracked since the match moves with the recovered pose
+            Eigen::Matrix4f correction = backgroundRecoveryPose * backgroundTrackedPose.inverse();
+
+            const Eigen::Matrix4f queuedFernPose = queuedFern != -1 ? ferns.frames.at(queuedFern)->pose : Eigen::Matrix4f::Identity();
+
+            if(globalDeformation.applyBackground(ferns.frames, rawGraph, poseGraph, correction))
+            {
+                currPose = correction * currPose;
+                trackingStart = tick;
+
+                poseMatches.push_back(PoseMatch(backgroundFern, ferns.frames.size(), ferns.frames.at(backgroundFern)->pose, currPose, backgroundConstraints, true));
+
+                fernDeforms += rawGraph.size() > 0;
+
+                fernAccepted = true;
+
+                //The queued match was tracked after the snapshot so moves rigidly, its targets move with its fern
+                if(queuedFern != -1)
+                {
+                    const Eigen::Matrix4f fernMotion = ferns.frames.at(queuedFern)->pose * queuedFernPose.inverse();
+
+                    for(size_t i = 0; i < queuedConstraints.size(); i++)
+                    {
+                        queuedConstraints.at(i).sourcePoint = correction * queuedConstraints.at(i).sourcePoint;
+                        queuedConstraints.at(i).targetPoint = fernMotion * queuedConstraints.at(i).targetPoint;
+                    }
+
+                    queuedRecoveryPose = fernMotion * queuedRecoveryPose;
+                    queuedTrackedPose = correction * queuedTrackedPose;
+                }
+            }
+        }
+
+        if(backgroundLoops && !localisationOnly && !lost && queuedFern != -1 && !globalDeformation.backgroundPending())
+        {
+            startBackgroundLoop(queuedFern, queuedTime, queuedRecoveryPose, queuedTrackedPose, queuedConstraints);
+
+            queuedFern = -1;
+        }
+
+        //If we didn't match to a fern. Not while a background solve runs either, it has the node positions as they were
+        if(!lost && closeLoops && !localisationOnly && rawGraph.size() == 0 && !(backgroundLoops && globalDeformation.backgroundPending()))
         {
             //Only predict old view, since we just predicted the current view for the ferns (which failed!)
             TICK("IndexMap::INACTIVE");
@@ -498,7 +654,7 @@ void ElasticFusion::processFrame(const unsigned char * rgb,
                                                       fastOdom,
                                                       false);
 
-            Eigen::MatrixXd covar = modelToModel.getCovariance();
+            Eigen::Matrix<double, 6, 6> covar = modelToModel.getCovariance();
             bool covOk = true;
 
             for(int i = 0; i < 6; i++)
@@ -520,36 +676,56 @@ void ElasticFusion::processFrame(const unsigned char * rgb,
                 resize.vertex(indexMap.vertexTex(), consBuff);
                 resize.time(indexMap.oldTimeTex(), timesBuff);
 
+                //Transform in parallel, then add the constraints in the original order
+                ThreadPool::getInstance().parallelFor(0, consBuff.rows, 4, [&](const int start, const int end)
+                {
+                    for(int j = start; j < end; j++)
+                    {
+                        const Eigen::Vector4f * vert = consBuff.row<Eigen::Vector4f>(j);
+                        const unsigned int * time = timesBuff.row<unsigned int>(j);
+                        Eigen::Vector4f * raw = consRawBuff.row<Eigen::Vector4f>(j);
+                        Eigen::Vector4f * model = consModelBuff.row<Eigen::Vector4f>(j);
+
+                        for(int i = 0; i < consBuff.cols; i++)
+                        {
+                            if(vert[i](2) > 0 &&
+                               vert[i](2) < maxDepthProcessed &&
+                               time[i] > 0)
+                            {
+                                raw[i] = currPose * Eigen::Vector4f(vert[i](0), vert[i](1), vert[i](2), 1.0f);
+                                model[i] = estPose * Eigen::Vector4f(vert[i](0), vert[i](1), vert[i](2), 1.0f);
+                            }
+                            else
+                            {
+                                raw[i](3) = 0;
+                            }
+                        }
+                    }
+                });
+
                 for(int i = 0; i < consBuff.cols; i++)
                 {
                     for(int j = 0; j < consBuff.rows; j++)
                     {
-                        if(consBuff.at<Eigen::Vector4f>(j, i)(2) > 0 &&
-                           consBuff.at<Eigen::Vector4f>(j, i)(2) < maxDepthProcessed &&
-                           timesBuff.at<unsigned short>(j, i) > 0)
+                        if(consRawBuff.at<Eigen::Vector4f>(j, i)(3) != 0)
                         {
-                            Eigen::Vector4f worldRawPoint = currPose * Eigen::Vector4f(consBuff.at<Eigen::Vector4f>(j, i)(0),
-                                                                                       consBuff.at<Eigen::Vector4f>(j, i)(1),
-                                                                                       consBuff.at<Eigen::Vector4f>(j, i)(2),
-                                                                                       1.0f);
-
-                            Eigen::Vector4f worldModelPoint = estPose * Eigen::Vector4f(consBuff.at<Eigen::Vector4f>(j, i)(0),
-                                                                                        consBuff.at<Eigen::Vector4f>(j, i)(1),
-                                                                                        consBuff.at<Eigen::Vector4f>(j, i)(2),
-                                                                                        1.0f);
+                            const Eigen::Vector4f & worldRawPoint = consRawBuff.at<Eigen::Vector4f>(j, i);
+                            const Eigen::Vector4f & worldModelPoint = consModelBuff.at<Eigen::Vector4f>(j, i);
 
                             constraints.push_back(Ferns::SurfaceConstraint(worldRawPoint, worldModelPoint));
 
                             localDeformation.addConstraint(worldRawPoint,
                                                            worldModelPoint,
                                                            tick,
-                                                           timesBuff.at<unsigned short>(j, i),
+                                                           timesBuff.at<unsigned int>(j, i),
                                                            deforms == 0);
                         }
                     }
                 }
 
-                std::vector<Deformation::Constraint> newRelativeCons;
+                std::vector<Deformation::Constraint> & newRelativeCons = relativeConsBuff;
+
+                newRelativeCons.clear();
 
                 if(localDeformation.constrain(ferns.frames, rawGraph, tick, false, poseGraph, false, &newRelativeCons))
                 {
@@ -558,6 +734,7 @@ void ElasticFusion::processFrame(const unsigned char * rgb,
                     deforms += rawGraph.size() > 0;
 
                     currPose = estPose;
+                    trackingStart = tick;
 
                     for(size_t i = 0; i < newRelativeCons.size(); i += newRelativeCons.size() / 3)
                     {
@@ -567,7 +744,7 @@ void ElasticFusion::processFrame(const unsigned char * rgb,
             }
         }
 
-        if(!rgbOnly && trackingOk && !lost)
+        if(!rgbOnly && trackingOk && !lost && !localisationOnly)
         {
             TICK("indexMap");
             indexMap.predictIndices(currPose, tick, globalModel.model(), maxDepthProcessed, timeDelta);
@@ -601,7 +778,12 @@ void ElasticFusion::processFrame(const unsigned char * rgb,
                                          confidenceThreshold,
                                          tick,
                                          tick - timeDelta,
-                                         std::numeric_limits<unsigned short>::max());
+                                         std::numeric_limits<int>::max());
+            }
+
+            if(mapPager && rawGraph.size() > 0)
+            {
+                mapPager->addDeformation(rawGraph, tick);
             }
 
             globalModel.clean(currPose,
@@ -616,29 +798,126 @@ void ElasticFusion::processFrame(const unsigned char * rgb,
                               timeDelta,
                               maxDepthProcessed,
                               fernAccepted);
+
+            if(mapPager && tick % PAGE_RATE == 0)
+            {
+                TICK("pageOut");
+                globalModel.pageOut(currPose.topRightCorner(3, 1),
+                                    tick,
+                                    timeDelta,
+                                    mapPager->getBlockSize(),
+                                    pageDistance,
+                                    pageBuff);
+
+                if(pageBuff.size() > 0)
+                {
+                    mapPager->pageOut(pageBuff);
+                }
+                TOCK("pageOut");
+            }
         }
     }
 
     poseGraph.push_back(std::pair<unsigned long long int, Eigen::Matrix4f>(tick, currPose));
     poseLogTimes.push_back(timestamp);
 
-    TICK("sampleGraph");
+    //The pose is final here, no need to make anyone wait for graph sampling and prediction
+    if(posePublisher)
+    {
+        PoseStatus status;
+        memcpy(status.pose, currPose.data(), sizeof(status.pose));
+        status.timestamp = timestamp;
+        status.tick = tick;
+        status.lost = lost;
+        status.deformed = deforms != lastDeforms;
+        status.fernDeformed = fernDeforms != lastFernDeforms;
+        status.degradation = governor.getLevel();
+        status.icpError = frameToModel.lastICPError;
+        status.icpCount = frameToModel.lastICPCount;
+        status.deforms = deforms;
+        status.fernDeforms = fernDeforms;
+
+        posePublisher->publish(status);
+    }
+
+    if(!localisationOnly && governor.sampleGraph(tick))
+    {
+        const unsigned long long int sampleStart = Stopwatch::getCurrentSystemTime();
+
+        TICK("sampleGraph");
+
+        localDeformation.sampleGraphModel(globalModel.model());
 
-    localDeformation.sampleGraphModel(globalModel.model());
+        globalDeformation.sampleGraphFrom(localDeformation);
 
-    globalDeformation.sampleGraphFrom(localDeformation);
+        TOCK("sampleGraph");
+
+        governor.addTiming(FrameGovernor::SAMPLE_GRAPH, (Stopwatch::getCurrentSystemTime() - sampleStart) / 1000.0f);
+    }
 
-    TOCK("sampleGraph");
+    //Anything paged in lands a frame or two after the request, well before it's in view
+    if(mapPager)
+    {
+        mapPager->request(currPose.topRightCorner(3, 1), pageDistance - mapPager->getBlockSize());
+
+        if(mapPager->ready(pageBuff))
+        {
+            globalModel.append(pageBuff);
+        }
+    }
 
     predict();
 
     if(!lost)
     {
-        processFerns();
+        if(!localisationOnly && governor.addFerns())
+        {
+            const unsigned long long int fernStart = Stopwatch::getCurrentSystemTime();
+
+            processFerns();
+
+            governor.addTiming(FrameGovernor::FERN_ADD, (Stopwatch::getCurrentSystemTime() - fernStart) / 1000.0f);
+        }
+
         tick++;
     }
 
     TOCK("Run");
+
+    governor.endFrame();
+
+    frameAllocations = AllocationCounter::get() - allocations;
+    frameFrees = AllocationCounter::getFrees() - frees;
+}
+
+void ElasticFusion::startBackgroundLoop(const int fern,
+                                        const int time,
+                                        const Eigen::Matrix4f & recoveryPose,
+                                        const Eigen::Matrix4f & trackedPose,
+                                        const std::vector<Ferns::SurfaceConstraint> & constraints)
+{
+    for(size_t i = 0; i < constraints.size(); i++)
+    {
+        globalDeformation.addConstraint(constraints.at(i).sourcePoint,
+                                        constraints.at(i).targetPoint,
+                                        time,
+                                        ferns.frames.at(fern)->srcTime,
+                                        true);
+    }
+
+    for(size_t i = 0; i < relativeCons.size(); i++)
+    {
+        globalDeformation.addConstraint(relativeCons.at(i));
+    }
+
+    //Keep tracking against the current map while the solve runs, apply it when it's done
+    if(globalDeformation.constrainBackground(ferns.frames, poseGraph))
+    {
+        backgroundFern = fern;
+        backgroundRecoveryPose = recoveryPose;
+        backgroundTrackedPose = trackedPose;
+        backgroundConstraints = constraints;
+    }
 }
 
 void ElasticFusion::processFerns()
@@ -650,6 +929,9 @@ void ElasticFusion::processFerns()
 
 void ElasticFusion::predict()
 {
+    //Nothing in a frozen map is ever recent, so all of it counts as active
+    const int window = localisationOnly ? std::numeric_limits<int>::max() : timeDelta;
+
     TICK("IndexMap::ACTIVE");
 
     if(lastFrameRecovery)
@@ -660,7 +942,7 @@ void ElasticFusion::predict()
                                  confidenceThreshold,
                                  0,
                                  tick,
-                                 timeDelta,
+                                 window,
                                  IndexMap::ACTIVE);
     }
     else
@@ -671,7 +953,7 @@ void ElasticFusion::predict()
                                  confidenceThreshold,
                                  tick,
                                  tick,
-                                 timeDelta,
+                                 window,
                                  IndexMap::ACTIVE);
     }
 
@@ -686,9 +968,9 @@ void ElasticFusion::predict()
 
 void ElasticFusion::metriciseDepth()
 {
-    std::vector<Uniform> uniforms;
+    std::vector<Uniform> & uniforms = metricUniforms;
 
-    uniforms.push_back(Uniform("maxD", depthCutoff));
+    uniforms.at(0).f = depthCutoff;
 
     computePacks[ComputePack::METRIC]->compute(textures[GPUTexture::DEPTH_RAW]->texture, &uniforms);
     computePacks[ComputePack::METRIC_FILTERED]->compute(textures[GPUTexture::DEPTH_FILTERED]->texture, &uniforms);
@@ -696,21 +978,19 @@ void ElasticFusion::metriciseDepth()
 
 void ElasticFusion::filterDepth()
 {
-    std::vector<Uniform> uniforms;
+    std::vector<Uniform> & uniforms = filterUniforms;
 
-    uniforms.push_back(Uniform("cols", (float)Resolution::getInstance().cols()));
-    uniforms.push_back(Uniform("rows", (float)Resolution::getInstance().rows()));
-    uniforms.push_back(Uniform("maxD", depthCutoff));
+    uniforms.at(2).f = depthCutoff;
 
     computePacks[ComputePack::FILTER]->compute(textures[GPUTexture::DEPTH_RAW]->texture, &uniforms);
 }
 
 void ElasticFusion::normaliseDepth(const float & minVal, const float & maxVal)
 {
-    std::vector<Uniform> uniforms;
+    std::vector<Uniform> & uniforms = normUniforms;
 
-    uniforms.push_back(Uniform("maxVal", maxVal * 1000.f));
-    uniforms.push_back(Uniform("minVal", minVal * 1000.f));
+    uniforms.at(0).f = maxVal * 1000.f;
+    uniforms.at(1).f = minVal * 1000.f;
 
     computePacks[ComputePack::NORM]->compute(textures[GPUTexture::DEPTH_RAW]->texture, &uniforms);
 }
@@ -719,103 +999,266 @@ void ElasticFusion::savePly()
 {
     std::string filename = saveFilename;
     filename.append(".ply");
-    std::cout << "Output was saved to " << filename << std::endl;
 
-    // Open file
-    std::ofstream fs;
-    fs.open (filename.c_str ());
+    if(exportMap(filename))
+    {
+        std::cout << "Output was saved to " << filename << std::endl;
+    }
+}
+
+bool ElasticFusion::exportMap(const std::string & filename, const bool compressed)
+{
+    MapWriter writer(filename, compressed ? MapWriter::COMPRESSED : MapWriter::PLY, confidenceThreshold);
 
-    Eigen::Vector4f * mapData = globalModel.downloadMap();
+    //1M surfels (48MB) mapped at a time
+    globalModel.streamMap(1 << 20, [&](const Eigen::Vector4f * surfels, const int count)
+    {
+        writer.write(surfels, count);
+    });
 
-    int validCount = 0;
+    return writer.finish();
+}
 
-    for(unsigned int i = 0; i < globalModel.lastCount(); i++)
+bool ElasticFusion::appendJournal(const std::string & filename)
+{
+    if(!mapJournal || journalFile != filename)
     {
-        Eigen::Vector4f pos = mapData[(i * 3) + 0];
+        mapJournal.reset(new MapJournal(filename));
+        journalFile = filename;
+        journalRewrite = globalModel.lastRewrite();
+    }
 
-        if(pos[3] > confidenceThreshold)
-        {
-            validCount++;
-        }
+    TICK("Journal");
+
+    //Timestamps only say what changed since the last entry if nothing moved the whole map in between
+    mapJournal->begin(tick - 1, globalModel.lastRewrite() != journalRewrite);
+    journalRewrite = globalModel.lastRewrite();
+
+    globalModel.streamMap(1 << 20, [&](const Eigen::Vector4f * surfels, const int count)
+    {
+        mapJournal->add(surfels, count);
+    });
+
+    const bool ok = mapJournal->end();
+
+    TOCK("Journal");
+
+    return ok;
+}
+
+int ElasticFusion::readMap(const float confidenceThreshold,
+                           const Eigen::AlignedBox3f & region,
+                           const std::function<void(const Eigen::Vector4f *, const int)> & f)
+{
+    //1M surfels (48MB) mapped at a time
+    globalModel.streamMap(confidenceThreshold, region, 1 << 20, f);
+
+    //tick has already moved on to the next frame
+    return tick - 1;
+}
+
+std::shared_ptr<const MapSnapshot> ElasticFusion::snapshotMap(const float confidenceThreshold, const Eigen::AlignedBox3f & region)
+{
+    if(lastSnapshot &&
+       lastSnapshot->tick == tick - 1 &&
+       lastSnapshot->rewrite == globalModel.lastRewrite() &&
+       lastSnapshot->confidenceThreshold == confidenceThreshold &&
+       lastSnapshot->region.min() == region.min() &&
+       lastSnapshot->region.max() == region.max())
+    {
+        return lastSnapshot;
     }
 
-    // Write header
-    fs << "ply";
-    fs << "\nformat " << "binary_little_endian" << " 1.0";
+    //Snapshots only get out through here, so if we're the only holder nobody can be reading it
+    std::shared_ptr<MapSnapshot> snapshot = spareSnapshot && spareSnapshot.use_count() == 1 ? spareSnapshot : std::make_shared<MapSnapshot>();
 
-    // Vertices
-    fs << "\nelement vertex "<< validCount;
-    fs << "\nproperty float x"
-          "\nproperty float y"
-          "\nproperty float z";
+    TICK("Snapshot");
 
-    fs << "\nproperty uchar red"
-          "\nproperty uchar green"
-          "\nproperty uchar blue";
+    snapshot->surfels.clear();
 
-    fs << "\nproperty float nx"
-          "\nproperty float ny"
-          "\nproperty float nz";
+    snapshot->tick = readMap(confidenceThreshold, region, [&](const Eigen::Vector4f * surfels, const int count)
+    {
+        snapshot->surfels.insert(snapshot->surfels.end(), surfels, surfels + count * 3);
+    });
 
-    fs << "\nproperty float radius";
+    snapshot->rewrite = globalModel.lastRewrite();
+    snapshot->confidenceThreshold = confidenceThreshold;
+    snapshot->region = region;
 
-    fs << "\nend_header\n";
+    TOCK("Snapshot");
 
-    // Close the file
-    fs.close ();
+    spareSnapshot = lastSnapshot;
+    lastSnapshot = snapshot;
 
-    // Open file in binary appendable
-    std::ofstream fpout (filename.c_str (), std::ios::app | std::ios::binary);
+    return snapshot;
+}
 
-    for(unsigned int i = 0; i < globalModel.lastCount(); i++)
+bool ElasticFusion::saveCheckpoint(const std::string & filename, const bool background)
+{
+    if(!checkpointWriter.begin())
     {
-        Eigen::Vector4f pos = mapData[(i * 3) + 0];
+        return false;
+    }
 
-        if(pos[3] > confidenceThreshold)
-        {
-            Eigen::Vector4f col = mapData[(i * 3) + 1];
-            Eigen::Vector4f nor = mapData[(i * 3) + 2];
+    TICK("Checkpoint");
 
-            nor[0] *= -1;
-            nor[1] *= -1;
-            nor[2] *= -1;
+    checkpointWriter.section(Checkpoint::STATE);
+    checkpointWriter.write<int32_t>(Resolution::getInstance().width());
+    checkpointWriter.write<int32_t>(Resolution::getInstance().height());
+    checkpointWriter.write<int32_t>(tick);
+    checkpointWriter.write(currPose);
+    checkpointWriter.write<int32_t>(deforms);
+    checkpointWriter.write<int32_t>(fernDeforms);
+    checkpointWriter.write<int32_t>(trackingCount);
+    checkpointWriter.write<uint8_t>(lost);
+    checkpointWriter.write<uint8_t>(lastFrameRecovery);
 
-            float value;
-            memcpy (&value, &pos[0], sizeof (float));
-            fpout.write (reinterpret_cast<const char*> (&value), sizeof (float));
+    checkpointWriter.section(Checkpoint::MODEL);
+    globalModel.save(checkpointWriter, mapPager.get());
 
-            memcpy (&value, &pos[1], sizeof (float));
-            fpout.write (reinterpret_cast<const char*> (&value), sizeof (float));
+    checkpointWriter.section(Checkpoint::FERNS);
+    ferns.save(checkpointWriter);
 
-            memcpy (&value, &pos[2], sizeof (float));
-            fpout.write (reinterpret_cast<const char*> (&value), sizeof (float));
+    checkpointWriter.section(Checkpoint::LOCAL_DEFORMATION);
+    localDeformation.save(checkpointWriter);
 
-            unsigned char r = int(col[0]) >> 16 & 0xFF;
-            unsigned char g = int(col[0]) >> 8 & 0xFF;
-            unsigned char b = int(col[0]) & 0xFF;
+    checkpointWriter.section(Checkpoint::GLOBAL_DEFORMATION);
+    globalDeformation.save(checkpointWriter);
 
-            fpout.write (reinterpret_cast<const char*> (&r), sizeof (unsigned char));
-            fpout.write (reinterpret_cast<const char*> (&g), sizeof (unsigned char));
-            fpout.write (reinterpret_cast<const char*> (&b), sizeof (unsigned char));
+    checkpointWriter.section(Checkpoint::POSE_GRAPH);
+    checkpointWriter.write<uint64_t>(poseGraph.size());
 
-            memcpy (&value, &nor[0], sizeof (float));
-            fpout.write (reinterpret_cast<const char*> (&value), sizeof (float));
+    for(size_t i = 0; i < poseGraph.size(); i++)
+    {
+        checkpointWriter.write<uint64_t>(poseGraph.at(i).first);
+        checkpointWriter.write(poseGraph.at(i).second);
+    }
+
+    checkpointWriter.write(poseLogTimes);
+    checkpointWriter.write(relativeCons);
 
-            memcpy (&value, &nor[1], sizeof (float));
-            fpout.write (reinterpret_cast<const char*> (&value), sizeof (float));
+    bool saved = checkpointWriter.save(filename, background);
 
-            memcpy (&value, &nor[2], sizeof (float));
-            fpout.write (reinterpret_cast<const char*> (&value), sizeof (float));
+    TOCK("Checkpoint");
 
-            memcpy (&value, &nor[3], sizeof (float));
-            fpout.write (reinterpret_cast<const char*> (&value), sizeof (float));
+    return saved;
+}
+
+bool ElasticFusion::loadCheckpoint(const std::string & filename)
+{
+    CheckpointReader reader(filename);
+
+    int32_t width = 0, height = 0, savedTick = 0, savedDeforms = 0, savedFernDeforms = 0, savedTrackingCount = 0;
+    Eigen::Matrix4f savedPose;
+    uint8_t savedLost = 0, savedRecovery = 0;
+
+    if(!reader.isValid() ||
+       !reader.section(Checkpoint::STATE) ||
+       !reader.read(width) || !reader.read(height) ||
+       width != Resolution::getInstance().width() || height != Resolution::getInstance().height() ||
+       !reader.read(savedTick) || !reader.read(savedPose) || !reader.read(savedDeforms) || !reader.read(savedFernDeforms) ||
+       !reader.read(savedTrackingCount) || !reader.read(savedLost) || !reader.read(savedRecovery))
+    {
+        return false;
+    }
+
+    std::vector<std::pair<unsigned long long int, Eigen::Matrix4f> > savedPoseGraph;
+    uint64_t numPoses = 0;
+
+    if(!reader.section(Checkpoint::POSE_GRAPH) || !reader.read(numPoses))
+    {
+        return false;
+    }
+
+    for(uint64_t i = 0; i < numPoses; i++)
+    {
+        uint64_t time = 0;
+        Eigen::Matrix4f pose;
+
+        if(!reader.read(time) || !reader.read(pose))
+        {
+            return false;
         }
+
+        savedPoseGraph.push_back(std::make_pair(time, pose));
+    }
+
+    std::vector<unsigned long long int> savedLogTimes;
+    std::vector<Deformation::Constraint> savedRelativeCons;
+
+    if(!reader.read(savedLogTimes) || !reader.read(savedRelativeCons) || savedLogTimes.size() != savedPoseGraph.size())
+    {
+        return false;
+    }
+
+    //Everything is read and checked before any of it goes in, so a bad file leaves the current state alone
+    GlobalModel::Staged stagedModel;
+    Ferns::Staged stagedFerns;
+    Deformation::Staged stagedLocal, stagedGlobal;
+
+    if(!reader.section(Checkpoint::MODEL) || !globalModel.stage(reader, stagedModel) ||
+       !reader.section(Checkpoint::FERNS) || !ferns.stage(reader, stagedFerns) ||
+       !reader.section(Checkpoint::LOCAL_DEFORMATION) || !localDeformation.stage(reader, stagedLocal) ||
+       !reader.section(Checkpoint::GLOBAL_DEFORMATION) || !globalDeformation.stage(reader, stagedGlobal))
+    {
+        return false;
+    }
+
+    globalModel.commit(stagedModel);
+    ferns.commit(stagedFerns);
+    localDeformation.commit(stagedLocal);
+    globalDeformation.commit(stagedGlobal);
+
+    //The checkpoint has the whole map
+    if(mapPager)
+    {
+        mapPager->clear();
     }
 
-    // Close file
-    fs.close ();
+    poseGraph.swap(savedPoseGraph);
+    poseLogTimes.swap(savedLogTimes);
+    relativeCons.swap(savedRelativeCons);
+    poseMatches.clear();
+
+    tick = savedTick;
+    currPose = savedPose;
+    deforms = savedDeforms;
+    fernDeforms = savedFernDeforms;
+    trackingCount = savedTrackingCount;
+    lost = savedLost;
+    lastFrameRecovery = savedRecovery;
+    trackingStart = tick;
+    backgroundFern = -1;
+    queuedFern = -1;
+
+    //Bring the predicted views in line with the restored map
+    predict();
 
-    delete [] mapData;
+    return true;
+}
+
+bool ElasticFusion::loadPriorMap(const std::string & filename)
+{
+    if(!loadCheckpoint(filename))
+    {
+        return false;
+    }
+
+    //A new session in the old map's frame, starting where the map did or found by relocalisation
+    poseGraph.clear();
+    poseLogTimes.clear();
+    relativeCons.clear();
+
+    currPose = Eigen::Matrix4f::Identity();
+    lost = reloc;
+    lastFrameRecovery = false;
+    trackingCount = 0;
+    trackingStart = tick;
+    localisationOnly = true;
+
+    predict();
+
+    return true;
 }
 
 Eigen::Vector3f ElasticFusion::rodrigues2(const Eigen::Matrix3f& matrix)
@@ -896,6 +1339,16 @@ const std::vector<PoseMatch> & ElasticFusion::getPoseMatches()
     return poseMatches;
 }
 
+const std::vector<std::pair<unsigned long long int, Eigen::Matrix4f> > & ElasticFusion::getPoseGraph()
+{
+    return poseGraph;
+}
+
+const std::vector<unsigned long long int> & ElasticFusion::getPoseLogTimes()
+{
+    return poseLogTimes;
+}
+
 const RGBDOdometry & ElasticFusion::getModelToModel()
 {
     return modelToModel;
@@ -926,6 +1379,57 @@ void ElasticFusion::setFastOdom(const bool & val)
     fastOdom = val;
 }
 
+void ElasticFusion::setBackgroundLoopClosure(const bool & val)
+{
+    backgroundLoops = val;
+}
+
+void ElasticFusion::setAsyncRelocalisation(const bool & val)
+{
+    asyncFerns = val;
+}
+
+void ElasticFusion::setLocalisationOnly(const bool & val)
+{
+    localisationOnly = val;
+}
+
+void ElasticFusion::setSurfelBudget(const int & val)
+{
+    globalModel.setBudget(std::max(val, 0));
+}
+
+void ElasticFusion::setPublisher(const std::string & val)
+{
+    posePublisher.reset(val.length() ? new PosePublisher(val) : 0);
+
+    if(posePublisher && !posePublisher->isOpen())
+    {
+        std::cout << "Couldn't create shared memory " << val << " to publish to" << std::endl;
+        posePublisher.reset();
+    }
+}
+
+bool ElasticFusion::setPaging(const std::string & filename, const float blockSize, const float distance)
+{
+    mapPager.reset(filename.length() ? new MapPager(filename, blockSize) : 0);
+    pageDistance = distance;
+
+    if(mapPager && !mapPager->isOpen())
+    {
+        std::cout << "Couldn't create page file " << filename << std::endl;
+        mapPager.reset();
+        return false;
+    }
+
+    return true;
+}
+
+MapPager * ElasticFusion::getMapPager()
+{
+    return mapPager.get();
+}
+
 void ElasticFusion::setSo3(const bool & val)
 {
     so3 = val;
@@ -956,6 +1460,26 @@ const bool & ElasticFusion::getLost() //lel
     return lost;
 }
 
+const unsigned long long int & ElasticFusion::getFrameAllocations()
+{
+    return frameAllocations;
+}
+
+const unsigned long long int & ElasticFusion::getFrameFrees()
+{
+    return frameFrees;
+}
+
+void ElasticFusion::setFrameDeadline(const float & val)
+{
+    governor.setDeadline(val);
+}
+
+const FrameGovernor & ElasticFusion::getGovernor()
+{
+    return governor;
+}
+
 const int & ElasticFusion::getTick()
 {
     return tick;
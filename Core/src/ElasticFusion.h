@@ -23,6 +23,15 @@
 #include "Utils/Resolution.h"
 #include "Utils/Intrinsics.h"
 #include "Utils/Stopwatch.h"
+#include "Utils/AllocationCounter.h"
+#include "Utils/ThreadPool.h"
+#include "Utils/Checkpoint.h"
+#include "Utils/MapWriter.h"
+#include "Utils/MapJournal.h"
+#include "Utils/MapSnapshot.h"
+#include "Utils/PosePublisher.h"
+#include "Utils/MapPager.h"
+#include "Utils/FrameGovernor.h"
 #include "Shaders/Shaders.h"
 #include "Shaders/ComputePack.h"
 #include "Shaders/FeedbackBuffer.h"
@@ -35,6 +44,7 @@
 #include "Defines.h"
 
 #include <iomanip>
+#include <memory>
 #include <pangolin/gl/glcuda.h>
 
 class ElasticFusion
@@ -117,6 +127,18 @@ class ElasticFusion
          */
         EFUSION_API const std::vector<PoseMatch> & getPoseMatches();
 
+        /**
+         * Every frame's pose by tick, loop closures included, as saved to the .freiburg on destruction
+         * @return
+         */
+        EFUSION_API const std::vector<std::pair<unsigned long long int, Eigen::Matrix4f> > & getPoseGraph();
+
+        /**
+         * The timestamps of the poses in getPoseGraph
+         * @return
+         */
+        EFUSION_API const std::vector<unsigned long long int> & getPoseLogTimes();
+
         /**
          * This is the tracking class, if you want access
          * @return
@@ -183,12 +205,88 @@ class ElasticFusion
          */
         EFUSION_API void setDepthCutoff(const float & val);
 
+        /**
+         * Solve global loop closures on a background thread instead of stalling the frame that found them. Matches found
+         * while a solve runs are queued behind it, and local loop closures wait for it
+         * @param val default is false
+         */
+        EFUSION_API void setBackgroundLoopClosure(const bool & val);
+
+        /**
+         * Look up and verify fern matches on a separate thread, results arrive a few frames late
+         * @param val default is false
+         */
+        EFUSION_API void setAsyncRelocalisation(const bool & val);
+
+        /**
+         * Publish the pose and tracking status of every frame into shared memory as soon as it's final,
+         * other processes read it with PoseReader (Utils/PoseChannel.h)
+         * @param val shared memory name, empty (the default) stops publishing
+         */
+        EFUSION_API void setPublisher(const std::string & val);
+
+        /**
+         * Page blocks of the map that are far from the camera and haven't been seen for a while out to a memory
+         * mapped file, and back in when the camera (or a relocalisation) comes near them again. Checkpoints still
+         * hold the whole map. Set it before the first frame
+         * @param filename page file, empty (the default) turns paging off
+         * @param blockSize edge length of the blocks that get paged in metres
+         * @param distance blocks with their centre further than this from the camera get paged out
+         * @return false if the page file couldn't be created
+         */
+        EFUSION_API bool setPaging(const std::string & filename, const float blockSize, const float distance);
+
+        /**
+         * @return the pager, or null if paging is off
+         */
+        EFUSION_API MapPager * getMapPager();
+
+        /**
+         * Freeze the map: only predict, track and relocalise (if on). Nothing is fused, cleaned, deformed or added to
+         * the fern database, so frames are cheaper and the map's memory doesn't grow
+         * @param val default is false
+         */
+        EFUSION_API void setLocalisationOnly(const bool & val);
+
+        /**
+         * Keep the map under this many surfels by evicting the least valuable inactive ones (low confidence,
+         * briefly observed, long unseen), see GlobalModel::setBudget. Set it before the first frame
+         * @param val default is 0, no budget
+         */
+        EFUSION_API void setSurfelBudget(const int & val);
+
         /**
          * Returns whether or not the camera is lost, if relocalisation mode is on
          * @return
          */
         EFUSION_API const bool & getLost();
 
+        /**
+         * Heap allocations the calling thread made during the last processFrame call, only counted when built with
+         * COUNT_ALLOCATIONS. Work handed to other threads (the thread pool, background solves) isn't counted
+         * @return allocations over the call, expect the pose graph and fern database to show up as they grow
+         */
+        EFUSION_API const unsigned long long int & getFrameAllocations();
+
+        /**
+         * Heap frees during the last processFrame call, counted like getFrameAllocations
+         * @return
+         */
+        EFUSION_API const unsigned long long int & getFrameFrees();
+
+        /**
+         * Per frame deadline in milliseconds. Work is turned down a step at a time (graph sampling, fern
+         * keyframes, fern lookups, then coarser tracking) to stay under it rather than dropping frames
+         * @param val default is 0, no deadline
+         */
+        EFUSION_API void setFrameDeadline(const float & val);
+
+        /**
+         * What the deadline governor is doing, see FrameGovernor
+         * @return
+         */
+        EFUSION_API const FrameGovernor & getGovernor();
+
         /**
          * Get the internal clock value of the fusion process
          * @return monotonically increasing integer value (not real-world time)
@@ -247,6 +345,63 @@ class ElasticFusion
          */
         EFUSION_API void savePly();
 
+        /**
+         * Streams the current model out to a file without copying it all to the host first
+         * @param filename
+         * @param compressed write the compressed native format (see MapWriter) instead of a binary PLY
+         * @return false if the file couldn't be written
+         */
+        EFUSION_API bool exportMap(const std::string & filename, const bool compressed = false);
+
+        /**
+         * Appends what changed in the model since the last call to a delta journal (see MapJournal), the first call
+         * creates the journal and writes a keyframe. Call this between frames, as often as consumers need updates
+         * @param filename
+         * @return false if the entry couldn't be written
+         */
+        EFUSION_API bool appendJournal(const std::string & filename);
+
+        /**
+         * Zero copy read of the surfels above confidenceThreshold (and inside region if it isn't empty), filtered on the GPU.
+         * f is handed mapped windows of matching surfels, 3 Eigen::Vector4f each, that are only valid until it returns.
+         * Call between frames on the GL thread, the map can't change while this runs
+         * @return the tick the surfels are consistent with
+         */
+        EFUSION_API int readMap(const float confidenceThreshold,
+                                const Eigen::AlignedBox3f & region,
+                                const std::function<void(const Eigen::Vector4f *, const int)> & f);
+
+        /**
+         * Copies the matching surfels into a snapshot other threads can keep reading while tracking carries on.
+         * Asking again before the map changes hands back the same snapshot, and ones nobody holds anymore get reused
+         */
+        EFUSION_API std::shared_ptr<const MapSnapshot> snapshotMap(const float confidenceThreshold,
+                                                                   const Eigen::AlignedBox3f & region = Eigen::AlignedBox3f());
+
+        /**
+         * Saves the whole session (surfel map, ferns, deformation graphs, pose graph and clock) to a binary checkpoint.
+         * The map is read back from the GPU here, writing it out to disk can be left to a worker thread
+         * @param filename
+         * @param background if true, return as soon as the checkpoint is in memory
+         * @return false if the last background checkpoint is still being written
+         */
+        EFUSION_API bool saveCheckpoint(const std::string & filename, const bool background = true);
+
+        /**
+         * Resumes the session stored in a checkpoint, call this between frames
+         * @param filename
+         * @return false if the file is missing, corrupt or was made with a different resolution or version, nothing is changed then
+         */
+        EFUSION_API bool loadCheckpoint(const std::string & filename);
+
+        /**
+         * Loads the map and ferns of a checkpoint to localise against, see setLocalisationOnly. The trajectory starts
+         * afresh at the map's origin, or lost if relocalisation is on so the ferns can find where we are
+         * @param filename
+         * @return false if the checkpoint couldn't be loaded
+         */
+        EFUSION_API bool loadPriorMap(const std::string & filename);
+
         /**
          * Renders a normalised view of the input raw depth for displaying as an OpenGL texture
          * (this is stored under textures[GPUTexture::DEPTH_NORM]
@@ -282,6 +437,13 @@ class ElasticFusion
 
         void processFerns();
 
+        //Starts a global solve for a fern match on globalDeformation's worker thread
+        void startBackgroundLoop(const int fern,
+                                 const int time,
+                                 const Eigen::Matrix4f & recoveryPose,
+                                 const Eigen::Matrix4f & trackedPose,
+                                 const std::vector<Ferns::SurfaceConstraint> & constraints);
+
         Eigen::Vector3f rodrigues2(const Eigen::Matrix3f& matrix);
 
         Eigen::Matrix4f currPose;
@@ -305,7 +467,40 @@ class ElasticFusion
 
         Img<Eigen::Matrix<unsigned char, 3, 1>> imageBuff;
         Img<Eigen::Vector4f> consBuff;
-        Img<unsigned short> timesBuff;
+        Img<unsigned int> timesBuff;
+        Img<Eigen::Vector4f> consRawBuff;
+        Img<Eigen::Vector4f> consModelBuff;
+
+        //Per frame scratch, cleared rather than reallocated
+        std::vector<Ferns::SurfaceConstraint> surfaceConsBuff;
+        std::vector<Deformation::Constraint> relativeConsBuff;
+        std::vector<float> rawGraphBuff;
+
+        CheckpointWriter checkpointWriter;
+
+        std::unique_ptr<MapJournal> mapJournal;
+        std::string journalFile;
+        unsigned int journalRewrite;
+
+        std::shared_ptr<MapSnapshot> lastSnapshot;
+        std::shared_ptr<MapSnapshot> spareSnapshot;
+
+        std::unique_ptr<PosePublisher> posePublisher;
+
+        std::unique_ptr<MapPager> mapPager;
+        float pageDistance;
+        std::vector<Eigen::Vector4f> pageBuff;
+
+        static const int PAGE_RATE = 30;
+
+        //Asynchronous fern lookups older than this many frames are dropped
+        static const int MAX_LOOKUP_AGE = 5;
+
+        FrameGovernor governor;
+
+        std::vector<Uniform> normUniforms;
+        std::vector<Uniform> filterUniforms;
+        std::vector<Uniform> metricUniforms;
 
         const bool closeLoops;
         const bool iclnuim;
@@ -313,7 +508,26 @@ class ElasticFusion
         const bool reloc;
         bool lost;
         bool lastFrameRecovery;
+        bool backgroundLoops;
+        int backgroundFern;
+        Eigen::Matrix4f backgroundRecoveryPose;
+        Eigen::Matrix4f backgroundTrackedPose;
+        std::vector<Ferns::SurfaceConstraint> backgroundConstraints;
+
+        //The latest fern match found while a background solve was running, -1 if none
+        int queuedFern;
+        int queuedTime;
+        Eigen::Matrix4f queuedRecoveryPose;
+        Eigen::Matrix4f queuedTrackedPose;
+        std::vector<Ferns::SurfaceConstraint> queuedConstraints;
+        bool asyncFerns;
+        bool localisationOnly;
+        unsigned long long int frameAllocations;
+        unsigned long long int frameFrees;
         int trackingCount;
+
+        //Tick the current unbroken stretch of tracking began, lost, found or jumped by a loop closure
+        int trackingStart;
         const float maxDepthProcessed;
 
         bool rgbOnly;
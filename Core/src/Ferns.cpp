@@ -37,16 +37,23 @@ Ferns::Ferns(int n, int maxDepth, const float photoThresh)
         Intrinsics::getInstance().cy() / factor,
         Intrinsics::getInstance().fx() / factor,
         Intrinsics::getInstance().fy() / factor),
-   vertFern(width, height, GL_RGBA32F, GL_LUMINANCE, GL_FLOAT, false, true),
-   vertCurrent(width, height, GL_RGBA32F, GL_LUMINANCE, GL_FLOAT, false, true),
-   normFern(width, height, GL_RGBA32F, GL_LUMINANCE, GL_FLOAT, false, true),
-   normCurrent(width, height, GL_RGBA32F, GL_LUMINANCE, GL_FLOAT, false, true),
    colorFern(width, height, GL_RGBA, GL_RGB, GL_UNSIGNED_BYTE, false, true),
    colorCurrent(width, height, GL_RGBA, GL_RGB, GL_UNSIGNED_BYTE, false, true),
    resize(Resolution::getInstance().width(), Resolution::getInstance().height(), width, height),
-   imageBuff(width, height),
-   vertBuff(width, height),
-   normBuff(width, height)
+   imageBuff(height, width),
+   vertBuff(height, width),
+   normBuff(height, width),
+   scratchFrame(num, 0, Eigen::Matrix4f::Identity(), 0, width * height),
+   lookupFrame(num, 0, Eigen::Matrix4f::Identity(), 0, width * height),
+   lookupPending(false),
+   lookupDone(false),
+   lookupShutdown(false),
+   queryImg(height, width),
+   queryVerts(height, width),
+   queryNorms(height, width),
+   queryTime(0),
+   queryLost(false),
+   queryClosest(-1)
 {
     random.seed(time(0));
     generateFerns();
@@ -54,6 +61,17 @@ Ferns::Ferns(int n, int maxDepth, const float photoThresh)
 
 Ferns::~Ferns()
 {
+    if(lookupThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(lookupMutex);
+            lookupShutdown = true;
+        }
+
+        lookupCond.notify_one();
+        lookupThread.join();
+    }
+
     for(size_t i = 0; i < frames.size(); i++)
     {
         delete frames.at(i);
@@ -80,88 +98,79 @@ void Ferns::generateFerns()
 
 bool Ferns::addFrame(GPUTexture * imageTexture, GPUTexture * vertexTexture, GPUTexture * normalTexture, const Eigen::Matrix4f & pose, int srcTime, const float threshold)
 {
-    Img<Eigen::Matrix<unsigned char, 3, 1>> img(height, width);
-    Img<Eigen::Vector4f> verts(height, width);
-    Img<Eigen::Vector4f> norms(height, width);
+    Img<Eigen::Matrix<unsigned char, 3, 1>> & img = imageBuff;
+    Img<Eigen::Vector4f> & verts = vertBuff;
+    Img<Eigen::Vector4f> & norms = normBuff;
 
     resize.image(imageTexture, img);
     resize.vertex(vertexTexture, verts);
     resize.vertex(normalTexture, norms);
 
-    Frame * frame = new Frame(num,
-                              frames.size(),
-                              pose,
-                              srcTime,
-                              width * height,
-                              (unsigned char *)img.data,
-                              (Eigen::Vector4f *)verts.data,
-                              (Eigen::Vector4f *)norms.data);
+    //Encode into scratch, only keyframes we keep get their own Frame
+    Frame * frame = &scratchFrame;
 
-    int * coOccurrences = new int[frames.size()];
+    encode(frame, verts, img);
 
-    memset(coOccurrences, 0, sizeof(int) * frames.size());
+    countCoOccurrences(frame, coOccurrences);
 
-    for(int i = 0; i < num; i++)
-    {
-        unsigned char code = badCode;
+    float minimum = std::numeric_limits<float>::max();
 
-        if(verts.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2) > 0)
+    if(frame->goodCodes > 0)
+    {
+        minimum = ThreadPool::getInstance().parallelReduce(0, (int)frames.size(), 256, minimum,
+        [&](const int start, const int end)
         {
-            const Eigen::Matrix<unsigned char, 3, 1> & pix = img.at<Eigen::Matrix<unsigned char, 3, 1>>(conservatory.at(i).pos(1), conservatory.at(i).pos(0));
+            float chunkMinimum = std::numeric_limits<float>::max();
 
-            code = (pix(0) > conservatory.at(i).rgbd(0)) << 3 |
-                   (pix(1) > conservatory.at(i).rgbd(1)) << 2 |
-                   (pix(2) > conservatory.at(i).rgbd(2)) << 1 |
-                   (int(verts.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2) * 1000.0f) > conservatory.at(i).rgbd(3));
+            for(int i = start; i < end; i++)
+            {
+                float maxCo = std::min(frame->goodCodes, frames.at(i)->goodCodes);
 
-            frame->goodCodes++;
+                float dissim = (float)(maxCo - coOccurrences[i]) / (float)maxCo;
 
-            for(size_t j = 0; j < conservatory.at(i).ids[code].size(); j++)
-            {
-                coOccurrences[conservatory.at(i).ids[code].at(j)]++;
+                if(dissim < chunkMinimum)
+                {
+                    chunkMinimum = dissim;
+                }
             }
-        }
 
-        frame->codes[i] = code;
+            return chunkMinimum;
+        },
+        [](const float a, const float b) { return std::min(a, b); });
     }
 
-    float minimum = std::numeric_limits<float>::max();
-
-    if(frame->goodCodes > 0)
+    if((minimum > threshold || frames.size() == 0) && frame->goodCodes > 0)
     {
-        for(size_t i = 0; i < frames.size(); i++)
-        {
-            float maxCo = std::min(frame->goodCodes, frames.at(i)->goodCodes);
+        std::lock_guard<std::mutex> lock(framesMutex);
 
-            float dissim = (float)(maxCo - coOccurrences[i]) / (float)maxCo;
+        Frame * keyframe = new Frame(num, frames.size(), pose, srcTime, width * height);
 
-            if(dissim < minimum)
-            {
-                minimum = dissim;
-            }
-        }
-    }
+        //The images' rows are padded, keyframes keep them packed
+        keyframe->initRgb = new unsigned char[width * height * 3];
+        keyframe->initVerts = new Eigen::Vector4f[width * height];
+        keyframe->initNorms = new Eigen::Vector4f[width * height];
 
-    delete [] coOccurrences;
+        img.copyTo((Eigen::Matrix<unsigned char, 3, 1> *)keyframe->initRgb);
+        verts.copyTo(keyframe->initVerts);
+        norms.copyTo(keyframe->initNorms);
+
+        memcpy(keyframe->codes, frame->codes, num);
+        keyframe->goodCodes = frame->goodCodes;
 
-    if((minimum > threshold || frames.size() == 0) && frame->goodCodes > 0)
-    {
         for(int i = 0; i < num; i++)
         {
-            if(frame->codes[i] != badCode)
+            if(keyframe->codes[i] != badCode)
             {
-                conservatory.at(i).ids[frame->codes[i]].push_back(frame->id);
+                conservatory.at(i).ids[keyframe->codes[i]].push_back(keyframe->id);
             }
         }
 
-        frames.push_back(frame);
+        frames.push_back(keyframe);
 
         return true;
     }
     else
     {
-        delete frame;
-
         return false;
     }
 }
@@ -174,136 +183,446 @@ Eigen::Matrix4f Ferns::findFrame(std::vector<SurfaceConstraint> & constraints,
                                  const int time,
                                  const bool lost)
 {
+    assert(!lookupThread.joinable() && "Don't mix findFrame and findFrameAsync, they share rgbd");
+
     lastClosest = -1;
 
-    Img<Eigen::Matrix<unsigned char, 3, 1>> imgSmall(height, width);
-    Img<Eigen::Vector4f> vertSmall(height, width);
-    Img<Eigen::Vector4f> normSmall(height, width);
+    Img<Eigen::Matrix<unsigned char, 3, 1>> & imgSmall = imageBuff;
+    Img<Eigen::Vector4f> & vertSmall = vertBuff;
+    Img<Eigen::Vector4f> & normSmall = normBuff;
 
     resize.image(imageTexture, imgSmall);
     resize.vertex(vertexTexture, vertSmall);
     resize.vertex(normalTexture, normSmall);
 
-    Frame * frame = new Frame(num, 0, Eigen::Matrix4f::Identity(), 0, width * height);
+    int minId = findClosest(&scratchFrame, coOccurrences, vertSmall, imgSmall, time);
+
+    Eigen::Matrix4f estPose = Eigen::Matrix4f::Identity();
 
-    int * coOccurrences = new int[frames.size()];
+    if(minId != -1 && verifyFrame(frames.at(minId), frames.at(minId)->pose, vertSmall, normSmall, imgSmall, lost, estPose))
+    {
+        lastClosest = minId;
 
-    memset(coOccurrences, 0, sizeof(int) * frames.size());
+        getConstraints(constraints, vertSmall, currPose, estPose);
+    }
 
-    for(int i = 0; i < num; i++)
+    return estPose;
+}
+
+void Ferns::findFrameAsync(const Eigen::Matrix4f & currPose,
+                           GPUTexture * vertexTexture,
+                           GPUTexture * normalTexture,
+                           GPUTexture * imageTexture,
+                           const int time,
+                           const bool lost)
+{
     {
-        unsigned char code = badCode;
+        std::lock_guard<std::mutex> lock(lookupMutex);
 
-        if(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2) > 0)
+        if(lookupPending)
         {
-            const Eigen::Matrix<unsigned char, 3, 1> & pix = imgSmall.at<Eigen::Matrix<unsigned char, 3, 1>>(conservatory.at(i).pos(1), conservatory.at(i).pos(0));
+            return;
+        }
+    }
 
-            code = (pix(0) > conservatory.at(i).rgbd(0)) << 3 |
-                   (pix(1) > conservatory.at(i).rgbd(1)) << 2 |
-                   (pix(2) > conservatory.at(i).rgbd(2)) << 1 |
-                   (int(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2) * 1000.0f) > conservatory.at(i).rgbd(3));
+    if(!lookupThread.joinable())
+    {
+        //From here on rgbd only runs on the lookup thread, its step timings would land on top of tracking's
+        rgbd.setTimed(false);
 
-            frame->goodCodes++;
+        lookupThread = std::thread(&Ferns::lookupLoop, this);
+    }
 
-            for(size_t j = 0; j < conservatory.at(i).ids[code].size(); j++)
+    //The readbacks have to happen here on the GL thread, everything else is done by lookupLoop
+    resize.image(imageTexture, queryImg);
+    resize.vertex(vertexTexture, queryVerts);
+    resize.vertex(normalTexture, queryNorms);
+
+    queryPose = currPose;
+    queryTime = time;
+    queryLost = lost;
+
+    {
+        std::lock_guard<std::mutex> lock(lookupMutex);
+        lookupPending = true;
+        lookupDone = false;
+    }
+
+    lookupCond.notify_one();
+}
+
+bool Ferns::getFrameResult(std::vector<SurfaceConstraint> & constraints,
+                           Eigen::Matrix4f & recoveryPose,
+                           Eigen::Matrix4f & queryPose,
+                           int & queryTime)
+{
+    lastClosest = -1;
+
+    {
+        std::lock_guard<std::mutex> lock(lookupMutex);
+
+        if(!lookupPending || !lookupDone)
+        {
+            return false;
+        }
+    }
+
+    queryPose = this->queryPose;
+    queryTime = this->queryTime;
+
+    if(queryClosest != -1)
+    {
+        lastClosest = queryClosest;
+
+        //The fern may have been deformed while we were looking, so only the relative pose is kept
+        recoveryPose = frames.at(queryClosest)->pose * queryRelative;
+
+        getConstraints(constraints, queryVerts, queryPose, recoveryPose);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(lookupMutex);
+        lookupPending = false;
+    }
+
+    return true;
+}
+
+void Ferns::lookupLoop()
+{
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(lookupMutex);
+
+            lookupCond.wait(lock, [this]{ return lookupShutdown || (lookupPending && !lookupDone); });
+
+            if(lookupShutdown)
             {
-                coOccurrences[conservatory.at(i).ids[code].at(j)]++;
+                return;
             }
         }
 
-        frame->codes[i] = code;
+        int minId = -1;
+        const Frame * fern = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(framesMutex);
+
+            minId = findClosest(&lookupFrame, lookupCoOccurrences, queryVerts, queryImg, queryTime);
+
+            //Frames are never freed or modified after being added (apart from their pose)
+            fern = minId != -1 ? frames.at(minId) : 0;
+        }
+
+        queryRelative = Eigen::Matrix4f::Identity();
+
+        if(fern && !verifyFrame(fern, Eigen::Matrix4f::Identity(), queryVerts, queryNorms, queryImg, queryLost, queryRelative))
+        {
+            minId = -1;
+        }
+
+        queryClosest = minId;
+
+        {
+            std::lock_guard<std::mutex> lock(lookupMutex);
+            lookupDone = true;
+        }
+
+        lookupCond.notify_all();
     }
+}
 
-    float minimum = std::numeric_limits<float>::max();
-    int minId = -1;
+void Ferns::save(CheckpointWriter & writer)
+{
+    writer.write<int32_t>(num);
+    writer.write<int32_t>(width);
+    writer.write<int32_t>(height);
+
+    for(int i = 0; i < num; i++)
+    {
+        writer.write(conservatory.at(i).pos);
+        writer.write(conservatory.at(i).rgbd);
+
+        for(int j = 0; j < 16; j++)
+        {
+            writer.write(conservatory.at(i).ids[j]);
+        }
+    }
+
+    writer.write<uint64_t>(frames.size());
 
     for(size_t i = 0; i < frames.size(); i++)
     {
-        float maxCo = std::min(frame->goodCodes, frames.at(i)->goodCodes);
+        const Frame * frame = frames.at(i);
+
+        writer.write<int32_t>(frame->id);
+        writer.write<int32_t>(frame->srcTime);
+        writer.write(frame->pose);
+        writer.write<int32_t>(frame->goodCodes);
+        writer.write(frame->codes, num);
+
+        writer.write<uint8_t>(frame->initRgb != 0);
+        writer.write<uint8_t>(frame->initVerts != 0);
+        writer.write<uint8_t>(frame->initNorms != 0);
+
+        if(frame->initRgb)
+        {
+            writer.write(frame->initRgb, width * height * 3);
+        }
+
+        if(frame->initVerts)
+        {
+            writer.write(frame->initVerts, width * height);
+        }
+
+        if(frame->initNorms)
+        {
+            writer.write(frame->initNorms, width * height);
+        }
+    }
+}
+
+bool Ferns::stage(CheckpointReader & reader, Staged & staged)
+{
+    int32_t savedNum = 0, savedWidth = 0, savedHeight = 0;
+
+    if(!reader.read(savedNum) || !reader.read(savedWidth) || !reader.read(savedHeight) ||
+       savedNum != num || savedWidth != width || savedHeight != height)
+    {
+        return false;
+    }
 
-        float dissim = (float)(maxCo - coOccurrences[i]) / (float)maxCo;
+    staged.conservatory.resize(num);
+
+    for(int i = 0; i < num; i++)
+    {
+        if(!reader.read(staged.conservatory.at(i).pos) || !reader.read(staged.conservatory.at(i).rgbd))
+        {
+            return false;
+        }
 
-        if(dissim < minimum && time - frames.at(i)->srcTime > 300)
+        for(int j = 0; j < 16; j++)
         {
-            minimum = dissim;
-            minId = i;
+            if(!reader.read(staged.conservatory.at(i).ids[j]))
+            {
+                return false;
+            }
         }
     }
 
-    delete [] coOccurrences;
+    uint64_t numFrames = 0;
 
-    Eigen::Matrix4f estPose = Eigen::Matrix4f::Identity();
+    if(!reader.read(numFrames))
+    {
+        return false;
+    }
 
-    if(minId != -1 && blockHDAware(frame, frames.at(minId)) > 0.3)
+    for(uint64_t i = 0; i < numFrames; i++)
     {
-        Eigen::Matrix4f fernPose = frames.at(minId)->pose;
+        int32_t id = 0, srcTime = 0, goodCodes = 0;
+        Eigen::Matrix4f pose;
+        const unsigned char * codes = 0;
+        uint8_t hasRgb = 0, hasVerts = 0, hasNorms = 0;
+        const unsigned char * rgb = 0;
+        const Eigen::Vector4f * verts = 0;
+        const Eigen::Vector4f * norms = 0;
+
+        if(!reader.read(id) || !reader.read(srcTime) || !reader.read(pose) || !reader.read(goodCodes) || !reader.read(codes, num) ||
+           !reader.read(hasRgb) || !reader.read(hasVerts) || !reader.read(hasNorms) ||
+           (hasRgb && !reader.read(rgb, width * height * 3)) ||
+           (hasVerts && !reader.read(verts, width * height)) ||
+           (hasNorms && !reader.read(norms, width * height)))
+        {
+            return false;
+        }
 
-        vertFern.texture->Upload(frames.at(minId)->initVerts, GL_RGBA, GL_FLOAT);
-        vertCurrent.texture->Upload(vertSmall.data, GL_RGBA, GL_FLOAT);
+        //Frame copies the images out of the mapped file
+        Frame * frame = new Frame(num, id, pose, srcTime, width * height, (unsigned char *)rgb, (Eigen::Vector4f *)verts, (Eigen::Vector4f *)norms);
 
-        normFern.texture->Upload(frames.at(minId)->initNorms, GL_RGBA, GL_FLOAT);
-        normCurrent.texture->Upload(normSmall.data, GL_RGBA, GL_FLOAT);
+        memcpy(frame->codes, codes, num);
+        frame->goodCodes = goodCodes;
 
-//        colorFern.texture->Upload(frames.at(minId)->initRgb, GL_RGB, GL_UNSIGNED_BYTE);
-//        colorCurrent.texture->Upload(imgSmall.data, GL_RGB, GL_UNSIGNED_BYTE);
+        staged.frames.push_back(frame);
+    }
 
-        //WARNING initICP* must be called before initRGB*
-        rgbd.initICPModel(&vertFern, &normFern, (float)maxDepth / 1000.0f, fernPose);
-//        rgbd.initRGBModel(&colorFern);
+    return true;
+}
 
-        rgbd.initICP(&vertCurrent, &normCurrent, (float)maxDepth / 1000.0f);
-//        rgbd.initRGB(&colorCurrent);
+void Ferns::commit(Staged & staged)
+{
+    //Let an in flight lookup finish with the old frames, then throw its result away
+    {
+        std::unique_lock<std::mutex> lock(lookupMutex);
+        lookupCond.wait(lock, [this]{ return !lookupPending || lookupDone; });
+        lookupPending = false;
+    }
 
-        Eigen::Vector3f trans = fernPose.topRightCorner(3, 1);
-        Eigen::Matrix<float, 3, 3, Eigen::RowMajor> rot = fernPose.topLeftCorner(3, 3);
+    std::lock_guard<std::mutex> lock(framesMutex);
 
-        TICK("fernOdom");
-        rgbd.getIncrementalTransformation(trans,
-                                          rot,
-                                          false,
-                                          100,
-                                          false,
-                                          false,
-                                          false);
-        TOCK("fernOdom");
+    //The old frames go when staged does
+    frames.swap(staged.frames);
+    conservatory.swap(staged.conservatory);
 
-        estPose.topRightCorner(3, 1) = trans;
-        estPose.topLeftCorner(3, 3) = rot;
+    lastClosest = -1;
+}
 
-        float photoError = photometricCheck(vertSmall, imgSmall, estPose, fernPose, frames.at(minId)->initRgb);
+int Ferns::findClosest(Frame * frame,
+                       std::vector<int> & coOccurrences,
+                       const Img<Eigen::Vector4f> & vertSmall,
+                       const Img<Eigen::Matrix<unsigned char, 3, 1>> & imgSmall,
+                       const int time)
+{
+    encode(frame, vertSmall, imgSmall);
 
-        int icpCountThresh = lost ? 1400 : 2400;
+    countCoOccurrences(frame, coOccurrences);
 
-//        std::cout << rgbd.lastICPError << ", " << rgbd.lastICPCount << ", " << photoError << std::endl;
+    //Chunks are combined in order and ties keep the earlier frame, same as a sequential scan
+    std::pair<float, int> closest = ThreadPool::getInstance().parallelReduce(0, (int)frames.size(), 256, std::make_pair(std::numeric_limits<float>::max(), -1),
+    [&](const int start, const int end)
+    {
+        std::pair<float, int> chunkClosest(std::numeric_limits<float>::max(), -1);
 
-        if(rgbd.lastICPError < 0.0003 && rgbd.lastICPCount > icpCountThresh && photoError < photoThresh)
+        for(int i = start; i < end; i++)
         {
-            lastClosest = minId;
+            float maxCo = std::min(frame->goodCodes, frames.at(i)->goodCodes);
+
+            float dissim = (float)(maxCo - coOccurrences[i]) / (float)maxCo;
 
-            for(int i = 0; i < num; i += num / 50)
+            if(dissim < chunkClosest.first && time - frames.at(i)->srcTime > 300)
             {
-                if(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2) > 0 &&
-                   int(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2) * 1000.0f) < maxDepth)
-                {
-                    Eigen::Vector4f worldRawPoint = currPose * Eigen::Vector4f(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(0),
-                                                                               vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(1),
-                                                                               vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2),
-                                                                               1.0f);
+                chunkClosest = std::make_pair(dissim, i);
+            }
+        }
 
-                    Eigen::Vector4f worldModelPoint = estPose * Eigen::Vector4f(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(0),
-                                                                                vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(1),
-                                                                                vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2),
-                                                                                1.0f);
+        return chunkClosest;
+    },
+    [](const std::pair<float, int> & a, const std::pair<float, int> & b) { return b.first < a.first ? b : a; });
 
-                    constraints.push_back(SurfaceConstraint(worldRawPoint, worldModelPoint));
-                }
+    int minId = closest.second;
+
+    if(minId != -1 && blockHDAware(frame, frames.at(minId)) > 0.3)
+    {
+        return minId;
+    }
+
+    return -1;
+}
+
+void Ferns::encode(Frame * frame,
+                   const Img<Eigen::Vector4f> & verts,
+                   const Img<Eigen::Matrix<unsigned char, 3, 1>> & img)
+{
+    frame->goodCodes = ThreadPool::getInstance().parallelReduce(0, num, 64, 0,
+    [&](const int start, const int end)
+    {
+        int goodCodes = 0;
+
+        for(int i = start; i < end; i++)
+        {
+            unsigned char code = badCode;
+
+            if(verts.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2) > 0)
+            {
+                const Eigen::Matrix<unsigned char, 3, 1> & pix = img.at<Eigen::Matrix<unsigned char, 3, 1>>(conservatory.at(i).pos(1), conservatory.at(i).pos(0));
+
+                code = (pix(0) > conservatory.at(i).rgbd(0)) << 3 |
+                       (pix(1) > conservatory.at(i).rgbd(1)) << 2 |
+                       (pix(2) > conservatory.at(i).rgbd(2)) << 1 |
+                       (int(verts.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2) * 1000.0f) > conservatory.at(i).rgbd(3));
+
+                goodCodes++;
+            }
+
+            frame->codes[i] = code;
+        }
+
+        return goodCodes;
+    },
+    [](const int a, const int b) { return a + b; });
+}
+
+void Ferns::countCoOccurrences(const Frame * frame, std::vector<int> & coOccurrences)
+{
+    coOccurrences.assign(frames.size(), 0);
+
+    //Scattered increments, cheaper to leave this one serial
+    for(int i = 0; i < num; i++)
+    {
+        const unsigned char code = frame->codes[i];
+
+        if(code != badCode)
+        {
+            for(size_t j = 0; j < conservatory.at(i).ids[code].size(); j++)
+            {
+                coOccurrences[conservatory.at(i).ids[code].at(j)]++;
             }
         }
     }
+}
 
-    delete frame;
+bool Ferns::verifyFrame(const Frame * fern,
+                        const Eigen::Matrix4f & fernPose,
+                        const Img<Eigen::Vector4f> & vertSmall,
+                        const Img<Eigen::Vector4f> & normSmall,
+                        const Img<Eigen::Matrix<unsigned char, 3, 1>> & imgSmall,
+                        const bool lost,
+                        Eigen::Matrix4f & estPose)
+{
+    //WARNING initICP* must be called before initRGB*
+    rgbd.initICPModel(fern->initVerts, fern->initNorms, (float)maxDepth / 1000.0f, fernPose);
 
-    return estPose;
+    assert(vertSmall.stride == normSmall.stride);
+    rgbd.initICP((const Eigen::Vector4f *)vertSmall.data, (const Eigen::Vector4f *)normSmall.data, (float)maxDepth / 1000.0f, vertSmall.stride);
+
+    Eigen::Vector3f trans = fernPose.topRightCorner(3, 1);
+    Eigen::Matrix<float, 3, 3, Eigen::RowMajor> rot = fernPose.topLeftCorner(3, 3);
+
+    TICK("fernOdom");
+    rgbd.getIncrementalTransformation(trans,
+                                      rot,
+                                      false,
+                                      100,
+                                      false,
+                                      false,
+                                      false);
+    TOCK("fernOdom");
+
+    estPose.topRightCorner(3, 1) = trans;
+    estPose.topLeftCorner(3, 3) = rot;
+
+    float photoError = photometricCheck(vertSmall, imgSmall, estPose, fernPose, fern->initRgb);
+
+    int icpCountThresh = lost ? 1400 : 2400;
+
+//    std::cout << rgbd.lastICPError << ", " << rgbd.lastICPCount << ", " << photoError << std::endl;
+
+    return rgbd.lastICPError < 0.0003 && rgbd.lastICPCount > icpCountThresh && photoError < photoThresh;
+}
+
+void Ferns::getConstraints(std::vector<SurfaceConstraint> & constraints,
+                           const Img<Eigen::Vector4f> & vertSmall,
+                           const Eigen::Matrix4f & currPose,
+                           const Eigen::Matrix4f & estPose)
+{
+    for(int i = 0; i < num; i += num / 50)
+    {
+        if(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2) > 0 &&
+           int(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2) * 1000.0f) < maxDepth)
+        {
+            Eigen::Vector4f worldRawPoint = currPose * Eigen::Vector4f(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(0),
+                                                                       vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(1),
+                                                                       vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2),
+                                                                       1.0f);
+
+            Eigen::Vector4f worldModelPoint = estPose * Eigen::Vector4f(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(0),
+                                                                        vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(1),
+                                                                        vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2),
+                                                                        1.0f);
+
+            constraints.push_back(SurfaceConstraint(worldRawPoint, worldModelPoint));
+        }
+    }
 }
 
 float Ferns::photometricCheck(const Img<Eigen::Vector4f> & vertSmall,
@@ -319,37 +638,47 @@ float Ferns::photometricCheck(const Img<Eigen::Vector4f> & vertSmall,
 
     Img<Eigen::Matrix<unsigned char, 3, 1>> imgFern(height, width, (Eigen::Matrix<unsigned char, 3, 1> *)fernRgb);
 
-    float photoSum = 0;
-    int photoCount = 0;
+    const Eigen::Matrix4f diff = fernPose.inverse() * estPose;
 
-    for(int i = 0; i < num; i++)
+    //Sum and count of the absolute differences, integers so the result doesn't depend on the split
+    Eigen::Vector2i photo = ThreadPool::getInstance().parallelReduce(0, num, 64, Eigen::Vector2i(0, 0),
+    [&](const int start, const int end)
     {
-        if(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2) > 0 &&
-           int(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2) * 1000.0f) < maxDepth)
-        {
-            Eigen::Vector4f vertPoint = Eigen::Vector4f(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(0),
-                                                        vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(1),
-                                                        vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2),
-                                                        1.0f);
+        Eigen::Vector2i chunkPhoto(0, 0);
 
-            Eigen::Matrix4f diff = fernPose.inverse() * estPose;
+        for(int i = start; i < end; i++)
+        {
+            if(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2) > 0 &&
+               int(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2) * 1000.0f) < maxDepth)
+            {
+                Eigen::Vector4f vertPoint = Eigen::Vector4f(vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(0),
+                                                            vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(1),
+                                                            vertSmall.at<Eigen::Vector4f>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2),
+                                                            1.0f);
 
-            Eigen::Vector4f worldCorrPoint = diff * vertPoint;
+                Eigen::Vector4f worldCorrPoint = diff * vertPoint;
 
-            Eigen::Vector2i correspondence((worldCorrPoint(0) * (1/invfx) / worldCorrPoint(2) + cx), (worldCorrPoint(1) * (1/invfy) / worldCorrPoint(2) + cy));
+                Eigen::Vector2i correspondence((worldCorrPoint(0) * (1/invfx) / worldCorrPoint(2) + cx), (worldCorrPoint(1) * (1/invfy) / worldCorrPoint(2) + cy));
 
-            if(correspondence(0) >= 0 && correspondence(1) >= 0 && correspondence(0) < width && correspondence(1) < height &&
-               (imgFern.at<Eigen::Matrix<unsigned char, 3, 1>>(correspondence(1), correspondence(0))(0) > 0 ||
-                imgFern.at<Eigen::Matrix<unsigned char, 3, 1>>(correspondence(1), correspondence(0))(1) > 0 ||
-                imgFern.at<Eigen::Matrix<unsigned char, 3, 1>>(correspondence(1), correspondence(0))(2) > 0))
-            {
-                photoSum += abs((int)imgFern.at<Eigen::Matrix<unsigned char, 3, 1>>(correspondence(1), correspondence(0))(0) - (int)imgSmall.at<Eigen::Matrix<unsigned char, 3, 1>>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(0));
-                photoSum += abs((int)imgFern.at<Eigen::Matrix<unsigned char, 3, 1>>(correspondence(1), correspondence(0))(1) - (int)imgSmall.at<Eigen::Matrix<unsigned char, 3, 1>>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(1));
-                photoSum += abs((int)imgFern.at<Eigen::Matrix<unsigned char, 3, 1>>(correspondence(1), correspondence(0))(2) - (int)imgSmall.at<Eigen::Matrix<unsigned char, 3, 1>>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2));
-                photoCount++;
+                if(correspondence(0) >= 0 && correspondence(1) >= 0 && correspondence(0) < width && correspondence(1) < height &&
+                   (imgFern.at<Eigen::Matrix<unsigned char, 3, 1>>(correspondence(1), correspondence(0))(0) > 0 ||
+                    imgFern.at<Eigen::Matrix<unsigned char, 3, 1>>(correspondence(1), correspondence(0))(1) > 0 ||
+                    imgFern.at<Eigen::Matrix<unsigned char, 3, 1>>(correspondence(1), correspondence(0))(2) > 0))
+                {
+                    chunkPhoto(0) += abs((int)imgFern.at<Eigen::Matrix<unsigned char, 3, 1>>(correspondence(1), correspondence(0))(0) - (int)imgSmall.at<Eigen::Matrix<unsigned char, 3, 1>>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(0));
+                    chunkPhoto(0) += abs((int)imgFern.at<Eigen::Matrix<unsigned char, 3, 1>>(correspondence(1), correspondence(0))(1) - (int)imgSmall.at<Eigen::Matrix<unsigned char, 3, 1>>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(1));
+                    chunkPhoto(0) += abs((int)imgFern.at<Eigen::Matrix<unsigned char, 3, 1>>(correspondence(1), correspondence(0))(2) - (int)imgSmall.at<Eigen::Matrix<unsigned char, 3, 1>>(conservatory.at(i).pos(1), conservatory.at(i).pos(0))(2));
+                    chunkPhoto(1)++;
+                }
             }
         }
-    }
+
+        return chunkPhoto;
+    },
+    [](const Eigen::Vector2i & a, const Eigen::Vector2i & b) { return Eigen::Vector2i(a + b); });
+
+    float photoSum = photo(0);
+    int photoCount = photo(1);
 
     return photoSum / float(photoCount);
 }
@@ -24,10 +24,15 @@
 #include <Eigen/LU>
 #include <vector>
 #include <limits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "Utils/Resolution.h"
 #include "Utils/Intrinsics.h"
 #include "Utils/RGBDOdometry.h"
+#include "Utils/ThreadPool.h"
+#include "Utils/Checkpoint.h"
 #include "Shaders/Resize.h"
 
 class Ferns
@@ -59,6 +64,34 @@ class Ferns
                                   const int time,
                                   const bool lost);
 
+        /**
+         * Queues the current view for lookup and verification on the relocalisation thread.
+         * Ignored if the previous lookup hasn't been collected yet
+         */
+        void findFrameAsync(const Eigen::Matrix4f & currPose,
+                            GPUTexture * vertexTexture,
+                            GPUTexture * normalTexture,
+                            GPUTexture * imageTexture,
+                            const int time,
+                            const bool lost);
+
+        /**
+         * Collects a finished asynchronous lookup and sets lastClosest
+         * @param recoveryPose pose of the queried view against the matched fern
+         * @param queryPose tracked pose of the queried view
+         * @param queryTime time the queried view was submitted with
+         * @return true if a lookup finished since the last call
+         */
+        bool getFrameResult(std::vector<SurfaceConstraint> & constraints,
+                            Eigen::Matrix4f & recoveryPose,
+                            Eigen::Matrix4f & queryPose,
+                            int & queryTime);
+
+        /**
+         * Writes the conservatory and every keyframe into a checkpoint
+         */
+        void save(CheckpointWriter & writer);
+
         class Fern
         {
             public:
@@ -136,6 +169,39 @@ class Ferns
                 Eigen::Vector4f * initNorms;
         };
 
+        /**
+         * A checkpoint's conservatory and keyframes, read and checked but not in use yet
+         */
+        class Staged
+        {
+            public:
+                Staged() {}
+                Staged(const Staged &) = delete;
+                Staged & operator=(const Staged &) = delete;
+
+                virtual ~Staged()
+                {
+                    for(size_t i = 0; i < frames.size(); i++)
+                    {
+                        delete frames.at(i);
+                    }
+                }
+
+                std::vector<Fern> conservatory;
+                std::vector<Frame*> frames;
+        };
+
+        /**
+         * Reads the conservatory and keyframes out of a checkpoint without touching the current ones
+         * @return false if the checkpoint was made with a different number of ferns or resolution
+         */
+        bool stage(CheckpointReader & reader, Staged & staged);
+
+        /**
+         * Swaps in what stage read, drops any pending asynchronous lookup
+         */
+        void commit(Staged & staged);
+
         std::vector<Frame*> frames;
 
         const int num;
@@ -157,6 +223,33 @@ class Ferns
     private:
         void generateFerns();
 
+        void encode(Frame * frame,
+                    const Img<Eigen::Vector4f> & verts,
+                    const Img<Eigen::Matrix<unsigned char, 3, 1>> & img);
+
+        void countCoOccurrences(const Frame * frame, std::vector<int> & coOccurrences);
+
+        int findClosest(Frame * frame,
+                        std::vector<int> & coOccurrences,
+                        const Img<Eigen::Vector4f> & vertSmall,
+                        const Img<Eigen::Matrix<unsigned char, 3, 1>> & imgSmall,
+                        const int time);
+
+        bool verifyFrame(const Frame * fern,
+                         const Eigen::Matrix4f & fernPose,
+                         const Img<Eigen::Vector4f> & vertSmall,
+                         const Img<Eigen::Vector4f> & normSmall,
+                         const Img<Eigen::Matrix<unsigned char, 3, 1>> & imgSmall,
+                         const bool lost,
+                         Eigen::Matrix4f & estPose);
+
+        void getConstraints(std::vector<SurfaceConstraint> & constraints,
+                            const Img<Eigen::Vector4f> & vertSmall,
+                            const Eigen::Matrix4f & currPose,
+                            const Eigen::Matrix4f & estPose);
+
+        void lookupLoop();
+
         float blockHD(const Frame * f1, const Frame * f2);
         float blockHDAware(const Frame * f1, const Frame * f2);
 
@@ -166,12 +259,6 @@ class Ferns
                                const Eigen::Matrix4f & fernPose,
                                const unsigned char * fernRgb);
 
-        GPUTexture vertFern;
-        GPUTexture vertCurrent;
-
-        GPUTexture normFern;
-        GPUTexture normCurrent;
-
         GPUTexture colorFern;
         GPUTexture colorCurrent;
 
@@ -180,6 +267,33 @@ class Ferns
         Img<Eigen::Matrix<unsigned char, 3, 1>> imageBuff;
         Img<Eigen::Vector4f> vertBuff;
         Img<Eigen::Vector4f> normBuff;
+
+        //Reused every frame by addFrame/findFrame, the lookup thread has its own
+        Frame scratchFrame;
+        std::vector<int> coOccurrences;
+
+        Frame lookupFrame;
+        std::vector<int> lookupCoOccurrences;
+
+        //Guards frames and conservatory against the lookup thread
+        std::mutex framesMutex;
+
+        std::thread lookupThread;
+        std::mutex lookupMutex;
+        std::condition_variable lookupCond;
+        bool lookupPending;
+        bool lookupDone;
+        bool lookupShutdown;
+
+        //Only touched by the lookup thread while a lookup is pending
+        Img<Eigen::Matrix<unsigned char, 3, 1>> queryImg;
+        Img<Eigen::Vector4f> queryVerts;
+        Img<Eigen::Vector4f> queryNorms;
+        Eigen::Matrix4f queryPose;
+        int queryTime;
+        bool queryLost;
+        int queryClosest;
+        Eigen::Matrix4f queryRelative;
 };
 
 #endif /* FERNS_H_ */
@@ -22,13 +22,22 @@ const int GlobalModel::TEXTURE_DIMENSION = 3072;
 const int GlobalModel::MAX_VERTICES = GlobalModel::TEXTURE_DIMENSION * GlobalModel::TEXTURE_DIMENSION;
 const int GlobalModel::NODE_TEXTURE_DIMENSION = 16384;
 const int GlobalModel::MAX_NODES = GlobalModel::NODE_TEXTURE_DIMENSION / 16; //16 floats per node
+const float GlobalModel::LOW_WATER = 0.9f;
+const float GlobalModel::AGE_SCALE = 3000.0f; //Frames, about a minute and a half at 30Hz
 
 GlobalModel::GlobalModel()
  : target(0),
    renderSource(1),
    bufferSize(MAX_VERTICES * Vertex::SIZE),
    count(0),
+   newUnstableCount(0),
+   nextId(0),
+   rewrites(0),
    initProgram(loadProgramFromFile("init_unstable.vert")),
+   copyProgram(loadProgramFromFile("copy_surfels.vert")),
+   filterProgram(loadProgramGeomFromFile("filter_surfels.vert", "copy_unstable.geom")),
+   budgetProgram(loadProgramGeomFromFile("budget_surfels.vert", "copy_unstable.geom")),
+   pageProgram(loadProgramGeomFromFile("page_surfels.vert", "copy_unstable.geom")),
    drawProgram(loadProgramFromFile("draw_feedback.vert", "draw_feedback.frag")),
    drawSurfelProgram(loadProgramFromFile("draw_global_surface.vert", "draw_global_surface.frag", "draw_global_surface.geom")),
    dataProgram(loadProgramFromFile("data.vert", "data.frag", "data.geom")),
@@ -38,8 +47,11 @@ GlobalModel::GlobalModel()
    updateMapVertsConfs(TEXTURE_DIMENSION, TEXTURE_DIMENSION, GL_RGBA32F, GL_LUMINANCE, GL_FLOAT),
    updateMapColorsTime(TEXTURE_DIMENSION, TEXTURE_DIMENSION, GL_RGBA32F, GL_LUMINANCE, GL_FLOAT),
    updateMapNormsRadii(TEXTURE_DIMENSION, TEXTURE_DIMENSION, GL_RGBA32F, GL_LUMINANCE, GL_FLOAT),
-   deformationNodes(NODE_TEXTURE_DIMENSION, 1, GL_LUMINANCE32F_ARB, GL_LUMINANCE, GL_FLOAT)
+   deformationNodes(NODE_TEXTURE_DIMENSION, 1, GL_LUMINANCE32F_ARB, GL_LUMINANCE, GL_FLOAT),
+   filterCapacity(0)
 {
+    memset(&budgetStats, 0, sizeof(BudgetStats));
+
     vbos = new std::pair<GLuint, GLuint>[2];
 
     float * vertices = new float[bufferSize];
@@ -72,6 +84,9 @@ GlobalModel::GlobalModel()
 
     delete [] vertices;
 
+    glGenTransformFeedbacks(1, &filterFid);
+    glGenBuffers(1, &filterVbo);
+
     std::vector<Eigen::Vector2f> uv;
 
     for(int i = 0; i < Resolution::getInstance().width(); i++)
@@ -134,6 +149,58 @@ GlobalModel::GlobalModel()
 
     unstableProgram->Unbind();
 
+    copyProgram->Bind();
+
+    int copyUpdate[3] =
+    {
+        glGetVaryingLocationNV(copyProgram->programId(), "vPosition0"),
+        glGetVaryingLocationNV(copyProgram->programId(), "vColor0"),
+        glGetVaryingLocationNV(copyProgram->programId(), "vNormRad0"),
+    };
+
+    glTransformFeedbackVaryingsNV(copyProgram->programId(), 3, copyUpdate, GL_INTERLEAVED_ATTRIBS);
+
+    copyProgram->Unbind();
+
+    filterProgram->Bind();
+
+    int filterUpdate[3] =
+    {
+        glGetVaryingLocationNV(filterProgram->programId(), "vPosition0"),
+        glGetVaryingLocationNV(filterProgram->programId(), "vColor0"),
+        glGetVaryingLocationNV(filterProgram->programId(), "vNormRad0"),
+    };
+
+    glTransformFeedbackVaryingsNV(filterProgram->programId(), 3, filterUpdate, GL_INTERLEAVED_ATTRIBS);
+
+    filterProgram->Unbind();
+
+    budgetProgram->Bind();
+
+    int budgetUpdate[3] =
+    {
+        glGetVaryingLocationNV(budgetProgram->programId(), "vPosition0"),
+        glGetVaryingLocationNV(budgetProgram->programId(), "vColor0"),
+        glGetVaryingLocationNV(budgetProgram->programId(), "vNormRad0"),
+    };
+
+    glTransformFeedbackVaryingsNV(budgetProgram->programId(), 3, budgetUpdate, GL_INTERLEAVED_ATTRIBS);
+
+    budgetProgram->Unbind();
+
+    pageProgram->Bind();
+
+    int pageUpdate[3] =
+    {
+        glGetVaryingLocationNV(pageProgram->programId(), "vPosition0"),
+        glGetVaryingLocationNV(pageProgram->programId(), "vColor0"),
+        glGetVaryingLocationNV(pageProgram->programId(), "vNormRad0"),
+    };
+
+    glTransformFeedbackVaryingsNV(pageProgram->programId(), 3, pageUpdate, GL_INTERLEAVED_ATTRIBS);
+
+    pageProgram->Unbind();
+
     initProgram->Bind();
 
     int locInit[3] =
@@ -146,6 +213,8 @@ GlobalModel::GlobalModel()
     glTransformFeedbackVaryingsNV(initProgram->programId(), 3, locInit, GL_INTERLEAVED_ATTRIBS);
 
     glGenQueries(1, &countQuery);
+    glGenQueries(1, &newUnstableQuery);
+    glGenQueries(1, &keptQuery);
 
     //Empty both transform feedbacks
     glEnable(GL_RASTERIZER_DISCARD);
@@ -188,12 +257,17 @@ GlobalModel::~GlobalModel()
     glDeleteTransformFeedbacks(1, &vbos[1].second);
 
     glDeleteQueries(1, &countQuery);
+    glDeleteQueries(1, &newUnstableQuery);
+    glDeleteQueries(1, &keptQuery);
 
     glDeleteBuffers(1, &uvo);
 
     glDeleteTransformFeedbacks(1, &newUnstableFid);
     glDeleteBuffers(1, &newUnstableVbo);
 
+    glDeleteTransformFeedbacks(1, &filterFid);
+    glDeleteBuffers(1, &filterVbo);
+
     delete [] vbos;
 }
 
@@ -244,6 +318,10 @@ void GlobalModel::initialise(const FeedbackBuffer & rawFeedback,
 
     initProgram->Unbind();
 
+    //init_unstable.vert numbers the first surfels by vertex
+    nextId = count;
+    rewrites++;
+
     glFinish();
 }
 
@@ -385,8 +463,12 @@ void GlobalModel::fuse(const Eigen::Matrix4f & pose,
 
     glBeginTransformFeedback(GL_POINTS);
 
+    glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, newUnstableQuery);
+
     glDrawArrays(GL_POINTS, 0, uvSize);
 
+    glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+
     glEndTransformFeedback();
 
     frameBuffer.Unbind();
@@ -404,6 +486,9 @@ void GlobalModel::fuse(const Eigen::Matrix4f & pose,
     glPopAttrib();
 
     glFinish();
+
+    //Needed to hand out ids to the new surfels in clean()
+    glGetQueryObjectuiv(newUnstableQuery, GL_QUERY_RESULT, &newUnstableCount);
     TOCK("Fuse::Data");
 
     TICK("Fuse::Update");
@@ -488,6 +573,18 @@ void GlobalModel::clean(const Eigen::Matrix4f & pose,
         //Can be optimised by only uploading new nodes with offset
         glBindTexture(GL_TEXTURE_2D, deformationNodes.texture->tid);
         glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, graph.size(), 1, GL_LUMINANCE, GL_FLOAT, graph.data());
+
+        //Surfels out of view get moved without their timestamps changing
+        rewrites++;
+    }
+
+    //Over the budget with nothing left to evict the shrunk buffers would silently drop surfels
+    reserve(count + newUnstableCount);
+
+    //Most new unstable surfels are cleaned away again but still use up ids, compact them before they run out
+    if(nextId > Vertex::MAX_ID - newUnstableCount)
+    {
+        renumber();
     }
 
     TICK("Fuse::Copy");
@@ -507,6 +604,7 @@ void GlobalModel::clean(const Eigen::Matrix4f & pose,
     unstableProgram->setUniform(Uniform("timeDelta", timeDelta));
     unstableProgram->setUniform(Uniform("maxDepth", maxDepth));
     unstableProgram->setUniform(Uniform("isFern", (int)isFern));
+    unstableProgram->setUniform(Uniform("idBase", (int)nextId));
 
     Eigen::Matrix4f t_inv = pose.inverse();
     unstableProgram->setUniform(Uniform("t_inv", t_inv));
@@ -593,8 +691,150 @@ void GlobalModel::clean(const Eigen::Matrix4f & pose,
 
     std::swap(target, renderSource);
 
+    nextId += newUnstableCount;
+    newUnstableCount = 0;
+
     glFinish();
     TOCK("Fuse::Copy");
+
+    if(budgetStats.budget > 0 && count > budgetStats.budget)
+    {
+        compact(time, timeDelta);
+    }
+}
+
+void GlobalModel::compact(const int & time, const int timeDelta)
+{
+    TICK("Fuse::Compact");
+
+    const unsigned long long int start = Stopwatch::getCurrentSystemTime();
+    const unsigned int before = count;
+    const unsigned int goal = budgetStats.budget * LOW_WATER;
+
+    budgetProgram->Bind();
+    budgetProgram->setUniform(Uniform("time", time));
+    budgetProgram->setUniform(Uniform("timeDelta", timeDelta));
+    budgetProgram->setUniform(Uniform("ageScale", AGE_SCALE));
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[target].first);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, 0);
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, reinterpret_cast<GLvoid*>(sizeof(Eigen::Vector4f)));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, reinterpret_cast<GLvoid*>(sizeof(Eigen::Vector4f) * 2));
+
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    //Find the lowest value threshold that gets us down to the goal, in log space since values span orders of magnitude.
+    //Each step is a count only pass over the map, nothing is written or read back
+    float lo = 1e-4f;
+    float hi = 1e6f;
+
+    if(countKept(hi) <= goal)
+    {
+        for(int i = 0; i < BISECTIONS; i++)
+        {
+            const float mid = std::sqrt(lo * hi);
+
+            if(countKept(mid) > goal)
+            {
+                lo = mid;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+    }
+
+    budgetProgram->setUniform(Uniform("threshold", hi));
+
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, vbos[renderSource].second);
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, vbos[renderSource].first);
+
+    glBeginTransformFeedback(GL_POINTS);
+
+    glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, countQuery);
+
+    glDrawTransformFeedback(GL_POINTS, vbos[target].second);
+
+    glEndTransformFeedback();
+
+    glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+
+    glGetQueryObjectuiv(countQuery, GL_QUERY_RESULT, &count);
+
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glDisableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+
+    budgetProgram->Unbind();
+
+    //Order is kept, so the map stays sorted by id
+    std::swap(target, renderSource);
+
+    glFinish();
+
+    budgetStats.compactions++;
+    budgetStats.lastEvicted = before - count;
+    budgetStats.evicted += budgetStats.lastEvicted;
+    budgetStats.lastThreshold = hi;
+    budgetStats.lastMs = (Stopwatch::getCurrentSystemTime() - start) / 1000.0f;
+    budgetStats.shortfall = count > budgetStats.budget ? count - budgetStats.budget : 0;
+
+    TOCK("Fuse::Compact");
+}
+
+unsigned int GlobalModel::countKept(const float threshold)
+{
+    unsigned int kept = 0;
+
+    budgetProgram->setUniform(Uniform("threshold", threshold));
+
+    glBeginQuery(GL_PRIMITIVES_GENERATED, keptQuery);
+
+    glDrawTransformFeedback(GL_POINTS, vbos[target].second);
+
+    glEndQuery(GL_PRIMITIVES_GENERATED);
+
+    glGetQueryObjectuiv(keptQuery, GL_QUERY_RESULT, &kept);
+
+    return kept;
+}
+
+void GlobalModel::setBudget(const unsigned int & val)
+{
+    budgetStats.budget = std::min(val, (unsigned int)MAX_VERTICES);
+
+    //One clean adds at most a frame of new surfels before the budget is enforced again
+    if(count == 0)
+    {
+        const int capacity = budgetStats.budget > 0 ? std::min(MAX_VERTICES, (int)budgetStats.budget + Resolution::getInstance().numPixels()) : MAX_VERTICES;
+
+        bufferSize = capacity * Vertex::SIZE;
+
+        for(int i = 0; i < 2; i++)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, vbos[i].first);
+            glBufferData(GL_ARRAY_BUFFER, bufferSize, 0, GL_STREAM_DRAW);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
+
+const GlobalModel::BudgetStats & GlobalModel::getBudgetStats()
+{
+    return budgetStats;
 }
 
 unsigned int GlobalModel::lastCount()
@@ -602,32 +842,547 @@ unsigned int GlobalModel::lastCount()
     return count;
 }
 
+unsigned int GlobalModel::lastRewrite()
+{
+    return rewrites;
+}
+
 Eigen::Vector4f * GlobalModel::downloadMap()
 {
     glFinish();
 
     Eigen::Vector4f * vertices = new Eigen::Vector4f[count * 3];
 
-    memset(&vertices[0], 0, count * Vertex::SIZE);
+    //Straight from the model buffer, no need for a staging copy
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[target].first);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, count * Vertex::SIZE, vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return vertices;
+}
+
+void GlobalModel::streamMap(const int windowSize, const std::function<void(const Eigen::Vector4f *, const int)> & f)
+{
+    glFinish();
+
+    mapWindows(vbos[target].first, count, windowSize, f);
+}
+
+void GlobalModel::streamMap(const float confidenceThreshold,
+                            const Eigen::AlignedBox3f & region,
+                            const int windowSize,
+                            const std::function<void(const Eigen::Vector4f *, const int)> & f)
+{
+    if(count == 0)
+    {
+        return;
+    }
+
+    //Everything could match, so there has to be room for the whole map
+    reserveFilter(count);
+
+    filterProgram->Bind();
+
+    filterProgram->setUniform(Uniform("threshold", confidenceThreshold));
+    filterProgram->setUniform(Uniform("useRegion", (int)!region.isEmpty()));
+    filterProgram->setUniform(Uniform("regionMin", Eigen::Vector3f(region.min())));
+    filterProgram->setUniform(Uniform("regionMax", Eigen::Vector3f(region.max())));
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[target].first);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, 0);
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, reinterpret_cast<GLvoid*>(sizeof(Eigen::Vector4f)));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, reinterpret_cast<GLvoid*>(sizeof(Eigen::Vector4f) * 2));
+
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, filterFid);
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, filterVbo);
+
+    glBeginTransformFeedback(GL_POINTS);
+
+    glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, countQuery);
+
+    glDrawTransformFeedback(GL_POINTS, vbos[target].second);
+
+    glEndTransformFeedback();
+
+    glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+
+    unsigned int matches = 0;
+
+    glGetQueryObjectuiv(countQuery, GL_QUERY_RESULT, &matches);
+
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glDisableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+
+    filterProgram->Unbind();
+
+    mapWindows(filterVbo, matches, windowSize, f);
+}
+
+void GlobalModel::reserveFilter(const int numSurfels)
+{
+    if(numSurfels > filterCapacity)
+    {
+        filterCapacity = std::min(MAX_VERTICES, numSurfels + numSurfels / 2);
+
+        glBindBuffer(GL_ARRAY_BUFFER, filterVbo);
+        glBufferData(GL_ARRAY_BUFFER, filterCapacity * Vertex::SIZE, 0, GL_STREAM_READ);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
+
+void GlobalModel::reserve(const unsigned int numSurfels)
+{
+    const int needed = std::min(MAX_VERTICES, (int)numSurfels);
+
+    if(needed <= bufferSize / Vertex::SIZE)
+    {
+        return;
+    }
+
+    //Leave some slack so a map hovering over its budget doesn't reallocate every frame
+    const int capacity = std::min(MAX_VERTICES, needed + needed / 4);
+    const int keep = count * Vertex::SIZE;
+
+    //Only target holds the map, renderSource is always written over before it's read
+    GLuint scratch = 0;
+
+    if(keep > 0)
+    {
+        glGenBuffers(1, &scratch);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+        glBufferData(GL_COPY_WRITE_BUFFER, keep, 0, GL_STREAM_COPY);
+        glBindBuffer(GL_COPY_READ_BUFFER, vbos[target].first);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, keep);
+    }
+
+    bufferSize = capacity * Vertex::SIZE;
+
+    //Same buffer names, so the transform feedback objects and their draw counts stay valid
+    for(int i = 0; i < 2; i++)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, vbos[i].first);
+        glBufferData(GL_ARRAY_BUFFER, bufferSize, 0, GL_STREAM_DRAW);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if(keep > 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, scratch);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbos[target].first);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, keep);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &scratch);
+    }
+}
+
+void GlobalModel::pageOut(const Eigen::Vector3f & camera,
+                          const int & time,
+                          const int timeDelta,
+                          const float blockSize,
+                          const float distance,
+                          std::vector<Eigen::Vector4f> & paged)
+{
+    paged.clear();
+
+    if(count == 0)
+    {
+        return;
+    }
+
+    reserveFilter(count);
+
+    pageProgram->Bind();
+
+    pageProgram->setUniform(Uniform("time", time));
+    pageProgram->setUniform(Uniform("timeDelta", timeDelta));
+    pageProgram->setUniform(Uniform("blockSize", blockSize));
+    pageProgram->setUniform(Uniform("camera", camera));
+    pageProgram->setUniform(Uniform("distance", distance));
+    pageProgram->setUniform(Uniform("paged", 1));
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[target].first);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, 0);
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, reinterpret_cast<GLvoid*>(sizeof(Eigen::Vector4f)));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, reinterpret_cast<GLvoid*>(sizeof(Eigen::Vector4f) * 2));
+
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    //First the surfels that go
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, filterFid);
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, filterVbo);
+
+    glBeginTransformFeedback(GL_POINTS);
+
+    glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, countQuery);
+
+    glDrawTransformFeedback(GL_POINTS, vbos[target].second);
+
+    glEndTransformFeedback();
+
+    glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+
+    unsigned int numPaged = 0;
+
+    glGetQueryObjectuiv(countQuery, GL_QUERY_RESULT, &numPaged);
+
+    //Then the ones that stay, in order
+    if(numPaged > 0)
+    {
+        pageProgram->setUniform(Uniform("paged", 0));
+
+        glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, vbos[renderSource].second);
+
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, vbos[renderSource].first);
+
+        glBeginTransformFeedback(GL_POINTS);
+
+        glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, countQuery);
+
+        glDrawTransformFeedback(GL_POINTS, vbos[target].second);
+
+        glEndTransformFeedback();
+
+        glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+
+        glGetQueryObjectuiv(countQuery, GL_QUERY_RESULT, &count);
+
+        std::swap(target, renderSource);
+    }
+
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glDisableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+
+    pageProgram->Unbind();
+
+    if(numPaged > 0)
+    {
+        paged.resize(numPaged * 3);
+
+        glBindBuffer(GL_ARRAY_BUFFER, filterVbo);
+        glGetBufferSubData(GL_ARRAY_BUFFER, 0, numPaged * Vertex::SIZE, paged.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
+
+void GlobalModel::append(const std::vector<Eigen::Vector4f> & surfels)
+{
+    reserve(count + surfels.size() / 3);
+
+    const int numSurfels = std::min((int)surfels.size() / 3, bufferSize / Vertex::SIZE - (int)count);
+
+    budgetStats.dropped += surfels.size() / 3 - std::max(numSurfels, 0);
+
+    if(numSurfels <= 0)
+    {
+        return;
+    }
+
+    reserveFilter(numSurfels);
+
+    if(nextId > Vertex::MAX_ID - numSurfels)
+    {
+        renumber();
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, filterVbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, numSurfels * Vertex::SIZE, surfels.data());
+
+    copyProgram->Bind();
+
+    copyProgram->setUniform(Uniform("renumber", 0));
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[target].first);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, 0);
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, reinterpret_cast<GLvoid*>(sizeof(Eigen::Vector4f)));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, reinterpret_cast<GLvoid*>(sizeof(Eigen::Vector4f) * 2));
+
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, vbos[renderSource].second);
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, vbos[renderSource].first);
+
+    glBeginTransformFeedback(GL_POINTS);
+
+    glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, countQuery);
+
+    glDrawTransformFeedback(GL_POINTS, vbos[target].second);
+
+    //The new surfels go on the end with the next ids
+    copyProgram->setUniform(Uniform("renumber", 1));
+    copyProgram->setUniform(Uniform("idBase", (int)nextId));
+
+    glBindBuffer(GL_ARRAY_BUFFER, filterVbo);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, 0);
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, reinterpret_cast<GLvoid*>(sizeof(Eigen::Vector4f)));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, reinterpret_cast<GLvoid*>(sizeof(Eigen::Vector4f) * 2));
+
+    glDrawArrays(GL_POINTS, 0, numSurfels);
+
+    glEndTransformFeedback();
+
+    glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+
+    glGetQueryObjectuiv(countQuery, GL_QUERY_RESULT, &count);
 
-    GLuint downloadVbo;
+    glDisable(GL_RASTERIZER_DISCARD);
 
-    glGenBuffers(1, &downloadVbo);
-    glBindBuffer(GL_ARRAY_BUFFER, downloadVbo);
-    glBufferData(GL_ARRAY_BUFFER, bufferSize, 0, GL_STREAM_DRAW);
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glDisableVertexAttribArray(2);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
 
-    glBindBuffer(GL_COPY_READ_BUFFER, vbos[renderSource].first);
-    glBindBuffer(GL_COPY_WRITE_BUFFER, downloadVbo);
+    copyProgram->Unbind();
 
-    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, count * Vertex::SIZE);
-    glGetBufferSubData(GL_COPY_WRITE_BUFFER, 0, count * Vertex::SIZE, vertices);
+    std::swap(target, renderSource);
+
+    nextId += numSurfels;
 
-    glBindBuffer(GL_COPY_READ_BUFFER, 0);
-    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
-    glDeleteBuffers(1, &downloadVbo);
+    //Their timestamps are old, so nothing tracking changes by timestamp would notice them
+    rewrites++;
 
     glFinish();
+}
 
-    return vertices;
+void GlobalModel::renumber()
+{
+    copyProgram->Bind();
+
+    //Numbering from 0 in buffer order keeps the ids sorted
+    copyProgram->setUniform(Uniform("renumber", 1));
+    copyProgram->setUniform(Uniform("idBase", 0));
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[target].first);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, 0);
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, reinterpret_cast<GLvoid*>(sizeof(Eigen::Vector4f)));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, reinterpret_cast<GLvoid*>(sizeof(Eigen::Vector4f) * 2));
+
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, vbos[renderSource].second);
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, vbos[renderSource].first);
+
+    glBeginTransformFeedback(GL_POINTS);
+
+    glDrawTransformFeedback(GL_POINTS, vbos[target].second);
+
+    glEndTransformFeedback();
+
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glDisableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+
+    copyProgram->Unbind();
+
+    std::swap(target, renderSource);
+
+    nextId = count;
+
+    //Every surfel has a new id, the journal has to start again from a keyframe
+    rewrites++;
+
+    glFinish();
+}
+
+void GlobalModel::mapWindows(const GLuint vbo, const unsigned int numSurfels, const int windowSize, const std::function<void(const Eigen::Vector4f *, const int)> & f)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+    for(unsigned int first = 0; first < numSurfels; first += windowSize)
+    {
+        const int n = std::min(numSurfels - first, (unsigned int)windowSize);
+
+        const Eigen::Vector4f * window = (const Eigen::Vector4f *)glMapBufferRange(GL_ARRAY_BUFFER, first * Vertex::SIZE, n * Vertex::SIZE, GL_MAP_READ_BIT);
+
+        if(!window)
+        {
+            break;
+        }
+
+        f(window, n);
+
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GlobalModel::save(CheckpointWriter & writer, MapPager * pager)
+{
+    glFinish();
+
+    if(pager)
+    {
+        pager->flush();
+    }
+
+    const uint32_t paged = pager ? pager->pagedSurfels() : 0;
+
+    if(nextId > Vertex::MAX_ID - paged)
+    {
+        renumber();
+    }
+
+    writer.write<uint32_t>(count + paged);
+    writer.write<uint32_t>(nextId + paged);
+
+    Eigen::Vector4f * vertices = writer.reserve<Eigen::Vector4f>((count + paged) * 3);
+
+    //The latest map always ends up in target
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[target].first);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, count * Vertex::SIZE, vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    //Paged out surfels go after the resident ones with the next ids, like append would give them
+    if(pager)
+    {
+        Eigen::Vector4f * out = vertices + count * 3;
+        uint32_t id = nextId;
+
+        memset(out, 0, paged * Vertex::SIZE);
+
+        pager->forEach([&](const Eigen::Vector4f * surfels, const int n)
+        {
+            memcpy(out, surfels, n * Vertex::SIZE);
+
+            for(int i = 0; i < n; i++)
+            {
+                Vertex::setId(&out[i * 3], id++);
+            }
+
+            out += n * 3;
+        });
+    }
+}
+
+bool GlobalModel::stage(CheckpointReader & reader, Staged & staged)
+{
+    staged.numVertices = 0;
+    staged.nextId = 0;
+    staged.vertices = 0;
+
+    //Version 1 checkpoints predate surfel ids, number them from scratch
+    staged.renumber = reader.getVersion() == 1;
+
+    if(!(reader.read(staged.numVertices) && (int)staged.numVertices <= MAX_VERTICES &&
+         (staged.renumber || reader.read(staged.nextId)) &&
+         reader.read(staged.vertices, staged.numVertices * 3)))
+    {
+        return false;
+    }
+
+    //Ids from a checkpoint that ran out of them can't be carried on from
+    staged.renumber = staged.renumber || staged.nextId > Vertex::MAX_ID;
+
+    return true;
+}
+
+void GlobalModel::commit(const Staged & staged)
+{
+    const uint32_t numVertices = staged.numVertices;
+
+    reserve(numVertices);
+
+    //Upload into the spare buffer, then copy across with a transform feedback so the draw count is right
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[renderSource].first);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, numVertices * Vertex::SIZE, staged.vertices);
+
+    copyProgram->Bind();
+
+    copyProgram->setUniform(Uniform("renumber", (int)staged.renumber));
+    copyProgram->setUniform(Uniform("idBase", 0));
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, 0);
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, reinterpret_cast<GLvoid*>(sizeof(Eigen::Vector4f)));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, Vertex::SIZE, reinterpret_cast<GLvoid*>(sizeof(Eigen::Vector4f) * 2));
+
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, vbos[target].second);
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, vbos[target].first);
+
+    glBeginTransformFeedback(GL_POINTS);
+
+    glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, countQuery);
+
+    glDrawArrays(GL_POINTS, 0, numVertices);
+
+    glEndTransformFeedback();
+
+    glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+
+    glGetQueryObjectuiv(countQuery, GL_QUERY_RESULT, &count);
+
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glDisableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+
+    copyProgram->Unbind();
+
+    nextId = staged.renumber ? count : staged.nextId;
+    rewrites++;
+
+    glFinish();
 }
@@ -27,8 +27,12 @@
 #include "IndexMap.h"
 #include "Utils/Stopwatch.h"
 #include "Utils/Intrinsics.h"
+#include "Utils/Checkpoint.h"
+#include "Utils/MapPager.h"
 #include <pangolin/gl/gl.h>
 #include <Eigen/LU>
+#include <Eigen/Geometry>
+#include <functional>
 
 #include "Defines.h"
 
@@ -46,6 +50,22 @@ class GlobalModel
         static const int NODE_TEXTURE_DIMENSION;
         static const int MAX_NODES;
 
+        struct BudgetStats
+        {
+            unsigned int budget;
+            unsigned int compactions;
+            unsigned long long int evicted;
+            unsigned int lastEvicted;
+            float lastThreshold;
+            float lastMs;
+
+            //Surfels still over the budget after the last compaction, i.e. everything left was active
+            unsigned int shortfall;
+
+            //Paged in surfels that didn't fit even at MAX_VERTICES
+            unsigned long long int dropped;
+        };
+
         EFUSION_API void renderPointCloud(pangolin::OpenGlMatrix mvp,
                               const float threshold,
                               const bool drawUnstable,
@@ -87,19 +107,129 @@ class GlobalModel
 
         EFUSION_API unsigned int lastCount();
 
+        /**
+         * Caps the map at this many surfels, 0 (the default) for no cap. Whenever clean leaves more than this the least
+         * valuable inactive surfels are evicted until the map is back down to LOW_WATER of it. Call before the first
+         * frame to also shrink the surfel buffers to fit, they grow again if the map can't be kept under the budget
+         * @param val
+         */
+        EFUSION_API void setBudget(const unsigned int & val);
+
+        EFUSION_API const BudgetStats & getBudgetStats();
+
+        /**
+         * Counts the times the whole map may have changed without surfel timestamps showing it (deformations, loads),
+         * anything tracking changes by timestamp has to start over when this moves on
+         */
+        EFUSION_API unsigned int lastRewrite();
+
+        /**
+         * Copies the whole map into a new[]ed array the caller has to delete[], streamMap avoids the copy
+         */
         Eigen::Vector4f * downloadMap();
 
+        /**
+         * Maps the surfel buffer a window at a time and hands each window to f, the whole map is never copied to the host
+         * @param windowSize surfels per window
+         * @param f called with the window's surfels (3 Eigen::Vector4f each) and how many there are
+         */
+        void streamMap(const int windowSize, const std::function<void(const Eigen::Vector4f *, const int)> & f);
+
+        /**
+         * As above but only for surfels above a confidence threshold and optionally inside a box. The filtering
+         * happens on the GPU, so only the matching surfels are ever read back
+         * @param region ignored if empty
+         */
+        void streamMap(const float confidenceThreshold,
+                       const Eigen::AlignedBox3f & region,
+                       const int windowSize,
+                       const std::function<void(const Eigen::Vector4f *, const int)> & f);
+
+        /**
+         * Takes the surfels of every block (blockSize cubed) with its centre further than distance from camera that
+         * hasn't been seen for timeDelta out of the map
+         * @param paged the surfels taken out, 3 Eigen::Vector4f each
+         */
+        void pageOut(const Eigen::Vector3f & camera,
+                     const int & time,
+                     const int timeDelta,
+                     const float blockSize,
+                     const float distance,
+                     std::vector<Eigen::Vector4f> & paged);
+
+        /**
+         * Puts surfels (e.g. paged back in) into the map. They're given new ids after all the current ones, so
+         * the map stays in id order, and whatever doesn't fit is dropped
+         */
+        void append(const std::vector<Eigen::Vector4f> & surfels);
+
+        /**
+         * Reads the current surfels back into a checkpoint
+         * @param pager if set its surfels are saved too, as if they'd never been paged out
+         */
+        void save(CheckpointWriter & writer, MapPager * pager = 0);
+
+        /**
+         * A checkpoint's surfels, read and checked but not uploaded yet. They point into the reader
+         */
+        struct Staged
+        {
+            uint32_t numVertices;
+            uint32_t nextId;
+            bool renumber;
+            const Eigen::Vector4f * vertices;
+        };
+
+        /**
+         * Reads the surfels out of a checkpoint without touching the map
+         */
+        bool stage(CheckpointReader & reader, Staged & staged);
+
+        /**
+         * Replaces the map with what stage read
+         */
+        void commit(const Staged & staged);
+
     private:
+        void compact(const int & time, const int timeDelta);
+
+        unsigned int countKept(const float threshold);
+
+        void reserveFilter(const int numSurfels);
+
+        void reserve(const unsigned int numSurfels);
+
+        //Gives the surfels ids 0 to count - 1 in buffer order
+        void renumber();
+
+        void mapWindows(const GLuint vbo, const unsigned int numSurfels, const int windowSize, const std::function<void(const Eigen::Vector4f *, const int)> & f);
+
         //First is the vbo, second is the fid
         std::pair<GLuint, GLuint> * vbos;
         int target, renderSource;
 
-        const int bufferSize;
+        int bufferSize;
+
+        BudgetStats budgetStats;
+
+        static const float LOW_WATER;
+        static const float AGE_SCALE;
+        static const int BISECTIONS = 12;
 
         GLuint countQuery;
+        GLuint keptQuery;
         unsigned int count;
 
+        GLuint newUnstableQuery;
+        unsigned int newUnstableCount;
+        uint32_t nextId;
+        unsigned int rewrites;
+
         std::shared_ptr<Shader> initProgram;
+        std::shared_ptr<Shader> copyProgram;
+        std::shared_ptr<Shader> filterProgram;
+        std::shared_ptr<Shader> budgetProgram;
+        std::shared_ptr<Shader> pageProgram;
         std::shared_ptr<Shader> drawProgram;
         std::shared_ptr<Shader> drawSurfelProgram;
 
@@ -123,6 +253,10 @@ class GlobalModel
 
         GLuint newUnstableVbo, newUnstableFid;
 
+        //Filtered map reads and paged surfels go here, grown on demand
+        GLuint filterVbo, filterFid;
+        int filterCapacity;
+
         pangolin::GlFramebuffer frameBuffer;
         GLuint uvo;
         int uvSize;
@@ -71,9 +71,9 @@ IndexMap::IndexMap()
                 GL_RGBA32F, GL_LUMINANCE, GL_FLOAT, false, true),
   timeTexture(Resolution::getInstance().width(),
               Resolution::getInstance().height(),
-              GL_LUMINANCE16UI_EXT,
+              GL_LUMINANCE32UI_EXT,
               GL_LUMINANCE_INTEGER_EXT,
-              GL_UNSIGNED_SHORT,
+              GL_UNSIGNED_INT,
               false,
               true),
   oldRenderBuffer(Resolution::getInstance().width(), Resolution::getInstance().height()),
@@ -92,9 +92,9 @@ IndexMap::IndexMap()
                    GL_RGBA32F, GL_LUMINANCE, GL_FLOAT, false, true),
   oldTimeTexture(Resolution::getInstance().width(),
                  Resolution::getInstance().height(),
-                 GL_LUMINANCE16UI_EXT,
+                 GL_LUMINANCE32UI_EXT,
                  GL_LUMINANCE_INTEGER_EXT,
-                 GL_UNSIGNED_SHORT,
+                 GL_UNSIGNED_INT,
                  false,
                  true),
   infoRenderBuffer(Resolution::getInstance().width(), Resolution::getInstance().height()),
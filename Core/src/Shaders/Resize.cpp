@@ -38,16 +38,16 @@ Resize::Resize(int srcWidth,
                 true),
   timeTexture(destWidth,
               destHeight,
-              GL_LUMINANCE16UI_EXT,
+              GL_LUMINANCE32UI_EXT,
               GL_LUMINANCE_INTEGER_EXT,
-              GL_UNSIGNED_SHORT,
+              GL_UNSIGNED_INT,
               false,
               true),
   imageProgram(loadProgramFromFile("empty.vert", "resize.frag", "quad.geom")),
   imageRenderBuffer(destWidth, destHeight),
   vertexProgram(loadProgramFromFile("empty.vert", "resize.frag", "quad.geom")),
   vertexRenderBuffer(destWidth, destHeight),
-  timeProgram(loadProgramFromFile("empty.vert", "resize.frag", "quad.geom")),
+  timeProgram(loadProgramFromFile("empty.vert", "resize_time.frag", "quad.geom")),
   timeRenderBuffer(destWidth, destHeight)
 {
    imageFrameBuffer.AttachColour(*imageTexture.texture);
@@ -84,8 +84,15 @@ void Resize::image(GPUTexture * source, Img<Eigen::Matrix<unsigned char, 3, 1>>
 
     glDrawArrays(GL_POINTS, 0, 1);
 
+    //Rows of dest may be padded
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glPixelStorei(GL_PACK_ROW_LENGTH, dest.stride / sizeof(Eigen::Matrix<unsigned char, 3, 1>));
+
     glReadPixels(0, 0, imageRenderBuffer.width, imageRenderBuffer.height, GL_RGB, GL_UNSIGNED_BYTE, dest.data);
 
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
     imageFrameBuffer.Unbind();
 
     glBindTexture(GL_TEXTURE_2D, 0);
@@ -119,8 +126,15 @@ void Resize::vertex(GPUTexture * source, Img<Eigen::Vector4f> & dest)
 
     glDrawArrays(GL_POINTS, 0, 1);
 
+    //Rows of dest may be padded
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glPixelStorei(GL_PACK_ROW_LENGTH, dest.stride / sizeof(Eigen::Vector4f));
+
     glReadPixels(0, 0, vertexRenderBuffer.width, vertexRenderBuffer.height, GL_RGBA, GL_FLOAT, dest.data);
 
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
     vertexFrameBuffer.Unbind();
 
     glBindTexture(GL_TEXTURE_2D, 0);
@@ -134,7 +148,7 @@ void Resize::vertex(GPUTexture * source, Img<Eigen::Vector4f> & dest)
     glFinish();
 }
 
-void Resize::time(GPUTexture * source, Img<unsigned short> & dest)
+void Resize::time(GPUTexture * source, Img<unsigned int> & dest)
 {
     timeFrameBuffer.Bind();
 
@@ -154,7 +168,14 @@ void Resize::time(GPUTexture * source, Img<unsigned short> & dest)
 
     glDrawArrays(GL_POINTS, 0, 1);
 
-    glReadPixels(0, 0, timeRenderBuffer.width, timeRenderBuffer.height, GL_LUMINANCE_INTEGER_EXT, GL_UNSIGNED_SHORT, dest.data);
+    //Rows of dest may be padded
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glPixelStorei(GL_PACK_ROW_LENGTH, dest.stride / sizeof(unsigned int));
+
+    glReadPixels(0, 0, timeRenderBuffer.width, timeRenderBuffer.height, GL_LUMINANCE_INTEGER_EXT, GL_UNSIGNED_INT, dest.data);
+
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
 
     timeFrameBuffer.Unbind();
 
@@ -38,7 +38,7 @@ class Resize
 
         void image(GPUTexture * source, Img<Eigen::Matrix<unsigned char, 3, 1>> & dest);
         void vertex(GPUTexture * source, Img<Eigen::Vector4f> & dest);
-        void time(GPUTexture * source, Img<unsigned short> & dest);
+        void time(GPUTexture * source, Img<unsigned int> & dest);
 
         GPUTexture imageTexture;
         GPUTexture vertexTexture;
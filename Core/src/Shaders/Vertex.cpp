@@ -26,7 +26,7 @@
  * float confidence
  *
  * float color (encoded as a 24-bit integer)
- * float <unused>
+ * float id (raw bits, see Vertex::id)
  * float initTime
  * float timestamp
  *
@@ -34,7 +34,8 @@
  * float radius
  *--------------------
 
- * Which is three vec4s
+ * Which is three vec4s. The times are frame numbers, which floats hold
+ * exactly up to 2^24 (over 150 hours at 30Hz)
  */
 
 const int Vertex::SIZE = sizeof(Eigen::Vector4f) * 3;
@@ -20,6 +20,8 @@
 #define VERTEX_H_
 
 #include <Eigen/Core>
+#include <cstdint>
+#include <cstring>
 
 #include "../Defines.h"
 
@@ -28,6 +30,31 @@ class Vertex
     public:
         EFUSION_API static const int SIZE;
 
+        /**
+         * Every surfel gets an id when it's added to the map that it keeps until it's removed or GlobalModel renumbers
+         * the map, which it does before ids would pass MAX_ID. Ids are handed out in increasing order and the model
+         * buffer stays sorted by them.
+         * @param surfel the 3 Eigen::Vector4f of one surfel
+         */
+        static uint32_t id(const Eigen::Vector4f * surfel)
+        {
+            uint32_t bits;
+            memcpy(&bits, &surfel[1](1), sizeof(uint32_t));
+            return bits - ID_OFFSET;
+        }
+
+        static void setId(Eigen::Vector4f * surfel, const uint32_t id)
+        {
+            const uint32_t bits = id + ID_OFFSET;
+            memcpy(&surfel[1](1), &bits, sizeof(uint32_t));
+        }
+
+        //Added to ids in the shaders so their bits are always a normal float
+        static const uint32_t ID_OFFSET = 0x00800000;
+
+        //Past this the bits would head into Inf and NaN, and idBase + gl_VertexID would overflow an int
+        static const uint32_t MAX_ID = 0x7F000000 - ID_OFFSET;
+
     private:
         Vertex(){}
 };
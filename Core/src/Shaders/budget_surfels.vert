@@ -0,0 +1,52 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#version 330 core
+
+layout (location = 0) in vec4 vPos;
+layout (location = 1) in vec4 vCol;
+layout (location = 2) in vec4 vNormR;
+
+out vec4 vPosition;
+out vec4 vColor;
+out vec4 vNormRad;
+flat out int test;
+
+uniform int time;
+uniform int timeDelta;
+uniform float ageScale;
+uniform float threshold;
+
+void main()
+{
+    vPosition = vPos;
+    vColor = vCol;
+    vNormRad = vNormR;
+
+    float age = float(time) - vColor.w;
+
+    //Only surfels outside the active window can go, anything being tracked against stays
+    bool inactive = vColor.w > 0 && age > float(timeDelta);
+
+    //Confident surfels seen over a long stretch are worth keeping, ones only seen briefly
+    //(usually a stale layer a newer surface took over from) and long unseen ones aren't
+    float span = max(vColor.w - vColor.z, 0.0);
+    float value = vPosition.w * (1.0 + span / float(timeDelta)) / (1.0 + age / ageScale);
+
+    test = !inactive || value >= threshold ? 1 : 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#version 330 core
+
+layout (location = 0) in vec4 vPosition;
+layout (location = 1) in vec4 vColor;
+layout (location = 2) in vec4 vNormRad;
+
+out vec4 vPosition0;
+out vec4 vColor0;
+out vec4 vNormRad0;
+
+uniform int renumber;
+uniform int idBase;
+
+//Surfel ids live in the otherwise unused vColor.y as raw bits, offset so they're always normal floats
+const uint ID_OFFSET = 0x00800000U;
+
+void main()
+{
+    vPosition0 = vPosition;
+    vColor0 = vColor;
+    vNormRad0 = vNormRad;
+
+    if(renumber != 0)
+    {
+        vColor0.y = uintBitsToFloat(uint(idBase + gl_VertexID) + ID_OFFSET);
+    }
+}
@@ -45,6 +45,10 @@ uniform float nodeCols;
 uniform float maxDepth;
 uniform int timeDelta;
 uniform int isFern;
+uniform int idBase;
+
+//Surfel ids live in the otherwise unused vColor.y as raw bits, offset so they're always normal floats
+const uint ID_OFFSET = 0x00800000U;
 
 void main()
 {
@@ -110,10 +114,12 @@ void main()
         test = 0;
     }
     
-    //New unstable point
+    //New unstable point, these are drawn straight from the new unstable buffer so gl_VertexID counts from zero.
+    //GlobalModel renumbers the map first if idBase is too close to the end of the ids
     if(vColor.w == -2)
     {
         vColor.w = time;
+        vColor.y = uintBitsToFloat(uint(idBase + gl_VertexID) + ID_OFFSET);
     }
     
     //Degenerate case or too unstable
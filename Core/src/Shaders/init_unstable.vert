@@ -26,11 +26,14 @@ out vec4 vPosition0;
 out vec4 vColor0;
 out vec4 vNormRad0;
 
+//Surfel ids live in the otherwise unused vColor.y as raw bits, offset so they're always normal floats
+const uint ID_OFFSET = 0x00800000U;
+
 void main()
 {
     vPosition0 = vPosition;
     vColor0 = vColor;
-    vColor0.y = 0; //Unused
+    vColor0.y = uintBitsToFloat(uint(gl_VertexID) + ID_OFFSET); //Stable surfel id
     vColor0.z = 1; //This sets the vertex's initialisation time
     vNormRad0 = vNormRad;
 }
@@ -0,0 +1,49 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#version 330 core
+
+layout (location = 0) in vec4 vPos;
+layout (location = 1) in vec4 vCol;
+layout (location = 2) in vec4 vNormR;
+
+out vec4 vPosition;
+out vec4 vColor;
+out vec4 vNormRad;
+flat out int test;
+
+uniform int time;
+uniform int timeDelta;
+uniform float blockSize;
+uniform vec3 camera;
+uniform float distance;
+uniform int paged;
+
+void main()
+{
+    vPosition = vPos;
+    vColor = vCol;
+    vNormRad = vNormR;
+
+    //Whole blocks go at once, so it's the block centre that has to be far enough away (see MapPager::centre)
+    vec3 block = (floor(vPosition.xyz / blockSize) + 0.5) * blockSize;
+
+    bool pageOut = vColor.w > 0 && float(time) - vColor.w > float(timeDelta) && length(block - camera) > distance;
+
+    test = pageOut == (paged != 0) ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "AllocationCounter.h"
+
+#ifdef COUNT_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+#include <cerrno>
+
+#ifdef __GNUC__
+//Initial exec TLS is a fixed offset from the thread pointer, the default model can call malloc the first time a thread touches it
+#define ALLOCATION_TLS __attribute__((tls_model("initial-exec")))
+#else
+#define ALLOCATION_TLS
+#endif
+
+//Per thread and constant initialised, so it's ready before anything allocates and other threads never show up
+static thread_local unsigned long long int allocations ALLOCATION_TLS = 0;
+static thread_local unsigned long long int frees ALLOCATION_TLS = 0;
+
+#ifdef __GLIBC__
+
+//Everything ends up in malloc or one of these, operator new and Eigen's aligned allocations included
+extern "C"
+{
+    void * __libc_malloc(size_t size);
+    void * __libc_calloc(size_t n, size_t size);
+    void * __libc_realloc(void * ptr, size_t size);
+    void * __libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void * ptr);
+
+    void * malloc(size_t size) noexcept
+    {
+        allocations++;
+        return __libc_malloc(size);
+    }
+
+    void * calloc(size_t n, size_t size) noexcept
+    {
+        allocations++;
+        return __libc_calloc(n, size);
+    }
+
+    void * realloc(void * ptr, size_t size) noexcept
+    {
+        allocations++;
+        return __libc_realloc(ptr, size);
+    }
+
+    void * memalign(size_t alignment, size_t size) noexcept
+    {
+        allocations++;
+        return __libc_memalign(alignment, size);
+    }
+
+    void * aligned_alloc(size_t alignment, size_t size) noexcept
+    {
+        allocations++;
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void ** ptr, size_t alignment, size_t size) noexcept
+    {
+        allocations++;
+        *ptr = __libc_memalign(alignment, size);
+        return *ptr || size == 0 ? 0 : ENOMEM;
+    }
+
+    void free(void * ptr) noexcept
+    {
+        frees += ptr != 0;
+        __libc_free(ptr);
+    }
+}
+
+#else
+
+void * operator new(size_t size)
+{
+    allocations++;
+
+    void * ptr = malloc(size == 0 ? 1 : size);
+
+    if(!ptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+}
+
+void operator delete(void * ptr) noexcept
+{
+    frees += ptr != 0;
+    free(ptr);
+}
+
+#endif
+
+unsigned long long int AllocationCounter::get()
+{
+    return allocations;
+}
+
+unsigned long long int AllocationCounter::getFrees()
+{
+    return frees;
+}
+
+bool AllocationCounter::enabled()
+{
+    return true;
+}
+
+#else
+
+unsigned long long int AllocationCounter::get()
+{
+    return 0;
+}
+
+unsigned long long int AllocationCounter::getFrees()
+{
+    return 0;
+}
+
+bool AllocationCounter::enabled()
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef UTILS_ALLOCATIONCOUNTER_H_
+#define UTILS_ALLOCATIONCOUNTER_H_
+
+#include "../Defines.h"
+
+/**
+ * Counts heap allocations and frees made by the calling thread, so processFrame's counts aren't muddied by the
+ * thread pool, background solves, cameras or loggers. With glibc malloc, calloc, realloc, memalign and free are
+ * counted, which catches Eigen's aligned allocations too, elsewhere only operator new and delete are.
+ * Only active when built with COUNT_ALLOCATIONS, otherwise always returns 0
+ */
+class AllocationCounter
+{
+    public:
+        EFUSION_API static unsigned long long int get();
+
+        EFUSION_API static unsigned long long int getFrees();
+
+        EFUSION_API static bool enabled();
+};
+
+#endif /* UTILS_ALLOCATIONCOUNTER_H_ */
@@ -0,0 +1,272 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "Checkpoint.h"
+
+#include <cstdio>
+#include <fstream>
+
+#ifndef WIN32
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+CheckpointWriter::CheckpointWriter()
+ : sectionStart(0),
+   writeDone(true)
+{}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    if(writeThread.joinable())
+    {
+        writeThread.join();
+    }
+}
+
+bool CheckpointWriter::busy()
+{
+    return !writeDone;
+}
+
+bool CheckpointWriter::begin()
+{
+    if(busy())
+    {
+        return false;
+    }
+
+    if(writeThread.joinable())
+    {
+        writeThread.join();
+    }
+
+    //Keeps its capacity, so steady state checkpoints don't reallocate
+    buffer.clear();
+    sectionStart = 0;
+
+    write(Checkpoint::MAGIC);
+    write(Checkpoint::VERSION);
+    write(uint64_t(0));
+
+    return true;
+}
+
+void CheckpointWriter::append(const void * data, const size_t bytes)
+{
+    buffer.insert(buffer.end(), (const char *)data, (const char *)data + bytes);
+}
+
+void CheckpointWriter::align()
+{
+    buffer.resize((buffer.size() + Checkpoint::ALIGNMENT - 1) & ~(Checkpoint::ALIGNMENT - 1), 0);
+}
+
+void CheckpointWriter::section(const uint32_t tag)
+{
+    endSection();
+
+    align();
+
+    sectionStart = buffer.size();
+
+    write(tag);
+    write(uint32_t(0));
+    write(uint64_t(0));
+}
+
+void CheckpointWriter::endSection()
+{
+    if(sectionStart)
+    {
+        uint64_t bytes = buffer.size() - sectionStart - sizeof(uint64_t) * 2;
+        memcpy(&buffer[sectionStart + sizeof(uint64_t)], &bytes, sizeof(uint64_t));
+        sectionStart = 0;
+    }
+}
+
+bool CheckpointWriter::save(const std::string & filename, const bool background)
+{
+    endSection();
+    align();
+
+    uint64_t total = buffer.size();
+    memcpy(&buffer[sizeof(uint32_t) * 2], &total, sizeof(uint64_t));
+
+    if(!background)
+    {
+        return writeFile(filename, buffer);
+    }
+
+    writing.swap(buffer);
+    writeDone = false;
+    writeThread = std::thread(&CheckpointWriter::writeLoop, this, filename);
+
+    return true;
+}
+
+void CheckpointWriter::writeLoop(const std::string filename)
+{
+    writeFile(filename, writing);
+    writeDone = true;
+}
+
+bool CheckpointWriter::writeFile(const std::string & filename, const std::vector<char> & data)
+{
+    //Never leave a half written checkpoint in place of a good one
+    std::string tmp = filename + ".tmp";
+
+    std::ofstream file(tmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+    file.close();
+
+    if(!file)
+    {
+        std::remove(tmp.c_str());
+        return false;
+    }
+
+#ifdef WIN32
+    std::remove(filename.c_str());
+#endif
+
+    return std::rename(tmp.c_str(), filename.c_str()) == 0;
+}
+
+CheckpointReader::CheckpointReader(const std::string & filename)
+ : data(0),
+   size(0),
+   mapped(false),
+   version(0),
+   position(0),
+   sectionEnd(0)
+{
+#ifndef WIN32
+    int fd = open(filename.c_str(), O_RDONLY);
+
+    if(fd >= 0)
+    {
+        struct stat st;
+
+        if(fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void * ptr = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if(ptr != MAP_FAILED)
+            {
+                data = (const unsigned char *)ptr;
+                size = st.st_size;
+                mapped = true;
+            }
+        }
+
+        close(fd);
+    }
+#else
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+
+    if(file)
+    {
+        fallback.resize(file.tellg());
+        file.seekg(0);
+        file.read((char *)fallback.data(), fallback.size());
+
+        if(file)
+        {
+            data = fallback.data();
+            size = fallback.size();
+        }
+    }
+#endif
+
+    if(!data)
+    {
+        return;
+    }
+
+    sectionEnd = size;
+
+    uint32_t magic = 0;
+    uint64_t total = 0;
+
+    if(!read(magic) || magic != Checkpoint::MAGIC || !read(version) || version > Checkpoint::VERSION || !read(total) || total != size)
+    {
+        version = 0;
+        return;
+    }
+
+    //Index the sections
+    while(position < size)
+    {
+        uint32_t tag = 0, pad = 0;
+        uint64_t bytes = 0;
+
+        if(!read(tag) || !read(pad) || !read(bytes) || bytes > size - position)
+        {
+            version = 0;
+            return;
+        }
+
+        sections.push_back(std::make_pair(tag, std::make_pair(position, position + bytes)));
+
+        position += bytes;
+        align();
+    }
+}
+
+CheckpointReader::~CheckpointReader()
+{
+#ifndef WIN32
+    if(mapped)
+    {
+        munmap((void *)data, size);
+    }
+#endif
+}
+
+bool CheckpointReader::isValid()
+{
+    return data && version > 0;
+}
+
+uint32_t CheckpointReader::getVersion()
+{
+    return version;
+}
+
+void CheckpointReader::align()
+{
+    position = (position + Checkpoint::ALIGNMENT - 1) & ~(Checkpoint::ALIGNMENT - 1);
+}
+
+bool CheckpointReader::section(const uint32_t tag)
+{
+    for(size_t i = 0; i < sections.size(); i++)
+    {
+        if(sections[i].first == tag)
+        {
+            position = sections[i].second.first;
+            sectionEnd = sections[i].second.second;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,202 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef UTILS_CHECKPOINT_H_
+#define UTILS_CHECKPOINT_H_
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+
+#include "../Defines.h"
+
+/**
+ * Session checkpoints are a header followed by tagged sections, readers skip sections they don't know.
+ * Arrays always start 16 byte aligned so they can be used straight out of the mapped file.
+ */
+namespace Checkpoint
+{
+    static const uint32_t MAGIC = 0x4b434645; //"EFCK"
+    static const uint32_t VERSION = 2;
+    static const size_t ALIGNMENT = 16;
+
+    enum Section
+    {
+        STATE = 1,
+        MODEL = 2,
+        FERNS = 3,
+        LOCAL_DEFORMATION = 4,
+        GLOBAL_DEFORMATION = 5,
+        POSE_GRAPH = 6
+    };
+}
+
+class CheckpointWriter
+{
+    public:
+        CheckpointWriter();
+        virtual ~CheckpointWriter();
+
+        /**
+         * Starts a new checkpoint in memory
+         * @return false if the last one is still being written to disk
+         */
+        bool begin();
+
+        void section(const uint32_t tag);
+
+        template<typename T>
+        void write(const T & val)
+        {
+            append(&val, sizeof(T));
+        }
+
+        template<typename T>
+        void write(const T * data, const size_t n)
+        {
+            align();
+            append(data, n * sizeof(T));
+        }
+
+        template<typename T>
+        void write(const std::vector<T> & vec)
+        {
+            write<uint64_t>(vec.size());
+            write(vec.data(), vec.size());
+        }
+
+        /**
+         * Space for n elements to be filled in directly (e.g. by a GL readback), valid until the next write
+         */
+        template<typename T>
+        T * reserve(const size_t n)
+        {
+            align();
+            size_t offset = buffer.size();
+            buffer.resize(offset + n * sizeof(T));
+            return (T *)&buffer[offset];
+        }
+
+        /**
+         * Writes the checkpoint to filename.tmp and renames it over filename once complete
+         * @param background if true this returns immediately and the file is written on a worker thread
+         */
+        bool save(const std::string & filename, const bool background);
+
+        bool busy();
+
+    private:
+        void append(const void * data, const size_t bytes);
+        void align();
+        void endSection();
+
+        static bool writeFile(const std::string & filename, const std::vector<char> & data);
+
+        void writeLoop(const std::string filename);
+
+        std::vector<char> buffer;
+        size_t sectionStart;
+
+        std::vector<char> writing;
+        std::thread writeThread;
+        std::atomic<bool> writeDone;
+};
+
+class CheckpointReader
+{
+    public:
+        /**
+         * Maps the file into memory, arrays read from it point straight into the mapping
+         */
+        CheckpointReader(const std::string & filename);
+        virtual ~CheckpointReader();
+
+        /**
+         * @return true if the file exists and has a compatible header and complete sections
+         */
+        bool isValid();
+
+        uint32_t getVersion();
+
+        /**
+         * Moves to the start of the section with this tag
+         */
+        bool section(const uint32_t tag);
+
+        template<typename T>
+        bool read(T & val)
+        {
+            if(position + sizeof(T) > sectionEnd)
+            {
+                return false;
+            }
+
+            memcpy(&val, data + position, sizeof(T));
+            position += sizeof(T);
+            return true;
+        }
+
+        template<typename T>
+        bool read(const T *& array, const size_t n)
+        {
+            align();
+
+            if(position > sectionEnd || n > (sectionEnd - position) / sizeof(T))
+            {
+                return false;
+            }
+
+            array = (const T *)(data + position);
+            position += n * sizeof(T);
+            return true;
+        }
+
+        template<typename T>
+        bool read(std::vector<T> & vec)
+        {
+            uint64_t n = 0;
+            const T * array = 0;
+
+            if(!read(n) || !read(array, n))
+            {
+                return false;
+            }
+
+            vec.assign(array, array + n);
+            return true;
+        }
+
+    private:
+        void align();
+
+        const unsigned char * data;
+        size_t size;
+        bool mapped;
+        std::vector<unsigned char> fallback;
+
+        uint32_t version;
+        std::vector<std::pair<uint32_t, std::pair<size_t, size_t> > > sections;
+
+        size_t position;
+        size_t sectionEnd;
+};
+
+#endif /* UTILS_CHECKPOINT_H_ */
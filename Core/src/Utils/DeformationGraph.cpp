@@ -19,9 +19,10 @@
 #include "CholeskyDecomp.h"
 #include "DeformationGraph.h"
 
-DeformationGraph::DeformationGraph(int k, std::vector<Eigen::Vector3f> * sourceVertices)
+DeformationGraph::DeformationGraph(int k, std::vector<Eigen::Vector3f> * sourceVertices, const char * timerName)
  : k(k),
    initialised(false),
+   timerName(timerName),
    wRot(1),
    wReg(10),
    wCon(100),
@@ -64,14 +65,15 @@ void DeformationGraph::initialiseGraph(std::vector<Eigen::Vector3f> * customGrap
 
     graphCloud->insert(graphCloud->end(), customGraph->begin(), customGraph->end());
 
-    graphNodes.clear();
-
     graph.clear();
 
+    //The graph is resampled every frame, keep the old nodes (and their neighbour lists' memory) around
     graphNodes.resize(graphCloud->size());
 
     for(unsigned int i = 0; i < graphCloud->size(); i++)
     {
+        graphNodes[i].neighbours.clear();
+
         graphNodes[i].id = i;
 
         graphNodes[i].enabled = true;
@@ -103,112 +105,102 @@ void DeformationGraph::applyGraphToPoses(std::vector<Eigen::Matrix4f*> & poses)
 {
     assert(poses.size() == poseMap.size() && initialised);
 
-    Eigen::Vector3f newPosition;
-    Eigen::Matrix3f rotation;
-
-    for(size_t i = 0; i < poses.size(); i++)
+    ThreadPool::getInstance().parallelFor(0, poses.size(), 32, [&](const int start, const int end)
     {
-        std::vector<VertexWeightMap> & weightMap = poseMap.at(i);
+        Eigen::Vector3f newPosition;
+        Eigen::Matrix3f rotation;
 
-        newPosition = Eigen::Vector3f::Zero();
-        rotation = Eigen::Matrix3f::Zero();
-
-        for(size_t j = 0; j < weightMap.size(); j++)
+        for(int i = start; i < end; i++)
         {
-            newPosition += weightMap.at(j).weight * (graph.at(weightMap.at(j).node)->rotation * (poses.at(i)->topRightCorner(3, 1) - graph.at(weightMap.at(j).node)->position) +
-                                                     graph.at(weightMap.at(j).node)->position + graph.at(weightMap.at(j).node)->translation);
+            std::vector<VertexWeightMap> & weightMap = poseMap.at(i);
 
-            rotation += weightMap.at(j).weight * graph.at(weightMap.at(j).node)->rotation;
-        }
+            newPosition = Eigen::Vector3f::Zero();
+            rotation = Eigen::Matrix3f::Zero();
+
+            for(size_t j = 0; j < weightMap.size(); j++)
+            {
+                newPosition += weightMap.at(j).weight * (graph.at(weightMap.at(j).node)->rotation * (poses.at(i)->topRightCorner(3, 1) - graph.at(weightMap.at(j).node)->position) +
+                                                         graph.at(weightMap.at(j).node)->position + graph.at(weightMap.at(j).node)->translation);
 
-        Eigen::Matrix3f newRotation = rotation * poses.at(i)->topLeftCorner(3, 3);
+                rotation += weightMap.at(j).weight * graph.at(weightMap.at(j).node)->rotation;
+            }
 
-        Eigen::JacobiSVD<Eigen::Matrix3f> svd(newRotation, Eigen::ComputeFullU | Eigen::ComputeFullV);
+            Eigen::Matrix3f newRotation = rotation * poses.at(i)->topLeftCorner(3, 3);
 
-        poses.at(i)->topRightCorner(3, 1) = newPosition;
-        poses.at(i)->topLeftCorner(3, 3) = svd.matrixU() * svd.matrixV().transpose();
-    }
+            Eigen::JacobiSVD<Eigen::Matrix3f> svd(newRotation, Eigen::ComputeFullU | Eigen::ComputeFullV);
+
+            poses.at(i)->topRightCorner(3, 1) = newPosition;
+            poses.at(i)->topLeftCorner(3, 3) = svd.matrixU() * svd.matrixV().transpose();
+        }
+    });
 }
 
 void DeformationGraph::setPosesSeq(std::vector<unsigned long long int> * poseTimeMap, const std::vector<Eigen::Matrix4f> & poses)
 {
     poseMap.clear();
+    poseMap.resize(poses.size());
 
     const unsigned int lookBack = 20;
 
     std::vector<int> pointIdxNKNSearch(k + 1);
     std::vector<float> pointNKNSquaredDistance(k + 1);
 
-    for(unsigned int i = 0; i < poses.size(); i++)
+    ThreadPool::getInstance().parallelFor(0, poses.size(), 16, [&](const int start, const int end)
     {
-        unsigned long long int poseTime = poseTimeMap->at(i);
+        for(int i = start; i < end; i++)
+        {
+            unsigned long long int poseTime = poseTimeMap->at(i);
 
-        unsigned int foundIndex = 0;
+            unsigned int foundIndex = 0;
 
-        int imin = 0;
-        int imax = sampledGraphTimes.size() - 1;
-        int imid = (imin + imax) / 2;
+            int imin = 0;
+            int imax = sampledGraphTimes.size() - 1;
+            int imid = (imin + imax) / 2;
 
-        while(imax >= imin)
-        {
-            imid = (imin + imax) / 2;
+            while(imax >= imin)
+            {
+                imid = (imin + imax) / 2;
+
+                if (sampledGraphTimes[imid] < poseTime)
+                {
+                    imin = imid + 1;
+                }
+                else if(sampledGraphTimes[imid] > poseTime)
+                {
+                    imax = imid - 1;
+                }
+                else
+                {
+                    break;
+                }
+            }
 
-            if (sampledGraphTimes[imid] < poseTime)
+            imin = std::min(imin, (int)sampledGraphTimes.size() - 1);
+
+            if(abs(int64_t(sampledGraphTimes[imin]) - int64_t(poseTime)) <= abs(int64_t(sampledGraphTimes[imid]) - int64_t(poseTime)) &&
+              abs(int64_t(sampledGraphTimes[imin]) - int64_t(poseTime)) <= abs(int64_t(sampledGraphTimes[imax]) - int64_t(poseTime)))
             {
-                imin = imid + 1;
+                foundIndex = imin;
             }
-            else if(sampledGraphTimes[imid] > poseTime)
+            else if(abs(int64_t(sampledGraphTimes[imid]) - int64_t(poseTime)) <= abs(int64_t(sampledGraphTimes[imin]) - int64_t(poseTime)) &&
+              abs(int64_t(sampledGraphTimes[imid]) - int64_t(poseTime)) <= abs(int64_t(sampledGraphTimes[imax]) - int64_t(poseTime)))
             {
-                imax = imid - 1;
+                foundIndex = imid;
             }
             else
             {
-                break;
+                foundIndex = imax;
             }
-        }
-
-        imin = std::min(imin, (int)sampledGraphTimes.size() - 1);
-
-        if(abs(int64_t(sampledGraphTimes[imin]) - int64_t(poseTime)) <= abs(int64_t(sampledGraphTimes[imid]) - int64_t(poseTime)) &&
-          abs(int64_t(sampledGraphTimes[imin]) - int64_t(poseTime)) <= abs(int64_t(sampledGraphTimes[imax]) - int64_t(poseTime)))
-        {
-            foundIndex = imin;
-        }
-        else if(abs(int64_t(sampledGraphTimes[imid]) - int64_t(poseTime)) <= abs(int64_t(sampledGraphTimes[imin]) - int64_t(poseTime)) &&
-          abs(int64_t(sampledGraphTimes[imid]) - int64_t(poseTime)) <= abs(int64_t(sampledGraphTimes[imax]) - int64_t(poseTime)))
-        {
-            foundIndex = imid;
-        }
-        else
-        {
-            foundIndex = imax;
-        }
-
-        std::vector<std::pair<float, int> > nearNodes;
-
-        if(foundIndex == graphCloud->size())
-        {
-            foundIndex = graphCloud->size() - 1;
-        }
 
-        unsigned int distanceBack = 0;
-        for(int j = (int)foundIndex; j >= 0; j--)
-        {
-            std::pair<float, int> newNode;
-            newNode.first = (graphCloud->at(j) - poses.at(i).topRightCorner(3, 1)).norm();
-            newNode.second = j;
+            std::vector<std::pair<float, int> > nearNodes;
 
-            nearNodes.push_back(newNode);
-
-            if(++distanceBack == lookBack)
+            if(foundIndex == graphCloud->size())
             {
-                break;
+                foundIndex = graphCloud->size() - 1;
             }
-        }
 
-        if(distanceBack != lookBack)
-        {
-            for(unsigned int j = foundIndex + 1; j < sampledGraphTimes.size(); j++)
+            unsigned int distanceBack = 0;
+            for(int j = (int)foundIndex; j >= 0; j--)
             {
                 std::pair<float, int> newNode;
                 newNode.first = (graphCloud->at(j) - poses.at(i).topRightCorner(3, 1)).norm();
@@ -221,32 +213,49 @@ void DeformationGraph::setPosesSeq(std::vector<unsigned long long int> * poseTim
                     break;
                 }
             }
-        }
 
-        std::sort(nearNodes.begin(), nearNodes.end(), [](const std::pair<float, int> &left, const std::pair<float, int> &right) {return left.first < right.first;});
+            if(distanceBack != lookBack)
+            {
+                for(unsigned int j = foundIndex + 1; j < sampledGraphTimes.size(); j++)
+                {
+                    std::pair<float, int> newNode;
+                    newNode.first = (graphCloud->at(j) - poses.at(i).topRightCorner(3, 1)).norm();
+                    newNode.second = j;
 
-        Eigen::Vector3f vertexPosition = poses.at(i).topRightCorner(3, 1);
-        double dMax = nearNodes.at(k).first;
+                    nearNodes.push_back(newNode);
 
-        std::vector<VertexWeightMap> newMap;
+                    if(++distanceBack == lookBack)
+                    {
+                        break;
+                    }
+                }
+            }
 
-        double weightSum = 0;
+            std::sort(nearNodes.begin(), nearNodes.end(), [](const std::pair<float, int> &left, const std::pair<float, int> &right) {return left.first < right.first;});
 
-        for(unsigned int j = 0; j < (unsigned int)k; j++)
-        {
-            newMap.push_back(VertexWeightMap(pow(1.0f - (vertexPosition - graphNodes[nearNodes.at(j).second].position).norm() / dMax, 2), nearNodes.at(j).second));
-            weightSum += newMap.back().weight;
-        }
+            Eigen::Vector3f vertexPosition = poses.at(i).topRightCorner(3, 1);
+            double dMax = nearNodes.at(k).first;
 
-        for(unsigned int j = 0; j < newMap.size(); j++)
-        {
-            newMap.at(j).weight /= weightSum;
-        }
+            std::vector<VertexWeightMap> newMap;
 
-        VertexWeightMap::sort(newMap, graph);
+            double weightSum = 0;
 
-        poseMap.push_back(newMap);
-    }
+            for(unsigned int j = 0; j < (unsigned int)k; j++)
+            {
+                newMap.push_back(VertexWeightMap(pow(1.0f - (vertexPosition - graphNodes[nearNodes.at(j).second].position).norm() / dMax, 2), nearNodes.at(j).second));
+                weightSum += newMap.back().weight;
+            }
+
+            for(unsigned int j = 0; j < newMap.size(); j++)
+            {
+                newMap.at(j).weight /= weightSum;
+            }
+
+            VertexWeightMap::sort(newMap, graph);
+
+            poseMap.at(i).swap(newMap);
+        }
+    });
 }
 
 void DeformationGraph::connectGraphSeq()
@@ -294,76 +303,64 @@ void DeformationGraph::weightVerticesSeq(std::vector<unsigned long long int> * v
     std::vector<int> pointIdxNKNSearch(k + 1);
     std::vector<float> pointNKNSquaredDistance(k + 1);
 
-    for(unsigned int i = lastPointCount; i < sourceVertices->size(); i++)
+    vertexMap.resize(sourceVertices->size());
+
+    ThreadPool::getInstance().parallelFor(lastPointCount, sourceVertices->size(), 16, [&](const int start, const int end)
     {
-        unsigned long long int vertexTime = vertexTimeMap->at(i);
+        for(int i = start; i < end; i++)
+        {
+            unsigned long long int vertexTime = vertexTimeMap->at(i);
 
-        unsigned int foundIndex = 0;
+            unsigned int foundIndex = 0;
 
-        int imin = 0;
-        int imax = sampledGraphTimes.size() - 1;
-        int imid = (imin + imax) / 2;
+            int imin = 0;
+            int imax = sampledGraphTimes.size() - 1;
+            int imid = (imin + imax) / 2;
 
-        while(imax >= imin)
-        {
-            imid = (imin + imax) / 2;
+            while(imax >= imin)
+            {
+                imid = (imin + imax) / 2;
+
+                if (sampledGraphTimes[imid] < vertexTime)
+                {
+                    imin = imid + 1;
+                }
+                else if(sampledGraphTimes[imid] > vertexTime)
+                {
+                    imax = imid - 1;
+                }
+                else
+                {
+                    break;
+                }
+            }
+
+            imin = std::min(imin, (int)sampledGraphTimes.size() - 1);
 
-            if (sampledGraphTimes[imid] < vertexTime)
+            if(abs(int64_t(sampledGraphTimes[imin]) - int64_t(vertexTime)) <= abs(int64_t(sampledGraphTimes[imid]) - int64_t(vertexTime)) &&
+              abs(int64_t(sampledGraphTimes[imin]) - int64_t(vertexTime)) <= abs(int64_t(sampledGraphTimes[imax]) - int64_t(vertexTime)))
             {
-                imin = imid + 1;
+                foundIndex = imin;
             }
-            else if(sampledGraphTimes[imid] > vertexTime)
+            else if(abs(int64_t(sampledGraphTimes[imid]) - int64_t(vertexTime)) <= abs(int64_t(sampledGraphTimes[imin]) - int64_t(vertexTime)) &&
+              abs(int64_t(sampledGraphTimes[imid]) - int64_t(vertexTime)) <= abs(int64_t(sampledGraphTimes[imax]) - int64_t(vertexTime)))
             {
-                imax = imid - 1;
+                foundIndex = imid;
             }
             else
             {
-                break;
+                foundIndex = imax;
             }
-        }
-
-        imin = std::min(imin, (int)sampledGraphTimes.size() - 1);
-
-        if(abs(int64_t(sampledGraphTimes[imin]) - int64_t(vertexTime)) <= abs(int64_t(sampledGraphTimes[imid]) - int64_t(vertexTime)) &&
-          abs(int64_t(sampledGraphTimes[imin]) - int64_t(vertexTime)) <= abs(int64_t(sampledGraphTimes[imax]) - int64_t(vertexTime)))
-        {
-            foundIndex = imin;
-        }
-        else if(abs(int64_t(sampledGraphTimes[imid]) - int64_t(vertexTime)) <= abs(int64_t(sampledGraphTimes[imin]) - int64_t(vertexTime)) &&
-          abs(int64_t(sampledGraphTimes[imid]) - int64_t(vertexTime)) <= abs(int64_t(sampledGraphTimes[imax]) - int64_t(vertexTime)))
-        {
-            foundIndex = imid;
-        }
-        else
-        {
-            foundIndex = imax;
-        }
 
-        std::vector<std::pair<float, int> > nearNodes;
+            std::vector<std::pair<float, int> > nearNodes;
 
-        if(foundIndex == graphCloud->size())
-        {
-            foundIndex = graphCloud->size() - 1;
-        }
-
-        unsigned int distanceBack = 0;
-        for(int j = (int)foundIndex; j >= 0; j--)
-        {
-            std::pair<float, int> newNode;
-            newNode.first = (graphCloud->at(j) - sourceVertices->at(i)).norm();
-            newNode.second = j;
-
-            nearNodes.push_back(newNode);
-
-            if(++distanceBack == lookBack)
+            if(foundIndex == graphCloud->size())
             {
-                break;
+                foundIndex = graphCloud->size() - 1;
             }
-        }
 
-        if(distanceBack != lookBack)
-        {
-            for(unsigned int j = foundIndex + 1; j < sampledGraphTimes.size(); j++)
+            unsigned int distanceBack = 0;
+            for(int j = (int)foundIndex; j >= 0; j--)
             {
                 std::pair<float, int> newNode;
                 newNode.first = (graphCloud->at(j) - sourceVertices->at(i)).norm();
@@ -376,43 +373,63 @@ void DeformationGraph::weightVerticesSeq(std::vector<unsigned long long int> * v
                     break;
                 }
             }
-        }
 
-        std::sort(nearNodes.begin(), nearNodes.end(), [](const std::pair<float, int> &left, const std::pair<float, int> &right) {return left.first < right.first;});
+            if(distanceBack != lookBack)
+            {
+                for(unsigned int j = foundIndex + 1; j < sampledGraphTimes.size(); j++)
+                {
+                    std::pair<float, int> newNode;
+                    newNode.first = (graphCloud->at(j) - sourceVertices->at(i)).norm();
+                    newNode.second = j;
 
-        Eigen::Vector3f vertexPosition = sourceVertices->at(i);
-        double dMax = nearNodes.at(k).first;
+                    nearNodes.push_back(newNode);
 
-        std::vector<VertexWeightMap> newMap;
+                    if(++distanceBack == lookBack)
+                    {
+                        break;
+                    }
+                }
+            }
 
-        double weightSum = 0;
+            std::sort(nearNodes.begin(), nearNodes.end(), [](const std::pair<float, int> &left, const std::pair<float, int> &right) {return left.first < right.first;});
 
-        for(unsigned int j = 0; j < (unsigned int)k; j++)
-        {
-            newMap.push_back(VertexWeightMap(pow(1.0f - (vertexPosition - graphNodes[nearNodes.at(j).second].position).norm() / dMax, 2), nearNodes.at(j).second));
-            weightSum += newMap.back().weight;
-        }
+            Eigen::Vector3f vertexPosition = sourceVertices->at(i);
+            double dMax = nearNodes.at(k).first;
 
-        for(unsigned int j = 0; j < newMap.size(); j++)
-        {
-            newMap.at(j).weight /= weightSum;
-        }
+            std::vector<VertexWeightMap> newMap;
 
-        VertexWeightMap::sort(newMap, graph);
+            double weightSum = 0;
 
-        vertexMap.push_back(newMap);
-    }
+            for(unsigned int j = 0; j < (unsigned int)k; j++)
+            {
+                newMap.push_back(VertexWeightMap(pow(1.0f - (vertexPosition - graphNodes[nearNodes.at(j).second].position).norm() / dMax, 2), nearNodes.at(j).second));
+                weightSum += newMap.back().weight;
+            }
+
+            for(unsigned int j = 0; j < newMap.size(); j++)
+            {
+                newMap.at(j).weight /= weightSum;
+            }
+
+            VertexWeightMap::sort(newMap, graph);
+
+            vertexMap.at(i).swap(newMap);
+        }
+    });
 }
 
 void DeformationGraph::applyGraphToVertices()
 {
-    Eigen::Vector3f position;
-
-    for(unsigned int i = 0; i < sourceVertices->size(); i++)
+    ThreadPool::getInstance().parallelFor(0, sourceVertices->size(), 256, [&](const int start, const int end)
     {
-        computeVertexPosition(i, position);
-        sourceVertices->at(i) = position;
-    }
+        Eigen::Vector3f position;
+
+        for(int i = start; i < end; i++)
+        {
+            computeVertexPosition(i, position);
+            sourceVertices->at(i) = position;
+        }
+    });
 }
 
 void DeformationGraph::addConstraint(int vertexId, Eigen::Vector3f & target)
@@ -458,13 +475,13 @@ bool DeformationGraph::optimiseGraphSparse(float & error, float & meanConsErr, c
 {
     assert(initialised);
 
-    TICK("opt");
+    TICK(timerName);
 
     meanConsErr = nonRelativeConstraintError();
 
     if(fernMatch && meanConsErr < 0.06)
     {
-        TOCK("opt");
+        TOCK(timerName);
         return false;
     }
 
@@ -525,7 +542,7 @@ bool DeformationGraph::optimiseGraphSparse(float & error, float & meanConsErr, c
 
     cholesky->freeFactor();
 
-    TOCK("opt");
+    TOCK(timerName);
 
     meanConsErr = nonRelativeConstraintError();
 
@@ -650,37 +667,17 @@ void DeformationGraph::sparseJacobian(Jacobian & jacobian, const int numRows, co
         }
     }
 
+    //Which constraints get rows was worked out by sparseResidual, which always runs first
+    assert(constraintRows.size() == constraints.size());
+
     for(unsigned int l = 0; l < constraints.size(); l++)
     {
         const std::vector<VertexWeightMap> & weightMap = vertexMap.at(constraints.at(l).vertexId);
 
-        bool nodeInfluences = false;
-
-        for(size_t i = 0; i < weightMap.size(); i++)
-        {
-            if(graph.at(weightMap.at(i).node)->enabled)
-            {
-                nodeInfluences = true;
-                break;
-            }
-        }
-
-        if(constraints.at(l).relative && !nodeInfluences)
+        if(constraintRows.at(l) != -1)
         {
-            const std::vector<VertexWeightMap> & relWeightMap = vertexMap.at(constraints.at(l).targetId);
-
-            for(size_t i = 0; i < relWeightMap.size(); i++)
-            {
-                if(graph.at(relWeightMap.at(i).node)->enabled)
-                {
-                    nodeInfluences = true;
-                    break;
-                }
-            }
-        }
+            assert(constraintRows.at(l) == lastRow);
 
-        if(nodeInfluences)
-        {
             Eigen::Vector3f sourcePosition = sourceVertices->at(constraints.at(l).vertexId);
 
             rows[lastRow] = new OrderedJacobianRow(4 * k * 2);
@@ -889,6 +886,8 @@ Eigen::VectorXd DeformationGraph::sparseResidual(const int maxRows)
         }
     }
 
+    constraintRows.resize(constraints.size());
+
     for(unsigned int l = 0; l < constraints.size(); l++)
     {
         const std::vector<VertexWeightMap> & weightMap = vertexMap.at(constraints.at(l).vertexId);
@@ -920,6 +919,28 @@ Eigen::VectorXd DeformationGraph::sparseResidual(const int maxRows)
 
         if(nodeInfluences)
         {
+            constraintRows.at(l) = numRows;
+
+            numRows += eConRows;
+        }
+        else
+        {
+            constraintRows.at(l) = -1;
+        }
+    }
+
+    //Rows are known now, the vertex positions are the expensive part
+    ThreadPool::getInstance().parallelFor(0, constraints.size(), 32, [&](const int start, const int end)
+    {
+        for(int l = start; l < end; l++)
+        {
+            const int row = constraintRows.at(l);
+
+            if(row == -1)
+            {
+                continue;
+            }
+
             if(constraints.at(l).relative)
             {
                 Eigen::Vector3f srcPos, tarPos;
@@ -928,7 +949,7 @@ Eigen::VectorXd DeformationGraph::sparseResidual(const int maxRows)
 
                 computeVertexPosition(constraints.at(l).targetId, tarPos);
 
-                residual.segment(numRows, 3) = (srcPos - tarPos).cast<double>() * sqrt(wCon);
+                residual.segment(row, 3) = (srcPos - tarPos).cast<double>() * sqrt(wCon);
             }
             else
             {
@@ -936,12 +957,10 @@ Eigen::VectorXd DeformationGraph::sparseResidual(const int maxRows)
 
                 computeVertexPosition(constraints.at(l).vertexId, position);
 
-                residual.segment(numRows, 3) = (position - constraints.at(l).targetPosition).cast<double>() * sqrt(wCon);
+                residual.segment(row, 3) = (position - constraints.at(l).targetPosition).cast<double>() * sqrt(wCon);
             }
-
-            numRows += eConRows;
         }
-    }
+    });
 
     residual.conservativeResize(numRows);
 
@@ -1010,17 +1029,24 @@ void DeformationGraph::computeVertexPosition(int vertexId, Eigen::Vector3f & pos
 
 float DeformationGraph::nonRelativeConstraintError()
 {
-    float result = 0;
-
-    for(unsigned int l = 0; l < constraints.size(); l++)
+    float result = ThreadPool::getInstance().parallelReduce(0, constraints.size(), 64, 0.0f,
+    [&](const int start, const int end)
     {
-        if(!constraints.at(l).relative)
+        float chunkResult = 0;
+
+        for(int l = start; l < end; l++)
         {
-            Eigen::Vector3f position;
-            computeVertexPosition(constraints.at(l).vertexId, position);
-            result += (position - constraints.at(l).targetPosition).norm();
+            if(!constraints.at(l).relative)
+            {
+                Eigen::Vector3f position;
+                computeVertexPosition(constraints.at(l).vertexId, position);
+                chunkResult += (position - constraints.at(l).targetPosition).norm();
+            }
         }
-    }
+
+        return chunkResult;
+    },
+    [](const float a, const float b) { return a + b; });
 
     return result / constraints.size();
 }
@@ -24,6 +24,7 @@
 #include "Stopwatch.h"
 #include "GraphNode.h"
 #include "Jacobian.h"
+#include "ThreadPool.h"
 
 /**
  * This is basically and object-oriented type approach. Using an array based approach would be faster...
@@ -34,7 +35,8 @@ class CholeskyDecomp;
 class DeformationGraph
 {
     public:
-        DeformationGraph(int k, std::vector<Eigen::Vector3f> * sourceVertices);
+        //timerName is what optimiseGraphSparse is timed as, graphs solved off the main thread need their own
+        DeformationGraph(int k, std::vector<Eigen::Vector3f> * sourceVertices, const char * timerName = "opt");
         virtual ~DeformationGraph();
 
         void initialiseGraph(std::vector<Eigen::Vector3f> * customGraph,
@@ -111,6 +113,8 @@ class DeformationGraph
     private:
         bool initialised;
 
+        const char * timerName;
+
         //From paper
         const double wRot;
         const double wReg;
@@ -132,6 +136,9 @@ class DeformationGraph
         //Maps pose indices to neighbours and weights
         std::vector<std::vector<VertexWeightMap> > poseMap;
 
+        //First residual row of each constraint, -1 if no enabled node influences it
+        std::vector<int> constraintRows;
+
         //Stores a vertex constraint
         class Constraint
         {
@@ -0,0 +1,225 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "FrameGovernor.h"
+#include "Stopwatch.h"
+
+#include <algorithm>
+#include <cstring>
+
+const float FrameGovernor::SMOOTHING = 0.1f;
+const float FrameGovernor::HEADROOM = 0.9f;
+
+//Rough odometry cost of each pyramid setting against the full one, until it's been measured
+static const float odomFactor[3] = {1.0f, 0.4f, 0.15f};
+
+FrameGovernor::FrameGovernor()
+ : deadline(0),
+   level(FULL),
+   settled(0),
+   frameStart(0),
+   sampleGraphCost(0),
+   fernAddCost(0),
+   fernFindCost(0),
+   restCost(0)
+{
+    memset(stageMs, 0, sizeof(stageMs));
+    memset(odomCost, 0, sizeof(odomCost));
+    memset(&stats, 0, sizeof(Stats));
+}
+
+void FrameGovernor::setDeadline(const float deadline)
+{
+    this->deadline = std::max(deadline, 0.0f);
+
+    if(this->deadline == 0)
+    {
+        level = FULL;
+    }
+
+    settled = 0;
+}
+
+float FrameGovernor::getDeadline() const
+{
+    return deadline;
+}
+
+void FrameGovernor::beginFrame()
+{
+    frameStart = Stopwatch::getCurrentSystemTime();
+
+    memset(stageMs, 0, sizeof(stageMs));
+
+    if(deadline > 0 && restCost > 0)
+    {
+        int fit = NUM_LEVELS - 1;
+
+        for(int i = FULL; i < NUM_LEVELS; i++)
+        {
+            if(predict((Level)i) <= deadline * HEADROOM)
+            {
+                fit = i;
+                break;
+            }
+        }
+
+        //Straight up as soon as the current level won't fit, back down a level at a time once it has for a while
+        if(fit > level)
+        {
+            level = (Level)fit;
+            settled = 0;
+        }
+        else if(fit < level && ++settled >= SETTLE_FRAMES)
+        {
+            level = (Level)(level - 1);
+            settled = 0;
+        }
+        else if(fit == level)
+        {
+            settled = 0;
+        }
+    }
+
+    stats.level = level;
+    stats.predictedMs = predict(level);
+}
+
+void FrameGovernor::addTiming(const Stage stage, const float ms)
+{
+    stageMs[stage] += ms;
+}
+
+void FrameGovernor::endFrame()
+{
+    const float total = (Stopwatch::getCurrentSystemTime() - frameStart) / 1000.0f;
+
+    if(stageMs[ODOM] > 0)
+    {
+        smooth(odomCost[coarseOdom() ? 2 : fastOdom() ? 1 : 0], stageMs[ODOM]);
+    }
+
+    if(stageMs[SAMPLE_GRAPH] > 0)
+    {
+        smooth(sampleGraphCost, stageMs[SAMPLE_GRAPH]);
+    }
+
+    if(stageMs[FERN_ADD] > 0)
+    {
+        smooth(fernAddCost, stageMs[FERN_ADD]);
+    }
+
+    if(stageMs[FERN_FIND] > 0)
+    {
+        smooth(fernFindCost, stageMs[FERN_FIND]);
+    }
+
+    float rest = total;
+
+    for(int i = 0; i < NUM_STAGES; i++)
+    {
+        rest -= stageMs[i];
+    }
+
+    smooth(restCost, std::max(rest, 0.001f));
+
+    stats.lastMs = total;
+    stats.frames[level]++;
+
+    if(deadline > 0 && total > deadline)
+    {
+        stats.overruns++;
+    }
+}
+
+FrameGovernor::Level FrameGovernor::getLevel() const
+{
+    return level;
+}
+
+bool FrameGovernor::sampleGraph(const int tick) const
+{
+    return level < DEFER_GRAPH || tick % GRAPH_INTERVAL == 0;
+}
+
+bool FrameGovernor::addFerns() const
+{
+    return level < SKIP_FERN_ADD;
+}
+
+bool FrameGovernor::findFerns(const bool lost) const
+{
+    return level < SKIP_FERN_FIND || lost;
+}
+
+bool FrameGovernor::fastOdom() const
+{
+    return level >= FAST_ODOM;
+}
+
+bool FrameGovernor::coarseOdom() const
+{
+    return level >= COARSE_ODOM;
+}
+
+float FrameGovernor::predict(const Level level) const
+{
+    float cost = restCost;
+
+    cost += level < DEFER_GRAPH ? sampleGraphCost : sampleGraphCost / GRAPH_INTERVAL;
+    cost += level < SKIP_FERN_ADD ? fernAddCost : 0;
+    cost += level < SKIP_FERN_FIND ? fernFindCost : 0;
+
+    const int mode = level >= COARSE_ODOM ? 2 : level >= FAST_ODOM ? 1 : 0;
+
+    if(odomCost[mode] > 0)
+    {
+        cost += odomCost[mode];
+    }
+    else
+    {
+        //Scale whichever setting we do know about
+        for(int i = 0; i < 3; i++)
+        {
+            if(odomCost[i] > 0)
+            {
+                cost += odomCost[i] * odomFactor[mode] / odomFactor[i];
+                break;
+            }
+        }
+    }
+
+    return cost;
+}
+
+const FrameGovernor::Stats & FrameGovernor::getStats() const
+{
+    return stats;
+}
+
+const char * FrameGovernor::levelName(const Level level)
+{
+    static const char * names[NUM_LEVELS] = {"full", "defer graph", "skip fern add", "skip fern find", "fast odom", "coarse odom"};
+
+    return level >= FULL && level < NUM_LEVELS ? names[level] : "";
+}
+
+void FrameGovernor::smooth(float & estimate, const float ms)
+{
+    estimate = estimate > 0 ? estimate + SMOOTHING * (ms - estimate) : ms;
+}
@@ -0,0 +1,140 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef UTILS_FRAMEGOVERNOR_H_
+#define UTILS_FRAMEGOVERNOR_H_
+
+#include "../Defines.h"
+
+/**
+ * Keeps ElasticFusion::processFrame under a per frame deadline by turning down work before the deadline is
+ * missed, rather than dropping whole frames after it has been. Each level keeps everything the one before
+ * it turned off, in order of how little they matter to tracking.
+ *
+ * Decisions come from smoothed timings of the stages each level turns off plus everything else in the frame,
+ * so the cost of a level is predicted before it's used. Turning work up again waits until the level below
+ * has been predicted to fit for a while, so it doesn't flap around the deadline.
+ */
+class FrameGovernor
+{
+    public:
+        enum Level
+        {
+            FULL = 0,
+            DEFER_GRAPH,    //Resample the deformation graph every GRAPH_INTERVAL frames
+            SKIP_FERN_ADD,  //No new ferns (keyframes for global loop closure)
+            SKIP_FERN_FIND, //No global loop closure, unless we're lost
+            FAST_ODOM,      //Fewer iterations on the finest level
+            COARSE_ODOM,    //Track on the two coarse levels only
+            NUM_LEVELS
+        };
+
+        enum Stage
+        {
+            ODOM = 0,
+            SAMPLE_GRAPH,
+            FERN_ADD,
+            FERN_FIND,
+            NUM_STAGES
+        };
+
+        struct Stats
+        {
+            Level level;
+
+            //Frames over the deadline, and frames spent at each level
+            unsigned long long int overruns;
+            unsigned long long int frames[NUM_LEVELS];
+
+            float lastMs;
+            float predictedMs;
+        };
+
+        FrameGovernor();
+
+        /**
+         * Milliseconds per frame, 0 (the default) turns the governor off
+         */
+        void setDeadline(const float deadline);
+
+        EFUSION_API float getDeadline() const;
+
+        /**
+         * Picks the level for the frame that's starting
+         */
+        void beginFrame();
+
+        /**
+         * Milliseconds spent in a stage this frame
+         */
+        void addTiming(const Stage stage, const float ms);
+
+        void endFrame();
+
+        EFUSION_API Level getLevel() const;
+
+        bool sampleGraph(const int tick) const;
+
+        bool addFerns() const;
+
+        bool findFerns(const bool lost) const;
+
+        bool fastOdom() const;
+
+        bool coarseOdom() const;
+
+        /**
+         * What a frame is expected to cost at this level, in milliseconds
+         */
+        float predict(const Level level) const;
+
+        EFUSION_API const Stats & getStats() const;
+
+        EFUSION_API static const char * levelName(const Level level);
+
+        static const int GRAPH_INTERVAL = 4;
+
+    private:
+        void smooth(float & estimate, const float ms);
+
+        float deadline;
+
+        Level level;
+        int settled;
+
+        unsigned long long int frameStart;
+
+        float stageMs[NUM_STAGES];
+
+        //Smoothed costs of each stage when it runs, odometry separately per pyramid setting
+        float sampleGraphCost;
+        float fernAddCost;
+        float fernFindCost;
+        float odomCost[3];
+
+        //Everything in the frame bar the stages above
+        float restCost;
+
+        Stats stats;
+
+        static const float SMOOTHING;
+        static const float HEADROOM;
+        static const int SETTLE_FRAMES = 15;
+};
+
+#endif /* UTILS_FRAMEGOVERNOR_H_ */
@@ -20,7 +20,16 @@
 #define UTILS_IMG_H_
 
 #include <Eigen/Core>
+#include <cassert>
+#include <cstring>
 
+#include "ImgPool.h"
+
+/**
+ * Image with row stride. Owned images come from the ImgPool, with every row padded out to start on a 64 byte
+ * boundary, and go back to it when destroyed. Non-owned ones wrap a foreign buffer or are views into another image.
+ * Address rows through stride (row, at), only continuous images can be treated as one flat array.
+ */
 template <class T>
 class Img
 {
@@ -28,46 +37,128 @@ class Img
         Img(const int rows, const int cols)
          : rows(rows),
            cols(cols),
-           data(new unsigned char[rows * cols * sizeof(T)]),
+           stride(alignedStride(cols)),
+           data(ImgPool::getInstance().acquire(rows * stride)),
            owned(true)
         {}
 
-        Img(const int rows, const int cols, T * data)
+        /**
+         * Wraps data without copying, it has to outlive the image
+         * @param stride bytes between the start of consecutive rows, 0 for tightly packed
+         */
+        Img(const int rows, const int cols, T * data, const int stride = 0)
          : rows(rows),
            cols(cols),
+           stride(stride ? stride : cols * sizeof(T)),
            data((unsigned char *)data),
            owned(false)
-        {}
+        {
+            assert(this->stride >= int(cols * sizeof(T)));
+        }
+
+        Img(Img && other)
+         : rows(other.rows),
+           cols(other.cols),
+           stride(other.stride),
+           data(other.data),
+           owned(other.owned)
+        {
+            other.data = 0;
+        }
+
+        Img(const Img & other) = delete;
+        Img & operator=(const Img & other) = delete;
 
         virtual ~Img()
         {
             if(owned)
             {
-                delete [] data;
+                ImgPool::getInstance().release(data, rows * stride);
             }
         }
 
         const int rows;
         const int cols;
+        const int stride;
         unsigned char * data;
         const bool owned;
 
+        /**
+         * Sub image sharing this one's data, only valid while this image is
+         */
+        Img<T> view(const int row, const int col, const int viewRows, const int viewCols)
+        {
+            assert(row >= 0 && col >= 0 && row + viewRows <= rows && col + viewCols <= cols);
+            return Img<T>(viewRows, viewCols, (T *)(data + stride * row + col * sizeof(T)), stride);
+        }
+
+        bool continuous() const
+        {
+            return stride == int(cols * sizeof(T));
+        }
+
+        /**
+         * Copies the image out tightly packed, dst needs room for rows * cols
+         */
+        void copyTo(T * dst) const
+        {
+            if(continuous())
+            {
+                memcpy(dst, data, rows * stride);
+                return;
+            }
+
+            for(int r = 0; r < rows; r++)
+            {
+                memcpy(dst + r * cols, data + stride * r, cols * sizeof(T));
+            }
+        }
+
+        /**
+         * Smallest multiple of ImgPool::ALIGNMENT that fits cols and is a whole number of pixels, so the row
+         * length in pixels (e.g. for GL_PACK_ROW_LENGTH) is exact
+         */
+        static int alignedStride(const int cols)
+        {
+            size_t unit = ImgPool::ALIGNMENT;
+
+            while(unit % sizeof(T))
+            {
+                unit += ImgPool::ALIGNMENT;
+            }
+
+            return (int)((cols * sizeof(T) + unit - 1) / unit * unit);
+        }
+
+        template<typename V> inline
+        V * row(const int r)
+        {
+            return (V*)(data + stride * r);
+        }
+
+        template<typename V> inline const
+        V * row(const int r) const
+        {
+            return (const V*)(data + stride * r);
+        }
+
         template<typename V> inline
         V & at(const int i)
         {
+            assert(continuous());
             return ((V*)data)[i];
         }
 
         template<typename V> inline
         V & at(const int row, const int col)
         {
-            return ((V*)data)[cols * row + col];
+            return ((V*)(data + stride * row))[col];
         }
 
         template<typename V> inline const
         V & at(const int row, const int col) const
         {
-            return ((const V*)data)[cols * row + col];
+            return ((const V*)(data + stride * row))[col];
         }
 };
 
@@ -0,0 +1,141 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "ImgPool.h"
+
+#include <cstdlib>
+#include <new>
+
+#ifdef WIN32
+#  include <malloc.h>
+#endif
+
+ImgPool & ImgPool::getInstance()
+{
+    static ImgPool instance;
+    return instance;
+}
+
+ImgPool::ImgPool()
+ : pooledBytes(0),
+   maxPooledBytes(64 * 1024 * 1024)
+{}
+
+ImgPool::~ImgPool()
+{
+    trim();
+}
+
+unsigned char * ImgPool::alignedAlloc(const size_t bytes)
+{
+    void * data = 0;
+
+#ifdef WIN32
+    data = _aligned_malloc(bytes, ALIGNMENT);
+#else
+    if(posix_memalign(&data, ALIGNMENT, bytes) != 0)
+    {
+        data = 0;
+    }
+#endif
+
+    if(!data)
+    {
+        throw std::bad_alloc();
+    }
+
+    return (unsigned char *)data;
+}
+
+void ImgPool::alignedFree(unsigned char * data)
+{
+#ifdef WIN32
+    _aligned_free(data);
+#else
+    free(data);
+#endif
+}
+
+unsigned char * ImgPool::acquire(const size_t bytes)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        //Most recently released first, it's the most likely to still be in cache
+        for(size_t i = buffers.size(); i > 0; i--)
+        {
+            if(buffers[i - 1].first == bytes)
+            {
+                unsigned char * data = buffers[i - 1].second;
+                buffers.erase(buffers.begin() + (i - 1));
+                pooledBytes -= bytes;
+                return data;
+            }
+        }
+    }
+
+    return alignedAlloc(bytes);
+}
+
+void ImgPool::release(unsigned char * data, const size_t bytes)
+{
+    if(!data)
+    {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if(pooledBytes + bytes <= maxPooledBytes)
+        {
+            buffers.push_back(std::make_pair(bytes, data));
+            pooledBytes += bytes;
+            return;
+        }
+    }
+
+    alignedFree(data);
+}
+
+void ImgPool::setLimit(const size_t maxBytes)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    maxPooledBytes = maxBytes;
+
+    while(pooledBytes > maxPooledBytes)
+    {
+        pooledBytes -= buffers.front().first;
+        alignedFree(buffers.front().second);
+        buffers.erase(buffers.begin());
+    }
+}
+
+void ImgPool::trim()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for(size_t i = 0; i < buffers.size(); i++)
+    {
+        alignedFree(buffers[i].second);
+    }
+
+    buffers.clear();
+    pooledBytes = 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef UTILS_IMGPOOL_H_
+#define UTILS_IMGPOOL_H_
+
+#include <vector>
+#include <mutex>
+#include <cstddef>
+
+#include "../Defines.h"
+
+/**
+ * Recycles the aligned buffers behind owned Img instances, so images that come and go
+ * (downsampled copies, scratch images) don't hit the allocator every frame
+ */
+class ImgPool
+{
+    public:
+        static const size_t ALIGNMENT = 64;
+
+        EFUSION_API static ImgPool & getInstance();
+
+        /**
+         * Returns a ALIGNMENT aligned buffer of at least the given size, reusing a released one if possible
+         */
+        EFUSION_API unsigned char * acquire(const size_t bytes);
+
+        /**
+         * Hands a buffer from acquire back, it's kept for reuse unless the pool is over its limit
+         */
+        EFUSION_API void release(unsigned char * data, const size_t bytes);
+
+        /**
+         * @param maxBytes upper bound on the memory kept around for reuse, 0 disables pooling
+         */
+        EFUSION_API void setLimit(const size_t maxBytes);
+
+        /**
+         * Frees everything that's currently pooled
+         */
+        EFUSION_API void trim();
+
+        static unsigned char * alignedAlloc(const size_t bytes);
+
+        static void alignedFree(unsigned char * data);
+
+    private:
+        ImgPool();
+        virtual ~ImgPool();
+
+        std::mutex mutex;
+        std::vector<std::pair<size_t, unsigned char *> > buffers;
+        size_t pooledBytes;
+        size_t maxPooledBytes;
+};
+
+#endif /* UTILS_IMGPOOL_H_ */
@@ -0,0 +1,424 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "MapJournal.h"
+
+#include <zlib.h>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+
+MapJournal::MapJournal(const std::string & filename, const int keyframeRate)
+ : fp(fopen(filename.c_str(), "wb")),
+   keyframeRate(keyframeRate),
+   failed(fp == 0),
+   time(0),
+   lastEntryTime(-1),
+   entriesSinceKeyframe(0),
+   keyframe(true),
+   chunkOffsets(ThreadPool::MAX_CHUNKS + 1)
+{
+    if(!failed)
+    {
+        uint32_t header[2] = {MAGIC, VERSION};
+        failed |= fwrite(header, sizeof(uint32_t), 2, fp) != 2;
+        failed |= fflush(fp) != 0;
+    }
+}
+
+MapJournal::~MapJournal()
+{
+    if(fp)
+    {
+        fclose(fp);
+    }
+}
+
+int MapJournal::lastTime() const
+{
+    return lastEntryTime;
+}
+
+void MapJournal::begin(const int time, const bool keyframe)
+{
+    this->time = time;
+    this->keyframe = keyframe || lastEntryTime < 0 || entriesSinceKeyframe + 1 >= keyframeRate;
+
+    ids.clear();
+    upserts.clear();
+}
+
+void MapJournal::add(const Eigen::Vector4f * surfels, const int count)
+{
+    if(failed || count <= 0)
+    {
+        return;
+    }
+
+    const int numChunks = ThreadPool::MAX_CHUNKS;
+    const int chunkSize = (count + numChunks - 1) / numChunks;
+    const size_t firstId = ids.size();
+    const float since = lastEntryTime;
+
+    ids.resize(firstId + count);
+
+    //Anything fused, added or seen after a deformation since the last entry has a newer timestamp
+    ThreadPool::getInstance().parallelFor(0, numChunks, 1, [&](const int start, const int end)
+    {
+        for(int c = start; c < end; c++)
+        {
+            int dirty = 0;
+
+            for(int i = c * chunkSize; i < std::min(count, (c + 1) * chunkSize); i++)
+            {
+                ids[firstId + i] = Vertex::id(&surfels[i * 3]);
+                dirty += keyframe || surfels[i * 3 + 1](3) > since;
+            }
+
+            chunkOffsets[c + 1] = dirty;
+        }
+    });
+
+    chunkOffsets[0] = 0;
+
+    for(int c = 0; c < numChunks; c++)
+    {
+        chunkOffsets[c + 1] += chunkOffsets[c];
+    }
+
+    const size_t firstUpsert = upserts.size();
+
+    upserts.resize(firstUpsert + chunkOffsets[numChunks] * MapWriter::SURFEL_BYTES);
+
+    ThreadPool::getInstance().parallelFor(0, numChunks, 1, [&](const int start, const int end)
+    {
+        for(int c = start; c < end; c++)
+        {
+            unsigned char * out = upserts.data() + firstUpsert + chunkOffsets[c] * MapWriter::SURFEL_BYTES;
+
+            for(int i = c * chunkSize; i < std::min(count, (c + 1) * chunkSize); i++)
+            {
+                if(keyframe || surfels[i * 3 + 1](3) > since)
+                {
+                    memcpy(out, &surfels[i * 3], MapWriter::SURFEL_BYTES);
+                    out += MapWriter::SURFEL_BYTES;
+                }
+            }
+        }
+    });
+}
+
+bool MapJournal::end()
+{
+    if(failed)
+    {
+        return false;
+    }
+
+    //The model buffer is only ever compacted or appended to, so it stays in id order
+    assert(std::is_sorted(ids.begin(), ids.end()));
+
+    removed.clear();
+
+    if(!keyframe)
+    {
+        std::set_difference(lastIds.begin(), lastIds.end(), ids.begin(), ids.end(), std::back_inserter(removed));
+    }
+
+    const int numUpserts = upserts.size() / MapWriter::SURFEL_BYTES;
+    const int numBlocks = (numUpserts + MapWriter::BLOCK_SURFELS - 1) / MapWriter::BLOCK_SURFELS;
+
+    if(numBlocks > (int)blocks.size())
+    {
+        blocks.resize(numBlocks);
+    }
+
+    ThreadPool::getInstance().parallelFor(0, numBlocks, 1, [&](const int start, const int end)
+    {
+        std::vector<unsigned char> shuffled;
+
+        for(int b = start; b < end; b++)
+        {
+            const int first = b * MapWriter::BLOCK_SURFELS;
+
+            if(!MapWriter::compressBlock(upserts.data() + first * MapWriter::SURFEL_BYTES,
+                                         std::min(numUpserts - first, MapWriter::BLOCK_SURFELS),
+                                         shuffled,
+                                         blocks[b]))
+            {
+                blocks[b].clear();
+            }
+        }
+    });
+
+    //Removed ids are sorted, so the gaps between them are small and deflate well
+    for(size_t i = removed.size(); i > 1; i--)
+    {
+        removed[i - 1] -= removed[i - 2];
+    }
+
+    unsigned long removedBytes = compressBound(removed.size() * sizeof(uint32_t));
+    compressedRemoved.resize(removedBytes);
+
+    failed |= compress2(compressedRemoved.data(), &removedBytes, (const unsigned char *)removed.data(), removed.size() * sizeof(uint32_t), Z_BEST_SPEED) != Z_OK;
+
+    EntryHeader header = {(uint32_t)(keyframe ? KEYFRAME : DELTA),
+                          time,
+                          (uint32_t)ids.size(),
+                          (uint32_t)numUpserts,
+                          (uint32_t)removed.size(),
+                          (uint32_t)numBlocks,
+                          (uint32_t)removedBytes};
+
+    failed |= fwrite(&header, sizeof(EntryHeader), 1, fp) != 1;
+
+    for(int b = 0; b < numBlocks && !failed; b++)
+    {
+        uint32_t block[2] = {(uint32_t)std::min(numUpserts - b * MapWriter::BLOCK_SURFELS, MapWriter::BLOCK_SURFELS), (uint32_t)blocks[b].size()};
+
+        failed |= blocks[b].empty();
+        failed |= fwrite(block, sizeof(uint32_t), 2, fp) != 2;
+        failed |= fwrite(blocks[b].data(), 1, blocks[b].size(), fp) != blocks[b].size();
+    }
+
+    failed |= fwrite(compressedRemoved.data(), 1, removedBytes, fp) != removedBytes;
+
+    //Each entry hits the file whole, readers only ever see a cut off last entry
+    failed |= fflush(fp) != 0;
+
+    lastIds.swap(ids);
+    lastEntryTime = time;
+    entriesSinceKeyframe = keyframe ? 0 : entriesSinceKeyframe + 1;
+
+    return !failed;
+}
+
+MapJournalReader::MapJournalReader(const std::string & filename)
+ : fp(fopen(filename.c_str(), "rb"))
+{
+    if(!fp)
+    {
+        return;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    const long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    uint32_t header[2] = {0, 0};
+
+    if(fread(header, sizeof(uint32_t), 2, fp) != 2 || header[0] != MapJournal::MAGIC || header[1] > MapJournal::VERSION)
+    {
+        fclose(fp);
+        fp = 0;
+        return;
+    }
+
+    //Only the headers are read, anything past a cut off entry is ignored
+    Index entry;
+
+    while(fread(&entry.header, sizeof(MapJournal::EntryHeader), 1, fp) == 1)
+    {
+        entry.offset = ftell(fp);
+
+        bool complete = true;
+
+        for(uint32_t b = 0; b < entry.header.numBlocks && complete; b++)
+        {
+            uint32_t block[2] = {0, 0};
+
+            complete = fread(block, sizeof(uint32_t), 2, fp) == 2 && fseek(fp, block[1], SEEK_CUR) == 0 && ftell(fp) <= size;
+        }
+
+        if(!complete || fseek(fp, entry.header.removedBytes, SEEK_CUR) != 0 || ftell(fp) > size)
+        {
+            break;
+        }
+
+        index.push_back(entry);
+    }
+}
+
+MapJournalReader::~MapJournalReader()
+{
+    if(fp)
+    {
+        fclose(fp);
+    }
+}
+
+bool MapJournalReader::isValid() const
+{
+    return fp != 0;
+}
+
+int MapJournalReader::entries() const
+{
+    return index.size();
+}
+
+int MapJournalReader::entryTime(const int i) const
+{
+    return index.at(i).header.time;
+}
+
+bool MapJournalReader::read(const int i, Entry & entry)
+{
+    if(!fp || i < 0 || i >= (int)index.size())
+    {
+        return false;
+    }
+
+    const MapJournal::EntryHeader & header = index[i].header;
+
+    entry.type = (MapJournal::Type)header.type;
+    entry.time = header.time;
+    entry.numSurfels = header.numSurfels;
+    entry.upserts.resize(header.numUpserts * 3);
+    entry.removed.resize(header.numRemoved);
+
+    bool ok = fseek(fp, index[i].offset, SEEK_SET) == 0;
+
+    uint32_t done = 0;
+
+    for(uint32_t b = 0; b < header.numBlocks && ok; b++)
+    {
+        uint32_t block[2] = {0, 0};
+
+        ok = fread(block, sizeof(uint32_t), 2, fp) == 2 && done + block[0] <= header.numUpserts;
+
+        if(ok)
+        {
+            compressed.resize(block[1]);
+
+            ok = fread(compressed.data(), 1, compressed.size(), fp) == compressed.size() &&
+                 MapWriter::decompressBlock(compressed.data(), compressed.size(), block[0], scratch, (unsigned char *)&entry.upserts[done * 3]);
+
+            done += block[0];
+        }
+    }
+
+    if(ok)
+    {
+        compressed.resize(header.removedBytes);
+
+        unsigned long length = entry.removed.size() * sizeof(uint32_t);
+
+        ok = done == header.numUpserts &&
+             fread(compressed.data(), 1, compressed.size(), fp) == compressed.size() &&
+             uncompress((unsigned char *)entry.removed.data(), &length, compressed.data(), compressed.size()) == Z_OK &&
+             length == entry.removed.size() * sizeof(uint32_t);
+    }
+
+    for(size_t r = 1; r < entry.removed.size(); r++)
+    {
+        entry.removed[r] += entry.removed[r - 1];
+    }
+
+    return ok;
+}
+
+bool MapJournalReader::replay(const int time, std::vector<Eigen::Vector4f> & surfels)
+{
+    int last = -1;
+
+    while(last + 1 < (int)index.size() && index[last + 1].header.time <= time)
+    {
+        last++;
+    }
+
+    int first = last;
+
+    while(first >= 0 && index[first].header.type != MapJournal::KEYFRAME)
+    {
+        first--;
+    }
+
+    surfels.clear();
+
+    if(first < 0)
+    {
+        return false;
+    }
+
+    Entry entry;
+
+    for(int i = first; i <= last; i++)
+    {
+        if(!read(i, entry))
+        {
+            surfels.clear();
+            return false;
+        }
+
+        apply(entry, surfels);
+    }
+
+    return true;
+}
+
+void MapJournalReader::apply(const Entry & entry, std::vector<Eigen::Vector4f> & surfels)
+{
+    if(entry.type == MapJournal::KEYFRAME)
+    {
+        surfels = entry.upserts;
+        return;
+    }
+
+    //Everything is in id order, so this is a single merge
+    const size_t numSurfels = surfels.size() / 3;
+    const size_t numUpserts = entry.upserts.size() / 3;
+
+    std::vector<Eigen::Vector4f> merged;
+    merged.reserve(entry.numSurfels * 3);
+
+    size_t s = 0, u = 0, r = 0;
+
+    while(s < numSurfels || u < numUpserts)
+    {
+        if(u < numUpserts && (s == numSurfels || Vertex::id(&entry.upserts[u * 3]) <= Vertex::id(&surfels[s * 3])))
+        {
+            if(s < numSurfels && Vertex::id(&entry.upserts[u * 3]) == Vertex::id(&surfels[s * 3]))
+            {
+                s++;
+            }
+
+            merged.insert(merged.end(), &entry.upserts[u * 3], &entry.upserts[u * 3] + 3);
+            u++;
+        }
+        else
+        {
+            const uint32_t id = Vertex::id(&surfels[s * 3]);
+
+            while(r < entry.removed.size() && entry.removed[r] < id)
+            {
+                r++;
+            }
+
+            if(r == entry.removed.size() || entry.removed[r] != id)
+            {
+                merged.insert(merged.end(), &surfels[s * 3], &surfels[s * 3] + 3);
+            }
+
+            s++;
+        }
+    }
+
+    surfels.swap(merged);
+}
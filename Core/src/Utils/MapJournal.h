@@ -0,0 +1,172 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef UTILS_MAPJOURNAL_H_
+#define UTILS_MAPJOURNAL_H_
+
+#include <Eigen/Core>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+
+#include "MapWriter.h"
+#include "../Shaders/Vertex.h"
+#include "../Defines.h"
+
+/**
+ * Append-only journal of map changes. Each entry is either a keyframe holding every surfel or a delta holding
+ * the surfels added or changed since the previous entry plus the ids of the ones that went away.
+ * Surfels are keyed by their stable id (Vertex::id) and are byte shuffled and deflated like MapWriter's
+ * COMPRESSED format. Entries are only ever appended, so a truncated tail just loses the last entry.
+ */
+class MapJournal
+{
+    public:
+        enum Type
+        {
+            KEYFRAME = 0,
+            DELTA = 1
+        };
+
+        /**
+         * @param keyframeRate a keyframe is written every this many entries, bounding how far replay has to go
+         */
+        EFUSION_API MapJournal(const std::string & filename, const int keyframeRate = 50);
+        EFUSION_API virtual ~MapJournal();
+
+        /**
+         * Starts the entry for time, stream the whole current map through add() and then call end()
+         * @param keyframe force a keyframe, needed when surfels may have changed without their timestamps moving
+         */
+        EFUSION_API void begin(const int time, const bool keyframe);
+
+        /**
+         * A window of the current map in model buffer order, 3 Eigen::Vector4f per surfel
+         */
+        EFUSION_API void add(const Eigen::Vector4f * surfels, const int count);
+
+        /**
+         * Compresses and appends the entry
+         * @return false if anything failed to write
+         */
+        EFUSION_API bool end();
+
+        /**
+         * Time of the last entry written, -1 before the first
+         */
+        EFUSION_API int lastTime() const;
+
+        static const uint32_t MAGIC = 0x4a4d4645; //"EFMJ"
+        static const uint32_t VERSION = 1;
+
+        struct EntryHeader
+        {
+            uint32_t type;
+            int32_t time;
+            uint32_t numSurfels;
+            uint32_t numUpserts;
+            uint32_t numRemoved;
+            uint32_t numBlocks;
+            uint32_t removedBytes;
+        };
+
+    private:
+        FILE * fp;
+        const int keyframeRate;
+        bool failed;
+
+        int time;
+        int lastEntryTime;
+        int entriesSinceKeyframe;
+        bool keyframe;
+
+        std::vector<uint32_t> ids;
+        std::vector<uint32_t> lastIds;
+        std::vector<uint32_t> removed;
+        std::vector<unsigned char> upserts;
+
+        std::vector<int> chunkOffsets;
+        std::vector<std::vector<unsigned char> > blocks;
+        std::vector<unsigned char> compressedRemoved;
+};
+
+/**
+ * Reads a MapJournal back, either entry by entry for incremental consumers or as the whole map at some time
+ */
+class MapJournalReader
+{
+    public:
+        struct Entry
+        {
+            MapJournal::Type type;
+            int time;
+            uint32_t numSurfels;
+
+            /**
+             * Added or changed surfels in id order, 3 Eigen::Vector4f each
+             */
+            std::vector<Eigen::Vector4f> upserts;
+
+            /**
+             * Ids of removed surfels in increasing order, always empty for keyframes
+             */
+            std::vector<uint32_t> removed;
+        };
+
+        EFUSION_API MapJournalReader(const std::string & filename);
+        EFUSION_API virtual ~MapJournalReader();
+
+        EFUSION_API bool isValid() const;
+
+        /**
+         * Number of complete entries in the journal
+         */
+        EFUSION_API int entries() const;
+
+        EFUSION_API int entryTime(const int index) const;
+
+        EFUSION_API bool read(const int index, Entry & entry);
+
+        /**
+         * Rebuilds the map as it was at time, from the last keyframe at or before it plus the deltas after
+         * @param surfels 3 Eigen::Vector4f per surfel, in model buffer order
+         * @return false if there's no entry at or before time or the journal is damaged
+         */
+        EFUSION_API bool replay(const int time, std::vector<Eigen::Vector4f> & surfels);
+
+        /**
+         * Applies one entry to a map previously rebuilt by replay() or this
+         */
+        EFUSION_API static void apply(const Entry & entry, std::vector<Eigen::Vector4f> & surfels);
+
+    private:
+        struct Index
+        {
+            MapJournal::EntryHeader header;
+            long offset;
+        };
+
+        FILE * fp;
+        std::vector<Index> index;
+
+        std::vector<unsigned char> compressed;
+        std::vector<unsigned char> scratch;
+};
+
+#endif /* UTILS_MAPJOURNAL_H_ */
@@ -0,0 +1,698 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "MapPager.h"
+#include "MapWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <Eigen/LU>
+
+#ifndef WIN32
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+MapPager::MapPager(const std::string & filename, const float blockSize)
+ : filename(filename),
+   blockSize(blockSize),
+   fd(-1),
+   data(0),
+   capacity(0),
+   end(0),
+   busy(false),
+   shutdown(false),
+   firstDeformation(0)
+{
+    memset(&stats, 0, sizeof(Stats));
+
+#ifndef WIN32
+    fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if(fd >= 0)
+    {
+        pageThread = std::thread(&MapPager::pageLoop, this);
+    }
+#endif
+}
+
+MapPager::~MapPager()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutdown = true;
+    }
+
+    wake.notify_one();
+
+    if(pageThread.joinable())
+    {
+        pageThread.join();
+    }
+
+#ifndef WIN32
+    if(data)
+    {
+        munmap(data, capacity);
+    }
+
+    if(fd >= 0)
+    {
+        close(fd);
+        unlink(filename.c_str());
+    }
+#endif
+}
+
+bool MapPager::isOpen() const
+{
+    return fd >= 0;
+}
+
+float MapPager::getBlockSize() const
+{
+    return blockSize;
+}
+
+int64_t MapPager::key(const Eigen::Vector3f & position) const
+{
+    const int64_t bias = int64_t(1) << (KEY_BITS - 1);
+    const int64_t mask = (int64_t(1) << KEY_BITS) - 1;
+
+    const int64_t x = ((int64_t)std::floor(position(0) / blockSize) + bias) & mask;
+    const int64_t y = ((int64_t)std::floor(position(1) / blockSize) + bias) & mask;
+    const int64_t z = ((int64_t)std::floor(position(2) / blockSize) + bias) & mask;
+
+    return (x << (KEY_BITS * 2)) | (y << KEY_BITS) | z;
+}
+
+Eigen::Vector3f MapPager::centre(const int64_t key) const
+{
+    const int64_t bias = int64_t(1) << (KEY_BITS - 1);
+    const int64_t mask = (int64_t(1) << KEY_BITS) - 1;
+
+    //Same as the block centres page_surfels.vert works with
+    return Eigen::Vector3f((((key >> (KEY_BITS * 2)) & mask) - bias) + 0.5f,
+                           (((key >> KEY_BITS) & mask) - bias) + 0.5f,
+                           ((key & mask) - bias) + 0.5f) * blockSize;
+}
+
+void MapPager::pageOut(std::vector<Eigen::Vector4f> & surfels)
+{
+    if(!isOpen() || surfels.empty())
+    {
+        surfels.clear();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        jobs.push_back(Job());
+        jobs.back().surfels.swap(surfels);
+        jobs.back().deformation = firstDeformation + deformations.size();
+    }
+
+    wake.notify_one();
+}
+
+void MapPager::addDeformation(const std::vector<float> & graph, const int time)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    deformations.push_back(DeformationEvent());
+    deformations.back().graph = graph;
+    deformations.back().time = time;
+}
+
+void MapPager::request(const Eigen::Vector3f & position, const float radius)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::vector<int64_t> keys;
+
+        for(std::map<int64_t, Block>::iterator it = blocks.begin(); it != blocks.end(); ++it)
+        {
+            if(!it->second.loading && (centre(it->first) - position).norm() < radius)
+            {
+                it->second.loading = true;
+                keys.push_back(it->first);
+            }
+        }
+
+        if(keys.empty())
+        {
+            return;
+        }
+
+        jobs.push_back(Job());
+        jobs.back().keys.swap(keys);
+    }
+
+    wake.notify_one();
+}
+
+bool MapPager::ready(std::vector<Eigen::Vector4f> & surfels)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if(done.empty())
+    {
+        return false;
+    }
+
+    surfels.clear();
+    surfels.swap(done);
+
+    return true;
+}
+
+void MapPager::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    idle.wait(lock, [this]{ return jobs.empty() && !busy; });
+}
+
+unsigned long long int MapPager::pagedSurfels()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return stats.surfels + done.size() / 3;
+}
+
+void MapPager::forEach(const std::function<void(const Eigen::Vector4f *, const int)> & f)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::vector<Eigen::Vector4f> surfels;
+    std::vector<unsigned char> blockScratch;
+
+    for(std::map<int64_t, Block>::iterator it = blocks.begin(); it != blocks.end(); ++it)
+    {
+        for(size_t i = 0; i < it->second.extents.size(); i++)
+        {
+            const Extent & extent = it->second.extents.at(i);
+
+            surfels.clear();
+
+            if(!load(extent, surfels, blockScratch))
+            {
+                continue;
+            }
+
+            for(uint64_t d = extent.deformation; d < firstDeformation + deformations.size(); d++)
+            {
+                deform(surfels.data(), extent.count, deformations.at(d - firstDeformation));
+            }
+
+            f(surfels.data(), extent.count);
+        }
+    }
+
+    if(!done.empty())
+    {
+        f(done.data(), done.size() / 3);
+    }
+}
+
+void MapPager::clear()
+{
+    flush();
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    blocks.clear();
+    freeRegions.clear();
+    end = 0;
+
+    done.clear();
+
+    firstDeformation += deformations.size();
+    deformations.clear();
+
+    stats.surfels = 0;
+}
+
+MapPager::Stats MapPager::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Stats current = stats;
+    current.blocks = blocks.size();
+    current.fileBytes = end;
+
+    return current;
+}
+
+void MapPager::pageLoop()
+{
+    while(true)
+    {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            wake.wait(lock, [this]{ return shutdown || !jobs.empty(); });
+
+            //Whatever's still queued goes with the file
+            if(shutdown)
+            {
+                return;
+            }
+
+            job.surfels.swap(jobs.front().surfels);
+            job.keys.swap(jobs.front().keys);
+            job.deformation = jobs.front().deformation;
+
+            jobs.pop_front();
+            busy = true;
+        }
+
+        if(job.keys.empty())
+        {
+            write(job);
+        }
+        else
+        {
+            read(job);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            prune();
+            busy = false;
+        }
+
+        idle.notify_all();
+    }
+}
+
+void MapPager::write(Job & job)
+{
+    const int count = job.surfels.size() / 3;
+
+    //Group by block, surfels in a block keep their (id) order
+    std::vector<std::pair<int64_t, int> > order(count);
+
+    for(int i = 0; i < count; i++)
+    {
+        order[i] = std::make_pair(key(job.surfels[i * 3].head<3>()), i);
+    }
+
+    std::sort(order.begin(), order.end());
+
+    //They're already off the GPU, so anything that can't be written goes back in with the next ready
+    std::vector<Eigen::Vector4f> kept;
+
+    for(int first = 0; first < count;)
+    {
+        const int64_t block = order[first].first;
+
+        int last = first;
+
+        while(last < count && order[last].first == block && last - first < MapWriter::BLOCK_SURFELS)
+        {
+            last++;
+        }
+
+        const int n = last - first;
+
+        packed.resize(n * MapWriter::SURFEL_BYTES);
+
+        for(int i = 0; i < n; i++)
+        {
+            memcpy(&packed[i * MapWriter::SURFEL_BYTES], &job.surfels[order[first + i].second * 3], MapWriter::SURFEL_BYTES);
+        }
+
+        const int start = first;
+
+        first = last;
+
+        std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+
+        size_t offset = (size_t)-1;
+
+        if(MapWriter::compressBlock(packed.data(), n, scratch, compressed))
+        {
+            lock.lock();
+            offset = allocate(compressed.size());
+        }
+
+        if(offset == (size_t)-1)
+        {
+            for(int i = start; i < last; i++)
+            {
+                kept.insert(kept.end(), &job.surfels[order[i].second * 3], &job.surfels[order[i].second * 3] + 3);
+            }
+
+            continue;
+        }
+
+        memcpy(data + offset, compressed.data(), compressed.size());
+
+        Extent extent = {offset, (uint32_t)compressed.size(), (uint32_t)n, job.deformation};
+
+        //If the block is queued to be paged in this goes along with it
+        blocks[block].extents.push_back(extent);
+
+        stats.surfels += n;
+        stats.pagedOut += n;
+    }
+
+    if(kept.empty())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    //Catch up on the deformations the resident map had while these were queued
+    for(uint64_t d = std::max(job.deformation, firstDeformation); d < firstDeformation + deformations.size(); d++)
+    {
+        deform(kept.data(), kept.size() / 3, deformations.at(d - firstDeformation));
+    }
+
+    done.insert(done.end(), kept.begin(), kept.end());
+
+    stats.returned += kept.size() / 3;
+}
+
+void MapPager::read(Job & job)
+{
+    std::vector<Eigen::Vector4f> & surfels = job.surfels;
+
+    std::vector<const DeformationEvent *> events;
+    uint64_t eventsStart = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        //Deque elements stay put while more are pushed, and only this thread pops them
+        eventsStart = firstDeformation;
+
+        for(size_t i = 0; i < deformations.size(); i++)
+        {
+            events.push_back(&deformations.at(i));
+        }
+    }
+
+    for(size_t k = 0; k < job.keys.size(); k++)
+    {
+        std::vector<Extent> extents;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            std::map<int64_t, Block>::iterator it = blocks.find(job.keys.at(k));
+
+            if(it == blocks.end())
+            {
+                continue;
+            }
+
+            extents.swap(it->second.extents);
+            blocks.erase(it);
+        }
+
+        for(size_t i = 0; i < extents.size(); i++)
+        {
+            const Extent & extent = extents.at(i);
+            const size_t first = surfels.size();
+
+            const bool loaded = load(extent, surfels, scratch);
+
+            if(loaded)
+            {
+                for(uint64_t d = std::max(extent.deformation, eventsStart); d < eventsStart + events.size(); d++)
+                {
+                    deform(&surfels[first], extent.count, *events.at(d - eventsStart));
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+
+            release(extent.offset, extent.size);
+
+            stats.surfels -= extent.count;
+            stats.pagedIn += loaded ? extent.count : 0;
+            stats.dropped += loaded ? 0 : extent.count;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    done.insert(done.end(), surfels.begin(), surfels.end());
+}
+
+bool MapPager::load(const Extent & extent, std::vector<Eigen::Vector4f> & surfels, std::vector<unsigned char> & blockScratch)
+{
+    const size_t first = surfels.size();
+
+    surfels.resize(first + extent.count * 3);
+
+    if(!MapWriter::decompressBlock(data + extent.offset, extent.size, extent.count, blockScratch, (unsigned char *)&surfels[first]))
+    {
+        surfels.resize(first);
+        return false;
+    }
+
+    return true;
+}
+
+size_t MapPager::allocate(const size_t size)
+{
+    //First fit from the holes left by paged in blocks, then off the end of the file
+    std::multimap<size_t, size_t>::iterator it = freeRegions.lower_bound(size);
+
+    if(it != freeRegions.end())
+    {
+        const size_t offset = it->second;
+        const size_t rest = it->first - size;
+
+        freeRegions.erase(it);
+
+        if(rest > 0)
+        {
+            freeRegions.insert(std::make_pair(rest, offset + size));
+        }
+
+        return offset;
+    }
+
+    if(end + size > capacity && !grow(end + size))
+    {
+        return (size_t)-1;
+    }
+
+    const size_t offset = end;
+    end += size;
+
+    return offset;
+}
+
+void MapPager::release(const size_t offset, const size_t size)
+{
+    freeRegions.insert(std::make_pair(size, offset));
+}
+
+bool MapPager::grow(const size_t size)
+{
+#ifndef WIN32
+    const size_t newCapacity = std::max(std::max(capacity * 2, size), MIN_CAPACITY);
+
+    if(ftruncate(fd, newCapacity) != 0)
+    {
+        return false;
+    }
+
+    void * mapped = mmap(0, newCapacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if(mapped == MAP_FAILED)
+    {
+        return false;
+    }
+
+    if(data)
+    {
+        munmap(data, capacity);
+    }
+
+    data = (unsigned char *)mapped;
+    capacity = newCapacity;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void MapPager::prune()
+{
+    //Deformations only matter to what was paged out before them
+    uint64_t oldest = firstDeformation + deformations.size();
+
+    for(std::map<int64_t, Block>::const_iterator it = blocks.begin(); it != blocks.end(); ++it)
+    {
+        for(size_t i = 0; i < it->second.extents.size(); i++)
+        {
+            oldest = std::min(oldest, it->second.extents.at(i).deformation);
+        }
+    }
+
+    for(size_t i = 0; i < jobs.size(); i++)
+    {
+        if(jobs.at(i).keys.empty())
+        {
+            oldest = std::min(oldest, jobs.at(i).deformation);
+        }
+    }
+
+    while(firstDeformation < oldest)
+    {
+        deformations.pop_front();
+        firstDeformation++;
+    }
+}
+
+void MapPager::deform(Eigen::Vector4f * surfels, const int count, const DeformationEvent & event)
+{
+    //The same as copy_unstable.vert does to the resident map
+    const int nodes = event.graph.size() / 16;
+    const float * graph = event.graph.data();
+
+    const int k = 4;
+    const int lookBack = 20;
+
+    if(nodes == 0)
+    {
+        return;
+    }
+
+    for(int s = 0; s < count; s++)
+    {
+        Eigen::Vector4f * surfel = &surfels[s * 3];
+
+        //Fused with the updated pose already
+        if(surfel[1](2) == event.time)
+        {
+            continue;
+        }
+
+        const int poseTime = int(surfel[1](2));
+
+        int imin = 0;
+        int imax = nodes - 1;
+        int imid = (imin + imax) / 2;
+
+        while(imax >= imin)
+        {
+            imid = (imin + imax) / 2;
+
+            const int nodeTime = int(graph[imid * 16 + 15]);
+
+            if(nodeTime < poseTime)
+            {
+                imin = imid + 1;
+            }
+            else if(nodeTime > poseTime)
+            {
+                imax = imid - 1;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        imin = std::min(imin, nodes - 1);
+        imax = std::max(imax, 0);
+
+        const int nodeMin = int(graph[imin * 16 + 15]);
+        const int nodeMid = int(graph[imid * 16 + 15]);
+        const int nodeMax = int(graph[imax * 16 + 15]);
+
+        int foundIndex = imax;
+
+        if(std::abs(nodeMin - poseTime) <= std::abs(nodeMid - poseTime) &&
+           std::abs(nodeMin - poseTime) <= std::abs(nodeMax - poseTime))
+        {
+            foundIndex = imin;
+        }
+        else if(std::abs(nodeMid - poseTime) <= std::abs(nodeMin - poseTime) &&
+                std::abs(nodeMid - poseTime) <= std::abs(nodeMax - poseTime))
+        {
+            foundIndex = imid;
+        }
+
+        const Eigen::Vector3f position = surfel[0].head<3>();
+
+        std::pair<float, int> near[lookBack];
+        int numNear = 0;
+
+        for(int j = foundIndex; j >= 0 && numNear < lookBack / 2; j--)
+        {
+            near[numNear++] = std::make_pair((position - Eigen::Map<const Eigen::Vector3f>(&graph[j * 16])).norm(), j);
+        }
+
+        for(int j = foundIndex + 1; j < nodes && numNear < lookBack; j++)
+        {
+            near[numNear++] = std::make_pair((position - Eigen::Map<const Eigen::Vector3f>(&graph[j * 16])).norm(), j);
+        }
+
+        std::sort(near, near + numNear);
+
+        const int numWeights = std::min(k, numNear);
+        const float dMax = numNear > k ? near[k].first : 16777216.0f;
+
+        float weights[k];
+        float weightSum = 0;
+
+        for(int j = 0; j < numWeights; j++)
+        {
+            weights[j] = std::pow(1.0f - near[j].first / dMax, 2.0f);
+            weightSum += weights[j];
+        }
+
+        Eigen::Vector3f newPos = Eigen::Vector3f::Zero();
+        Eigen::Vector3f newNorm = Eigen::Vector3f::Zero();
+
+        for(int j = 0; j < numWeights; j++)
+        {
+            const float * node = &graph[near[j].second * 16];
+
+            Eigen::Map<const Eigen::Vector3f> nodePosition(node);
+            Eigen::Map<const Eigen::Matrix3f> rotation(node + 3);
+            Eigen::Map<const Eigen::Vector3f> translation(node + 12);
+
+            const float weight = weights[j] / weightSum;
+
+            newPos += weight * (rotation * (position - nodePosition) + nodePosition + translation);
+            newNorm += weight * (rotation.inverse().transpose() * surfel[2].head<3>());
+        }
+
+        surfel[0].head<3>() = newPos;
+        surfel[2].head<3>() = newNorm.normalized();
+    }
+}
@@ -0,0 +1,202 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef UTILS_MAPPAGER_H_
+#define UTILS_MAPPAGER_H_
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+#include "../Defines.h"
+
+/**
+ * Keeps the parts of the map that are far from the camera in a memory mapped file rather than on the GPU.
+ * Space is cut into cubic blocks, surfels are paged out and back in a block at a time, compressed the same way
+ * as MapWriter blocks. All the file work and (de)compression happens on the pager's own thread, the GL thread
+ * only hands surfels over and picks them up.
+ *
+ * Deformations applied to the resident map while a block is paged out are replayed on it when it comes back,
+ * so it lines up with everything that stayed.
+ */
+class MapPager
+{
+    public:
+        /**
+         * @param filename page file, created (or truncated) here and removed again by the destructor
+         * @param blockSize edge length of the blocks in metres
+         */
+        EFUSION_API MapPager(const std::string & filename, const float blockSize);
+        EFUSION_API virtual ~MapPager();
+
+        EFUSION_API bool isOpen() const;
+
+        EFUSION_API float getBlockSize() const;
+
+        /**
+         * Pages these surfels out (3 Eigen::Vector4f each), surfels is left empty
+         */
+        void pageOut(std::vector<Eigen::Vector4f> & surfels);
+
+        /**
+         * Records a deformation graph (in the GlobalModel::clean format) as it's applied to the resident map
+         * @param time the tick it's applied at
+         */
+        void addDeformation(const std::vector<float> & graph, const int time);
+
+        /**
+         * Starts paging in every block with its centre within radius of centre, if any
+         */
+        void request(const Eigen::Vector3f & centre, const float radius);
+
+        /**
+         * Swaps in the surfels that finished paging in since the last call
+         * @return false if there weren't any
+         */
+        bool ready(std::vector<Eigen::Vector4f> & surfels);
+
+        /**
+         * Waits for the pager thread to catch up
+         */
+        void flush();
+
+        /**
+         * Surfels paged out or paged in but not picked up yet, call flush first for an exact count
+         */
+        EFUSION_API unsigned long long int pagedSurfels();
+
+        /**
+         * Calls f with every surfel that isn't resident (see pagedSurfels), up to date with deformations. Nothing is
+         * paged in. Call flush first
+         */
+        void forEach(const std::function<void(const Eigen::Vector4f *, const int)> & f);
+
+        /**
+         * Forgets everything paged out, e.g. when the map is replaced
+         */
+        void clear();
+
+        struct Stats
+        {
+            unsigned int blocks;
+            unsigned long long int surfels;
+            unsigned long long int fileBytes;
+            unsigned long long int pagedOut;
+            unsigned long long int pagedIn;
+
+            //Surfels that couldn't be written out (compression or file growth failed) and went back to the map
+            unsigned long long int returned;
+
+            //Surfels lost because their block wouldn't decompress on the way back in
+            unsigned long long int dropped;
+        };
+
+        EFUSION_API Stats getStats();
+
+    private:
+        struct Extent
+        {
+            size_t offset;
+            uint32_t size;
+            uint32_t count;
+
+            //Deformations recorded before this was paged out, later ones still have to be applied
+            uint64_t deformation;
+        };
+
+        struct Block
+        {
+            std::vector<Extent> extents;
+            bool loading;
+        };
+
+        struct DeformationEvent
+        {
+            std::vector<float> graph;
+            int time;
+        };
+
+        struct Job
+        {
+            std::vector<Eigen::Vector4f> surfels;
+            std::vector<int64_t> keys;
+            uint64_t deformation;
+        };
+
+        int64_t key(const Eigen::Vector3f & position) const;
+        Eigen::Vector3f centre(const int64_t key) const;
+
+        void pageLoop();
+        void write(Job & job);
+        void read(Job & job);
+        bool load(const Extent & extent, std::vector<Eigen::Vector4f> & surfels, std::vector<unsigned char> & blockScratch);
+
+        size_t allocate(const size_t size);
+        void release(const size_t offset, const size_t size);
+        bool grow(const size_t size);
+
+        void prune();
+
+        static void deform(Eigen::Vector4f * surfels, const int count, const DeformationEvent & event);
+
+        std::string filename;
+        const float blockSize;
+
+        int fd;
+        unsigned char * data;
+        size_t capacity;
+        size_t end;
+        std::multimap<size_t, size_t> freeRegions;
+
+        //Guards everything below
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable idle;
+
+        std::map<int64_t, Block> blocks;
+        std::deque<Job> jobs;
+        bool busy;
+        bool shutdown;
+
+        std::vector<Eigen::Vector4f> done;
+
+        std::deque<DeformationEvent> deformations;
+        uint64_t firstDeformation;
+
+        Stats stats;
+
+        std::thread pageThread;
+
+        //Only touched by the pager thread, data and capacity only change under the mutex
+        std::vector<unsigned char> packed;
+        std::vector<unsigned char> scratch;
+        std::vector<unsigned char> compressed;
+
+        static const int KEY_BITS = 21;
+        static const size_t MIN_CAPACITY = 64 << 20;
+};
+
+#endif /* UTILS_MAPPAGER_H_ */
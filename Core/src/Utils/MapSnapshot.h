@@ -0,0 +1,75 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef UTILS_MAPSNAPSHOT_H_
+#define UTILS_MAPSNAPSHOT_H_
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <vector>
+
+/**
+ * An immutable host copy of part of the map, safe to read from any thread for as long as it's held
+ */
+class MapSnapshot
+{
+    public:
+        MapSnapshot()
+         : tick(-1),
+           rewrite(0),
+           confidenceThreshold(0)
+        {}
+
+        /**
+         * The last frame fused into the map when this was taken, the surfels all reflect exactly that frame
+         */
+        int tick;
+
+        //Bumped by deformations and loads that change the map without the tick moving
+        unsigned int rewrite;
+
+        float confidenceThreshold;
+        Eigen::AlignedBox3f region;
+
+        /**
+         * 3 Eigen::Vector4f per surfel as laid out in the model buffer (see Vertex.cpp)
+         */
+        std::vector<Eigen::Vector4f> surfels;
+
+        int size() const
+        {
+            return surfels.size() / 3;
+        }
+
+        const Eigen::Vector4f & position(const int i) const
+        {
+            return surfels[i * 3];
+        }
+
+        const Eigen::Vector4f & color(const int i) const
+        {
+            return surfels[i * 3 + 1];
+        }
+
+        const Eigen::Vector4f & normal(const int i) const
+        {
+            return surfels[i * 3 + 2];
+        }
+};
+
+#endif /* UTILS_MAPSNAPSHOT_H_ */
@@ -0,0 +1,355 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "MapWriter.h"
+
+#include <zlib.h>
+#include <cstring>
+
+const int MapWriter::SURFEL_BYTES;
+const int MapWriter::BLOCK_SURFELS;
+
+//Wide enough for any count, the header is patched with the real value in finish()
+static const int COUNT_WIDTH = 20;
+
+MapWriter::MapWriter(const std::string & filename, const Format format, const float confidenceThreshold)
+ : fp(fopen(filename.c_str(), "wb")),
+   format(format),
+   confidenceThreshold(confidenceThreshold),
+   written(0),
+   countOffset(0),
+   failed(fp == 0),
+   chunkOffsets(ThreadPool::MAX_CHUNKS + 1)
+{
+    if(failed)
+    {
+        return;
+    }
+
+    if(format == PLY)
+    {
+        fputs("ply\nformat binary_little_endian 1.0\nelement vertex ", fp);
+        countOffset = ftell(fp);
+        fprintf(fp, "%-*d\n", COUNT_WIDTH, 0);
+
+        fputs("property float x\n"
+              "property float y\n"
+              "property float z\n"
+              "property uchar red\n"
+              "property uchar green\n"
+              "property uchar blue\n"
+              "property float nx\n"
+              "property float ny\n"
+              "property float nz\n"
+              "property float radius\n"
+              "end_header\n", fp);
+    }
+    else
+    {
+        uint32_t header[2] = {MAGIC, VERSION};
+        fwrite(header, sizeof(uint32_t), 2, fp);
+        countOffset = ftell(fp);
+        fwrite(&written, sizeof(uint64_t), 1, fp);
+    }
+}
+
+MapWriter::~MapWriter()
+{
+    finish();
+}
+
+void MapWriter::write(const Eigen::Vector4f * surfels, const int count)
+{
+    if(failed || count <= 0)
+    {
+        return;
+    }
+
+    const int numChunks = ThreadPool::MAX_CHUNKS;
+    const int chunkSize = (count + numChunks - 1) / numChunks;
+
+    //Count what passes the threshold in each chunk, so every chunk knows where its output starts
+    ThreadPool::getInstance().parallelFor(0, numChunks, 1, [&](const int start, const int end)
+    {
+        for(int c = start; c < end; c++)
+        {
+            int valid = 0;
+
+            for(int i = c * chunkSize; i < std::min(count, (c + 1) * chunkSize); i++)
+            {
+                valid += surfels[i * 3](3) > confidenceThreshold;
+            }
+
+            chunkOffsets[c + 1] = valid;
+        }
+    });
+
+    chunkOffsets[0] = 0;
+
+    for(int c = 0; c < numChunks; c++)
+    {
+        chunkOffsets[c + 1] += chunkOffsets[c];
+    }
+
+    if(format == PLY)
+    {
+        writePly(surfels, count);
+    }
+    else
+    {
+        writeCompressed(surfels, count);
+    }
+
+    written += chunkOffsets[numChunks];
+}
+
+void MapWriter::writePly(const Eigen::Vector4f * surfels, const int count)
+{
+    //x, y, z, r, g, b, nx, ny, nz, radius
+    const int vertexBytes = sizeof(float) * 7 + sizeof(unsigned char) * 3;
+    const int numChunks = ThreadPool::MAX_CHUNKS;
+    const int chunkSize = (count + numChunks - 1) / numChunks;
+
+    packed.resize(chunkOffsets[numChunks] * vertexBytes);
+
+    ThreadPool::getInstance().parallelFor(0, numChunks, 1, [&](const int start, const int end)
+    {
+        for(int c = start; c < end; c++)
+        {
+            unsigned char * out = packed.data() + chunkOffsets[c] * vertexBytes;
+
+            for(int i = c * chunkSize; i < std::min(count, (c + 1) * chunkSize); i++)
+            {
+                const Eigen::Vector4f & pos = surfels[(i * 3) + 0];
+
+                if(pos[3] > confidenceThreshold)
+                {
+                    const Eigen::Vector4f & col = surfels[(i * 3) + 1];
+                    Eigen::Vector4f nor = surfels[(i * 3) + 2];
+
+                    nor[0] *= -1;
+                    nor[1] *= -1;
+                    nor[2] *= -1;
+
+                    memcpy(out, pos.data(), sizeof(float) * 3);
+                    out += sizeof(float) * 3;
+
+                    *out++ = int(col[0]) >> 16 & 0xFF;
+                    *out++ = int(col[0]) >> 8 & 0xFF;
+                    *out++ = int(col[0]) & 0xFF;
+
+                    memcpy(out, nor.data(), sizeof(float) * 4);
+                    out += sizeof(float) * 4;
+                }
+            }
+        }
+    });
+
+    failed |= fwrite(packed.data(), 1, packed.size(), fp) != packed.size();
+}
+
+void MapWriter::writeCompressed(const Eigen::Vector4f * surfels, const int count)
+{
+    const int numChunks = ThreadPool::MAX_CHUNKS;
+    const int chunkSize = (count + numChunks - 1) / numChunks;
+    const int total = chunkOffsets[numChunks];
+
+    //Compact the surfels that pass the threshold
+    packed.resize(total * SURFEL_BYTES);
+
+    ThreadPool::getInstance().parallelFor(0, numChunks, 1, [&](const int start, const int end)
+    {
+        for(int c = start; c < end; c++)
+        {
+            unsigned char * out = packed.data() + chunkOffsets[c] * SURFEL_BYTES;
+
+            for(int i = c * chunkSize; i < std::min(count, (c + 1) * chunkSize); i++)
+            {
+                if(surfels[i * 3](3) > confidenceThreshold)
+                {
+                    memcpy(out, &surfels[i * 3], SURFEL_BYTES);
+                    out += SURFEL_BYTES;
+                }
+            }
+        }
+    });
+
+    const int numBlocks = (total + BLOCK_SURFELS - 1) / BLOCK_SURFELS;
+
+    if(numBlocks > (int)blocks.size())
+    {
+        blocks.resize(numBlocks);
+    }
+
+    ThreadPool::getInstance().parallelFor(0, numBlocks, 1, [&](const int start, const int end)
+    {
+        std::vector<unsigned char> shuffled;
+
+        for(int b = start; b < end; b++)
+        {
+            const int first = b * BLOCK_SURFELS;
+
+            if(!compressBlock(packed.data() + first * SURFEL_BYTES, std::min(total - first, BLOCK_SURFELS), shuffled, blocks[b]))
+            {
+                blocks[b].clear();
+            }
+        }
+    });
+
+    for(int b = 0; b < numBlocks; b++)
+    {
+        uint32_t header[2] = {(uint32_t)std::min(total - b * BLOCK_SURFELS, BLOCK_SURFELS), (uint32_t)blocks[b].size()};
+
+        failed |= blocks[b].empty();
+        failed |= fwrite(header, sizeof(uint32_t), 2, fp) != 2;
+        failed |= fwrite(blocks[b].data(), 1, blocks[b].size(), fp) != blocks[b].size();
+    }
+}
+
+bool MapWriter::compressBlock(const unsigned char * surfels, const int count, std::vector<unsigned char> & scratch, std::vector<unsigned char> & block)
+{
+    //Putting byte n of every surfel next to each other makes floats compress a lot better
+    scratch.resize(count * SURFEL_BYTES);
+
+    for(int byte = 0; byte < SURFEL_BYTES; byte++)
+    {
+        unsigned char * plane = scratch.data() + byte * count;
+
+        for(int i = 0; i < count; i++)
+        {
+            plane[i] = surfels[i * SURFEL_BYTES + byte];
+        }
+    }
+
+    unsigned long size = compressBound(scratch.size());
+    block.resize(size);
+
+    if(compress2(block.data(), &size, scratch.data(), scratch.size(), Z_BEST_SPEED) != Z_OK)
+    {
+        return false;
+    }
+
+    block.resize(size);
+
+    return true;
+}
+
+bool MapWriter::decompressBlock(const unsigned char * block, const int size, const int count, std::vector<unsigned char> & scratch, unsigned char * surfels)
+{
+    scratch.resize(count * SURFEL_BYTES);
+
+    unsigned long length = scratch.size();
+
+    if(uncompress(scratch.data(), &length, block, size) != Z_OK || length != scratch.size())
+    {
+        return false;
+    }
+
+    for(int byte = 0; byte < SURFEL_BYTES; byte++)
+    {
+        const unsigned char * plane = scratch.data() + byte * count;
+
+        for(int i = 0; i < count; i++)
+        {
+            surfels[i * SURFEL_BYTES + byte] = plane[i];
+        }
+    }
+
+    return true;
+}
+
+bool MapWriter::finish()
+{
+    if(!fp)
+    {
+        return !failed;
+    }
+
+    fseek(fp, countOffset, SEEK_SET);
+
+    if(format == PLY)
+    {
+        fprintf(fp, "%-*llu", COUNT_WIDTH, (unsigned long long)written);
+    }
+    else
+    {
+        fwrite(&written, sizeof(uint64_t), 1, fp);
+    }
+
+    failed |= fclose(fp) != 0;
+    fp = 0;
+
+    return !failed;
+}
+
+bool MapWriter::load(const std::string & filename, std::vector<Eigen::Vector4f> & surfels)
+{
+    FILE * in = fopen(filename.c_str(), "rb");
+
+    if(!in)
+    {
+        return false;
+    }
+
+    uint32_t header[2] = {0, 0};
+    uint64_t total = 0;
+
+    bool ok = fread(header, sizeof(uint32_t), 2, in) == 2 && header[0] == MAGIC && header[1] <= VERSION &&
+              fread(&total, sizeof(uint64_t), 1, in) == 1;
+
+    surfels.clear();
+
+    if(ok)
+    {
+        surfels.resize(total * 3);
+    }
+
+    std::vector<unsigned char> compressed;
+    std::vector<unsigned char> shuffled;
+    uint64_t done = 0;
+
+    while(ok && done < total)
+    {
+        uint32_t block[2] = {0, 0};
+
+        ok = fread(block, sizeof(uint32_t), 2, in) == 2 && done + block[0] <= total;
+
+        if(!ok)
+        {
+            break;
+        }
+
+        const int n = block[0];
+
+        compressed.resize(block[1]);
+
+        ok = fread(compressed.data(), 1, compressed.size(), in) == compressed.size() &&
+             decompressBlock(compressed.data(), compressed.size(), n, shuffled, (unsigned char *)&surfels[done * 3]);
+
+        done += n;
+    }
+
+    fclose(in);
+
+    if(!ok)
+    {
+        surfels.clear();
+    }
+
+    return ok;
+}
@@ -0,0 +1,104 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef UTILS_MAPWRITER_H_
+#define UTILS_MAPWRITER_H_
+
+#include <Eigen/Core>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+
+#include "ThreadPool.h"
+#include "../Defines.h"
+
+/**
+ * Writes the surfel map out window by window, so the whole map never has to be on the host at once.
+ * Windows are filtered by confidence and packed in parallel, then written as one block.
+ */
+class MapWriter
+{
+    public:
+        enum Format
+        {
+            /**
+             * Binary PLY with x, y, z, r, g, b, nx, ny, nz, radius per surfel
+             */
+            PLY,
+
+            /**
+             * Our own format, every surfel as stored on the GPU, byte shuffled and deflated in independent blocks
+             */
+            COMPRESSED
+        };
+
+        EFUSION_API MapWriter(const std::string & filename, const Format format, const float confidenceThreshold);
+        EFUSION_API virtual ~MapWriter();
+
+        /**
+         * Appends a window of surfels, 3 Eigen::Vector4f each as laid out in the model buffer
+         */
+        EFUSION_API void write(const Eigen::Vector4f * surfels, const int count);
+
+        /**
+         * Fills in the final surfel count and closes the file
+         * @return false if anything failed to write
+         */
+        EFUSION_API bool finish();
+
+        /**
+         * Reads a map written with the COMPRESSED format back in
+         * @param surfels 3 Eigen::Vector4f per surfel
+         */
+        EFUSION_API static bool load(const std::string & filename, std::vector<Eigen::Vector4f> & surfels);
+
+        /**
+         * Byte shuffles and deflates count surfels into block, this is one block of the COMPRESSED format
+         * @param scratch reused between calls to avoid allocating
+         */
+        static bool compressBlock(const unsigned char * surfels, const int count, std::vector<unsigned char> & scratch, std::vector<unsigned char> & block);
+
+        /**
+         * Inverse of compressBlock, surfels must have room for count surfels
+         */
+        static bool decompressBlock(const unsigned char * block, const int size, const int count, std::vector<unsigned char> & scratch, unsigned char * surfels);
+
+        static const uint32_t MAGIC = 0x504d4645; //"EFMP"
+        static const uint32_t VERSION = 1;
+
+        static const int SURFEL_BYTES = sizeof(Eigen::Vector4f) * 3;
+        static const int BLOCK_SURFELS = 1 << 16;
+
+    private:
+        void writePly(const Eigen::Vector4f * surfels, const int count);
+        void writeCompressed(const Eigen::Vector4f * surfels, const int count);
+
+        FILE * fp;
+        const Format format;
+        const float confidenceThreshold;
+        uint64_t written;
+        long countOffset;
+        bool failed;
+
+        std::vector<int> chunkOffsets;
+        std::vector<unsigned char> packed;
+        std::vector<std::vector<unsigned char> > blocks;
+};
+
+#endif /* UTILS_MAPWRITER_H_ */
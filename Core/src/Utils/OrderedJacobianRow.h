@@ -20,7 +20,7 @@
 #define UTILS_ORDEREDJACOBIANROW_H_
 
 #include <cassert>
-#include <unordered_map>
+#include <algorithm>
 
 class OrderedJacobianRow
 {
@@ -42,8 +42,7 @@ class OrderedJacobianRow
         //You have to use this in an ordered fashion for efficiency :)
         void append(const int index, const double value)
         {
-            assert(index > lastIndex);
-            indexSlotMap[index] = lastSlot;
+            assert(index > lastIndex && lastSlot < maxNonZero);
             indices[lastSlot] = index;
             vals[lastSlot] = value;
             lastSlot++;
@@ -53,7 +52,10 @@ class OrderedJacobianRow
         //To add to an existing and already weighted value
         void addTo(const int index, const double value, const double weight)
         {
-            double & val = vals[indexSlotMap[index]];
+            //Indices are sorted and rows are tiny, so no need for a map (and its allocations)
+            int * slot = std::lower_bound(indices, indices + lastSlot, index);
+            assert(slot != indices + lastSlot && *slot == index);
+            double & val = vals[slot - indices];
             val = ((val / weight) + value) * weight;
         }
 
@@ -69,7 +71,6 @@ class OrderedJacobianRow
         int lastSlot;
         int lastIndex;
         const int maxNonZero;
-        std::unordered_map<int, int> indexSlotMap;
 };
 
 
@@ -0,0 +1,185 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef UTILS_POSECHANNEL_H_
+#define UTILS_POSECHANNEL_H_
+
+#include <atomic>
+#include <string>
+#include <cstring>
+#include <cstdint>
+
+#ifndef WIN32
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+/**
+ * Everything published once per frame. Plain data only, it's copied in and out of shared memory as is
+ */
+struct PoseStatus
+{
+    //Camera to world, column-major like Eigen::Matrix4f
+    float pose[16];
+
+    //As handed to processFrame
+    int64_t timestamp;
+
+    int32_t tick;
+    uint8_t lost;
+
+    //Whether a local (model to model) or global (fern) loop closure deformed the map this frame
+    uint8_t deformed;
+    uint8_t fernDeformed;
+
+    //FrameGovernor::Level the frame ran at, 0 for all of it
+    uint8_t degradation;
+
+    float icpError;
+    float icpCount;
+
+    //Running totals of the above
+    int32_t deforms;
+    int32_t fernDeforms;
+};
+
+/**
+ * The shared memory layout, a sequence lock in front of the latest status. The writer makes sequence odd, copies
+ * the status in and makes it even again, so readers never block it and just retry if they see it change under them
+ */
+struct PoseChannel
+{
+    static const uint32_t MAGIC = 0x43504645; //"EFPC"
+    static const uint32_t VERSION = 1;
+
+    uint32_t magic;
+    uint32_t version;
+
+    //Own cache line, readers spin on it
+    alignas(64) std::atomic<uint32_t> sequence;
+
+    PoseStatus status;
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "The sequence has to be lock free to work across processes");
+
+/**
+ * Reads what ElasticFusion publishes with setPublisher() from another process. Header only, so readers don't
+ * need to link against anything (bar -lrt on older glibc)
+ */
+class PoseReader
+{
+    public:
+        PoseReader(const std::string & name)
+         : channel(0)
+        {
+#ifndef WIN32
+            int fd = shm_open(name[0] == '/' ? name.c_str() : ("/" + name).c_str(), O_RDONLY, 0);
+
+            if(fd >= 0)
+            {
+                void * ptr = mmap(0, sizeof(PoseChannel), PROT_READ, MAP_SHARED, fd, 0);
+
+                if(ptr != MAP_FAILED)
+                {
+                    channel = (const PoseChannel *)ptr;
+                }
+
+                close(fd);
+            }
+
+            if(channel && (channel->magic != PoseChannel::MAGIC || channel->version != PoseChannel::VERSION))
+            {
+                munmap((void *)channel, sizeof(PoseChannel));
+                channel = 0;
+            }
+#endif
+        }
+
+        virtual ~PoseReader()
+        {
+#ifndef WIN32
+            if(channel)
+            {
+                munmap((void *)channel, sizeof(PoseChannel));
+            }
+#endif
+        }
+
+        /**
+         * False if the publisher wasn't running when this was made, just make another one to retry
+         */
+        bool isOpen() const
+        {
+            return channel != 0;
+        }
+
+        /**
+         * Cheap to poll, changes every time a new status is published
+         */
+        uint32_t sequence() const
+        {
+            return channel ? channel->sequence.load(std::memory_order_acquire) : 0;
+        }
+
+        /**
+         * Copies out the latest status, never waits on the writer for longer than one copy
+         * @param seen if given, returns false straight away unless there's something newer than this sequence, and is
+         * set to the sequence that was read
+         * @return false if nothing (new) has been published
+         */
+        bool read(PoseStatus & status, uint32_t * seen = 0) const
+        {
+            if(!channel)
+            {
+                return false;
+            }
+
+            uint32_t before, after;
+
+            do
+            {
+                before = channel->sequence.load(std::memory_order_acquire);
+
+                if(seen && before == *seen)
+                {
+                    return false;
+                }
+
+                memcpy(&status, (const void *)&channel->status, sizeof(PoseStatus));
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                after = channel->sequence.load(std::memory_order_relaxed);
+            }
+            while((before & 1) || before != after);
+
+            if(seen)
+            {
+                *seen = before;
+            }
+
+            return before > 0;
+        }
+
+    private:
+        const PoseChannel * channel;
+};
+
+#endif /* UTILS_POSECHANNEL_H_ */
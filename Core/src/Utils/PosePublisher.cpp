@@ -0,0 +1,93 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "PosePublisher.h"
+
+PosePublisher::PosePublisher(const std::string & name)
+ : name(name[0] == '/' ? name : "/" + name),
+   channel(0)
+{
+#ifndef WIN32
+    int fd = shm_open(this->name.c_str(), O_CREAT | O_RDWR, 0644);
+
+    if(fd < 0)
+    {
+        return;
+    }
+
+    if(ftruncate(fd, sizeof(PoseChannel)) == 0)
+    {
+        void * ptr = mmap(0, sizeof(PoseChannel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if(ptr != MAP_FAILED)
+        {
+            channel = (PoseChannel *)ptr;
+
+            //Left over from a previous run, start the sequence again
+            memset((void *)channel, 0, sizeof(PoseChannel));
+
+            channel->magic = PoseChannel::MAGIC;
+            channel->version = PoseChannel::VERSION;
+
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+    }
+
+    close(fd);
+
+    if(!channel)
+    {
+        shm_unlink(this->name.c_str());
+    }
+#endif
+}
+
+PosePublisher::~PosePublisher()
+{
+#ifndef WIN32
+    if(channel)
+    {
+        munmap(channel, sizeof(PoseChannel));
+        shm_unlink(name.c_str());
+    }
+#endif
+}
+
+bool PosePublisher::isOpen() const
+{
+    return channel != 0;
+}
+
+void PosePublisher::publish(const PoseStatus & status)
+{
+    if(!channel)
+    {
+        return;
+    }
+
+    //Only we ever write it, so no need for a read-modify-write
+    const uint32_t sequence = channel->sequence.load(std::memory_order_relaxed);
+
+    channel->sequence.store(sequence + 1, std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy((void *)&channel->status, &status, sizeof(PoseStatus));
+
+    channel->sequence.store(sequence + 2, std::memory_order_release);
+}
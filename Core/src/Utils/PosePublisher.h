@@ -0,0 +1,49 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef UTILS_POSEPUBLISHER_H_
+#define UTILS_POSEPUBLISHER_H_
+
+#include "PoseChannel.h"
+#include "../Defines.h"
+
+/**
+ * Writer side of a PoseChannel, see PoseReader for the other end. The shared memory goes away with this
+ */
+class PosePublisher
+{
+    public:
+        /**
+         * @param name shared memory object to create, e.g. "efusion" ends up as /dev/shm/efusion on Linux
+         */
+        EFUSION_API PosePublisher(const std::string & name);
+        EFUSION_API virtual ~PosePublisher();
+
+        EFUSION_API bool isOpen() const;
+
+        /**
+         * Wait free, a reader mid copy just has to go again
+         */
+        EFUSION_API void publish(const PoseStatus & status);
+
+    private:
+        std::string name;
+        PoseChannel * channel;
+};
+
+#endif /* UTILS_POSEPUBLISHER_H_ */
@@ -39,7 +39,8 @@ RGBDOdometry::RGBDOdometry(int width,
   angleThres_(angleThresh),
   width(width),
   height(height),
-  cx(cx), cy(cy), fx(fx), fy(fy)
+  cx(cx), cy(cy), fx(fx), fy(fy),
+  timed(true)
 {
     sumDataSE3.create(MAX_THREADS);
     outDataSE3.create(1);
@@ -138,7 +139,7 @@ void RGBDOdometry::initICP(GPUTexture * filteredDepth, const float depthCutoff)
         createNMap(vmaps_curr_[i], nmaps_curr_[i]);
     }
 
-    cudaDeviceSynchronize();
+    cudaStreamSynchronize(cudaStreamPerThread);
 }
 
 void RGBDOdometry::initICP(GPUTexture * predictedVertices, GPUTexture * predictedNormals, const float depthCutoff)
@@ -155,6 +156,29 @@ void RGBDOdometry::initICP(GPUTexture * predictedVertices, GPUTexture * predicte
     cudaMemcpyFromArray(nmaps_tmp.ptr(), textPtr, 0, 0, nmaps_tmp.sizeBytes(), cudaMemcpyDeviceToDevice);
     cudaGraphicsUnmapResources(1, &predictedNormals->cudaRes);
 
+    mapsToCurr();
+}
+
+void RGBDOdometry::initICP(const Eigen::Vector4f * predictedVertices, const Eigen::Vector4f * predictedNormals, const float depthCutoff, const int stride)
+{
+    const size_t rowBytes = width * sizeof(Eigen::Vector4f);
+
+    if(stride == 0 || stride == (int)rowBytes)
+    {
+        vmaps_tmp.upload((const float *)predictedVertices, vmaps_tmp.size());
+        nmaps_tmp.upload((const float *)predictedNormals, nmaps_tmp.size());
+    }
+    else
+    {
+        cudaMemcpy2D(vmaps_tmp.ptr(), rowBytes, predictedVertices, stride, rowBytes, height, cudaMemcpyHostToDevice);
+        cudaMemcpy2D(nmaps_tmp.ptr(), rowBytes, predictedNormals, stride, rowBytes, height, cudaMemcpyHostToDevice);
+    }
+
+    mapsToCurr();
+}
+
+void RGBDOdometry::mapsToCurr()
+{
     copyMaps(vmaps_tmp, nmaps_tmp, vmaps_curr_[0], nmaps_curr_[0]);
 
     for(int i = 1; i < NUM_PYRS; ++i)
@@ -163,7 +187,7 @@ void RGBDOdometry::initICP(GPUTexture * predictedVertices, GPUTexture * predicte
         resizeNMap(nmaps_curr_[i - 1], nmaps_curr_[i]);
     }
 
-    cudaDeviceSynchronize();
+    cudaStreamSynchronize(cudaStreamPerThread);
 }
 
 void RGBDOdometry::initICPModel(GPUTexture * predictedVertices,
@@ -183,6 +207,22 @@ void RGBDOdometry::initICPModel(GPUTexture * predictedVertices,
     cudaMemcpyFromArray(nmaps_tmp.ptr(), textPtr, 0, 0, nmaps_tmp.sizeBytes(), cudaMemcpyDeviceToDevice);
     cudaGraphicsUnmapResources(1, &predictedNormals->cudaRes);
 
+    mapsToModel(modelPose);
+}
+
+void RGBDOdometry::initICPModel(const Eigen::Vector4f * predictedVertices,
+                                const Eigen::Vector4f * predictedNormals,
+                                const float depthCutoff,
+                                const Eigen::Matrix4f & modelPose)
+{
+    vmaps_tmp.upload((const float *)predictedVertices, vmaps_tmp.size());
+    nmaps_tmp.upload((const float *)predictedNormals, nmaps_tmp.size());
+
+    mapsToModel(modelPose);
+}
+
+void RGBDOdometry::mapsToModel(const Eigen::Matrix4f & modelPose)
+{
     copyMaps(vmaps_tmp, nmaps_tmp, vmaps_g_prev_[0], nmaps_g_prev_[0]);
 
     for(int i = 1; i < NUM_PYRS; ++i)
@@ -202,7 +242,7 @@ void RGBDOdometry::initICPModel(GPUTexture * predictedVertices,
         tranformMaps(vmaps_g_prev_[i], nmaps_g_prev_[i], device_Rcam, device_tcam, vmaps_g_prev_[i], nmaps_g_prev_[i]);
     }
 
-    cudaDeviceSynchronize();
+    cudaStreamSynchronize(cudaStreamPerThread);
 }
 
 void RGBDOdometry::populateRGBDData(GPUTexture * rgb,
@@ -231,7 +271,7 @@ void RGBDOdometry::populateRGBDData(GPUTexture * rgb,
         pyrDownUcharGauss(destImages[i], destImages[i + 1]);
     }
 
-    cudaDeviceSynchronize();
+    cudaStreamSynchronize(cudaStreamPerThread);
 }
 
 void RGBDOdometry::initRGBModel(GPUTexture * rgb)
@@ -270,7 +310,8 @@ void RGBDOdometry::getIncrementalTransformation(Eigen::Vector3f & trans,
                                                 const float & icpWeight,
                                                 const bool & pyramid,
                                                 const bool & fastOdom,
-                                                const bool & so3)
+                                                const bool & so3,
+                                                const bool & coarseOnly)
 {
     bool icp = !rgbOnly && icpWeight > 0;
     bool rgb = rgbOnly || icpWeight < 100;
@@ -330,7 +371,10 @@ void RGBDOdometry::getIncrementalTransformation(Eigen::Vector3f & trans,
 
             float residual[2];
 
-            TICK("so3Step");
+            if(timed)
+            {
+                TICK("so3Step");
+            }
             so3Step(lastNextImage[pyramidLevel],
                     nextImage[pyramidLevel],
                     imageBasis,
@@ -343,7 +387,10 @@ void RGBDOdometry::getIncrementalTransformation(Eigen::Vector3f & trans,
                     &residual[0],
                     GPUConfig::getInstance().so3StepThreads,
                     GPUConfig::getInstance().so3StepBlocks);
-            TOCK("so3Step");
+            if(timed)
+            {
+                TOCK("so3Step");
+            }
 
             lastSO3Error = sqrt(residual[0]) / residual[1];
             lastSO3Count = residual[1];
@@ -381,9 +428,9 @@ void RGBDOdometry::getIncrementalTransformation(Eigen::Vector3f & trans,
         }
     }
 
-    iterations[0] = fastOdom ? 3 : 10;
-    iterations[1] = pyramid ? 5 : 0;
-    iterations[2] = pyramid ? 4 : 0;
+    iterations[0] = coarseOnly ? 0 : fastOdom ? 3 : 10;
+    iterations[1] = pyramid || coarseOnly ? 5 : 0;
+    iterations[2] = pyramid || coarseOnly ? 4 : 0;
 
     Eigen::Matrix<float, 3, 3, Eigen::RowMajor> Rprev_inv = Rprev.inverse();
     mat33 device_Rprev_inv = Rprev_inv;
@@ -438,7 +485,10 @@ void RGBDOdometry::getIncrementalTransformation(Eigen::Vector3f & trans,
 
             if(rgb)
             {
-                TICK("computeRgbResidual");
+                if(timed)
+                {
+                    TICK("computeRgbResidual");
+                }
                 computeRgbResidual(pow(minimumGradientMagnitudes[i], 2.0) / pow(sobelScale, 2.0),
                                    nextdIdx[i],
                                    nextdIdy[i],
@@ -455,7 +505,10 @@ void RGBDOdometry::getIncrementalTransformation(Eigen::Vector3f & trans,
                                    rgbSize,
                                    GPUConfig::getInstance().rgbResThreads,
                                    GPUConfig::getInstance().rgbResBlocks);
-                TOCK("computeRgbResidual");
+                if(timed)
+                {
+                    TOCK("computeRgbResidual");
+                }
             }
 
             float sigmaVal = std::sqrt((float)sigma / rgbSize == 0 ? 1 : rgbSize);
@@ -490,7 +543,10 @@ void RGBDOdometry::getIncrementalTransformation(Eigen::Vector3f & trans,
 
             if(icp)
             {
-                TICK("icpStep");
+                if(timed)
+                {
+                    TICK("icpStep");
+                }
                 icpStep(device_Rcurr,
                         device_tcurr,
                         vmap_curr,
@@ -509,7 +565,10 @@ void RGBDOdometry::getIncrementalTransformation(Eigen::Vector3f & trans,
                         &residual[0],
                         GPUConfig::getInstance().icpStepThreads,
                         GPUConfig::getInstance().icpStepBlocks);
-                TOCK("icpStep");
+                if(timed)
+                {
+                    TOCK("icpStep");
+                }
             }
 
             lastICPError = sqrt(residual[0]) / residual[1];
@@ -520,7 +579,10 @@ void RGBDOdometry::getIncrementalTransformation(Eigen::Vector3f & trans,
 
             if(rgb)
             {
-                TICK("rgbStep");
+                if(timed)
+                {
+                    TICK("rgbStep");
+                }
                 rgbStep(corresImg[i],
                         sigmaVal,
                         pointClouds[i],
@@ -535,7 +597,10 @@ void RGBDOdometry::getIncrementalTransformation(Eigen::Vector3f & trans,
                         b_rgbd.data(),
                         GPUConfig::getInstance().rgbStepThreads,
                         GPUConfig::getInstance().rgbStepBlocks);
-                TOCK("rgbStep");
+                if(timed)
+                {
+                    TOCK("rgbStep");
+                }
             }
 
             Eigen::Matrix<double, 6, 1> result;
@@ -602,7 +667,12 @@ void RGBDOdometry::getIncrementalTransformation(Eigen::Vector3f & trans,
     rot = Rcurr;
 }
 
-Eigen::MatrixXd RGBDOdometry::getCovariance()
+void RGBDOdometry::setTimed(const bool value)
+{
+    timed = value;
+}
+
+Eigen::Matrix<double, 6, 6> RGBDOdometry::getCovariance()
 {
     return lastA.cast<double>().lu().inverse();
 }
@@ -46,6 +46,12 @@ class RGBDOdometry
 
         void initICPModel(GPUTexture * predictedVertices, GPUTexture * predictedNormals, const float depthCutoff, const Eigen::Matrix4f & modelPose);
 
+        //Host memory versions of the above, these don't touch GL so can be called off the GL thread.
+        //stride is the bytes between rows, 0 for tightly packed
+        void initICP(const Eigen::Vector4f * predictedVertices, const Eigen::Vector4f * predictedNormals, const float depthCutoff, const int stride = 0);
+
+        void initICPModel(const Eigen::Vector4f * predictedVertices, const Eigen::Vector4f * predictedNormals, const float depthCutoff, const Eigen::Matrix4f & modelPose);
+
         void initRGB(GPUTexture * rgb);
 
         void initRGBModel(GPUTexture * rgb);
@@ -58,9 +64,16 @@ class RGBDOdometry
                                           const float & icpWeight,
                                           const bool & pyramid,
                                           const bool & fastOdom,
-                                          const bool & so3);
+                                          const bool & so3,
+                                          const bool & coarseOnly = false);
+
+        Eigen::Matrix<double, 6, 6> getCovariance();
 
-        Eigen::MatrixXd getCovariance();
+        /**
+         * Stops the per step timings going to the Stopwatch, for instances run off the tracking thread that would
+         * otherwise share its icpStep, rgbStep, so3Step and computeRgbResidual entries
+         */
+        void setTimed(const bool value);
 
         float lastICPError;
         float lastICPCount;
@@ -73,6 +86,10 @@ class RGBDOdometry
         Eigen::Matrix<double, 6, 1> lastb;
 
     private:
+        void mapsToCurr();
+
+        void mapsToModel(const Eigen::Matrix4f & modelPose);
+
         void populateRGBDData(GPUTexture * rgb,
                               DeviceArray2D<float> * destDepths,
                               DeviceArray2D<unsigned char> * destImages);
@@ -131,6 +148,8 @@ class RGBDOdometry
         const int width;
         const int height;
         const float cx, cy, fx, fy;
+
+        bool timed;
 };
 
 #endif /* RGBDODOMETRY_H_ */
@@ -40,6 +40,7 @@
 #include <string>
 #include <iostream>
 #include <map>
+#include <mutex>
 #ifndef WIN32
 #  include <sys/time.h>
 #  include <unistd.h>
@@ -102,7 +103,9 @@ class Stopwatch
         {
             if(duration > 0)
             {
+                std::lock_guard<std::mutex> lock(mutex);
                 timings[name] = (float)(duration) / 1000.0f;
+                record(name.c_str(), timings[name]);
             }
         }
 
@@ -111,13 +114,17 @@ class Stopwatch
           signature = newSignature;
         }
 
-        const std::map<std::string, float> & getTimings()
+        //A copy, worker threads (e.g. background graph optimisation) can be writing to the map
+        std::map<std::string, float> getTimings()
         {
+            std::lock_guard<std::mutex> lock(mutex);
             return timings;
         }
 
         void printAll()
         {
+            std::lock_guard<std::mutex> lock(mutex);
+
             for(std::map<std::string, float>::const_iterator it = timings.begin(); it != timings.end(); it++)
             {
                 std::cout << it->first << ": " << it->second  << "ms" << std::endl;
@@ -128,6 +135,7 @@ class Stopwatch
 
         void pulse(std::string name)
         {
+            std::lock_guard<std::mutex> lock(mutex);
             timings[name] = 1;
         }
 
@@ -138,7 +146,13 @@ class Stopwatch
             if((currentSend = (clock.tv_sec * 1000000 + clock.tv_usec)) - lastSend > SEND_INTERVAL_MS)
             {
                 int size = 0;
-                stopwatchPacketType * data = serialiseTimings(size);
+                stopwatchPacketType * data = 0;
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    data = serialiseTimings(size);
+                }
+
                 sendto(sockfd, data, size, 0, (struct sockaddr *) &servaddr, sizeof(servaddr));
 
                 free(data);
@@ -147,6 +161,30 @@ class Stopwatch
             }
         }
 
+        /**
+         * Keep every timing from now on as well as the latest, for distributions rather than a live view
+         */
+        void setRecording(const bool value)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            recording = value;
+        }
+
+        /**
+         * Moves the timings recorded so far into samples (appending), in milliseconds by name
+         */
+        void takeRecorded(std::map<std::string, std::vector<float> > & samples)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            for(std::map<std::string, std::vector<float> >::iterator it = recorded.begin(); it != recorded.end(); it++)
+            {
+                std::vector<float> & out = samples[it->first];
+                out.insert(out.end(), it->second.begin(), it->second.end());
+                it->second.clear();
+            }
+        }
+
         static unsigned long long int getCurrentSystemTime()
         {
             timeval tv;
@@ -157,21 +195,50 @@ class Stopwatch
 
         void tick(std::string name, unsigned long long int start)
         {
+            std::lock_guard<std::mutex> lock(mutex);
         	tickTimings[name] = start;
         }
 
         void tock(std::string name, unsigned long long int end)
         {
+            std::lock_guard<std::mutex> lock(mutex);
         	float duration = (float)(end - tickTimings[name]) / 1000.0f;
 
             if(duration > 0)
             {
                 timings[name] = duration;
+                record(name.c_str(), duration);
+            }
+        }
+
+        //String literal versions, these don't build a std::string (and allocate) every call
+        void tick(const char * name, unsigned long long int start)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            *literal(name).first = start;
+        }
+
+        void tock(const char * name, unsigned long long int end)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::pair<unsigned long long int *, float *> & entry = literal(name);
+            float duration = (float)(end - *entry.first) / 1000.0f;
+
+            if(duration > 0)
+            {
+                if(!entry.second)
+                {
+                    entry.second = &timings[name];
+                }
+
+                *entry.second = duration;
+                record(name, duration);
             }
         }
 
     private:
         Stopwatch()
+         : recording(false)
         {
             memset(&servaddr, 0, sizeof(servaddr));
             servaddr.sin_family = AF_INET;
@@ -195,6 +262,29 @@ class Stopwatch
 #endif
         }
 
+        //Called with the lock held, this allocates so it's only for benchmarking
+        void record(const char * name, const float duration)
+        {
+            if(recording)
+            {
+                recorded[name].push_back(duration);
+            }
+        }
+
+        std::pair<unsigned long long int *, float *> & literal(const char * name)
+        {
+            std::map<const char *, std::pair<unsigned long long int *, float *> >::iterator it = literalTimings.find(name);
+
+            if(it == literalTimings.end())
+            {
+                std::map<std::string, float>::iterator timing = timings.find(name);
+
+                it = literalTimings.insert(std::make_pair(name, std::make_pair(&tickTimings[name], timing == timings.end() ? (float *)0 : &timing->second))).first;
+            }
+
+            return it->second;
+        }
+
         stopwatchPacketType * serialiseTimings(int & packetSize)
         {
             packetSize = sizeof(int) + sizeof(unsigned long long int);
@@ -228,6 +318,15 @@ class Stopwatch
         struct sockaddr_in servaddr;
         std::map<std::string, float> timings;
         std::map<std::string, unsigned long long int> tickTimings;
+
+        //Map nodes don't move, so literal names can point straight at their entries
+        std::map<const char *, std::pair<unsigned long long int *, float *> > literalTimings;
+
+        bool recording;
+        std::map<std::string, std::vector<float> > recorded;
+
+        //Worker threads (e.g. background graph optimisation) time themselves too
+        std::mutex mutex;
 };
 
 #endif /* STOPWATCH_H_ */
@@ -0,0 +1,435 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "SyntheticScene.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+#include <limits>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+//splitmix64, all the randomness (texture and noise) is hashed from coordinates so it doesn't depend on order
+static uint64_t mix(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static float uniform(const uint64_t hash)
+{
+    return (hash >> 40) * (1.0f / 16777216.0f);
+}
+
+//Sum of four uniforms from one hash, near enough normal for sensor noise and much cheaper than Box-Muller
+static float gaussian(const uint64_t hash)
+{
+    const float sum = (hash & 0xFFFF) + ((hash >> 16) & 0xFFFF) + ((hash >> 32) & 0xFFFF) + (hash >> 48);
+
+    return (sum * (1.0f / 65536.0f) - 2.0f) * 1.7320508f;
+}
+
+static const float CELL_SIZE = 0.2f;
+
+SyntheticScene::SyntheticScene(const Config & config)
+ : config(config),
+   pathHalfX(0),
+   pathHalfZ(0),
+   pathRadius(0),
+   speed(0),
+   eyeHeight(1.4f)
+{
+    //y is down, like the camera's, with the floor at 0
+    if(config.layout == ROOM)
+    {
+        addBox(Eigen::Vector3f(-3, -3, -3), Eigen::Vector3f(3, 0, 3), true);
+
+        addBox(Eigen::Vector3f(-0.5f, -0.75f, -0.4f), Eigen::Vector3f(0.5f, 0, 0.4f));
+        addBox(Eigen::Vector3f(-0.2f, -1.0f, -0.1f), Eigen::Vector3f(0.1f, -0.75f, 0.2f));
+        addBox(Eigen::Vector3f(-3, -2, -1), Eigen::Vector3f(-2.6f, 0, 1));
+        addBox(Eigen::Vector3f(1.8f, -1, 1.8f), Eigen::Vector3f(2.6f, 0, 2.6f));
+        addBox(Eigen::Vector3f(1.5f, -0.5f, -2.4f), Eigen::Vector3f(2.1f, 0, -1.8f));
+        addBox(Eigen::Vector3f(-0.15f, -3, 2.3f), Eigen::Vector3f(0.15f, 0, 2.6f));
+        addBox(Eigen::Vector3f(-2.2f, -2.2f, -3), Eigen::Vector3f(-1.2f, -1.4f, -2.8f));
+    }
+    else if(config.layout == CORRIDOR)
+    {
+        addBox(Eigen::Vector3f(-1.2f, -2.5f, -20), Eigen::Vector3f(1.2f, 0, 20), true);
+
+        for(int i = 0; i < 16; i++)
+        {
+            const float z = -19 + i * 2.5f;
+
+            //Pillars alternating between the walls, beams across the ceiling
+            addBox(Eigen::Vector3f(i % 2 ? 0.95f : -1.2f, -2.5f, z), Eigen::Vector3f(i % 2 ? 1.2f : -0.95f, 0, z + 0.3f));
+            addBox(Eigen::Vector3f(-1.2f, -2.5f, z + 1.2f), Eigen::Vector3f(1.2f, -2.3f, z + 1.4f));
+        }
+
+        pathHalfX = 0.6f;
+        pathHalfZ = 17;
+        pathRadius = 0.6f;
+        speed = 0.5f;
+    }
+    else
+    {
+        addBox(Eigen::Vector3f(-10, -2.5f, -10), Eigen::Vector3f(10, 0, 10), true);
+        addBox(Eigen::Vector3f(-8, -2.5f, -8), Eigen::Vector3f(8, 0, 8));
+
+        for(int side = 0; side < 4; side++)
+        {
+            for(int i = 0; i < 6; i++)
+            {
+                //Along the outer wall of each side, rotated a quarter turn at a time
+                const float along = -7 + i * 2.7f + side * 0.4f;
+                const float depth = i % 3 == 0 ? 0.5f : 0.25f;
+                const float height = i % 2 ? -2.5f : -1.2f;
+
+                Eigen::Vector3f min, max;
+
+                switch(side)
+                {
+                    case 0: min = Eigen::Vector3f(10 - depth, height, along); max = Eigen::Vector3f(10, 0, along + 0.4f); break;
+                    case 1: min = Eigen::Vector3f(along, height, 10 - depth); max = Eigen::Vector3f(along + 0.4f, 0, 10); break;
+                    case 2: min = Eigen::Vector3f(-10, height, along); max = Eigen::Vector3f(-10 + depth, 0, along + 0.4f); break;
+                    default: min = Eigen::Vector3f(along, height, -10); max = Eigen::Vector3f(along + 0.4f, 0, -10 + depth); break;
+                }
+
+                addBox(min, max);
+            }
+        }
+
+        pathHalfX = 9;
+        pathHalfZ = 9;
+        pathRadius = 1;
+        speed = 0.6f;
+    }
+
+    firstPose = worldPose(0);
+}
+
+void SyntheticScene::addBox(const Eigen::Vector3f & min, const Eigen::Vector3f & max, const bool inside)
+{
+    Box box;
+    box.min = min;
+    box.max = max;
+    box.inside = inside;
+
+    const uint64_t hash = mix(boxes.size() + 1);
+
+    box.colour = Eigen::Vector3f(0.5f + 0.5f * uniform(hash), 0.5f + 0.5f * uniform(mix(hash + 1)), 0.5f + 0.5f * uniform(mix(hash + 2)));
+
+    boxes.push_back(box);
+}
+
+const SyntheticScene::Config & SyntheticScene::getConfig() const
+{
+    return config;
+}
+
+void SyntheticScene::pathPoint(const float s, Eigen::Vector2f & position, Eigen::Vector2f & heading) const
+{
+    //Anticlockwise round a rounded rectangle in x-z, straights and quarter circles in turn
+    const float straightZ = 2 * (pathHalfZ - pathRadius);
+    const float straightX = 2 * (pathHalfX - pathRadius);
+    const float arc = 0.5f * (float)M_PI * pathRadius;
+
+    const float lengths[8] = {straightZ, arc, straightX, arc, straightZ, arc, straightX, arc};
+
+    const Eigen::Vector2f corners[4] = {Eigen::Vector2f(pathHalfX - pathRadius, pathHalfZ - pathRadius),
+                                        Eigen::Vector2f(-(pathHalfX - pathRadius), pathHalfZ - pathRadius),
+                                        Eigen::Vector2f(-(pathHalfX - pathRadius), -(pathHalfZ - pathRadius)),
+                                        Eigen::Vector2f(pathHalfX - pathRadius, -(pathHalfZ - pathRadius))};
+
+    float perimeter = 0;
+
+    for(int i = 0; i < 8; i++)
+    {
+        perimeter += lengths[i];
+    }
+
+    float along = std::fmod(s, perimeter);
+
+    int segment = 0;
+
+    while(segment < 7 && along > lengths[segment])
+    {
+        along -= lengths[segment++];
+    }
+
+    const int quarter = segment / 2;
+    const float angle = quarter * 0.5f * (float)M_PI;
+    const Eigen::Vector2f radial(std::cos(angle), std::sin(angle));
+    const Eigen::Vector2f tangent(-radial(1), radial(0));
+
+    if(segment % 2 == 0)
+    {
+        //Straight, starting where the last corner's arc left off
+        const Eigen::Vector2f & from = corners[(quarter + 3) % 4];
+
+        position = from + radial * pathRadius + tangent * along;
+        heading = tangent;
+    }
+    else
+    {
+        const float theta = angle + along / pathRadius;
+
+        position = corners[quarter] + Eigen::Vector2f(std::cos(theta), std::sin(theta)) * pathRadius;
+        heading = Eigen::Vector2f(-std::sin(theta), std::cos(theta));
+    }
+}
+
+Eigen::Isometry3f SyntheticScene::worldPose(const int frame) const
+{
+    const float t = frame / config.fps;
+
+    Eigen::Vector3f position, forward;
+
+    if(config.layout == ROOM)
+    {
+        //Round the table, one lap every 20 seconds, looking at it
+        const float theta = 2 * (float)M_PI * t / 20.0f;
+
+        position = Eigen::Vector3f(1.6f * std::cos(theta), -eyeHeight - 0.15f * std::sin(2.3f * theta), 1.1f * std::sin(theta));
+
+        const Eigen::Vector3f target(0.3f * std::sin(0.7f * theta), -0.8f, 0.3f * std::cos(0.5f * theta));
+
+        forward = target - position;
+    }
+    else
+    {
+        const float s = speed * t;
+
+        Eigen::Vector2f point, heading;
+        pathPoint(s, point, heading);
+
+        //Weave about the path and look around a little, the periods don't divide a lap so no two are the same
+        const float weave = (config.layout == LOOP ? 0.3f : 0.1f) * std::sin(2 * (float)M_PI * s / 13.7f);
+        const float yaw = std::atan2(heading(0), heading(1)) + 0.15f * std::sin(2 * (float)M_PI * s / 9.1f);
+
+        position = Eigen::Vector3f(point(0) + weave * heading(1), -eyeHeight - 0.05f * std::sin(2 * (float)M_PI * s / 5.3f), point(1) - weave * heading(0));
+
+        forward = Eigen::Vector3f(std::sin(yaw), 0.12f, std::cos(yaw));
+    }
+
+    const Eigen::Vector3f z = forward.normalized();
+    const Eigen::Vector3f x = Eigen::Vector3f(0, 1, 0).cross(z).normalized();
+    const Eigen::Vector3f y = z.cross(x);
+
+    Eigen::Isometry3f pose = Eigen::Isometry3f::Identity();
+    pose.linear().col(0) = x;
+    pose.linear().col(1) = y;
+    pose.linear().col(2) = z;
+    pose.translation() = position;
+
+    return pose;
+}
+
+Eigen::Matrix4f SyntheticScene::getPose(const int frame) const
+{
+    return (firstPose.inverse() * worldPose(frame)).matrix();
+}
+
+int64_t SyntheticScene::getTimestamp(const int frame) const
+{
+    return (int64_t)std::llround(frame * 1000000.0 / config.fps);
+}
+
+bool SyntheticScene::cast(const Eigen::Vector3f & origin, const Eigen::Vector3f & direction, float & depth, Eigen::Vector3f & colour) const
+{
+    float nearest = std::numeric_limits<float>::max();
+    int hitBox = -1;
+    int hitAxis = 0;
+
+    const Eigen::Vector3f inverse = direction.cwiseInverse();
+
+    for(size_t i = 0; i < boxes.size(); i++)
+    {
+        const Box & box = boxes[i];
+
+        float tNear = -std::numeric_limits<float>::max();
+        float tFar = std::numeric_limits<float>::max();
+        int nearAxis = 0;
+        int farAxis = 0;
+        bool miss = false;
+
+        for(int a = 0; a < 3 && !miss; a++)
+        {
+            if(std::fabs(direction(a)) < 1e-9f)
+            {
+                miss = origin(a) < box.min(a) || origin(a) > box.max(a);
+                continue;
+            }
+
+            float t1 = (box.min(a) - origin(a)) * inverse(a);
+            float t2 = (box.max(a) - origin(a)) * inverse(a);
+
+            if(t1 > t2)
+            {
+                std::swap(t1, t2);
+            }
+
+            if(t1 > tNear)
+            {
+                tNear = t1;
+                nearAxis = a;
+            }
+
+            if(t2 < tFar)
+            {
+                tFar = t2;
+                farAxis = a;
+            }
+
+            //Already behind something closer
+            miss = miss || tNear > nearest;
+        }
+
+        if(miss || tNear > tFar)
+        {
+            continue;
+        }
+
+        //From inside we see the far side, from outside the near one
+        const float t = box.inside ? tFar : tNear;
+
+        if(t > 1e-4f && t < nearest)
+        {
+            nearest = t;
+            hitBox = i;
+            hitAxis = box.inside ? farAxis : nearAxis;
+        }
+    }
+
+    if(hitBox == -1)
+    {
+        return false;
+    }
+
+    depth = nearest;
+
+    const Eigen::Vector3f point = origin + direction * nearest;
+
+    Eigen::Vector3f normal = Eigen::Vector3f::Zero();
+    normal(hitAxis) = direction(hitAxis) > 0 ? -1 : 1;
+
+    //Random brightness cells on the face, at two scales
+    const int u = (hitAxis + 1) % 3;
+    const int v = (hitAxis + 2) % 3;
+    const uint64_t face = mix(hitBox * 6 + hitAxis * 2 + (direction(hitAxis) > 0));
+
+    const int64_t coarseU = (int64_t)std::floor(point(u) / CELL_SIZE);
+    const int64_t coarseV = (int64_t)std::floor(point(v) / CELL_SIZE);
+    const int64_t fineU = (int64_t)std::floor(point(u) / (CELL_SIZE * 0.25f));
+    const int64_t fineV = (int64_t)std::floor(point(v) / (CELL_SIZE * 0.25f));
+
+    const float coarse = uniform(mix(mix(face ^ (uint64_t)coarseU) ^ (uint64_t)coarseV));
+    const float fine = uniform(mix(mix(~face ^ (uint64_t)fineU) ^ (uint64_t)fineV));
+
+    static const Eigen::Vector3f light = Eigen::Vector3f(-0.3f, -1.0f, -0.4f).normalized();
+
+    const float shade = 0.5f + 0.5f * std::max(normal.dot(light), 0.0f);
+
+    colour = boxes[hitBox].colour * (0.25f + 0.55f * coarse + 0.2f * fine) * shade;
+
+    return true;
+}
+
+void SyntheticScene::render(const int frame, unsigned short * depth, unsigned char * rgb) const
+{
+    const Eigen::Isometry3f pose = worldPose(frame);
+    const Eigen::Matrix3f rotation = pose.linear();
+    const Eigen::Vector3f origin = pose.translation();
+
+    const uint64_t frameHash = mix(config.seed ^ mix(frame));
+
+    ThreadPool::getInstance().parallelFor(0, config.height, 8, [&](const int start, const int end)
+    {
+        for(int row = start; row < end; row++)
+        {
+            for(int col = 0; col < config.width; col++)
+            {
+                const int i = row * config.width + col;
+
+                //z of 1 in the camera, so the distance along it is depth
+                const Eigen::Vector3f direction = rotation * Eigen::Vector3f((col + 0.5f - config.cx) / config.fx, (row + 0.5f - config.cy) / config.fy, 1);
+
+                const uint64_t pixelHash = mix(frameHash ^ (uint64_t)i);
+
+                float z = 0;
+                Eigen::Vector3f colour = Eigen::Vector3f::Zero();
+
+                if(cast(origin, direction, z, colour))
+                {
+                    z += gaussian(pixelHash) * config.depthNoise * z * z;
+                }
+
+                depth[i] = z > 0 && z < config.maxDepth ? (unsigned short)std::lround(z * 1000.0f) : 0;
+
+                for(int c = 0; c < 3; c++)
+                {
+                    const float value = colour(c) * 255.0f + gaussian(mix(pixelHash + c + 1)) * config.colourNoise;
+
+                    rgb[i * 3 + c] = (unsigned char)std::min(std::max(value + 0.5f, 0.0f), 255.0f);
+                }
+            }
+        }
+    });
+}
+
+bool SyntheticScene::saveTrajectory(const std::string & filename) const
+{
+    std::ofstream file(filename.c_str());
+
+    for(int i = 0; i < config.numFrames && file; i++)
+    {
+        const Eigen::Matrix4f pose = getPose(i);
+        const Eigen::Vector3f trans = pose.topRightCorner(3, 1);
+        const Eigen::Quaternionf rot(Eigen::Matrix3f(pose.topLeftCorner(3, 3)));
+
+        file << std::setprecision(6) << std::fixed << getTimestamp(i) / 1000000.0 << " ";
+        file << trans(0) << " " << trans(1) << " " << trans(2) << " ";
+        file << rot.x() << " " << rot.y() << " " << rot.z() << " " << rot.w() << "\n";
+    }
+
+    return (bool)file;
+}
+
+bool SyntheticScene::parseLayout(const std::string & name, Layout & layout)
+{
+    if(name == "room")
+    {
+        layout = ROOM;
+    }
+    else if(name == "corridor")
+    {
+        layout = CORRIDOR;
+    }
+    else if(name == "loop")
+    {
+        layout = LOOP;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
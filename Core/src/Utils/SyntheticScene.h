@@ -0,0 +1,147 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef UTILS_SYNTHETICSCENE_H_
+#define UTILS_SYNTHETICSCENE_H_
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "../Defines.h"
+
+/**
+ * Ray casts RGB-D frames of a few parametric scenes made of boxes along a scripted camera path, on the CPU.
+ * Everything is a function of the frame number and the seed, so any frame can be rendered at any time and
+ * always comes out the same, noise included.
+ *
+ * Surfaces are textured with a non-repeating grid of random brightness cells and lit from a fixed direction,
+ * so they look the same from everywhere, as photometric tracking assumes. Depth noise grows with the square of
+ * depth like a structured light sensor's.
+ */
+class SyntheticScene
+{
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        enum Layout
+        {
+            ROOM = 0,   //Orbiting inside a furnished room, looking at its centre
+            CORRIDOR,   //Down a long corridor with pillars and beams, turning round at each end
+            LOOP        //Round a square loop of corridors, a little off the last lap each time
+        };
+
+        struct Config
+        {
+            Config()
+             : layout(ROOM),
+               width(640),
+               height(480),
+               fx(528), fy(528), cx(320), cy(240),
+               numFrames(1800),
+               fps(30),
+               depthNoise(0.0012f),
+               colourNoise(2.0f),
+               maxDepth(8.0f),
+               seed(1)
+            {}
+
+            Layout layout;
+            int width, height;
+            float fx, fy, cx, cy;
+            int numFrames;
+            float fps;
+
+            //Standard deviation of depth per squared metre of depth, in metres
+            float depthNoise;
+
+            //Standard deviation of each colour channel, in levels
+            float colourNoise;
+
+            //Anything further is returned as 0
+            float maxDepth;
+
+            uint64_t seed;
+        };
+
+        EFUSION_API SyntheticScene(const Config & config);
+
+        EFUSION_API const Config & getConfig() const;
+
+        /**
+         * Camera to world, relative to the first frame (which is the identity) like ElasticFusion's poses
+         */
+        EFUSION_API Eigen::Matrix4f getPose(const int frame) const;
+
+        /**
+         * Microseconds, like .klg timestamps
+         */
+        EFUSION_API int64_t getTimestamp(const int frame) const;
+
+        /**
+         * @param depth millimetres, width * height of them
+         * @param rgb 8-bit RGB
+         */
+        EFUSION_API void render(const int frame, unsigned short * depth, unsigned char * rgb) const;
+
+        /**
+         * Writes every frame's pose in the same format ElasticFusion saves trajectories in
+         */
+        EFUSION_API bool saveTrajectory(const std::string & filename) const;
+
+        /**
+         * "room", "corridor" or "loop"
+         */
+        EFUSION_API static bool parseLayout(const std::string & name, Layout & layout);
+
+    private:
+        struct Box
+        {
+            Eigen::Vector3f min;
+            Eigen::Vector3f max;
+
+            //Seen from inside (walls of a room) rather than outside
+            bool inside;
+
+            Eigen::Vector3f colour;
+        };
+
+        void addBox(const Eigen::Vector3f & min, const Eigen::Vector3f & max, const bool inside = false);
+
+        Eigen::Isometry3f worldPose(const int frame) const;
+
+        //Position and direction of travel along the path, arc length s in metres
+        void pathPoint(const float s, Eigen::Vector2f & position, Eigen::Vector2f & heading) const;
+
+        bool cast(const Eigen::Vector3f & origin, const Eigen::Vector3f & direction, float & depth, Eigen::Vector3f & colour) const;
+
+        Config config;
+
+        std::vector<Box> boxes;
+
+        //Rounded rectangle the camera follows in the corridors, half extents and corner radius
+        float pathHalfX, pathHalfZ, pathRadius;
+        float speed;
+        float eyeHeight;
+
+        Eigen::Isometry3f firstPose;
+};
+
+#endif /* UTILS_SYNTHETICSCENE_H_ */
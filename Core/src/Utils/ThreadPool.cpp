@@ -0,0 +1,257 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "ThreadPool.h"
+
+#ifndef WIN32
+#  include <pthread.h>
+#endif
+
+//Queue of the pool thread we're on, -1 for everyone else
+static thread_local int currentQueue = -1;
+
+ThreadPool & ThreadPool::getInstance()
+{
+    static ThreadPool instance;
+    return instance;
+}
+
+ThreadPool::ThreadPool()
+ : nextQueue(0),
+   queued(0),
+   stopping(false)
+{
+    int hardware = std::thread::hardware_concurrency();
+
+    setWorkers(std::max(hardware - 1, 0));
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+void ThreadPool::setWorkers(const int numWorkers, const bool pinCores)
+{
+    stop();
+
+    stopping = false;
+
+    for(int i = 0; i < numWorkers; i++)
+    {
+        queues.push_back(new Queue);
+    }
+
+    int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+
+    for(int i = 0; i < numWorkers; i++)
+    {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this, i, pinCores ? (i + 1) % cores : -1));
+    }
+}
+
+int ThreadPool::getWorkers()
+{
+    return workers.size();
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+
+    wake.notify_all();
+
+    for(size_t i = 0; i < workers.size(); i++)
+    {
+        workers.at(i).join();
+    }
+
+    workers.clear();
+
+    for(size_t i = 0; i < queues.size(); i++)
+    {
+        delete queues.at(i);
+    }
+
+    queues.clear();
+}
+
+bool ThreadPool::split(const int begin, const int end, const int grain, int & chunkSize, int & numChunks)
+{
+    const int n = end - begin;
+
+    if(n <= 0)
+    {
+        return false;
+    }
+
+    chunkSize = std::max(std::max(grain, 1), (n + MAX_CHUNKS - 1) / MAX_CHUNKS);
+    numChunks = (n + chunkSize - 1) / chunkSize;
+
+    return true;
+}
+
+void ThreadPool::run(Job & job, const int begin, const int end, const int chunkSize, const int numChunks)
+{
+    job.remaining = numChunks;
+
+    for(int c = 0; c < numChunks; c++)
+    {
+        Task task;
+        task.job = &job;
+        task.chunk = c;
+        task.start = begin + c * chunkSize;
+        task.end = std::min(end, begin + (c + 1) * chunkSize);
+
+        if(!push(task))
+        {
+            execute(task);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+
+    wake.notify_all();
+
+    //Help out rather than block, this is what makes nested loops safe
+    while(job.remaining > 0)
+    {
+        if(!runOne())
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool ThreadPool::push(const Task & task)
+{
+    int first = currentQueue != -1 ? currentQueue : nextQueue++ % (int)queues.size();
+
+    for(size_t i = 0; i < queues.size(); i++)
+    {
+        Queue & queue = *queues.at((first + i) % queues.size());
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if(queue.count < Queue::SIZE)
+        {
+            queue.tasks[(queue.head + queue.count) % Queue::SIZE] = task;
+            queue.count++;
+            queued++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ThreadPool::pop(const int queue, const bool back, Task & task)
+{
+    Queue & q = *queues.at(queue);
+
+    std::lock_guard<std::mutex> lock(q.mutex);
+
+    if(q.count == 0)
+    {
+        return false;
+    }
+
+    if(back)
+    {
+        task = q.tasks[(q.head + q.count - 1) % Queue::SIZE];
+    }
+    else
+    {
+        task = q.tasks[q.head];
+        q.head = (q.head + 1) % Queue::SIZE;
+    }
+
+    q.count--;
+    queued--;
+
+    return true;
+}
+
+bool ThreadPool::runOne()
+{
+    Task task;
+
+    //Newest work from our own queue first, then steal the oldest from everyone else
+    if(currentQueue != -1 && pop(currentQueue, true, task))
+    {
+        execute(task);
+        return true;
+    }
+
+    const int numQueues = queues.size();
+    const int first = currentQueue != -1 ? currentQueue + 1 : 0;
+
+    for(int i = 0; i < numQueues; i++)
+    {
+        if(pop((first + i) % numQueues, false, task))
+        {
+            execute(task);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::execute(Task & task)
+{
+    task.job->call(task.job->f, task.chunk, task.start, task.end);
+    task.job->remaining--;
+}
+
+void ThreadPool::workerLoop(const int id, const int core)
+{
+    currentQueue = id;
+
+#ifndef WIN32
+    if(core != -1)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(core, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+    }
+#endif
+
+    while(true)
+    {
+        if(runOne())
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+
+        wake.wait(lock, [this]{ return stopping || queued > 0; });
+
+        if(stopping)
+        {
+            return;
+        }
+    }
+}
@@ -0,0 +1,208 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef UTILS_THREADPOOL_H_
+#define UTILS_THREADPOOL_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+#include "../Defines.h"
+
+/**
+ * Work stealing pool for the CPU side loops. Every thread has its own task queue, idle threads steal from the
+ * others and the thread that submits a loop helps run it, so nested and concurrent loops (e.g. from the fern
+ * lookup or background graph solve threads) are fine.
+ */
+class ThreadPool
+{
+    public:
+        EFUSION_API static ThreadPool & getInstance();
+
+        /**
+         * Restarts the pool, don't call this while a loop is running
+         * @param numWorkers threads on top of the caller, 0 runs everything inline. Default is one less than the hardware threads
+         * @param pinCores pin worker i to core i + 1, leaving core 0 for the tracking thread
+         */
+        EFUSION_API void setWorkers(const int numWorkers, const bool pinCores = false);
+
+        EFUSION_API int getWorkers();
+
+        /**
+         * Calls f(start, end) on chunks of [begin, end) no smaller than grain, returns when all chunks have run
+         */
+        template<typename F>
+        void parallelFor(const int begin, const int end, const int grain, const F & f)
+        {
+            int chunkSize = 0;
+            int numChunks = 0;
+
+            if(!split(begin, end, grain, chunkSize, numChunks))
+            {
+                return;
+            }
+
+            if(numChunks == 1 || workers.empty())
+            {
+                f(begin, end);
+                return;
+            }
+
+            Job job;
+            job.call = &ThreadPool::callFor<F>;
+            job.f = &f;
+
+            run(job, begin, end, chunkSize, numChunks);
+        }
+
+        /**
+         * Folds f(start, end) over chunks of [begin, end) with combine. Chunks only depend on the range and grain
+         * and are combined in order, so the result doesn't change with the number of workers
+         */
+        template<typename T, typename F, typename C>
+        T parallelReduce(const int begin, const int end, const int grain, const T & identity, const F & f, const C & combine)
+        {
+            int chunkSize = 0;
+            int numChunks = 0;
+
+            if(!split(begin, end, grain, chunkSize, numChunks))
+            {
+                return identity;
+            }
+
+            T partials[MAX_CHUNKS];
+
+            if(numChunks == 1 || workers.empty())
+            {
+                for(int c = 0; c < numChunks; c++)
+                {
+                    partials[c] = f(begin + c * chunkSize, std::min(end, begin + (c + 1) * chunkSize));
+                }
+            }
+            else
+            {
+                Reduce<T, F> reduce = {&f, partials};
+
+                Job job;
+                job.call = &ThreadPool::callReduce<T, F>;
+                job.f = &reduce;
+
+                run(job, begin, end, chunkSize, numChunks);
+            }
+
+            T result = identity;
+
+            for(int c = 0; c < numChunks; c++)
+            {
+                result = combine(result, partials[c]);
+            }
+
+            return result;
+        }
+
+        static const int MAX_CHUNKS = 256;
+
+    private:
+        ThreadPool();
+        virtual ~ThreadPool();
+
+        class Job
+        {
+            public:
+                void (*call)(const void * f, const int chunk, const int start, const int end);
+                const void * f;
+                std::atomic<int> remaining;
+        };
+
+        class Task
+        {
+            public:
+                Job * job;
+                int chunk;
+                int start;
+                int end;
+        };
+
+        //Fixed size so queueing never allocates, full queues just run the task inline
+        class Queue
+        {
+            public:
+                Queue()
+                 : head(0),
+                   count(0)
+                {}
+
+                static const int SIZE = MAX_CHUNKS * 4;
+
+                std::mutex mutex;
+                Task tasks[SIZE];
+                int head;
+                int count;
+        };
+
+        template<typename T, typename F>
+        struct Reduce
+        {
+            const F * f;
+            T * partials;
+        };
+
+        template<typename F>
+        static void callFor(const void * f, const int chunk, const int start, const int end)
+        {
+            (*(const F *)f)(start, end);
+        }
+
+        template<typename T, typename F>
+        static void callReduce(const void * f, const int chunk, const int start, const int end)
+        {
+            const Reduce<T, F> * reduce = (const Reduce<T, F> *)f;
+            reduce->partials[chunk] = (*reduce->f)(start, end);
+        }
+
+        static bool split(const int begin, const int end, const int grain, int & chunkSize, int & numChunks);
+
+        void run(Job & job, const int begin, const int end, const int chunkSize, const int numChunks);
+
+        bool push(const Task & task);
+
+        bool pop(const int queue, const bool back, Task & task);
+
+        bool runOne();
+
+        void execute(Task & task);
+
+        void workerLoop(const int id, const int core);
+
+        void stop();
+
+        std::vector<std::thread> workers;
+        std::vector<Queue *> queues;
+        std::atomic<int> nextQueue;
+        std::atomic<int> queued;
+
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+        bool stopping;
+};
+
+#endif /* UTILS_THREADPOOL_H_ */
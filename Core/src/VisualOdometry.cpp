@@ -0,0 +1,318 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "VisualOdometry.h"
+
+VisualOdometry::VisualOdometry(const float depthCut,
+                               const float icpThresh,
+                               const bool fastOdom,
+                               const bool so3)
+ : odometry(Resolution::getInstance().width(),
+            Resolution::getInstance().height(),
+            Intrinsics::getInstance().cx(),
+            Intrinsics::getInstance().cy(),
+            Intrinsics::getInstance().fx(),
+            Intrinsics::getInstance().fy()),
+   currPose(Eigen::Matrix4f::Identity()),
+   keyframePose(Eigen::Matrix4f::Identity()),
+   tick(0),
+   lastLatency(0),
+   fullLatency(0),
+   latencyBudget(0),
+   overruns(0),
+   degradedFrames(0),
+   degraded(false),
+   keyframeDistance(0),
+   keyframeAngle(0),
+   keyframeInliers(0),
+   maxDepthProcessed(20.0f),
+   rgbOnly(false),
+   icpWeight(icpThresh),
+   pyramid(true),
+   fastOdom(fastOdom),
+   so3(so3),
+   depthCutoff(depthCut)
+{
+    textures[GPUTexture::RGB] = new GPUTexture(Resolution::getInstance().width(),
+                                               Resolution::getInstance().height(),
+                                               GL_RGBA,
+                                               GL_RGB,
+                                               GL_UNSIGNED_BYTE,
+                                               true,
+                                               true);
+
+    textures[GPUTexture::DEPTH_RAW] = new GPUTexture(Resolution::getInstance().width(),
+                                                     Resolution::getInstance().height(),
+                                                     GL_LUMINANCE16UI_EXT,
+                                                     GL_LUMINANCE_INTEGER_EXT,
+                                                     GL_UNSIGNED_SHORT);
+
+    textures[GPUTexture::DEPTH_FILTERED] = new GPUTexture(Resolution::getInstance().width(),
+                                                          Resolution::getInstance().height(),
+                                                          GL_LUMINANCE16UI_EXT,
+                                                          GL_LUMINANCE_INTEGER_EXT,
+                                                          GL_UNSIGNED_SHORT,
+                                                          false,
+                                                          true);
+
+    filter = new ComputePack(loadProgramFromFile("empty.vert", "depth_bilateral.frag", "quad.geom"),
+                             textures[GPUTexture::DEPTH_FILTERED]->texture);
+
+    filterUniforms.push_back(Uniform("cols", (float)Resolution::getInstance().cols()));
+    filterUniforms.push_back(Uniform("rows", (float)Resolution::getInstance().rows()));
+    filterUniforms.push_back(Uniform("maxD", depthCutoff));
+}
+
+VisualOdometry::~VisualOdometry()
+{
+    delete filter;
+
+    for(std::map<std::string, GPUTexture*>::iterator it = textures.begin(); it != textures.end(); ++it)
+    {
+        delete it->second;
+    }
+
+    textures.clear();
+}
+
+void VisualOdometry::processFrame(const unsigned char * rgb,
+                                  const unsigned short * depth,
+                                  const int64_t & timestamp)
+{
+    const unsigned long long int start = Stopwatch::getCurrentSystemTime();
+
+    TICK("Odometry");
+
+    textures[GPUTexture::DEPTH_RAW]->texture->Upload(depth, GL_LUMINANCE_INTEGER_EXT, GL_UNSIGNED_SHORT);
+    textures[GPUTexture::RGB]->texture->Upload(rgb, GL_RGB, GL_UNSIGNED_BYTE);
+
+    TICK("Preprocess");
+    filterDepth();
+    TOCK("Preprocess");
+
+    //Fast odometry (the same pyramid, fewer iterations on the finest level) stands in while full tracking is too
+    //slow for the budget, every so often we try full tracking again in case things have calmed down
+    const bool probe = degraded && ++degradedFrames >= PROBE_INTERVAL;
+    const bool fast = fastOdom || (degraded && !probe);
+
+    if(tick == 0)
+    {
+        odometry.initFirstRGB(textures[GPUTexture::RGB]);
+        setKeyframe();
+    }
+    else
+    {
+        TICK("odomInit");
+        //WARNING initICP* must be called before initRGB*
+        odometry.initICPModel(&keyframe.vertexTexture, &keyframe.normalTexture, maxDepthProcessed, keyframePose);
+        odometry.initRGBModel(&keyframe.imageTexture);
+
+        odometry.initICP(textures[GPUTexture::DEPTH_FILTERED], maxDepthProcessed);
+        odometry.initRGB(textures[GPUTexture::RGB]);
+        TOCK("odomInit");
+
+        Eigen::Vector3f trans = currPose.topRightCorner(3, 1);
+        Eigen::Matrix<float, 3, 3, Eigen::RowMajor> rot = currPose.topLeftCorner(3, 3);
+
+        TICK("odom");
+        odometry.getIncrementalTransformation(trans,
+                                              rot,
+                                              rgbOnly,
+                                              icpWeight,
+                                              pyramid,
+                                              fast,
+                                              so3);
+        TOCK("odom");
+
+        currPose.topRightCorner(3, 1) = trans;
+        currPose.topLeftCorner(3, 3) = rot;
+
+        if(needsKeyframe())
+        {
+            setKeyframe();
+        }
+    }
+
+    poses.push_back(std::pair<unsigned long long int, Eigen::Matrix4f>(timestamp, currPose));
+
+    tick++;
+
+    TOCK("Odometry");
+
+    lastLatency = (Stopwatch::getCurrentSystemTime() - start) / 1000.0f;
+
+    if(latencyBudget > 0 && lastLatency > latencyBudget)
+    {
+        overruns++;
+    }
+
+    if(!fast)
+    {
+        fullLatency = lastLatency;
+        degraded = latencyBudget > 0 && fullLatency > latencyBudget;
+        degradedFrames = 0;
+    }
+}
+
+bool VisualOdometry::needsKeyframe()
+{
+    if(keyframeDistance <= 0 && keyframeAngle <= 0 && keyframeInliers <= 0)
+    {
+        return true;
+    }
+
+    const Eigen::Matrix4f motion = keyframePose.inverse() * currPose;
+
+    const float distance = motion.topRightCorner(3, 1).norm();
+    const float angle = Eigen::AngleAxisf(Eigen::Matrix3f(motion.topLeftCorner(3, 3))).angle();
+    const float inliers = odometry.lastICPCount / (float)Resolution::getInstance().numPixels();
+
+    return (keyframeDistance > 0 && distance > keyframeDistance) ||
+           (keyframeAngle > 0 && angle > keyframeAngle) ||
+           (keyframeInliers > 0 && inliers < keyframeInliers);
+}
+
+void VisualOdometry::setKeyframe()
+{
+    //In passthrough mode the existing maps aren't read, anything that isn't a render target will do
+    keyframe.vertex(textures[GPUTexture::RGB], textures[GPUTexture::DEPTH_FILTERED], true);
+    keyframe.normal(textures[GPUTexture::RGB], textures[GPUTexture::DEPTH_FILTERED], true);
+    keyframe.image(textures[GPUTexture::RGB], textures[GPUTexture::RGB], true);
+
+    keyframePose = currPose;
+}
+
+void VisualOdometry::filterDepth()
+{
+    filterUniforms.at(2).f = depthCutoff;
+
+    filter->compute(textures[GPUTexture::DEPTH_RAW]->texture, &filterUniforms);
+}
+
+void VisualOdometry::saveTrajectory(const std::string & filename, const bool iclnuim)
+{
+    std::ofstream f;
+    f.open(filename.c_str(), std::fstream::out);
+
+    for(size_t i = 0; i < poses.size(); i++)
+    {
+        std::stringstream strs;
+
+        if(iclnuim)
+        {
+            strs << std::setprecision(6) << std::fixed << (double)poses.at(i).first << " ";
+        }
+        else
+        {
+            strs << std::setprecision(6) << std::fixed << (double)poses.at(i).first / 1000000.0 << " ";
+        }
+
+        Eigen::Vector3f trans = poses.at(i).second.topRightCorner(3, 1);
+        Eigen::Matrix3f rot = poses.at(i).second.topLeftCorner(3, 3);
+
+        f << strs.str() << trans(0) << " " << trans(1) << " " << trans(2) << " ";
+
+        Eigen::Quaternionf currentCameraRotation(rot);
+
+        f << currentCameraRotation.x() << " " << currentCameraRotation.y() << " " << currentCameraRotation.z() << " " << currentCameraRotation.w() << "\n";
+    }
+
+    f.close();
+}
+
+const Eigen::Matrix4f & VisualOdometry::getCurrPose()
+{
+    return currPose;
+}
+
+const int & VisualOdometry::getTick()
+{
+    return tick;
+}
+
+const RGBDOdometry & VisualOdometry::getOdometry()
+{
+    return odometry;
+}
+
+const float & VisualOdometry::getLastLatency()
+{
+    return lastLatency;
+}
+
+const int & VisualOdometry::getOverruns()
+{
+    return overruns;
+}
+
+const bool & VisualOdometry::getDegraded()
+{
+    return degraded;
+}
+
+void VisualOdometry::setLatencyBudget(const float & val)
+{
+    latencyBudget = val;
+    degraded = latencyBudget > 0 && fullLatency > latencyBudget;
+    degradedFrames = 0;
+}
+
+void VisualOdometry::setKeyframeDistance(const float & val)
+{
+    keyframeDistance = val;
+}
+
+void VisualOdometry::setKeyframeAngle(const float & val)
+{
+    keyframeAngle = val;
+}
+
+void VisualOdometry::setKeyframeInliers(const float & val)
+{
+    keyframeInliers = val;
+}
+
+void VisualOdometry::setRgbOnly(const bool & val)
+{
+    rgbOnly = val;
+}
+
+void VisualOdometry::setIcpWeight(const float & val)
+{
+    icpWeight = val;
+}
+
+void VisualOdometry::setPyramid(const bool & val)
+{
+    pyramid = val;
+}
+
+void VisualOdometry::setFastOdom(const bool & val)
+{
+    fastOdom = val;
+}
+
+void VisualOdometry::setSo3(const bool & val)
+{
+    so3 = val;
+}
+
+void VisualOdometry::setDepthCutoff(const float & val)
+{
+    depthCutoff = val;
+}
@@ -0,0 +1,211 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef VISUALODOMETRY_H_
+#define VISUALODOMETRY_H_
+
+#include "Utils/RGBDOdometry.h"
+#include "Utils/Resolution.h"
+#include "Utils/Intrinsics.h"
+#include "Utils/Stopwatch.h"
+#include "Shaders/Shaders.h"
+#include "Shaders/ComputePack.h"
+#include "Shaders/FillIn.h"
+#include "Defines.h"
+
+#include <iomanip>
+#include <fstream>
+
+/**
+ * Tracking without a map. Runs the same depth preprocessing and ICP+RGB
+ * odometry as ElasticFusion but registers each frame against the last one
+ * (or against a keyframe) instead of a prediction of the surfel model, so
+ * there's no fusion, prediction, fern database or deformation.
+ */
+class VisualOdometry
+{
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        EFUSION_API VisualOdometry(const float depthCut = 3,
+                                   const float icpThresh = 10,
+                                   const bool fastOdom = false,
+                                   const bool so3 = true);
+
+        virtual ~VisualOdometry();
+
+        /**
+         * Tracks a frame, the pose is then available through getCurrPose
+         * @param rgb RGB colour data
+         * @param depth Depth in millimetres
+         * @param timestamp Timestamp of the frame
+         */
+        EFUSION_API void processFrame(const unsigned char * rgb,
+                                      const unsigned short * depth,
+                                      const int64_t & timestamp);
+
+        /**
+         * Writes the trajectory so far in the TUM RGB-D format
+         * @param filename
+         * @param iclnuim timestamps are frame numbers rather than microseconds
+         */
+        EFUSION_API void saveTrajectory(const std::string & filename, const bool iclnuim = false);
+
+        /**
+         * The current global camera pose estimate
+         * @return SE3 pose
+         */
+        EFUSION_API const Eigen::Matrix4f & getCurrPose();
+
+        /**
+         * The number of frames processed
+         * @return
+         */
+        EFUSION_API const int & getTick();
+
+        /**
+         * The tracking class, if you want access to its errors and covariance
+         * @return
+         */
+        EFUSION_API const RGBDOdometry & getOdometry();
+
+        /**
+         * Wall time of the last processFrame call, in milliseconds
+         * @return
+         */
+        EFUSION_API const float & getLastLatency();
+
+        /**
+         * How many frames have gone over the latency budget
+         * @return
+         */
+        EFUSION_API const int & getOverruns();
+
+        /**
+         * Whether the budget currently has tracking on fast odometry, i.e. fewer iterations on the finest pyramid level
+         * @return
+         */
+        EFUSION_API const bool & getDegraded();
+
+        /**
+         * Per frame latency budget in milliseconds, 0 (the default) for none.
+         * While full frames cost more than this tracking falls back to fast
+         * odometry, trying full tracking again every so often
+         * @param val
+         */
+        EFUSION_API void setLatencyBudget(const float & val);
+
+        /**
+         * Track against a keyframe that is only replaced once the camera has moved
+         * this far from it, in metres. 0 (the default) tracks frame to frame
+         * @param val
+         */
+        EFUSION_API void setKeyframeDistance(const float & val);
+
+        /**
+         * As above, for rotation in radians
+         * @param val
+         */
+        EFUSION_API void setKeyframeAngle(const float & val);
+
+        /**
+         * Also replace the keyframe if fewer than this fraction of pixels are ICP inliers
+         * @param val
+         */
+        EFUSION_API void setKeyframeInliers(const float & val);
+
+        /**
+         * Turns on or off RGB tracking (i.e. ICP only)
+         * @param val
+         */
+        EFUSION_API void setRgbOnly(const bool & val);
+
+        /**
+         * Weight for ICP in tracking
+         * @param val if 100, only use depth for tracking, if 0, only use RGB
+         */
+        EFUSION_API void setIcpWeight(const float & val);
+
+        /**
+         * Whether or not to use a pyramid for tracking
+         * @param val default is true
+         */
+        EFUSION_API void setPyramid(const bool & val);
+
+        /**
+         * Controls the number of tracking iterations
+         * @param val default is false
+         */
+        EFUSION_API void setFastOdom(const bool & val);
+
+        /**
+         * Turns on or off SO(3) alignment bootstrapping
+         * @param val
+         */
+        EFUSION_API void setSo3(const bool & val);
+
+        /**
+         * Raw data fusion cut off, also used to filter the input depth
+         * @param val default is 3 metres
+         */
+        EFUSION_API void setDepthCutoff(const float & val);
+
+    private:
+        void filterDepth();
+
+        void setKeyframe();
+
+        bool needsKeyframe();
+
+        RGBDOdometry odometry;
+        FillIn keyframe;
+
+        std::map<std::string, GPUTexture*> textures;
+        ComputePack * filter;
+        std::vector<Uniform> filterUniforms;
+
+        Eigen::Matrix4f currPose;
+        Eigen::Matrix4f keyframePose;
+
+        std::vector<std::pair<unsigned long long int, Eigen::Matrix4f> > poses;
+
+        int tick;
+
+        float lastLatency;
+        float fullLatency;
+        float latencyBudget;
+        int overruns;
+        int degradedFrames;
+        bool degraded;
+
+        float keyframeDistance;
+        float keyframeAngle;
+        float keyframeInliers;
+
+        const float maxDepthProcessed;
+
+        bool rgbOnly;
+        float icpWeight;
+        bool pyramid;
+        bool fastOdom;
+        bool so3;
+        float depthCutoff;
+
+        static const int PROBE_INTERVAL = 30;
+};
+
+#endif /* VISUALODOMETRY_H_ */
@@ -18,43 +18,61 @@
  
 #include <ElasticFusion.h>
 #include <Utils/RGBDOdometry.h>
+#include <Utils/SyntheticScene.h>
 
 #include <string>
 #include <iomanip>
 #include <fstream>
+#include <vector>
+#include <algorithm>
 
 std::ifstream asFile;
 std::string directory;
+SyntheticScene * scene = 0;
 Eigen::Matrix3f K;
 
-void loadImage(GPUTexture & image, const std::string & name)
+//Frame 1 or 2, from the folder's PNGs or rendered if there's no folder, depth in millimetres
+void loadFrame(const int frame, std::vector<unsigned char> & rgb, std::vector<unsigned short> & depth)
 {
+    rgb.resize(640 * 480 * 3);
+    depth.resize(640 * 480);
+
+    if(scene)
+    {
+        scene->render(frame - 1, depth.data(), rgb.data());
+        return;
+    }
+
     std::string imageLoc = directory;
-    imageLoc.append(name);
+    imageLoc.append(std::to_string(frame) + "c.png");
 
     pangolin::TypedImage img = pangolin::LoadImage(imageLoc);
 
-    Img<Eigen::Matrix<unsigned char, 3, 1>> imageRaw(480, 640, (Eigen::Matrix<unsigned char, 3, 1> *)img.ptr);
+    std::copy(img.ptr, img.ptr + rgb.size(), rgb.begin());
 
-    image.texture->Upload(imageRaw.data, GL_RGB, GL_UNSIGNED_BYTE);
-}
-
-void loadDepth(GPUTexture & depth, const std::string & name)
-{
     std::string depthLoc = directory;
-    depthLoc.append(name);
+    depthLoc.append(std::to_string(frame) + "d.png");
 
-    pangolin::TypedImage img = pangolin::LoadImage(depthLoc);
+    pangolin::TypedImage depthImg = pangolin::LoadImage(depthLoc);
 
-    Img<unsigned short> depthRaw(480, 640, (unsigned short *)img.ptr);
+    const unsigned short * depthRaw = (const unsigned short *)depthImg.ptr;
 
-    for(unsigned int i = 0; i < 480; i++)
+    for(size_t i = 0; i < depth.size(); i++)
     {
-        for(unsigned int j = 0; j < 640; j++)
-        {
-            depthRaw.at<unsigned short>(i, j) /= 5;
-        }
+        depth[i] = depthRaw[i] / 5;
     }
+}
+
+void loadImage(GPUTexture & image, std::vector<unsigned char> & rgb)
+{
+    Img<Eigen::Matrix<unsigned char, 3, 1>> imageRaw(480, 640, (Eigen::Matrix<unsigned char, 3, 1> *)rgb.data());
+
+    image.texture->Upload(imageRaw.data, GL_RGB, GL_UNSIGNED_BYTE);
+}
+
+void loadDepth(GPUTexture & depth, std::vector<unsigned short> & depthMm)
+{
+    Img<unsigned short> depthRaw(480, 640, depthMm.data());
 
     depth.texture->Upload(depthRaw.data, GL_LUMINANCE_INTEGER_EXT, GL_UNSIGNED_SHORT);
 }
@@ -66,14 +84,9 @@ Eigen::Vector3f getVertex(const int row, const int col, const float depth)
                            depth);
 }
 
-void loadVertices(GPUTexture & vertices, GPUTexture & normals, const std::string & name)
+void loadVertices(GPUTexture & vertices, GPUTexture & normals, std::vector<unsigned short> & depthMm)
 {
-    std::string depthLoc = directory;
-    depthLoc.append(name);
-
-    pangolin::TypedImage img = pangolin::LoadImage(depthLoc);
-
-    Img<unsigned short> depthRaw(480, 640, (unsigned short *)img.ptr);
+    Img<unsigned short> depthRaw(480, 640, depthMm.data());
 
     Img<Eigen::Vector4f> verts(480, 640);
     Img<Eigen::Vector4f> norms(480, 640);
@@ -91,13 +104,13 @@ void loadVertices(GPUTexture & vertices, GPUTexture & normals, const std::string
                depthRaw.at<unsigned short>(row - 1, col) > 0 &&
                depthRaw.at<unsigned short>(row, col - 1) > 0)
             {
-                Eigen::Vector3f actual = getVertex(row, col, depthRaw.at<unsigned short>(row, col) / 5000.f);
+                Eigen::Vector3f actual = getVertex(row, col, depthRaw.at<unsigned short>(row, col) / 1000.f);
 
-                Eigen::Vector3f fore = getVertex(row, col + 1, depthRaw.at<unsigned short>(row, col + 1) / 5000.f);
+                Eigen::Vector3f fore = getVertex(row, col + 1, depthRaw.at<unsigned short>(row, col + 1) / 1000.f);
 
                 Eigen::Vector3f del_x = fore - actual;
 
-                fore = getVertex(row + 1, col, depthRaw.at<unsigned short>(row + 1, col) / 5000.f);
+                fore = getVertex(row + 1, col, depthRaw.at<unsigned short>(row + 1, col) / 1000.f);
 
                 Eigen::Vector3f del_y = fore - actual;
 
@@ -124,8 +137,13 @@ void loadVertices(GPUTexture & vertices, GPUTexture & normals, const std::string
         }
     }
 
+    //Rows of owned images are padded
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, verts.stride / sizeof(Eigen::Vector4f));
+
     vertices.texture->Upload(verts.data, GL_RGBA, GL_FLOAT);
     normals.texture->Upload(norms.data, GL_RGBA, GL_FLOAT);
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 }
 
 void display(const GPUTexture & firstImage, const GPUTexture & secondImage, const int counter)
@@ -151,15 +169,29 @@ int main(int argc, char * argv[])
            0, 528, 240,
            0,   0,   1;
 
-    assert(argc == 2 && "Please supply the folder containing 1c.png, 1d.png, 2c.png and 2d.png");
-
-    directory.append(argv[1]);
+    //A folder containing 1c.png, 1d.png, 2c.png and 2d.png, or two frames of a synthetic room without one
+    if(argc > 1)
+    {
+        directory.append(argv[1]);
 
-    if(directory.at(directory.size() - 1) != '/')
+        if(directory.at(directory.size() - 1) != '/')
+        {
+            directory.append("/");
+        }
+    }
+    else
     {
-        directory.append("/");
+        std::cout << "No folder given, using a synthetic room" << std::endl;
+
+        scene = new SyntheticScene(SyntheticScene::Config());
     }
 
+    std::vector<unsigned char> firstRgb, secondRgb;
+    std::vector<unsigned short> firstRawDepth, secondRawDepth;
+
+    loadFrame(1, firstRgb, firstRawDepth);
+    loadFrame(2, secondRgb, secondRawDepth);
+
     pangolin::CreateWindowAndBind("GPUTest", 640, 480);
     pangolin::Display("Image").SetAspect(640.0f / 480.0f);
 
@@ -169,7 +201,7 @@ int main(int argc, char * argv[])
                           GL_UNSIGNED_BYTE,
                           false, true);
 
-    loadImage(firstImage, "1c.png");
+    loadImage(firstImage, firstRgb);
 
     GPUTexture secondImage(640, 480,
                            GL_RGBA,
@@ -177,7 +209,7 @@ int main(int argc, char * argv[])
                            GL_UNSIGNED_BYTE,
                            false, true);
 
-    loadImage(secondImage, "2c.png");
+    loadImage(secondImage, secondRgb);
 
     display(firstImage, secondImage, 0);
 
@@ -188,7 +220,7 @@ int main(int argc, char * argv[])
                            false,
                            true);
 
-    loadDepth(secondDepth, "2d.png");
+    loadDepth(secondDepth, secondRawDepth);
 
     GPUTexture vertexTexture(640, 480,
                              GL_RGBA32F,
@@ -202,7 +234,7 @@ int main(int argc, char * argv[])
                              GL_FLOAT,
                              false, true);
 
-    loadVertices(vertexTexture, normalTexture, "1d.png");
+    loadVertices(vertexTexture, normalTexture, firstRawDepth);
 
     cudaDeviceProp prop;
 
@@ -329,5 +361,7 @@ int main(int argc, char * argv[])
     std::cout << "rgbStepMap[\"" << dev << "\"] = std::pair<int, int>(" << rgbStepBestThreads <<", " << rgbStepBestBlocks << ");" << std::endl;
     std::cout << "rgbResMap[\"" << dev << "\"] = std::pair<int, int>(" << rgbResBestThreads <<", " << rgbResBestBlocks << ");" << std::endl;
     std::cout << "so3StepMap[\"" << dev << "\"] = std::pair<int, int>(" << so3StepBestThreads <<", " << so3StepBestBlocks << ");" << std::endl;
+
+    delete scene;
 }
 
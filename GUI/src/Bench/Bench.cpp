@@ -0,0 +1,367 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include <ElasticFusion.h>
+#include <Utils/Parse.h>
+#include <Utils/Stopwatch.h>
+#include <Utils/ThreadPool.h>
+
+#include "../Tools/RawLogReader.h"
+#include "../Tools/ChunkedLogReader.h"
+#include "../Tools/TUMLogReader.h"
+#include "../Tools/SyntheticLogReader.h"
+
+#include "BenchReport.h"
+#include "TrajectoryError.h"
+
+#include <pangolin/pangolin.h>
+#include <cuda_runtime_api.h>
+#include <sys/resource.h>
+
+#include <limits>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+/*
+ * Runs ElasticFusion over a log or a synthetic scene as fast as it will go, without drawing anything, and
+ * reports per stage latency, memory, throughput and (given ground truth) trajectory error. Flags are in the README.
+ */
+
+static float gpuUsedMb()
+{
+    size_t free = 0, total = 0;
+    cudaMemGetInfo(&free, &total);
+    return (total - free) / (1024.0f * 1024.0f);
+}
+
+static float hostPeakMb()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    //Kilobytes on Linux
+    return usage.ru_maxrss / 1024.0f;
+}
+
+static unsigned long long int now()
+{
+    return Stopwatch::getCurrentSystemTime();
+}
+
+int main(int argc, char * argv[])
+{
+    std::string empty;
+    std::string logFile, synthLayout, calibrationFile, groundTruthFile, outFile, baselineFile;
+
+    Parse::get().arg(argc, argv, "-l", logFile);
+    Parse::get().arg(argc, argv, "-cal", calibrationFile);
+    Parse::get().arg(argc, argv, "-gt", groundTruthFile);
+    Parse::get().arg(argc, argv, "-out", outFile);
+    Parse::get().arg(argc, argv, "-baseline", baselineFile);
+
+    const bool iclnuim = Parse::get().arg(argc, argv, "-icl", empty) > -1;
+    const bool flipColors = Parse::get().arg(argc, argv, "-f", empty) > -1;
+
+    SyntheticScene::Config synthConfig;
+    const bool synthetic = Parse::get().arg(argc, argv, "-synth", synthLayout) > 0 && SyntheticScene::parseLayout(synthLayout, synthConfig.layout);
+
+    if(!synthetic && logFile.empty())
+    {
+        std::cout << "Give a log with -l or a synthetic scene with -synth room|corridor|loop" << std::endl;
+        return 1;
+    }
+
+    ChunkedLog::Header logHeader;
+    const bool chunkedLog = !synthetic && ChunkedLog::readHeader(logFile, logHeader);
+
+    Resolution::getInstance(chunkedLog ? logHeader.width : 640, chunkedLog ? logHeader.height : 480);
+
+    if(calibrationFile.length())
+    {
+        std::ifstream file(calibrationFile.c_str());
+        float fx = 528, fy = 528, cx = 320, cy = 240;
+        file >> fx >> fy >> cx >> cy;
+        Intrinsics::getInstance(fx, fy, cx, cy);
+    }
+    else if(chunkedLog)
+    {
+        Intrinsics::getInstance(logHeader.fx, logHeader.fy, logHeader.cx, logHeader.cy);
+    }
+    else
+    {
+        Intrinsics::getInstance(528, 528, 320, 240);
+    }
+
+    LogReader * logReader = 0;
+
+    if(synthetic)
+    {
+        float noiseScale = 1;
+        Parse::get().arg(argc, argv, "-synthf", synthConfig.numFrames);
+        Parse::get().arg(argc, argv, "-synthn", noiseScale);
+
+        synthConfig.width = Resolution::getInstance().width();
+        synthConfig.height = Resolution::getInstance().height();
+        synthConfig.fx = Intrinsics::getInstance().fx();
+        synthConfig.fy = Intrinsics::getInstance().fy();
+        synthConfig.cx = Intrinsics::getInstance().cx();
+        synthConfig.cy = Intrinsics::getInstance().cy();
+        synthConfig.depthNoise *= noiseScale;
+        synthConfig.colourNoise *= noiseScale;
+
+        logReader = new SyntheticLogReader(synthConfig, flipColors);
+    }
+    else if(chunkedLog)
+    {
+        logReader = new ChunkedLogReader(logFile, flipColors);
+    }
+    else if(logFile.length() > 4 && logFile.compare(logFile.length() - 4, 4, ".txt") == 0)
+    {
+        float depthScale = 5000;
+        Parse::get().arg(argc, argv, "-ds", depthScale);
+
+        logReader = new TUMLogReader(logFile, flipColors, depthScale, iclnuim ? 1 : 1000000);
+    }
+    else
+    {
+        logReader = new RawLogReader(logFile, flipColors);
+    }
+
+    //The same settings as the GUI, for the ones that change how much work is done
+    float depth = 3.0f;
+    float frameDeadline = 0;
+    float rpeDelta = 1;
+    float tolerance = 5;
+    int surfelBudget = 0;
+    int warmup = 10;
+    int end = std::numeric_limits<int>::max();
+    int threads = ThreadPool::getInstance().getWorkers();
+
+    Parse::get().arg(argc, argv, "-d", depth);
+    Parse::get().arg(argc, argv, "-dl", frameDeadline);
+    Parse::get().arg(argc, argv, "-sb", surfelBudget);
+    Parse::get().arg(argc, argv, "-e", end);
+    Parse::get().arg(argc, argv, "-th", threads);
+    Parse::get().arg(argc, argv, "-warm", warmup);
+    Parse::get().arg(argc, argv, "-rpe", rpeDelta);
+    Parse::get().arg(argc, argv, "-tol", tolerance);
+
+    const bool openLoop = Parse::get().arg(argc, argv, "-o", empty) > -1;
+    const bool reloc = Parse::get().arg(argc, argv, "-rl", empty) > -1;
+    const bool fastOdom = Parse::get().arg(argc, argv, "-fo", empty) > -1;
+    const bool so3 = !(Parse::get().arg(argc, argv, "-nso", empty) > -1);
+    const bool headless = Parse::get().arg(argc, argv, "-headless", empty) > -1;
+
+    ThreadPool::getInstance().setWorkers(threads, Parse::get().arg(argc, argv, "-pin", empty) > -1);
+
+    //Still needs a GL context, headless makes it without a window (Pangolin built with EGL)
+    pangolin::Params windowParams;
+
+    windowParams.Set("SAMPLE_BUFFERS", 0);
+    windowParams.Set("SAMPLES", 0);
+
+    if(headless)
+    {
+        windowParams.Set("scheme", "headless");
+    }
+
+    pangolin::CreateWindowAndBind("bench", Resolution::getInstance().width(), Resolution::getInstance().height(), windowParams);
+
+    cudaDeviceProp prop;
+    cudaGetDeviceProperties(&prop, 0);
+
+    const float gpuBefore = gpuUsedMb();
+
+    ElasticFusion * eFusion = new ElasticFusion(openLoop ? std::numeric_limits<int>::max() / 2 : 200,
+                                                35000,
+                                                5e-05,
+                                                1e-05,
+                                                !openLoop,
+                                                iclnuim,
+                                                reloc,
+                                                115,
+                                                10,
+                                                depth,
+                                                10,
+                                                fastOdom,
+                                                0.3095f,
+                                                so3,
+                                                false,
+                                                logReader->getFile() + ".bench");
+
+    eFusion->setBackgroundLoopClosure(Parse::get().arg(argc, argv, "-bg", empty) > -1);
+    eFusion->setAsyncRelocalisation(Parse::get().arg(argc, argv, "-ar", empty) > -1);
+    eFusion->setSurfelBudget(surfelBudget);
+    eFusion->setFrameDeadline(frameDeadline);
+
+    float gpuPeak = gpuUsedMb();
+
+    std::vector<float> readTimes, frameTimes;
+
+    int frames = 0;
+    unsigned long long int processing = 0;
+    const unsigned long long int begin = now();
+
+    while(logReader->hasMore() && frames < end)
+    {
+        //The first frames pay for lazy allocations and shader warm up
+        if(frames == warmup)
+        {
+            Stopwatch::getInstance().setRecording(true);
+        }
+
+        const unsigned long long int start = now();
+
+        logReader->getNext();
+
+        const unsigned long long int read = now();
+
+        eFusion->processFrame(logReader->rgb, logReader->depth, logReader->timestamp);
+
+        //GL calls return before the work is done
+        glFinish();
+
+        const unsigned long long int done = now();
+
+        if(frames >= warmup)
+        {
+            readTimes.push_back((read - start) / 1000.0f);
+            frameTimes.push_back((done - read) / 1000.0f);
+        }
+
+        processing += done - read;
+        gpuPeak = std::max(gpuPeak, gpuUsedMb());
+
+        if(++frames % 100 == 0)
+        {
+            std::cout << "\r" << frames << "/" << logReader->getNumFrames() << "    "; std::cout.flush();
+        }
+    }
+
+    const unsigned long long int total = now() - begin;
+
+    std::cout << "\r" << frames << " frames" << std::endl << std::endl;
+
+    Stopwatch::getInstance().setRecording(false);
+
+    std::map<std::string, std::vector<float> > stages;
+    Stopwatch::getInstance().takeRecorded(stages);
+
+    BenchReport report;
+
+    report.setText("input", logReader->getFile());
+    report.setText("device", prop.name);
+
+    report.set("frames", frames);
+    report.set("frames.warmup", std::min(warmup, frames));
+    report.set("threads", ThreadPool::getInstance().getWorkers());
+
+    report.addDistribution("latency.frame", frameTimes);
+    report.addDistribution("latency.read", readTimes);
+
+    for(std::map<std::string, std::vector<float> >::const_iterator it = stages.begin(); it != stages.end(); it++)
+    {
+        report.addDistribution("latency.stage." + it->first, it->second);
+    }
+
+    report.set("throughput.fps", processing ? frames * 1000000.0 / processing : 0);
+    report.set("throughput.fps_with_read", total ? frames * 1000000.0 / total : 0);
+
+    report.set("memory.host_peak_mb", hostPeakMb());
+    report.set("memory.gpu_peak_mb", gpuPeak);
+    report.set("memory.gpu_added_mb", gpuPeak - gpuBefore);
+
+    report.set("map.surfels", eFusion->getGlobalModel().lastCount());
+    report.set("map.deforms", eFusion->getDeforms());
+    report.set("map.fern_deforms", eFusion->getFernDeforms());
+
+    TrajectoryError::Trajectory estimate, groundTruth;
+
+    for(size_t i = 0; i < eFusion->getPoseGraph().size(); i++)
+    {
+        TrajectoryError::Pose pose;
+        pose.timestamp = eFusion->getPoseLogTimes().at(i);
+        pose.pose.matrix() = eFusion->getPoseGraph().at(i).second.cast<double>();
+        estimate.push_back(pose);
+    }
+
+    if(synthetic)
+    {
+        const SyntheticScene & scene = ((SyntheticLogReader *)logReader)->getScene();
+
+        for(int i = 0; i < synthConfig.numFrames; i++)
+        {
+            TrajectoryError::Pose pose;
+            pose.timestamp = scene.getTimestamp(i);
+            pose.pose.matrix() = scene.getPose(i).cast<double>();
+            groundTruth.push_back(pose);
+        }
+    }
+    else if(groundTruthFile.length() && !TrajectoryError::load(groundTruthFile, groundTruth))
+    {
+        std::cout << "Couldn't read ground truth from " << groundTruthFile << std::endl;
+    }
+
+    if(groundTruth.size())
+    {
+        //ICL-NUIM timestamps are frame numbers at 30Hz
+        const TrajectoryError::Result error = TrajectoryError::compute(estimate, groundTruth, iclnuim ? 0 : 20000, iclnuim ? rpeDelta * 30 : rpeDelta * 1000000);
+
+        report.set("trajectory.matched", error.matched);
+        report.set("ate.rmse_m", error.ateRmse);
+        report.set("ate.mean_m", error.ateMean);
+        report.set("ate.median_m", error.ateMedian);
+        report.set("ate.max_m", error.ateMax);
+        report.set("rpe.translation_rmse_m", error.rpeTranslationRmse);
+        report.set("rpe.rotation_rmse_deg", error.rpeRotationRmse);
+    }
+
+    delete eFusion;
+    delete logReader;
+
+    report.print();
+
+    if(outFile.length() && !report.save(outFile))
+    {
+        std::cout << "Couldn't write " << outFile << std::endl;
+    }
+
+    int regressions = 0;
+
+    if(baselineFile.length())
+    {
+        std::map<std::string, double> baseline;
+
+        if(BenchReport::load(baselineFile, baseline))
+        {
+            std::cout << std::endl;
+
+            regressions = report.compare(baseline, tolerance / 100.0);
+
+            std::cout << std::endl << regressions << " regression" << (regressions == 1 ? "" : "s") << " against " << baselineFile << std::endl;
+        }
+        else
+        {
+            std::cout << "Couldn't read the baseline " << baselineFile << std::endl;
+        }
+    }
+
+    //Non-zero on regressions so scripts can stop on them
+    return regressions > 0 ? 2 : 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "BenchReport.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+
+void BenchReport::set(const std::string & name, const double value)
+{
+    values[name] = value;
+}
+
+void BenchReport::setText(const std::string & name, const std::string & value)
+{
+    texts[name] = value;
+}
+
+void BenchReport::addDistribution(const std::string & name, std::vector<float> samples)
+{
+    set(name + ".count", samples.size());
+
+    if(samples.empty())
+    {
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    double sum = 0;
+
+    for(size_t i = 0; i < samples.size(); i++)
+    {
+        sum += samples[i];
+    }
+
+    //Nearest rank
+    const int last = samples.size() - 1;
+
+    set(name + ".mean", sum / samples.size());
+    set(name + ".p50", samples[std::min(last, (int)std::ceil(0.50 * samples.size()) - 1)]);
+    set(name + ".p90", samples[std::min(last, (int)std::ceil(0.90 * samples.size()) - 1)]);
+    set(name + ".p99", samples[std::min(last, (int)std::ceil(0.99 * samples.size()) - 1)]);
+    set(name + ".max", samples[last]);
+}
+
+const std::map<std::string, double> & BenchReport::getValues()
+{
+    return values;
+}
+
+void BenchReport::print()
+{
+    for(std::map<std::string, std::string>::const_iterator it = texts.begin(); it != texts.end(); it++)
+    {
+        std::cout << std::left << std::setw(40) << it->first << it->second << std::endl;
+    }
+
+    for(std::map<std::string, double>::const_iterator it = values.begin(); it != values.end(); it++)
+    {
+        std::cout << std::left << std::setw(40) << it->first << it->second << std::endl;
+    }
+}
+
+//Just enough escaping for paths and device names
+static std::string quote(const std::string & text)
+{
+    std::string quoted = "\"";
+
+    for(size_t i = 0; i < text.length(); i++)
+    {
+        if(text[i] == '"' || text[i] == '\\')
+        {
+            quoted += '\\';
+        }
+
+        quoted += text[i];
+    }
+
+    return quoted + "\"";
+}
+
+bool BenchReport::save(const std::string & filename)
+{
+    std::ofstream file(filename.c_str());
+
+    file << "{" << std::endl;
+
+    size_t remaining = texts.size() + values.size();
+
+    for(std::map<std::string, std::string>::const_iterator it = texts.begin(); it != texts.end(); it++)
+    {
+        file << "    " << quote(it->first) << ": " << quote(it->second) << (--remaining ? "," : "") << std::endl;
+    }
+
+    file << std::setprecision(9);
+
+    for(std::map<std::string, double>::const_iterator it = values.begin(); it != values.end(); it++)
+    {
+        //JSON has no nan or inf
+        file << "    " << quote(it->first) << ": " << (std::isfinite(it->second) ? it->second : 0) << (--remaining ? "," : "") << std::endl;
+    }
+
+    file << "}" << std::endl;
+
+    return (bool)file;
+}
+
+bool BenchReport::load(const std::string & filename, std::map<std::string, double> & values)
+{
+    std::ifstream file(filename.c_str());
+
+    if(!file)
+    {
+        return false;
+    }
+
+    std::string line;
+
+    //One "name": value per line, as save writes them, text values are skipped
+    while(std::getline(file, line))
+    {
+        const size_t open = line.find('"');
+        const size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+        const size_t colon = close == std::string::npos ? close : line.find(':', close + 1);
+
+        if(colon == std::string::npos)
+        {
+            continue;
+        }
+
+        const char * start = line.c_str() + colon + 1;
+        char * end = 0;
+
+        const double value = strtod(start, &end);
+
+        if(end != start)
+        {
+            values[line.substr(open + 1, close - open - 1)] = value;
+        }
+    }
+
+    return !values.empty();
+}
+
+int BenchReport::direction(const std::string & name, double & minimum)
+{
+    const std::string family = name.substr(0, name.find('.'));
+    const bool count = name.length() > 6 && name.compare(name.length() - 6, 6, ".count") == 0;
+
+    if(count)
+    {
+        minimum = 0;
+        return 0;
+    }
+    else if(family == "latency")
+    {
+        //Milliseconds
+        minimum = 0.1;
+        return -1;
+    }
+    else if(family == "memory")
+    {
+        //Megabytes
+        minimum = 1;
+        return -1;
+    }
+    else if(family == "ate" || family == "rpe")
+    {
+        //Millimetres or hundredths of a degree
+        minimum = 0.001;
+        return -1;
+    }
+    else if(family == "throughput")
+    {
+        minimum = 0.1;
+        return 1;
+    }
+
+    minimum = 0;
+    return 0;
+}
+
+int BenchReport::compare(const std::map<std::string, double> & baseline, const double tolerance)
+{
+    int regressions = 0;
+
+    std::cout << std::left << std::setw(40) << "" << std::setw(14) << "baseline" << std::setw(14) << "now" << "change" << std::endl;
+
+    for(std::map<std::string, double>::const_iterator it = values.begin(); it != values.end(); it++)
+    {
+        std::map<std::string, double>::const_iterator base = baseline.find(it->first);
+
+        if(base == baseline.end())
+        {
+            continue;
+        }
+
+        double minimum = 0;
+        const int better = direction(it->first, minimum);
+        const double change = it->second - base->second;
+        const double relative = base->second != 0 ? change / std::fabs(base->second) : 0;
+
+        std::string verdict;
+
+        if(better != 0 && std::fabs(change) > minimum && std::fabs(relative) > tolerance)
+        {
+            const bool worse = (change > 0) == (better < 0);
+
+            verdict = worse ? "  WORSE" : "  better";
+            regressions += worse;
+        }
+
+        std::stringstream percent;
+        percent << std::showpos << std::fixed << std::setprecision(1) << relative * 100 << "%";
+
+        std::cout << std::left << std::setw(40) << it->first
+                  << std::setw(14) << base->second
+                  << std::setw(14) << it->second
+                  << percent.str() << verdict << std::endl;
+    }
+
+    return regressions;
+}
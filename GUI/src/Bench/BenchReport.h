@@ -0,0 +1,71 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef BENCHREPORT_H_
+#define BENCHREPORT_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Named results of a benchmark run, saved as a flat JSON object ("latency.frame.p99": 31.2, ...) so runs can be
+ * diffed, scripted and compared against a stored baseline.
+ *
+ * Names say which way is better: latency.*, memory.*, ate.* and rpe.* are lower is better, throughput.* higher,
+ * anything else (counts, settings) is only there for reference.
+ */
+class BenchReport
+{
+    public:
+        void set(const std::string & name, const double value);
+
+        void setText(const std::string & name, const std::string & value);
+
+        /**
+         * Adds name.count, .mean, .p50, .p90, .p99 and .max of the samples
+         */
+        void addDistribution(const std::string & name, std::vector<float> samples);
+
+        const std::map<std::string, double> & getValues();
+
+        void print();
+
+        bool save(const std::string & filename);
+
+        /**
+         * Reads back the numbers of a saved report
+         */
+        static bool load(const std::string & filename, std::map<std::string, double> & values);
+
+        /**
+         * Prints every result alongside the baseline's
+         * @param tolerance fraction a result can get worse by before it counts as a regression
+         * @return the number of regressions
+         */
+        int compare(const std::map<std::string, double> & baseline, const double tolerance);
+
+    private:
+        //1 if higher is better, -1 if lower is, 0 if neither. Changes smaller than minimum are noise either way
+        static int direction(const std::string & name, double & minimum);
+
+        std::map<std::string, double> values;
+        std::map<std::string, std::string> texts;
+};
+
+#endif /* BENCHREPORT_H_ */
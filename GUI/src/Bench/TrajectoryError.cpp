@@ -0,0 +1,183 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "TrajectoryError.h"
+
+#include <Eigen/LU>
+#include <Eigen/SVD>
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+bool TrajectoryError::load(const std::string & filename, Trajectory & trajectory)
+{
+    std::ifstream file(filename.c_str());
+
+    if(!file)
+    {
+        return false;
+    }
+
+    std::string line;
+
+    while(std::getline(file, line))
+    {
+        if(line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream tokens(line);
+        std::string time;
+        double x, y, z, qx, qy, qz, qw;
+
+        if(!(tokens >> time >> x >> y >> z >> qx >> qy >> qz >> qw))
+        {
+            continue;
+        }
+
+        const double scale = time.find('.') != std::string::npos ? 1000000.0 : 1.0;
+
+        Pose pose;
+        pose.timestamp = (uint64_t)(atof(time.c_str()) * scale + 0.5);
+        pose.pose.setIdentity();
+        pose.pose.translation() = Eigen::Vector3d(x, y, z);
+        pose.pose.linear() = Eigen::Quaterniond(qw, qx, qy, qz).normalized().toRotationMatrix();
+
+        trajectory.push_back(pose);
+    }
+
+    return !trajectory.empty();
+}
+
+static double rmse(const std::vector<double> & errors)
+{
+    double sum = 0;
+
+    for(size_t i = 0; i < errors.size(); i++)
+    {
+        sum += errors[i] * errors[i];
+    }
+
+    return errors.empty() ? 0 : std::sqrt(sum / errors.size());
+}
+
+TrajectoryError::Result TrajectoryError::compute(const Trajectory & estimate, const Trajectory & groundTruth, const uint64_t maxDifference, const uint64_t delta)
+{
+    Result result;
+
+    Trajectory truth(groundTruth);
+
+    std::sort(truth.begin(), truth.end(), [](const Pose & a, const Pose & b) { return a.timestamp < b.timestamp; });
+
+    //Each estimate with its nearest ground truth in time, in time order
+    Trajectory matchedEstimate, matchedTruth;
+
+    for(size_t i = 0; i < estimate.size() && !truth.empty(); i++)
+    {
+        const uint64_t time = estimate[i].timestamp;
+
+        Trajectory::const_iterator after = std::lower_bound(truth.begin(), truth.end(), time, [](const Pose & a, const uint64_t t) { return a.timestamp < t; });
+        Trajectory::const_iterator nearest = after;
+
+        if(after == truth.end() || (after != truth.begin() && time - (after - 1)->timestamp < after->timestamp - time))
+        {
+            nearest = after - 1;
+        }
+
+        const uint64_t difference = nearest->timestamp > time ? nearest->timestamp - time : time - nearest->timestamp;
+
+        if(difference <= maxDifference)
+        {
+            matchedEstimate.push_back(estimate[i]);
+            matchedTruth.push_back(*nearest);
+        }
+    }
+
+    result.matched = matchedEstimate.size();
+
+    if(result.matched < 3)
+    {
+        return result;
+    }
+
+    Eigen::Matrix3Xd estimatePoints(3, result.matched);
+    Eigen::Matrix3Xd truthPoints(3, result.matched);
+
+    for(int i = 0; i < result.matched; i++)
+    {
+        estimatePoints.col(i) = matchedEstimate[i].pose.translation();
+        truthPoints.col(i) = matchedTruth[i].pose.translation();
+    }
+
+    //Horn's closed form (via Umeyama), no scale as the depth is metric
+    const Eigen::Matrix4d alignment = Eigen::umeyama(estimatePoints, truthPoints, false);
+
+    std::vector<double> ate(result.matched);
+
+    for(int i = 0; i < result.matched; i++)
+    {
+        ate[i] = ((alignment.topLeftCorner(3, 3) * estimatePoints.col(i) + alignment.topRightCorner(3, 1)) - truthPoints.col(i)).norm();
+        result.ateMean += ate[i] / result.matched;
+        result.ateMax = std::max(result.ateMax, ate[i]);
+    }
+
+    result.ateRmse = rmse(ate);
+
+    std::vector<double> sorted(ate);
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    result.ateMedian = sorted[sorted.size() / 2];
+
+    //Relative error doesn't need aligning, motion over delta is compared directly
+    std::vector<double> translation, rotation;
+
+    size_t j = 0;
+
+    for(size_t i = 0; i < matchedEstimate.size(); i++)
+    {
+        j = std::max(j, i + 1);
+
+        while(j < matchedEstimate.size() && matchedEstimate[j].timestamp < matchedEstimate[i].timestamp + delta)
+        {
+            j++;
+        }
+
+        if(j == matchedEstimate.size())
+        {
+            break;
+        }
+
+        const Eigen::Isometry3d truthMotion = matchedTruth[i].pose.inverse() * matchedTruth[j].pose;
+        const Eigen::Isometry3d estimateMotion = matchedEstimate[i].pose.inverse() * matchedEstimate[j].pose;
+        const Eigen::Isometry3d error = truthMotion.inverse() * estimateMotion;
+
+        translation.push_back(error.translation().norm());
+        //atan2 rather than acos of the trace, which loses small angles to rounding
+        const Eigen::Matrix3d r = error.linear();
+        const Eigen::Vector3d axis(r(2, 1) - r(1, 2), r(0, 2) - r(2, 0), r(1, 0) - r(0, 1));
+
+        rotation.push_back(std::atan2(0.5 * axis.norm(), 0.5 * (r.trace() - 1)) * 180.0 / M_PI);
+    }
+
+    result.rpeTranslationRmse = rmse(translation);
+    result.rpeRotationRmse = rmse(rotation);
+
+    return result;
+}
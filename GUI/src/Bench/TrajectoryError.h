@@ -0,0 +1,77 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef TRAJECTORYERROR_H_
+#define TRAJECTORYERROR_H_
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Absolute and relative trajectory error, as in the TUM RGB-D benchmark tools. Estimates are paired with the
+ * ground truth pose nearest in time, the absolute error is taken after the rigid alignment that minimises it.
+ */
+class TrajectoryError
+{
+    public:
+        struct Pose
+        {
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+            uint64_t timestamp;
+            Eigen::Isometry3d pose;
+        };
+
+        typedef std::vector<Pose, Eigen::aligned_allocator<Pose> > Trajectory;
+
+        struct Result
+        {
+            Result()
+             : matched(0),
+               ateRmse(0), ateMean(0), ateMedian(0), ateMax(0),
+               rpeTranslationRmse(0), rpeRotationRmse(0)
+            {}
+
+            int matched;
+
+            //Metres
+            double ateRmse, ateMean, ateMedian, ateMax;
+
+            //Metres and degrees over each pair of poses delta apart
+            double rpeTranslationRmse, rpeRotationRmse;
+        };
+
+        /**
+         * Reads "timestamp tx ty tz qx qy qz qw" lines, timestamps with a decimal point are taken to be seconds
+         * and made microseconds (like GroundTruthOdometry does), others are used as they are
+         */
+        static bool load(const std::string & filename, Trajectory & trajectory);
+
+        /**
+         * @param maxDifference furthest apart in time an estimate and a ground truth pose can be to pair them
+         * @param delta time between the poses compared for the relative error
+         */
+        static Result compute(const Trajectory & estimate, const Trajectory & groundTruth, const uint64_t maxDifference, const uint64_t delta);
+};
+
+#endif /* TRAJECTORYERROR_H_ */
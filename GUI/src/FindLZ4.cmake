@@ -0,0 +1,15 @@
+###############################################################################
+# Find LZ4
+#
+# This sets the following variables:
+# LZ4_FOUND - True if LZ4 was found.
+# LZ4_INCLUDE_DIR - Directory containing lz4.h.
+# LZ4_LIBRARY - Library needed to use LZ4.
+
+find_path(LZ4_INCLUDE_DIR lz4.h)
+find_library(LZ4_LIBRARY NAMES lz4 liblz4)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LZ4 DEFAULT_MSG LZ4_LIBRARY LZ4_INCLUDE_DIR)
+
+mark_as_advanced(LZ4_LIBRARY LZ4_INCLUDE_DIR)
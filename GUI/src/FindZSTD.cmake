@@ -0,0 +1,15 @@
+###############################################################################
+# Find Zstandard
+#
+# This sets the following variables:
+# ZSTD_FOUND - True if zstd was found.
+# ZSTD_INCLUDE_DIR - Directory containing zstd.h.
+# ZSTD_LIBRARY - Library needed to use zstd.
+
+find_path(ZSTD_INCLUDE_DIR zstd.h)
+find_library(ZSTD_LIBRARY NAMES zstd libzstd)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(ZSTD DEFAULT_MSG ZSTD_LIBRARY ZSTD_INCLUDE_DIR)
+
+mark_as_advanced(ZSTD_LIBRARY ZSTD_INCLUDE_DIR)
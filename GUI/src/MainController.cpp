@@ -34,20 +34,122 @@ MainController::MainController(int argc, char * argv[])
     std::string calibrationFile;
     Parse::get().arg(argc, argv, "-cal", calibrationFile);
 
-    Resolution::getInstance(640, 480);
+    Parse::get().arg(argc, argv, "-l", logFile);
+
+    std::string synthLayout;
+    SyntheticScene::Config synthConfig;
+
+    //Rendered rather than read, otherwise it's treated just like a log
+    const bool synthetic = Parse::get().arg(argc, argv, "-synth", synthLayout) > 0 && SyntheticScene::parseLayout(synthLayout, synthConfig.layout);
+
+    if(synthetic)
+    {
+        logFile = Parse::get().baseDir() + "synthetic_" + synthLayout;
+    }
+
+    //Our own logs say what resolution and intrinsics they were recorded with
+    ChunkedLog::Header logHeader;
+    const bool chunkedLog = !synthetic && logFile.length() && ChunkedLog::readHeader(logFile, logHeader);
+
+    Resolution::getInstance(chunkedLog ? logHeader.width : 640, chunkedLog ? logHeader.height : 480);
 
     if(calibrationFile.length())
     {
         loadCalibration(calibrationFile);
     }
+    else if(chunkedLog)
+    {
+        Intrinsics::getInstance(logHeader.fx, logHeader.fy, logHeader.cx, logHeader.cy);
+    }
     else
     {
         Intrinsics::getInstance(528, 528, 320, 240);
     }
 
-    Parse::get().arg(argc, argv, "-l", logFile);
+    if(synthetic)
+    {
+        float noiseScale = 1;
+        Parse::get().arg(argc, argv, "-synthf", synthConfig.numFrames);
+        Parse::get().arg(argc, argv, "-synthn", noiseScale);
+
+        synthConfig.width = Resolution::getInstance().width();
+        synthConfig.height = Resolution::getInstance().height();
+        synthConfig.fx = Intrinsics::getInstance().fx();
+        synthConfig.fy = Intrinsics::getInstance().fy();
+        synthConfig.cx = Intrinsics::getInstance().cx();
+        synthConfig.cy = Intrinsics::getInstance().cy();
+        synthConfig.depthNoise *= noiseScale;
+        synthConfig.colourNoise *= noiseScale;
+    }
 
-    if(logFile.length())
+    std::string convertFile;
+
+    //Just converting a .klg log (or rendering a synthetic one) to a chunked one, nothing to run
+    if(logFile.length() && !chunkedLog && Parse::get().arg(argc, argv, "-convert", convertFile) > 0)
+    {
+        ChunkedLog::Header header;
+        header.width = Resolution::getInstance().width();
+        header.height = Resolution::getInstance().height();
+        header.fx = Intrinsics::getInstance().fx();
+        header.fy = Intrinsics::getInstance().fy();
+        header.cx = Intrinsics::getInstance().cx();
+        header.cy = Intrinsics::getInstance().cy();
+        header.depthCodec = ChunkedLog::bestDepthCodec();
+        header.imageCodec = ChunkedLog::IMAGE_JPEG;
+        header.depthScale = 0.001f;
+        header.framesPerChunk = 30;
+
+        std::cout << "Converting " << logFile << " to " << convertFile << " with " << ChunkedLog::depthCodecName(header.depthCodec) << " depth... "; std::cout.flush();
+
+        if(synthetic)
+        {
+            SyntheticScene scene(synthConfig);
+            ChunkedLogWriter writer(convertFile, header);
+
+            std::vector<unsigned short> depthBuffer(header.width * header.height);
+            std::vector<unsigned char> rgbBuffer(header.width * header.height * 3);
+
+            bool written = writer.isOpen();
+
+            for(int i = 0; i < synthConfig.numFrames && written; i++)
+            {
+                scene.render(i, depthBuffer.data(), rgbBuffer.data());
+                written = writer.addFrame(scene.getTimestamp(i), depthBuffer.data(), rgbBuffer.data());
+            }
+
+            written = writer.finish() && written && scene.saveTrajectory(convertFile + ".gt.freiburg");
+
+            std::cout << (written ? "done" : "failed") << std::endl;
+        }
+        else
+        {
+            std::cout << (ChunkedLogWriter::convert(logFile, convertFile, header) ? "done" : "failed") << std::endl;
+        }
+
+        good = false;
+        return;
+    }
+
+    if(synthetic)
+    {
+        logReader = new SyntheticLogReader(synthConfig, Parse::get().arg(argc, argv, "-f", empty) > -1);
+
+        //Ground truth to compare against, or to run with -p
+        ((SyntheticLogReader *)logReader)->getScene().saveTrajectory(logFile + ".gt.freiburg");
+    }
+    else if(chunkedLog)
+    {
+        logReader = new ChunkedLogReader(logFile, Parse::get().arg(argc, argv, "-f", empty) > -1);
+    }
+    else if(logFile.length() > 4 && logFile.compare(logFile.length() - 4, 4, ".txt") == 0)
+    {
+        float depthScale = 5000;
+        Parse::get().arg(argc, argv, "-ds", depthScale);
+
+        //ICL-NUIM associations number the frames rather than timestamp them
+        logReader = new TUMLogReader(logFile, Parse::get().arg(argc, argv, "-f", empty) > -1, depthScale, iclnuim ? 1 : 1000000);
+    }
+    else if(logFile.length())
     {
         logReader = new RawLogReader(logFile, Parse::get().arg(argc, argv, "-f", empty) > -1);
     }
@@ -67,6 +169,23 @@ MainController::MainController(int argc, char * argv[])
           good = ((LiveLogReader *)logReader)->cam->ok();
         }
 #endif
+
+        std::string recordFile;
+
+        if(good && Parse::get().arg(argc, argv, "-rec", recordFile) > 0)
+        {
+            ((LiveLogReader *)logReader)->record(recordFile);
+        }
+    }
+
+    float replaySpeed = 0;
+
+    //Play the log through a camera that keeps to its timestamps, to see what would happen live
+    if(logFile.length() && Parse::get().arg(argc, argv, "-replay", replaySpeed) > 0)
+    {
+        logReader = new LiveLogReader(logFile, Parse::get().arg(argc, argv, "-f", empty) > -1, new ReplayInterface(logReader, replaySpeed));
+
+        good = ((LiveLogReader *)logReader)->cam->ok();
     }
 
     if(Parse::get().arg(argc, argv, "-p", poseFile) > 0)
@@ -85,8 +204,16 @@ MainController::MainController(int argc, char * argv[])
     timeDelta = 200;
     icpCountThresh = 40000;
     start = 1;
+    checkpointRate = 0;
+    journalRate = 0;
+    surfelBudget = 0;
+    odometryBudget = 0;
+    keyframeDistance = 0;
+    pageBlockSize = 2;
+    pageDistance = 6;
+    frameDeadline = 0;
     so3 = !(Parse::get().arg(argc, argv, "-nso", empty) > -1);
-    end = std::numeric_limits<unsigned short>::max(); //Funny bound, since we predict times in this format really!
+    end = std::numeric_limits<int>::max();
 
     output_filename = logReader->getFile();
 
@@ -102,6 +229,18 @@ MainController::MainController(int argc, char * argv[])
     Parse::get().arg(argc, argv, "-s", start);
     Parse::get().arg(argc, argv, "-e", end);
     Parse::get().arg(argc, argv, "-name", output_filename);
+    Parse::get().arg(argc, argv, "-ck", checkpointRate);
+    Parse::get().arg(argc, argv, "-resume", resumeFile);
+    Parse::get().arg(argc, argv, "-jr", journalRate);
+    Parse::get().arg(argc, argv, "-pub", publisherName);
+    Parse::get().arg(argc, argv, "-loc", priorMapFile);
+    Parse::get().arg(argc, argv, "-vb", odometryBudget);
+    Parse::get().arg(argc, argv, "-vk", keyframeDistance);
+    Parse::get().arg(argc, argv, "-sb", surfelBudget);
+    Parse::get().arg(argc, argv, "-pg", pageFile);
+    Parse::get().arg(argc, argv, "-pgb", pageBlockSize);
+    Parse::get().arg(argc, argv, "-pgd", pageDistance);
+    Parse::get().arg(argc, argv, "-dl", frameDeadline);
 
     logReader->flipColors = Parse::get().arg(argc, argv, "-f", empty) > -1;
 
@@ -112,6 +251,13 @@ MainController::MainController(int argc, char * argv[])
     fastOdom = Parse::get().arg(argc, argv, "-fo", empty) > -1;
     rewind = Parse::get().arg(argc, argv, "-r", empty) > -1;
     frameToFrameRGB = Parse::get().arg(argc, argv, "-ftf", empty) > -1;
+    backgroundLoops = Parse::get().arg(argc, argv, "-bg", empty) > -1;
+    asyncReloc = Parse::get().arg(argc, argv, "-ar", empty) > -1;
+    odometryOnly = Parse::get().arg(argc, argv, "-vo", empty) > -1;
+
+    int threads = ThreadPool::getInstance().getWorkers();
+    Parse::get().arg(argc, argv, "-th", threads);
+    ThreadPool::getInstance().setWorkers(threads, Parse::get().arg(argc, argv, "-pin", empty) > -1);
 
     gui = new GUI(logFile.length() == 0, Parse::get().arg(argc, argv, "-sc", empty) > -1);
 
@@ -179,6 +325,12 @@ void MainController::loadCalibration(const std::string & filename)
 
 void MainController::launch()
 {
+    if(good && odometryOnly)
+    {
+        runOdometry();
+        return;
+    }
+
     while(good)
     {
         if(eFusion)
@@ -212,6 +364,29 @@ void MainController::launch()
                                         so3,
                                         frameToFrameRGB,
                                         output_filename);
+
+            eFusion->setBackgroundLoopClosure(backgroundLoops);
+            eFusion->setAsyncRelocalisation(asyncReloc);
+            eFusion->setPublisher(publisherName);
+            eFusion->setSurfelBudget(surfelBudget);
+            eFusion->setPaging(pageFile, pageBlockSize, pageDistance);
+            eFusion->setFrameDeadline(frameDeadline);
+
+            if(resumeFile.length())
+            {
+                if(eFusion->loadCheckpoint(resumeFile))
+                {
+                    logReader->fastForward(eFusion->getTick() - 1);
+                }
+                else
+                {
+                    std::cout << "Couldn't resume from " << resumeFile << std::endl;
+                }
+            }
+            else if(priorMapFile.length() && !eFusion->loadPriorMap(priorMapFile))
+            {
+                std::cout << "Couldn't load the map to localise against from " << priorMapFile << std::endl;
+            }
         }
         else
         {
@@ -221,6 +396,42 @@ void MainController::launch()
     }
 }
 
+void MainController::runOdometry()
+{
+    VisualOdometry odometry(depth, icp, fastOdom, so3);
+
+    odometry.setLatencyBudget(odometryBudget);
+    odometry.setKeyframeDistance(keyframeDistance);
+
+    while(!pangolin::ShouldQuit() && logReader->hasMore() && odometry.getTick() < end)
+    {
+        if(!gui->pause->Get() || pangolin::Pushed(*gui->step))
+        {
+            logReader->getNext();
+
+            odometry.processFrame(logReader->rgb, logReader->depth, logReader->timestamp);
+        }
+
+        gui->preCall();
+
+        std::stringstream stri;
+        stri << odometry.getOdometry().lastICPCount;
+        gui->trackInliers->Ref().Set(stri.str());
+
+        std::stringstream stre;
+        stre << (std::isnan(odometry.getOdometry().lastICPError) ? 0 : odometry.getOdometry().lastICPError);
+        gui->trackRes->Ref().Set(stre.str());
+
+        gui->drawFrustum(odometry.getCurrPose());
+
+        gui->postCall();
+    }
+
+    std::cout << odometry.getTick() << " frames, " << odometry.getOverruns() << " over budget" << std::endl;
+
+    odometry.saveTrajectory(output_filename + ".freiburg", iclnuim);
+}
+
 void MainController::run()
 {
     while(!pangolin::ShouldQuit() && !((!logReader->hasMore()) && quiet) && !(eFusion->getTick() == end && quiet))
@@ -290,6 +501,16 @@ void MainController::run()
                     delete currentPose;
                 }
 
+                if(checkpointRate > 0 && eFusion->getTick() % checkpointRate == 0)
+                {
+                    eFusion->saveCheckpoint(output_filename + ".ckpt");
+                }
+
+                if(journalRate > 0 && eFusion->getTick() % journalRate == 0)
+                {
+                    eFusion->appendJournal(output_filename + ".journal");
+                }
+
                 if(frameskip && Stopwatch::getInstance().getTimings().at("Run") > 1000.f / 30.f)
                 {
                     framesToSkip = int(Stopwatch::getInstance().getTimings().at("Run") / (1000.f / 30.f));
@@ -509,6 +730,11 @@ void MainController::run()
 
         gui->totalPoints->operator=(strs.str());
 
+        std::stringstream strsEvicted;
+        strsEvicted << eFusion->getGlobalModel().getBudgetStats().evicted;
+
+        gui->totalEvicted->operator=(strsEvicted.str());
+
         std::stringstream strs2;
         strs2 << eFusion->getLocalDeformation().getGraph().size();
 
@@ -534,6 +760,13 @@ void MainController::run()
 
         gui->totalFernDefs->operator=(strs6.str());
 
+        const FrameGovernor::Stats & governorStats = eFusion->getGovernor().getStats();
+
+        std::stringstream strs7;
+        strs7 << FrameGovernor::levelName(governorStats.level) << " (" << governorStats.overruns << " over)";
+
+        gui->degradation->operator=(strs7.str());
+
         gui->postCall();
 
         logReader->flipColors = gui->flipColors->Get();
@@ -17,11 +17,16 @@
  */
 
 #include <ElasticFusion.h>
+#include <VisualOdometry.h>
 #include <Utils/Parse.h>
+#include <Utils/ThreadPool.h>
 
 #include "Tools/GUI.h"
 #include "Tools/GroundTruthOdometry.h"
 #include "Tools/RawLogReader.h"
+#include "Tools/ChunkedLogReader.h"
+#include "Tools/TUMLogReader.h"
+#include "Tools/SyntheticLogReader.h"
 #include "Tools/LiveLogReader.h"
 
 #ifndef MAINCONTROLLER_H_
@@ -38,6 +43,8 @@ class MainController
     private:
         void run();
 
+        void runOdometry();
+
         void loadCalibration(const std::string & filename);
 
         bool good;
@@ -50,6 +57,10 @@ class MainController
         std::string logFile;
         std::string poseFile;
         std::string output_filename;
+        std::string resumeFile;
+        std::string publisherName;
+        std::string priorMapFile;
+        std::string pageFile;
 
         float confidence,
               depth,
@@ -57,12 +68,20 @@ class MainController
               icpErrThresh,
               covThresh,
               photoThresh,
-              fernThresh;
+              fernThresh,
+              odometryBudget,
+              keyframeDistance,
+              pageBlockSize,
+              pageDistance,
+              frameDeadline;
 
         int timeDelta,
             icpCountThresh,
             start,
-            end;
+            end,
+            checkpointRate,
+            journalRate,
+            surfelBudget;
 
         bool fillIn,
              openLoop,
@@ -72,7 +91,10 @@ class MainController
              fastOdom,
              so3,
              rewind,
-             frameToFrameRGB;
+             frameToFrameRGB,
+             backgroundLoops,
+             asyncReloc,
+             odometryOnly;
 
         int framesToSkip;
         bool streaming;
@@ -0,0 +1,109 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include <ElasticFusion.h>
+#include <Utils/AllocationCounter.h>
+#include <Utils/Resolution.h>
+#include <Utils/Intrinsics.h>
+
+#include "../Tools/SyntheticLogReader.h"
+
+#include <pangolin/pangolin.h>
+
+#include <cstdio>
+
+/*
+ * Runs the synthetic room through ElasticFusion and checks processFrame leaves the heap alone once it's warmed up.
+ * Frames where the fern database, pose graph or a deformation grew are let off, they're meant to allocate.
+ * Needs a GL context and a build with COUNT_ALLOCATIONS, otherwise there's nothing to check and it passes.
+ */
+
+int main()
+{
+    if(!AllocationCounter::enabled())
+    {
+        printf("Built without COUNT_ALLOCATIONS, skipping\n");
+        return 0;
+    }
+
+    const int warmup = 30;
+
+    SyntheticScene::Config config;
+    config.numFrames = 300;
+
+    Resolution::getInstance(config.width, config.height);
+    Intrinsics::getInstance(config.fx, config.fy, config.cx, config.cy);
+
+    pangolin::Params windowParams;
+
+    windowParams.Set("SAMPLE_BUFFERS", 0);
+    windowParams.Set("SAMPLES", 0);
+    windowParams.Set("scheme", "headless");
+
+    pangolin::CreateWindowAndBind("AllocationTest", config.width, config.height, windowParams);
+
+    SyntheticLogReader logReader(config, false);
+
+    ElasticFusion * eFusion = new ElasticFusion(200, 35000, 5e-05, 1e-05, true, false, false, 115, 10, 3, 10, false, 0.3095f, true, false, "AllocationTest");
+
+    int failures = 0;
+    int excused = 0;
+
+    for(int i = 0; logReader.hasMore(); i++)
+    {
+        logReader.getNext();
+
+        const size_t ferns = eFusion->getFerns().frames.size();
+        const size_t poseCapacity = eFusion->getPoseGraph().capacity();
+        const size_t timesCapacity = eFusion->getPoseLogTimes().capacity();
+        const int deforms = eFusion->getDeforms();
+        const int fernDeforms = eFusion->getFernDeforms();
+
+        eFusion->processFrame(logReader.rgb, logReader.depth, logReader.timestamp);
+
+        const unsigned long long int allocations = eFusion->getFrameAllocations();
+        const unsigned long long int frees = eFusion->getFrameFrees();
+
+        if(i < warmup || (allocations == 0 && frees == 0))
+        {
+            continue;
+        }
+
+        const bool grew = ferns != eFusion->getFerns().frames.size() ||
+                          poseCapacity != eFusion->getPoseGraph().capacity() ||
+                          timesCapacity != eFusion->getPoseLogTimes().capacity() ||
+                          deforms != eFusion->getDeforms() ||
+                          fernDeforms != eFusion->getFernDeforms();
+
+        if(grew)
+        {
+            excused++;
+        }
+        else
+        {
+            printf("FAILED frame %d: %llu allocations, %llu frees\n", i, allocations, frees);
+            failures++;
+        }
+    }
+
+    delete eFusion;
+
+    printf("%d frames allocated outside fern, pose graph and deformation growth, %d more inside it\n", failures, excused);
+
+    return failures > 0;
+}
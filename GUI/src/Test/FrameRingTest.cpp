@@ -0,0 +1,161 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "../Tools/FrameRing.h"
+
+#include <cstdio>
+#include <thread>
+#include <atomic>
+
+/*
+ * Runs a synthetic camera thread against a consumer that sometimes stalls, so frames are both skipped and dropped.
+ * Every frame is filled from its sequence number, a torn or reused slot shows up as a mismatch. Build with
+ * -fsanitize=thread to check the ordering too.
+ */
+
+static const int WIDTH = 64;
+static const int HEIGHT = 48;
+static const int NUM_PIXELS = WIDTH * HEIGHT;
+
+static bool intact(const FrameRing::Frame * frame)
+{
+    const uint16_t d = (uint16_t)frame->timestamp;
+    const uint8_t c = (uint8_t)frame->timestamp;
+
+    for(int i = 0; i < NUM_PIXELS; i++)
+    {
+        if(frame->depth[i] != d || frame->rgb[i * 3] != c || frame->rgb[i * 3 + 2] != c)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    const int numFrames = 20000;
+
+    FrameRing ring(WIDTH, HEIGHT, 4);
+
+    std::atomic<unsigned long long int> tapped(0);
+
+    ring.setTap([&](const FrameRing::Frame & frame)
+    {
+        tapped++;
+    });
+
+    std::thread producer([&]()
+    {
+        for(int i = 1; i <= numFrames; i++)
+        {
+            FrameRing::Frame * slot = ring.claim();
+
+            if(!slot)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            for(int j = 0; j < NUM_PIXELS; j++)
+            {
+                slot->depth[j] = (uint16_t)i;
+                slot->rgb[j * 3] = slot->rgb[j * 3 + 1] = slot->rgb[j * 3 + 2] = (uint8_t)i;
+            }
+
+            slot->timestamp = i;
+
+            ring.publish();
+        }
+    });
+
+    int failures = 0;
+    unsigned long long int acquired = 0;
+    int64_t last = 0;
+
+    while(last < numFrames)
+    {
+        if(!ring.wait(1000000))
+        {
+            //Whatever the producer dropped last never comes
+            if(ring.getStats().produced + ring.getStats().dropped >= (unsigned long long int)numFrames)
+            {
+                break;
+            }
+
+            printf("FAILED timed out after frame %lld\n", (long long int)last);
+            failures++;
+            break;
+        }
+
+        FrameRing::Frame * frame = ring.acquire();
+
+        if(!frame)
+        {
+            printf("FAILED wait returned but nothing to acquire\n");
+            failures++;
+            break;
+        }
+
+        acquired++;
+
+        if(frame->timestamp <= last)
+        {
+            printf("FAILED frame %lld after %lld\n", (long long int)frame->timestamp, (long long int)last);
+            failures++;
+        }
+
+        last = frame->timestamp;
+
+        //Stall now and then, like a slow frame of tracking, with the slot still held
+        if(acquired % 97 == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+
+        if(!intact(frame))
+        {
+            printf("FAILED frame %lld was overwritten while held\n", (long long int)frame->timestamp);
+            failures++;
+        }
+    }
+
+    producer.join();
+
+    //Pick up anything published after the loop gave up waiting
+    if(ring.acquire())
+    {
+        acquired++;
+    }
+
+    const FrameRing::Stats stats = ring.getStats();
+
+    if(stats.produced + stats.dropped != (unsigned long long int)numFrames ||
+       stats.produced != acquired + stats.skipped ||
+       tapped != stats.produced)
+    {
+        printf("FAILED %llu produced, %llu dropped, %llu skipped, %llu acquired, %llu tapped of %d\n",
+               stats.produced, stats.dropped, stats.skipped, acquired, tapped.load(), numFrames);
+        failures++;
+    }
+
+    printf("%s\n", failures ? "FrameRingTest failed" : "FrameRingTest passed");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "../Tools/RVLCodec.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/*
+ * Round trips depth through RVLCodec, including the frames that cost the most to code. Build with
+ * -fsanitize=address to catch compress writing past bound().
+ */
+
+static int failures = 0;
+
+static void check(const std::string & name, const std::vector<uint16_t> & depth)
+{
+    std::vector<unsigned char> compressed;
+
+    RVLCodec::compress(depth.data(), depth.size(), compressed);
+
+    std::vector<uint16_t> decompressed(depth.size() + 1, 0xbeef);
+
+    const bool decoded = RVLCodec::decompress(compressed.data(), compressed.size(), depth.size(), decompressed.data());
+    const bool fits = (int)compressed.size() <= RVLCodec::bound(depth.size());
+    const bool same = std::equal(depth.begin(), depth.end(), decompressed.begin()) && decompressed.back() == 0xbeef;
+
+    if(!decoded || !fits || !same)
+    {
+        printf("FAILED %s: decoded %d, %d bytes (bound %d), same %d\n", name.c_str(), decoded, (int)compressed.size(), RVLCodec::bound(depth.size()), same);
+        failures++;
+    }
+}
+
+int main()
+{
+    const int numPixels = 640 * 480;
+
+    std::vector<uint16_t> depth(numPixels);
+
+    for(int i = 0; i < numPixels; i++)
+    {
+        depth[i] = i % 2 ? 65535 : 1;
+    }
+
+    check("alternating 1/65535", depth);
+
+    srand(1);
+
+    for(int i = 0; i < numPixels; i++)
+    {
+        depth[i] = rand() & 0xffff;
+    }
+
+    check("uniform random", depth);
+
+    for(int i = 0; i < numPixels; i++)
+    {
+        depth[i] = i % 2 ? 0 : (i % 4 ? 65535 : 1);
+    }
+
+    check("alternating 0/1/0/65535", depth);
+
+    for(int i = 0; i < numPixels; i++)
+    {
+        depth[i] = (i / 3) % 2 ? 0 : 500 + (i % 640);
+    }
+
+    check("short runs", depth);
+
+    check("all zero", std::vector<uint16_t>(numPixels, 0));
+    check("all valid", std::vector<uint16_t>(numPixels, 1234));
+
+    for(int size = 0; size < 40; size++)
+    {
+        std::vector<uint16_t> small(size);
+
+        for(int i = 0; i < size; i++)
+        {
+            small[i] = rand() % 3 ? rand() & 0xffff : 0;
+        }
+
+        check("small " + std::to_string(size), small);
+    }
+
+    printf("%s\n", failures ? "RVLCodecTest failed" : "RVLCodecTest passed");
+
+    return failures ? 1 : 0;
+}
@@ -5,7 +5,10 @@
 #include <algorithm>
 #include <map>
 
+#include <memory>
+
 #include "ThreadMutexObject.h"
+#include "FrameRing.h"
 
 class CameraInterface
 {
@@ -16,9 +19,16 @@ class CameraInterface
       virtual std::string error() = 0;
 
       static const int numBuffers = 10;
-      ThreadMutexObject<int> latestDepthIndex;
-      std::pair<std::pair<uint8_t *,uint8_t *>,int64_t> frameBuffers[numBuffers];
+
+      //Depth frames paired with the latest colour frame, set up by the camera once it's running
+      std::unique_ptr<FrameRing> frames;
 
       virtual void setAutoExposure(bool value) = 0;
       virtual void setAutoWhiteBalance(bool value) = 0;
+
+      //Only a camera replaying a recording ever runs out of frames
+      virtual bool finished()
+      {
+          return false;
+      }
 };
@@ -0,0 +1,94 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef CHANNELSWAP_H_
+#define CHANNELSWAP_H_
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#endif
+
+/**
+ * Swaps red and blue in packed 8-bit RGB, src and dst can be the same buffer
+ */
+class ChannelSwap
+{
+    public:
+        static void swapRedBlue(const unsigned char * src, unsigned char * dst, const int numPixels)
+        {
+            int i = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+            //16 pixels at a time as three registers, each byte either stays or comes from two either side of it
+            const __m128i keep[3] = {mask(1), mask(0), mask(2)};
+            const __m128i fromNext[3] = {mask(0), mask(2), mask(1)};
+            const __m128i fromPrev[3] = {mask(2), mask(1), mask(0)};
+
+            for(; i + 16 <= numPixels; i += 16)
+            {
+                const __m128i a = _mm_loadu_si128((const __m128i *)(src + i * 3));
+                const __m128i b = _mm_loadu_si128((const __m128i *)(src + i * 3 + 16));
+                const __m128i c = _mm_loadu_si128((const __m128i *)(src + i * 3 + 32));
+
+                const __m128i nextA = _mm_or_si128(_mm_srli_si128(a, 2), _mm_slli_si128(b, 14));
+                const __m128i nextB = _mm_or_si128(_mm_srli_si128(b, 2), _mm_slli_si128(c, 14));
+                const __m128i nextC = _mm_srli_si128(c, 2);
+
+                const __m128i prevA = _mm_slli_si128(a, 2);
+                const __m128i prevB = _mm_or_si128(_mm_slli_si128(b, 2), _mm_srli_si128(a, 14));
+                const __m128i prevC = _mm_or_si128(_mm_slli_si128(c, 2), _mm_srli_si128(b, 14));
+
+                _mm_storeu_si128((__m128i *)(dst + i * 3), blend(a, nextA, prevA, keep[0], fromNext[0], fromPrev[0]));
+                _mm_storeu_si128((__m128i *)(dst + i * 3 + 16), blend(b, nextB, prevB, keep[1], fromNext[1], fromPrev[1]));
+                _mm_storeu_si128((__m128i *)(dst + i * 3 + 32), blend(c, nextC, prevC, keep[2], fromNext[2], fromPrev[2]));
+            }
+#endif
+
+            for(; i < numPixels; i++)
+            {
+                const unsigned char r = src[i * 3 + 0];
+                dst[i * 3 + 1] = src[i * 3 + 1];
+                dst[i * 3 + 0] = src[i * 3 + 2];
+                dst[i * 3 + 2] = r;
+            }
+        }
+
+    private:
+#if defined(__SSE2__) || defined(_M_X64)
+        //Selects the bytes of a register starting at the given channel
+        static __m128i mask(const int channel)
+        {
+            alignas(16) unsigned char bytes[16];
+
+            for(int j = 0; j < 16; j++)
+            {
+                bytes[j] = (j + 3 - channel) % 3 == 0 ? 0xFF : 0;
+            }
+
+            return _mm_load_si128((const __m128i *)bytes);
+        }
+
+        static __m128i blend(const __m128i & x, const __m128i & next, const __m128i & prev,
+                             const __m128i & keep, const __m128i & fromNext, const __m128i & fromPrev)
+        {
+            return _mm_or_si128(_mm_and_si128(x, keep), _mm_or_si128(_mm_and_si128(next, fromNext), _mm_and_si128(prev, fromPrev)));
+        }
+#endif
+};
+
+#endif /* CHANNELSWAP_H_ */
@@ -0,0 +1,501 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "ChunkedLog.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "JPEGLoader.h"
+#include "RVLCodec.h"
+
+#ifdef WITH_LZ4
+#  include <lz4.h>
+#endif
+#ifdef WITH_ZSTD
+#  include <zstd.h>
+#endif
+
+const uint32_t ChunkedLog::MAGIC;
+const uint32_t ChunkedLog::CHUNK_MAGIC;
+const uint32_t ChunkedLog::FOOTER_MAGIC;
+const uint32_t ChunkedLog::VERSION;
+
+//Neighbouring depths are close, so the deltas are mostly small and their high bytes mostly 0 or 255
+static void splitDepth(const unsigned short * depth, const int numPixels, unsigned char * planes)
+{
+    unsigned short last = 0;
+
+    for(int i = 0; i < numPixels; i++)
+    {
+        const unsigned short delta = depth[i] - last;
+        last = depth[i];
+
+        planes[i] = delta & 0xff;
+        planes[numPixels + i] = delta >> 8;
+    }
+}
+
+static void joinDepth(const unsigned char * planes, const int numPixels, unsigned short * depth)
+{
+    unsigned short last = 0;
+
+    for(int i = 0; i < numPixels; i++)
+    {
+        last += planes[i] | (planes[numPixels + i] << 8);
+        depth[i] = last;
+    }
+}
+
+bool ChunkedLog::supported(const uint32_t depthCodec)
+{
+    switch(depthCodec)
+    {
+        case DEPTH_RAW:
+        case DEPTH_ZLIB:
+        case DEPTH_RVL:
+            return true;
+#ifdef WITH_LZ4
+        case DEPTH_LZ4:
+            return true;
+#endif
+#ifdef WITH_ZSTD
+        case DEPTH_ZSTD:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+uint32_t ChunkedLog::bestDepthCodec()
+{
+    if(supported(DEPTH_LZ4))
+    {
+        return DEPTH_LZ4;
+    }
+    else if(supported(DEPTH_ZSTD))
+    {
+        return DEPTH_ZSTD;
+    }
+
+    return DEPTH_RVL;
+}
+
+const char * ChunkedLog::depthCodecName(const uint32_t depthCodec)
+{
+    switch(depthCodec)
+    {
+        case DEPTH_RAW:
+            return "raw";
+        case DEPTH_ZLIB:
+            return "zlib";
+        case DEPTH_LZ4:
+            return "lz4";
+        case DEPTH_ZSTD:
+            return "zstd";
+        case DEPTH_RVL:
+            return "rvl";
+        default:
+            return "unknown";
+    }
+}
+
+bool ChunkedLog::encodeDepth(const uint32_t codec,
+                             const unsigned short * depth,
+                             const int numPixels,
+                             std::vector<unsigned char> & scratch,
+                             std::vector<unsigned char> & out)
+{
+    const int rawSize = numPixels * sizeof(unsigned short);
+
+    switch(codec)
+    {
+        case DEPTH_RAW:
+        {
+            out.resize(rawSize);
+            memcpy(out.data(), depth, rawSize);
+            return true;
+        }
+        case DEPTH_ZLIB:
+        {
+            uLongf size = compressBound(rawSize);
+            out.resize(size);
+
+            if(compress2(out.data(), &size, (const Bytef *)depth, rawSize, Z_BEST_SPEED) != Z_OK)
+            {
+                return false;
+            }
+
+            out.resize(size);
+            return true;
+        }
+#ifdef WITH_LZ4
+        case DEPTH_LZ4:
+        {
+            scratch.resize(rawSize);
+            splitDepth(depth, numPixels, scratch.data());
+
+            out.resize(LZ4_compressBound(rawSize));
+
+            const int size = LZ4_compress_default((const char *)scratch.data(), (char *)out.data(), rawSize, out.size());
+
+            out.resize(size);
+            return size > 0;
+        }
+#endif
+#ifdef WITH_ZSTD
+        case DEPTH_ZSTD:
+        {
+            scratch.resize(rawSize);
+            splitDepth(depth, numPixels, scratch.data());
+
+            out.resize(ZSTD_compressBound(rawSize));
+
+            const size_t size = ZSTD_compress(out.data(), out.size(), scratch.data(), rawSize, 1);
+
+            if(ZSTD_isError(size))
+            {
+                return false;
+            }
+
+            out.resize(size);
+            return true;
+        }
+#endif
+        case DEPTH_RVL:
+        {
+            RVLCodec::compress(depth, numPixels, out);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool ChunkedLog::decodeDepth(const uint32_t codec,
+                             const unsigned char * data,
+                             const int size,
+                             const int numPixels,
+                             std::vector<unsigned char> & scratch,
+                             unsigned short * depth)
+{
+    const int rawSize = numPixels * sizeof(unsigned short);
+
+    switch(codec)
+    {
+        case DEPTH_RAW:
+        {
+            if(size != rawSize)
+            {
+                return false;
+            }
+
+            memcpy(depth, data, rawSize);
+            return true;
+        }
+        case DEPTH_ZLIB:
+        {
+            uLongf decompLength = rawSize;
+            return uncompress((Bytef *)depth, &decompLength, data, size) == Z_OK && (int)decompLength == rawSize;
+        }
+#ifdef WITH_LZ4
+        case DEPTH_LZ4:
+        {
+            scratch.resize(rawSize);
+
+            if(LZ4_decompress_safe((const char *)data, (char *)scratch.data(), size, rawSize) != rawSize)
+            {
+                return false;
+            }
+
+            joinDepth(scratch.data(), numPixels, depth);
+            return true;
+        }
+#endif
+#ifdef WITH_ZSTD
+        case DEPTH_ZSTD:
+        {
+            scratch.resize(rawSize);
+
+            if(ZSTD_decompress(scratch.data(), rawSize, data, size) != (size_t)rawSize)
+            {
+                return false;
+            }
+
+            joinDepth(scratch.data(), numPixels, depth);
+            return true;
+        }
+#endif
+        case DEPTH_RVL:
+        {
+            return RVLCodec::decompress(data, size, numPixels, depth);
+        }
+        default:
+            return false;
+    }
+}
+
+bool ChunkedLog::readHeader(const std::string & filename, Header & header)
+{
+    FILE * fp = fopen(filename.c_str(), "rb");
+
+    if(!fp)
+    {
+        return false;
+    }
+
+    const bool read = fread(&header, sizeof(Header), 1, fp) == 1;
+
+    fclose(fp);
+
+    return read && header.magic == MAGIC && header.version == VERSION;
+}
+
+ChunkedLogWriter::ChunkedLogWriter(const std::string & filename, const ChunkedLog::Header & header)
+ : fp(fopen(filename.c_str(), "wb")),
+   header(header),
+   failed(fp == 0),
+   finished(false),
+   numFrames(0)
+{
+    this->header.magic = ChunkedLog::MAGIC;
+    this->header.version = ChunkedLog::VERSION;
+    this->header.framesPerChunk = std::max(this->header.framesPerChunk, 1u);
+
+    if(fp)
+    {
+        failed |= fwrite(&this->header, sizeof(ChunkedLog::Header), 1, fp) != 1;
+    }
+
+    frames.reserve(this->header.framesPerChunk);
+}
+
+ChunkedLogWriter::~ChunkedLogWriter()
+{
+    if(!finished)
+    {
+        finish();
+    }
+}
+
+bool ChunkedLogWriter::isOpen()
+{
+    return fp != 0;
+}
+
+bool ChunkedLogWriter::addFrame(const int64_t timestamp, const unsigned short * depth, const unsigned char * rgb)
+{
+    const int numPixels = header.width * header.height;
+
+    if(!ChunkedLog::encodeDepth(header.depthCodec, depth, numPixels, scratch, encodedDepth))
+    {
+        failed = true;
+        return false;
+    }
+
+    if(header.imageCodec == ChunkedLog::IMAGE_JPEG)
+    {
+        jpeg.writeData(rgb, header.width, header.height, encodedImage);
+    }
+    else
+    {
+        encodedImage.assign(rgb, rgb + numPixels * 3);
+    }
+
+    return addEncodedFrame(timestamp, encodedDepth.data(), encodedDepth.size(), encodedImage.data(), encodedImage.size());
+}
+
+bool ChunkedLogWriter::addEncodedFrame(const int64_t timestamp,
+                                       const unsigned char * depth,
+                                       const uint32_t depthSize,
+                                       const unsigned char * image,
+                                       const uint32_t imageSize)
+{
+    if(!fp || finished)
+    {
+        return false;
+    }
+
+    ChunkedLog::FrameEntry entry;
+    entry.timestamp = timestamp;
+    entry.depthSize = depthSize;
+    entry.imageSize = imageSize;
+
+    frames.push_back(entry);
+    payload.insert(payload.end(), depth, depth + depthSize);
+    payload.insert(payload.end(), image, image + imageSize);
+
+    if(frames.size() == header.framesPerChunk)
+    {
+        writeChunk();
+    }
+
+    return !failed;
+}
+
+void ChunkedLogWriter::writeChunk()
+{
+    if(frames.empty())
+    {
+        return;
+    }
+
+    ChunkedLog::IndexEntry entry;
+    entry.offset = ftell(fp);
+    entry.firstFrame = numFrames;
+    entry.numFrames = frames.size();
+
+    ChunkedLog::ChunkHeader chunk;
+    chunk.magic = ChunkedLog::CHUNK_MAGIC;
+    chunk.numFrames = frames.size();
+    chunk.size = frames.size() * sizeof(ChunkedLog::FrameEntry) + payload.size();
+
+    failed |= fwrite(&chunk, sizeof(ChunkedLog::ChunkHeader), 1, fp) != 1;
+    failed |= fwrite(frames.data(), sizeof(ChunkedLog::FrameEntry), frames.size(), fp) != frames.size();
+    failed |= payload.size() && fwrite(payload.data(), payload.size(), 1, fp) != 1;
+
+    index.push_back(entry);
+    numFrames += frames.size();
+
+    frames.clear();
+    payload.clear();
+}
+
+bool ChunkedLogWriter::finish()
+{
+    if(finished)
+    {
+        return !failed;
+    }
+
+    finished = true;
+
+    if(!fp)
+    {
+        return false;
+    }
+
+    writeChunk();
+
+    ChunkedLog::Footer footer;
+    footer.indexOffset = ftell(fp);
+    footer.numChunks = index.size();
+    footer.numFrames = numFrames;
+    footer.magic = ChunkedLog::FOOTER_MAGIC;
+    footer.padding = 0;
+
+    failed |= index.size() && fwrite(index.data(), sizeof(ChunkedLog::IndexEntry), index.size(), fp) != index.size();
+    failed |= fwrite(&footer, sizeof(ChunkedLog::Footer), 1, fp) != 1;
+    failed |= fclose(fp) != 0;
+
+    fp = 0;
+
+    return !failed;
+}
+
+bool ChunkedLogWriter::convert(const std::string & klgFile, const std::string & filename, const ChunkedLog::Header & header)
+{
+    FILE * in = fopen(klgFile.c_str(), "rb");
+
+    if(!in)
+    {
+        return false;
+    }
+
+    const int numPixels = header.width * header.height;
+
+    int32_t numFrames = 0;
+    bool good = fread(&numFrames, sizeof(int32_t), 1, in) == 1;
+
+    ChunkedLogWriter writer(filename, header);
+
+    good = good && writer.isOpen();
+
+    std::vector<unsigned char> depthIn, imageIn, scratch, depthOut, imageOut;
+    std::vector<unsigned short> depth(numPixels);
+    std::vector<unsigned char> rgb(numPixels * 3);
+
+    JPEGLoader jpegIn;
+    JPEGWriter jpegOut;
+
+    for(int i = 0; i < numFrames && good; i++)
+    {
+        int64_t timestamp;
+        int32_t depthSize, imageSize;
+
+        good = fread(&timestamp, sizeof(int64_t), 1, in) == 1 &&
+               fread(&depthSize, sizeof(int32_t), 1, in) == 1 &&
+               fread(&imageSize, sizeof(int32_t), 1, in) == 1;
+
+        //Same limits as RawLogReader's buffers, .klg never stores anything bigger than raw
+        good = depthSize > 0 && depthSize <= numPixels * 2 && imageSize >= 0 && imageSize <= numPixels * 3;
+
+        if(!good)
+        {
+            break;
+        }
+
+        depthIn.resize(depthSize);
+        imageIn.resize(imageSize);
+
+        good = fread(depthIn.data(), depthSize, 1, in) == 1 && (imageSize == 0 || fread(imageIn.data(), imageSize, 1, in) == 1);
+
+        if(!good)
+        {
+            break;
+        }
+
+        //.klg depth is zlib unless it didn't compress
+        const bool klgRaw = depthSize == numPixels * 2;
+
+        if(header.depthCodec == (klgRaw ? ChunkedLog::DEPTH_RAW : ChunkedLog::DEPTH_ZLIB))
+        {
+            depthOut.swap(depthIn);
+        }
+        else
+        {
+            good = ChunkedLog::decodeDepth(klgRaw ? ChunkedLog::DEPTH_RAW : ChunkedLog::DEPTH_ZLIB,
+                                           depthIn.data(), depthSize, numPixels, scratch, depth.data()) &&
+                   ChunkedLog::encodeDepth(header.depthCodec, depth.data(), numPixels, scratch, depthOut);
+        }
+
+        //Likewise colour is JPEG unless it's raw, or missing
+        const uint32_t imageCodec = imageSize == numPixels * 3 ? ChunkedLog::IMAGE_RAW : ChunkedLog::IMAGE_JPEG;
+
+        if(imageSize == 0 || imageCodec == header.imageCodec)
+        {
+            imageOut.swap(imageIn);
+        }
+        else if(header.imageCodec == ChunkedLog::IMAGE_JPEG)
+        {
+            jpegOut.writeData(imageIn.data(), header.width, header.height, imageOut);
+        }
+        else
+        {
+            jpegIn.readData(imageIn.data(), imageSize, rgb.data());
+            imageOut.assign(rgb.begin(), rgb.end());
+        }
+
+        good = good && writer.addEncodedFrame(timestamp, depthOut.data(), depthOut.size(), imageOut.data(), imageOut.size());
+    }
+
+    fclose(in);
+
+    return writer.finish() && good;
+}
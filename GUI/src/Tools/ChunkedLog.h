@@ -0,0 +1,221 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef CHUNKEDLOG_H_
+#define CHUNKEDLOG_H_
+
+#if (defined WIN32) && (defined FAR)
+#  undef FAR
+#endif
+#include <zlib.h>
+#include <stdio.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "JPEGWriter.h"
+
+/**
+ * Log format that's quicker to read back than .klg. A header with the resolution, intrinsics and which codec
+ * each stream uses, then the frames in chunks, then an index of the chunks and a footer pointing at it:
+ *
+ * Header
+ * Chunk: ChunkHeader, a FrameEntry per frame, then each frame's depth and colour
+ * ...
+ * IndexEntry per chunk
+ * Footer
+ *
+ * A chunk is read with one call and the index allows seeking. If the footer is missing (the log was cut short)
+ * the chunks can still be found by walking them from the start.
+ */
+class ChunkedLog
+{
+    public:
+        enum DepthCodec
+        {
+            DEPTH_RAW = 0,
+            DEPTH_ZLIB = 1,
+
+            //Delta coded and split into byte planes before compression
+            DEPTH_LZ4 = 2,
+            DEPTH_ZSTD = 3,
+
+            //See RVLCodec
+            DEPTH_RVL = 4
+        };
+
+        enum ImageCodec
+        {
+            IMAGE_RAW = 0,
+
+            //As in .klg, see JPEGWriter
+            IMAGE_JPEG = 1
+        };
+
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            int32_t width;
+            int32_t height;
+            float fx, fy, cx, cy;
+            uint32_t depthCodec;
+            uint32_t imageCodec;
+
+            //Metres per depth unit
+            float depthScale;
+            uint32_t framesPerChunk;
+        };
+
+        struct ChunkHeader
+        {
+            uint32_t magic;
+            uint32_t numFrames;
+
+            //Everything after the chunk header
+            uint64_t size;
+        };
+
+        struct FrameEntry
+        {
+            int64_t timestamp;
+            uint32_t depthSize;
+            uint32_t imageSize;
+        };
+
+        struct IndexEntry
+        {
+            uint64_t offset;
+            uint32_t firstFrame;
+            uint32_t numFrames;
+        };
+
+        struct Footer
+        {
+            uint64_t indexOffset;
+            uint32_t numChunks;
+            uint32_t numFrames;
+            uint32_t magic;
+            uint32_t padding;
+        };
+
+        static const uint32_t MAGIC = 0x474c4645; //"EFLG"
+        static const uint32_t CHUNK_MAGIC = 0x4b4e4843; //"CHNK"
+        static const uint32_t FOOTER_MAGIC = 0x58444e49; //"INDX"
+        static const uint32_t VERSION = 1;
+
+        /**
+         * Whether this build can read and write a depth codec
+         */
+        static bool supported(const uint32_t depthCodec);
+
+        /**
+         * The compressed depth codec to use by default, the fastest to decode this build has
+         */
+        static uint32_t bestDepthCodec();
+
+        static const char * depthCodecName(const uint32_t depthCodec);
+
+        /**
+         * @param scratch reused between calls to avoid allocating
+         */
+        static bool encodeDepth(const uint32_t codec,
+                                const unsigned short * depth,
+                                const int numPixels,
+                                std::vector<unsigned char> & scratch,
+                                std::vector<unsigned char> & out);
+
+        /**
+         * Inverse of encodeDepth, depth must have room for numPixels
+         */
+        static bool decodeDepth(const uint32_t codec,
+                                const unsigned char * data,
+                                const int size,
+                                const int numPixels,
+                                std::vector<unsigned char> & scratch,
+                                unsigned short * depth);
+
+        /**
+         * Reads and checks the header of a log
+         * @return false if it isn't one of ours
+         */
+        static bool readHeader(const std::string & filename, Header & header);
+};
+
+class ChunkedLogWriter
+{
+    public:
+        /**
+         * @param header resolution, intrinsics, codecs and chunk size, the rest is filled in here
+         */
+        ChunkedLogWriter(const std::string & filename, const ChunkedLog::Header & header);
+
+        /**
+         * Calls finish if it hasn't been
+         */
+        virtual ~ChunkedLogWriter();
+
+        bool isOpen();
+
+        /**
+         * Encodes a frame with the header's codecs and appends it
+         */
+        bool addFrame(const int64_t timestamp, const unsigned short * depth, const unsigned char * rgb);
+
+        /**
+         * Appends a frame that's already encoded with the header's codecs
+         */
+        bool addEncodedFrame(const int64_t timestamp,
+                             const unsigned char * depth,
+                             const uint32_t depthSize,
+                             const unsigned char * image,
+                             const uint32_t imageSize);
+
+        /**
+         * Writes the last chunk, the index and footer and closes the file
+         * @return false if anything failed to write
+         */
+        bool finish();
+
+        /**
+         * Converts a .klg log, depth is re-encoded with the header's depth codec (unless that's zlib, which .klg
+         * already is) and colour is copied across if it's already in the header's image codec
+         * @param header resolution, intrinsics, codecs and chunk size of the new log, .klg logs have none of them
+         */
+        static bool convert(const std::string & klgFile, const std::string & filename, const ChunkedLog::Header & header);
+
+    private:
+        void writeChunk();
+
+        FILE * fp;
+        ChunkedLog::Header header;
+        bool failed;
+        bool finished;
+
+        uint32_t numFrames;
+        std::vector<ChunkedLog::FrameEntry> frames;
+        std::vector<unsigned char> payload;
+        std::vector<ChunkedLog::IndexEntry> index;
+
+        std::vector<unsigned char> scratch;
+        std::vector<unsigned char> encodedDepth;
+        std::vector<unsigned char> encodedImage;
+        JPEGWriter jpeg;
+};
+
+#endif /* CHUNKEDLOG_H_ */
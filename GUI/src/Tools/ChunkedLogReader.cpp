@@ -0,0 +1,309 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "ChunkedLogReader.h"
+
+#include <algorithm>
+
+ChunkedLogReader::ChunkedLogReader(std::string file, bool flipColors)
+ : LogReader(file, flipColors),
+   framesRead(0),
+   loadedChunk(-1)
+{
+    fp = fopen(file.c_str(), "rb");
+
+    assert(fp);
+
+    auto tmp = fread(&header, sizeof(ChunkedLog::Header), 1, fp);
+    assert(tmp && header.magic == ChunkedLog::MAGIC && header.version == ChunkedLog::VERSION);
+
+    assert(header.width == width && header.height == height && "Log doesn't match the resolution");
+
+    fseek(fp, 0, SEEK_END);
+    fileSize = ftell(fp);
+
+    if(!ChunkedLog::supported(header.depthCodec))
+    {
+        std::cout << "Built without " << ChunkedLog::depthCodecName(header.depthCodec) << " support, can't read " << file << std::endl;
+    }
+
+    if(!readIndex())
+    {
+        std::cout << "No index in " << file << ", scanning... "; std::cout.flush();
+        scanChunks();
+        std::cout << "done" << std::endl;
+    }
+
+    numFrames = index.size() ? index.back().firstFrame + index.back().numFrames : 0;
+    currentFrame = 0;
+
+    decompressionBufferDepth = new Bytef[numPixels * 2];
+    decompressionBufferImage = new Bytef[numPixels * 3];
+}
+
+ChunkedLogReader::~ChunkedLogReader()
+{
+    delete [] decompressionBufferDepth;
+    delete [] decompressionBufferImage;
+
+    fclose(fp);
+}
+
+bool ChunkedLogReader::readIndex()
+{
+    ChunkedLog::Footer footer;
+
+    if(fseek(fp, -(long)sizeof(ChunkedLog::Footer), SEEK_END) != 0 ||
+       fread(&footer, sizeof(ChunkedLog::Footer), 1, fp) != 1 ||
+       footer.magic != ChunkedLog::FOOTER_MAGIC)
+    {
+        return false;
+    }
+
+    index.resize(footer.numChunks);
+
+    return fseek(fp, footer.indexOffset, SEEK_SET) == 0 &&
+           (index.empty() || fread(index.data(), sizeof(ChunkedLog::IndexEntry), index.size(), fp) == index.size());
+}
+
+void ChunkedLogReader::scanChunks()
+{
+    index.clear();
+
+    uint64_t offset = sizeof(ChunkedLog::Header);
+    uint32_t frames = 0;
+
+    ChunkedLog::ChunkHeader chunk;
+
+    //Stops at the first chunk that isn't all there
+    while(fseek(fp, offset, SEEK_SET) == 0 &&
+          fread(&chunk, sizeof(ChunkedLog::ChunkHeader), 1, fp) == 1 &&
+          chunk.magic == ChunkedLog::CHUNK_MAGIC &&
+          fseek(fp, offset + sizeof(ChunkedLog::ChunkHeader) + chunk.size - 1, SEEK_SET) == 0 &&
+          fgetc(fp) != EOF)
+    {
+        ChunkedLog::IndexEntry entry;
+        entry.offset = offset;
+        entry.firstFrame = frames;
+        entry.numFrames = chunk.numFrames;
+
+        index.push_back(entry);
+
+        frames += chunk.numFrames;
+        offset += sizeof(ChunkedLog::ChunkHeader) + chunk.size;
+    }
+}
+
+bool ChunkedLogReader::loadChunk(const int chunk)
+{
+    if(chunk == loadedChunk)
+    {
+        return true;
+    }
+
+    loadedChunk = -1;
+    chunkData.clear();
+    frameOffsets.clear();
+
+    ChunkedLog::ChunkHeader chunkHeader;
+
+    //Don't trust a size or frame count that the file can't back up
+    if(chunk < 0 || chunk >= (int)index.size() ||
+       fseek(fp, index[chunk].offset, SEEK_SET) != 0 ||
+       fread(&chunkHeader, sizeof(ChunkedLog::ChunkHeader), 1, fp) != 1 ||
+       chunkHeader.magic != ChunkedLog::CHUNK_MAGIC ||
+       chunkHeader.numFrames != index[chunk].numFrames ||
+       chunkHeader.size > fileSize - std::min(fileSize, index[chunk].offset + sizeof(ChunkedLog::ChunkHeader)) ||
+       chunkHeader.numFrames > chunkHeader.size / sizeof(ChunkedLog::FrameEntry))
+    {
+        return false;
+    }
+
+    chunkData.resize(chunkHeader.size);
+
+    if(chunkData.size() && fread(chunkData.data(), chunkData.size(), 1, fp) != 1)
+    {
+        chunkData.clear();
+        return false;
+    }
+
+    const ChunkedLog::FrameEntry * entries = (const ChunkedLog::FrameEntry *)chunkData.data();
+
+    frameOffsets.resize(chunkHeader.numFrames);
+
+    //64 bit, so garbage sizes can't wrap round. frameValid checks each frame against the chunk
+    uint64_t offset = chunkHeader.numFrames * sizeof(ChunkedLog::FrameEntry);
+
+    for(uint32_t i = 0; i < chunkHeader.numFrames; i++)
+    {
+        frameOffsets[i] = offset;
+        offset += (uint64_t)entries[i].depthSize + entries[i].imageSize;
+    }
+
+    loadedChunk = chunk;
+
+    return true;
+}
+
+bool ChunkedLogReader::frameValid(const int i)
+{
+    if(i < 0 || i >= (int)frameOffsets.size())
+    {
+        return false;
+    }
+
+    const ChunkedLog::FrameEntry & entry = ((const ChunkedLog::FrameEntry *)chunkData.data())[i];
+
+    //Raw colour is copied as a whole frame, anything else is bounded by its own size
+    return frameOffsets[i] + entry.depthSize + entry.imageSize <= chunkData.size() &&
+           (header.imageCodec != ChunkedLog::IMAGE_RAW || entry.imageSize == 0 || entry.imageSize == (uint32_t)numPixels * 3);
+}
+
+void ChunkedLogReader::readFrame(const int frame)
+{
+    //Chunks are sorted by their first frame
+    int chunk = loadedChunk;
+
+    if(chunk == -1 || frame < (int)index[chunk].firstFrame || frame >= (int)(index[chunk].firstFrame + index[chunk].numFrames))
+    {
+        chunk = std::upper_bound(index.begin(), index.end(), (uint32_t)frame,
+                                 [](const uint32_t f, const ChunkedLog::IndexEntry & entry) { return f < entry.firstFrame; }) - index.begin() - 1;
+    }
+
+    const int i = chunk >= 0 ? frame - (int)index[chunk].firstFrame : -1;
+
+    depth = (unsigned short *)decompressionBufferDepth;
+    rgb = (unsigned char *)&decompressionBufferImage[0];
+
+    currentFrame++;
+
+    //A truncated or corrupt frame comes back blank rather than reading past what's there
+    if(!loadChunk(chunk) || !frameValid(i))
+    {
+        std::cout << "Frame " << frame << " of " << file << " is corrupt" << std::endl;
+
+        depthSize = 0;
+        imageSize = 0;
+
+        memset(decompressionBufferDepth, 0, numPixels * 2);
+        memset(decompressionBufferImage, 0, numPixels * 3);
+
+        return;
+    }
+
+    const ChunkedLog::FrameEntry & entry = ((const ChunkedLog::FrameEntry *)chunkData.data())[i];
+
+    const unsigned char * depthData = &chunkData[frameOffsets[i]];
+    const unsigned char * imageData = depthData + entry.depthSize;
+
+    timestamp = entry.timestamp;
+    depthSize = entry.depthSize;
+    imageSize = entry.imageSize;
+
+    //Depth and colour are independent, so decode them side by side
+    ThreadPool::getInstance().parallelFor(0, 2, 1, [&](const int start, const int end)
+    {
+        for(int task = start; task < end; task++)
+        {
+            if(task == 0)
+            {
+                if(!ChunkedLog::decodeDepth(header.depthCodec, depthData, depthSize, numPixels, depthScratch, (unsigned short *)decompressionBufferDepth))
+                {
+                    memset(decompressionBufferDepth, 0, numPixels * 2);
+                }
+            }
+            else
+            {
+                if(imageSize == 0)
+                {
+                    memset(&decompressionBufferImage[0], 0, numPixels * 3);
+                }
+                else if(header.imageCodec == ChunkedLog::IMAGE_JPEG)
+                {
+                    jpeg.readData((unsigned char *)imageData, imageSize, (unsigned char *)&decompressionBufferImage[0], flipColors);
+                }
+                else if(flipColors)
+                {
+                    ChannelSwap::swapRedBlue(imageData, (unsigned char *)&decompressionBufferImage[0], numPixels);
+                }
+                else
+                {
+                    memcpy(&decompressionBufferImage[0], imageData, numPixels * 3);
+                }
+            }
+        }
+    });
+}
+
+void ChunkedLogReader::getNext()
+{
+    readFrame(framesRead++);
+}
+
+void ChunkedLogReader::getBack()
+{
+    assert(framesRead > 0);
+
+    readFrame(--framesRead);
+}
+
+void ChunkedLogReader::fastForward(int frame)
+{
+    //Nothing to read on the way, the index says where everything is
+    while(currentFrame < frame && hasMore())
+    {
+        framesRead++;
+        currentFrame++;
+    }
+}
+
+int ChunkedLogReader::getNumFrames()
+{
+    return numFrames;
+}
+
+bool ChunkedLogReader::hasMore()
+{
+    return currentFrame + 1 < numFrames;
+}
+
+void ChunkedLogReader::rewind()
+{
+    framesRead = 0;
+    currentFrame = 0;
+}
+
+bool ChunkedLogReader::rewound()
+{
+    return framesRead == 0;
+}
+
+const std::string ChunkedLogReader::getFile()
+{
+    return file;
+}
+
+void ChunkedLogReader::setAuto(bool value)
+{
+
+}
+
+const ChunkedLog::Header & ChunkedLogReader::getHeader()
+{
+    return header;
+}
@@ -0,0 +1,87 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef CHUNKEDLOGREADER_H_
+#define CHUNKEDLOGREADER_H_
+
+#include <Utils/Resolution.h>
+#include <Utils/ThreadPool.h>
+
+#include "LogReader.h"
+#include "ChunkedLog.h"
+
+#include <cassert>
+#include <iostream>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/**
+ * Reads the logs ChunkedLogWriter writes, a chunk at a time
+ */
+class ChunkedLogReader : public LogReader
+{
+    public:
+        ChunkedLogReader(std::string file, bool flipColors);
+
+        virtual ~ChunkedLogReader();
+
+        void getNext();
+
+        void getBack();
+
+        int getNumFrames();
+
+        bool hasMore();
+
+        bool rewound();
+
+        void rewind();
+
+        void fastForward(int frame);
+
+        const std::string getFile();
+
+        void setAuto(bool value);
+
+        const ChunkedLog::Header & getHeader();
+
+    private:
+        bool readIndex();
+        void scanChunks();
+
+        bool loadChunk(const int chunk);
+        bool frameValid(const int i);
+        void readFrame(const int frame);
+
+        ChunkedLog::Header header;
+        std::vector<ChunkedLog::IndexEntry> index;
+
+        //Frames read so far, getBack steps back through them
+        int framesRead;
+
+        uint64_t fileSize;
+
+        int loadedChunk;
+        std::vector<unsigned char> chunkData;
+        std::vector<uint64_t> frameOffsets;
+
+        std::vector<unsigned char> depthScratch;
+};
+
+#endif /* CHUNKEDLOGREADER_H_ */
@@ -0,0 +1,236 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef FRAMERING_H_
+#define FRAMERING_H_
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstdlib>
+
+/**
+ * Hands frames from a camera callback thread (the one producer) to the reader (the one consumer) without locks
+ * or copies. The slots are allocated up front, the producer fills one in and publishes it, the consumer then owns
+ * it until it acquires the next one. If the consumer falls behind it skips straight to the newest frame, if the
+ * producer finds every slot taken it drops the frame it has. Both are counted.
+ */
+class FrameRing
+{
+    public:
+        struct Frame
+        {
+            uint16_t * depth;
+            uint8_t * rgb;
+            int64_t timestamp;
+
+            //Steady clock microseconds, set by publish
+            int64_t published;
+        };
+
+        struct Stats
+        {
+            unsigned long long int produced;
+            unsigned long long int dropped;
+            unsigned long long int skipped;
+        };
+
+        FrameRing(const int width, const int height, const int numSlots = 8)
+         : slots(numSlots),
+           head(0),
+           tail(0),
+           held(false),
+           waiting(false),
+           produced(0),
+           dropped(0),
+           skipped(0)
+        {
+            for(size_t i = 0; i < slots.size(); i++)
+            {
+                slots[i].depth = (uint16_t *)calloc(width * height, sizeof(uint16_t));
+                slots[i].rgb = (uint8_t *)calloc(width * height * 3, sizeof(uint8_t));
+                slots[i].timestamp = 0;
+                slots[i].published = 0;
+            }
+        }
+
+        virtual ~FrameRing()
+        {
+            for(size_t i = 0; i < slots.size(); i++)
+            {
+                free(slots[i].depth);
+                free(slots[i].rgb);
+            }
+        }
+
+        /**
+         * Producer side, the slot to fill in next
+         * @return null if the consumer hasn't released any, the frame should be dropped
+         */
+        Frame * claim()
+        {
+            const uint64_t h = head.load(std::memory_order_relaxed);
+
+            if(h - tail.load(std::memory_order_acquire) >= slots.size())
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return 0;
+            }
+
+            return &slots[h % slots.size()];
+        }
+
+        /**
+         * Producer side, hands the slot from the last claim over to the consumer
+         */
+        void publish()
+        {
+            Frame & slot = slots[head.load(std::memory_order_relaxed) % slots.size()];
+
+            slot.published = now();
+
+            {
+                std::lock_guard<std::mutex> lock(tapMutex);
+
+                if(tap)
+                {
+                    tap(slot);
+                }
+            }
+
+            produced.fetch_add(1, std::memory_order_relaxed);
+
+            //Sequentially consistent with the consumer's waiting flag so one of us always sees the other
+            head.fetch_add(1);
+
+            if(waiting.load())
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                signal.notify_one();
+            }
+        }
+
+        /**
+         * Consumer side, takes the newest published frame, giving back the one it had and skipping any older ones
+         * @return null if nothing new has been published, the frame from the last call is still ours then
+         */
+        Frame * acquire()
+        {
+            const uint64_t h = head.load(std::memory_order_acquire);
+            uint64_t t = tail.load(std::memory_order_relaxed);
+
+            //The one we hold is at tail
+            if(h - t <= (held ? 1u : 0u))
+            {
+                return 0;
+            }
+
+            const uint64_t newest = h - 1;
+
+            skipped.fetch_add(newest - t - (held ? 1 : 0), std::memory_order_relaxed);
+
+            held = true;
+
+            tail.store(newest, std::memory_order_release);
+
+            return &slots[newest % slots.size()];
+        }
+
+        /**
+         * Consumer side, blocks until acquire has something new
+         * @return false if nothing came within timeout microseconds
+         */
+        bool wait(const int timeout)
+        {
+            if(available())
+            {
+                return true;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+
+            waiting.store(true);
+
+            const bool arrived = signal.wait_for(lock, std::chrono::microseconds(timeout), [this]{ return available(); });
+
+            waiting.store(false);
+
+            return arrived;
+        }
+
+        /**
+         * Called from publish on the producer thread with every frame, including ones the consumer goes on to skip.
+         * It has to be quick and can't keep the frame, pass an empty function to stop
+         */
+        void setTap(const std::function<void(const Frame &)> & f)
+        {
+            std::lock_guard<std::mutex> lock(tapMutex);
+            tap = f;
+        }
+
+        Stats getStats() const
+        {
+            Stats stats;
+            stats.produced = produced.load(std::memory_order_relaxed);
+            stats.dropped = dropped.load(std::memory_order_relaxed);
+            stats.skipped = skipped.load(std::memory_order_relaxed);
+            return stats;
+        }
+
+        static int64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+    private:
+        bool available()
+        {
+            return head.load() - tail.load(std::memory_order_relaxed) > (held ? 1u : 0u);
+        }
+
+        std::vector<Frame> slots;
+
+        //Frames published and the first one the consumer still has, kept a cache line apart by padding rather than
+        //alignas, which plain new doesn't honour before C++17
+        char headPad[64];
+        std::atomic<uint64_t> head;
+        char tailPad[64 - sizeof(std::atomic<uint64_t>)];
+        std::atomic<uint64_t> tail;
+        char endPad[64 - sizeof(std::atomic<uint64_t>)];
+
+        //Only touched by the consumer
+        bool held;
+
+        std::atomic<bool> waiting;
+        std::mutex mutex;
+        std::condition_variable signal;
+
+        //Only ever contended while the tap is being changed
+        std::mutex tapMutex;
+        std::function<void(const Frame &)> tap;
+
+        std::atomic<unsigned long long int> produced;
+        std::atomic<unsigned long long int> dropped;
+        std::atomic<unsigned long long int> skipped;
+};
+
+#endif /* FRAMERING_H_ */
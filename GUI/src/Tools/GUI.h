@@ -153,10 +153,12 @@ class GUI
             gpuMem = new pangolin::Var<int>("ui.GPU memory free", 0);
 
             totalPoints = new pangolin::Var<std::string>("ui.Total points", "0");
+            totalEvicted = new pangolin::Var<std::string>("ui.Evicted points", "0");
             totalNodes = new pangolin::Var<std::string>("ui.Total nodes", "0");
             totalFerns = new pangolin::Var<std::string>("ui.Total ferns", "0");
             totalDefs = new pangolin::Var<std::string>("ui.Total deforms", "0");
             totalFernDefs = new pangolin::Var<std::string>("ui.Total fern deforms", "0");
+            degradation = new pangolin::Var<std::string>("ui.Degradation", "full");
 
             trackInliers = new pangolin::Var<std::string>("ui.Inliers", "0");
             trackRes = new pangolin::Var<std::string>("ui.Residual", "0");
@@ -199,11 +201,13 @@ class GUI
             delete pyramid;
             delete rgbOnly;
             delete totalFernDefs;
+            delete degradation;
             delete drawFerns;
             delete followPose;
             delete drawDeforms;
             delete drawRawCloud;
             delete totalPoints;
+            delete totalEvicted;
             delete frameToFrameRGB;
             delete flipColors;
             delete drawFilteredCloud;
@@ -406,10 +410,12 @@ class GUI
                             * drawWindow;
         pangolin::Var<int> * gpuMem;
         pangolin::Var<std::string> * totalPoints,
+                                   * totalEvicted,
                                    * totalNodes,
                                    * totalFerns,
                                    * totalDefs,
                                    * totalFernDefs,
+                                   * degradation,
                                    * trackInliers,
                                    * trackRes,
                                    * logProgress;
@@ -24,6 +24,8 @@ extern "C"
 #include "jpeglib.h"
 }
 
+#include "ChannelSwap.h"
+
 #include <stdio.h>
 #include <string>
 
@@ -43,7 +45,10 @@ class JPEGLoader
         JPEGLoader()
         {}
 
-        void readData(unsigned char * src, const int numBytes, unsigned char * data)
+        /**
+         * Logs store red and blue swapped, they're swapped back while decoding unless flipColors is set
+         */
+        void readData(unsigned char * src, const int numBytes, unsigned char * data, const bool flipColors = false)
         {
             jpeg_decompress_struct cinfo; // IJG JPEG codec structure
 
@@ -68,27 +73,30 @@ class JPEGLoader
 
             jpeg_read_header(&cinfo, TRUE);
 
+#ifdef JCS_EXTENSIONS
+            //libjpeg-turbo can write either order itself
+            cinfo.out_color_space = flipColors ? JCS_RGB : JCS_EXT_BGR;
+#endif
+
             jpeg_calc_output_dimensions(&cinfo);
 
             jpeg_start_decompress(&cinfo);
 
-            int width = cinfo.output_width;
-            int height = cinfo.output_height;
-
-            JSAMPARRAY buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr)&cinfo, JPOOL_IMAGE, width * 4, 1);
+            const int width = cinfo.output_width;
 
-            for(; height--; data += (width * 3))
+            //Straight into the output, no intermediate scanline
+            while(cinfo.output_scanline < cinfo.output_height)
             {
-                jpeg_read_scanlines(&cinfo, buffer, 1);
+                unsigned char * row = data + cinfo.output_scanline * width * 3;
 
-                unsigned char * bgr = (unsigned char *)buffer[0];
-                unsigned char * rgb = (unsigned char *)data;
+                jpeg_read_scanlines(&cinfo, &row, 1);
 
-                for(int i = 0; i < width; i++, bgr += 3, rgb += 3)
+#ifndef JCS_EXTENSIONS
+                if(!flipColors)
                 {
-                    unsigned char t0 = bgr[0], t1 = bgr[1], t2 = bgr[2];
-                    rgb[2] = t0; rgb[1] = t1; rgb[0] = t2;
+                    ChannelSwap::swapRedBlue(row, row, width);
                 }
+#endif
             }
 
             jpeg_finish_decompress(&cinfo);
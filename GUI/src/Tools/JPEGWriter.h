@@ -0,0 +1,123 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef TOOLS_JPEGWRITER_H_
+#define TOOLS_JPEGWRITER_H_
+
+extern "C"
+{
+#include "jpeglib.h"
+}
+
+#include <vector>
+#include <algorithm>
+
+//Grows a std::vector as libjpeg writes into it
+struct JPEGVectorDestination
+{
+    jpeg_destination_mgr mgr;
+    std::vector<unsigned char> * out;
+};
+
+static void initVectorDestination(j_compress_ptr cinfo)
+{
+    JPEGVectorDestination * dest = (JPEGVectorDestination *)cinfo->dest;
+    dest->out->resize(std::max(dest->out->capacity(), (size_t)(1 << 16)));
+    dest->mgr.next_output_byte = dest->out->data();
+    dest->mgr.free_in_buffer = dest->out->size();
+}
+
+static boolean growVectorDestination(j_compress_ptr cinfo)
+{
+    JPEGVectorDestination * dest = (JPEGVectorDestination *)cinfo->dest;
+    const size_t used = dest->out->size();
+    dest->out->resize(used * 2);
+    dest->mgr.next_output_byte = dest->out->data() + used;
+    dest->mgr.free_in_buffer = dest->out->size() - used;
+    return TRUE;
+}
+
+static void termVectorDestination(j_compress_ptr cinfo)
+{
+    JPEGVectorDestination * dest = (JPEGVectorDestination *)cinfo->dest;
+    dest->out->resize(dest->out->size() - dest->mgr.free_in_buffer);
+}
+
+/**
+ * Inverse of JPEGLoader, red and blue are swapped going in as JPEGLoader swaps them back coming out
+ */
+class JPEGWriter
+{
+    public:
+        JPEGWriter(const int quality = 90)
+         : quality(quality)
+        {}
+
+        void writeData(const unsigned char * rgb, const int width, const int height, std::vector<unsigned char> & out)
+        {
+            row.resize(width * 3);
+
+            jpeg_compress_struct cinfo;
+            jpeg_error_mgr errorMgr;
+
+            cinfo.err = jpeg_std_error(&errorMgr);
+
+            jpeg_create_compress(&cinfo);
+
+            JPEGVectorDestination dest;
+            dest.mgr.init_destination = initVectorDestination;
+            dest.mgr.empty_output_buffer = growVectorDestination;
+            dest.mgr.term_destination = termVectorDestination;
+            dest.out = &out;
+
+            cinfo.dest = &dest.mgr;
+
+            cinfo.image_width = width;
+            cinfo.image_height = height;
+            cinfo.input_components = 3;
+            cinfo.in_color_space = JCS_RGB;
+
+            jpeg_set_defaults(&cinfo);
+            jpeg_set_quality(&cinfo, quality, TRUE);
+
+            jpeg_start_compress(&cinfo, TRUE);
+
+            for(int y = 0; y < height; y++, rgb += width * 3)
+            {
+                for(int x = 0; x < width * 3; x += 3)
+                {
+                    row[x + 0] = rgb[x + 2];
+                    row[x + 1] = rgb[x + 1];
+                    row[x + 2] = rgb[x + 0];
+                }
+
+                JSAMPROW scanline = row.data();
+                jpeg_write_scanlines(&cinfo, &scanline, 1);
+            }
+
+            jpeg_finish_compress(&cinfo);
+
+            jpeg_destroy_compress(&cinfo);
+        }
+
+    private:
+        const int quality;
+        std::vector<unsigned char> row;
+};
+
+#endif /* TOOLS_JPEGWRITER_H_ */
@@ -23,8 +23,10 @@
 
 LiveLogReader::LiveLogReader(std::string file, bool flipColors, CameraType type)
  : LogReader(file, flipColors),
-   lastFrameTime(-1),
-   lastGot(-1)
+   lastPublished(0),
+   latencyFrames(0),
+   latencyTotal(0),
+   latencyMax(0)
 {
     std::cout << "Creating live capture... "; std::cout.flush();
 
@@ -35,10 +37,24 @@ LiveLogReader::LiveLogReader(std::string file, bool flipColors, CameraType type)
     else
       cam = nullptr;
 
-	decompressionBufferDepth = new Bytef[Resolution::getInstance().numPixels() * 2];
+    waitForFirstFrame();
+}
 
-	decompressionBufferImage = new Bytef[Resolution::getInstance().numPixels() * 3];
+LiveLogReader::LiveLogReader(std::string file, bool flipColors, CameraInterface * cam)
+ : LogReader(file, flipColors),
+   cam(cam),
+   lastPublished(0),
+   latencyFrames(0),
+   latencyTotal(0),
+   latencyMax(0)
+{
+    std::cout << "Creating replay capture... "; std::cout.flush();
+
+    waitForFirstFrame();
+}
 
+void LiveLogReader::waitForFirstFrame()
+{
     if(!cam || !cam->ok())
     {
         std::cout << "failed!" << std::endl;
@@ -50,14 +66,10 @@ LiveLogReader::LiveLogReader(std::string file, bool flipColors, CameraType type)
 
         std::cout << "Waiting for first frame"; std::cout.flush();
 
-        int lastDepth = cam->latestDepthIndex.getValue();
-
-        do
+        while(!cam->frames->wait(33333))
         {
-          std::this_thread::sleep_for(std::chrono::microseconds(33333));
             std::cout << "."; std::cout.flush();
-            lastDepth = cam->latestDepthIndex.getValue();
-        } while(lastDepth == -1);
+        }
 
         std::cout << " got it!" << std::endl;
     }
@@ -65,40 +77,90 @@ LiveLogReader::LiveLogReader(std::string file, bool flipColors, CameraType type)
 
 LiveLogReader::~LiveLogReader()
 {
-    delete [] decompressionBufferDepth;
+    if(cam && cam->frames)
+    {
+        FrameRing::Stats stats = cam->frames->getStats();
 
-    delete [] decompressionBufferImage;
+        std::cout << "Camera produced " << stats.produced << " frames, " << stats.dropped << " dropped, " << stats.skipped << " skipped";
+
+        if(latencyFrames > 0)
+        {
+            std::cout << ", latency " << latencyTotal / latencyFrames / 1000.0 << "ms mean, " << latencyMax / 1000.0 << "ms max";
+        }
+
+        std::cout << std::endl;
+    }
 
 	delete cam;
+
+    if(recorder)
+    {
+        LogWriter::Stats stats = recorder->getStats();
+
+        std::cout << "Recording " << stats.written + stats.queued << " frames to " << recordFile << ", "
+                  << stats.dropped << " dropped (at most " << stats.maxQueued << " queued)" << std::endl;
+    }
 }
 
-void LiveLogReader::getNext()
+bool LiveLogReader::record(const std::string & filename)
 {
-    int lastDepth = cam->latestDepthIndex.getValue();
+    if(!cam || !cam->frames)
+    {
+        return false;
+    }
 
-    assert(lastDepth != -1);
+    //Stop feeding any log we're already recording to before it goes
+    cam->frames->setTap(std::function<void(const FrameRing::Frame &)>());
 
-    int bufferIndex = lastDepth % CameraInterface::numBuffers;
+    recorder.reset(new LogWriter(filename, Resolution::getInstance().width(), Resolution::getInstance().height()));
+    recordFile = filename;
 
-    if(bufferIndex == lastGot)
+    if(!recorder->isOpen())
     {
-        return;
+        std::cout << "Couldn't create log " << filename << " to record to" << std::endl;
+        recorder.reset();
+        return false;
     }
 
-    if(lastFrameTime == cam->frameBuffers[bufferIndex].second)
+    //Recorded as each frame is published, so frames the tracker skips are kept and the copy stays off its thread
+    LogWriter * writer = recorder.get();
+
+    cam->frames->setTap([writer](const FrameRing::Frame & frame)
     {
-        return;
+        writer->addFrame(frame.timestamp, frame.depth, frame.rgb);
+    });
+
+    return true;
+}
+
+void LiveLogReader::getNext()
+{
+    //The last frame has been through everything by now
+    if(lastPublished)
+    {
+        const int64_t latency = FrameRing::now() - lastPublished;
+
+        latencyFrames++;
+        latencyTotal += latency;
+        latencyMax = std::max(latencyMax, latency);
+
+        lastPublished = 0;
     }
 
-    memcpy(&decompressionBufferDepth[0], cam->frameBuffers[bufferIndex].first.first, Resolution::getInstance().numPixels() * 2);
-    memcpy(&decompressionBufferImage[0], cam->frameBuffers[bufferIndex].first.second,Resolution::getInstance().numPixels() * 3);
+    //Block until there's a new frame rather than polling, if the camera stalls the last one is handed back again
+    if(!cam->frames->wait(FRAME_TIMEOUT))
+    {
+        return;
+    }
 
-    lastFrameTime = cam->frameBuffers[bufferIndex].second;
+    //Read straight out of the camera's slot, it's ours until the next call
+    FrameRing::Frame * frame = cam->frames->acquire();
 
-    timestamp = lastFrameTime;
+    timestamp = frame->timestamp;
+    lastPublished = frame->published;
 
-    rgb = (unsigned char *)&decompressionBufferImage[0];
-    depth = (unsigned short *)&decompressionBufferDepth[0];
+    rgb = frame->rgb;
+    depth = frame->depth;
 
     imageReadBuffer = 0;
     depthReadBuffer = 0;
@@ -108,16 +170,17 @@ void LiveLogReader::getNext()
 
     if(flipColors)
     {
-        for(int i = 0; i < Resolution::getInstance().numPixels() * 3; i += 3)
+        ThreadPool::getInstance().parallelFor(0, Resolution::getInstance().numPixels(), 16384, [&](const int start, const int end)
         {
-            std::swap(rgb[i + 0], rgb[i + 2]);
-        }
+            ChannelSwap::swapRedBlue(rgb + start * 3, rgb + start * 3, end - start);
+        });
     }
 }
 
 const std::string LiveLogReader::getFile()
 {
-    return Parse::get().baseDir().append("live");
+    //Replays are named after their log
+    return file.length() ? file : Parse::get().baseDir().append("live");
 }
 
 int LiveLogReader::getNumFrames()
@@ -127,7 +190,8 @@ int LiveLogReader::getNumFrames()
 
 bool LiveLogReader::hasMore()
 {
-    return true;
+    //Anything published before it finished is still to come
+    return !cam->finished() || cam->frames->wait(0);
 }
 
 void LiveLogReader::setAuto(bool value)
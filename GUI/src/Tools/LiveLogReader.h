@@ -27,11 +27,15 @@
 #include <signal.h>
 #include <chrono>
 #include <thread>
+#include <memory>
 
 #include <Utils/Parse.h>
+#include <Utils/ThreadPool.h>
 
 #include "LogReader.h"
 #include "CameraInterface.h"
+#include "ReplayInterface.h"
+#include "LogWriter.h"
 
 class LiveLogReader : public LogReader
 {
@@ -43,6 +47,11 @@ class LiveLogReader : public LogReader
 
 		LiveLogReader(std::string file, bool flipColors, CameraType type);
 
+        /**
+         * Reads from any other camera, e.g. a ReplayInterface, owned from here on
+         */
+        LiveLogReader(std::string file, bool flipColors, CameraInterface * cam);
+
 		virtual ~LiveLogReader();
 
         void getNext();
@@ -75,11 +84,28 @@ class LiveLogReader : public LogReader
 
         void setAuto(bool value);
 
+        /**
+         * Record every new frame from here on to a .klg log as it came from the camera, including ones getNext skips
+         * @return false if the log couldn't be created
+         */
+        bool record(const std::string & filename);
+
 		CameraInterface * cam;
 
 	private:
-		int64_t lastFrameTime;
-		int lastGot;
+        void waitForFirstFrame();
+
+		std::unique_ptr<LogWriter> recorder;
+		std::string recordFile;
+
+        //Publish to the next getNext, i.e. through a whole frame of processing
+        int64_t lastPublished;
+        unsigned long long int latencyFrames;
+        double latencyTotal;
+        int64_t latencyMax;
+
+		//How long getNext waits for the camera before giving up, in microseconds
+		static const int FRAME_TIMEOUT = 1000000;
 };
 
 #endif /* LIVELOGREADER_H_ */
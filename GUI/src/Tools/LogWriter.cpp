@@ -0,0 +1,242 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "LogWriter.h"
+
+#include <cstring>
+#include <algorithm>
+
+const int32_t LogWriter::INDEX_TAG;
+
+LogWriter::LogWriter(const std::string & filename, const int width, const int height, const int numWorkers, const int numSlots)
+ : width(width),
+   height(height),
+   fp(fopen(filename.c_str(), "wb")),
+   fileBuffer(FILE_BUFFER),
+   slots(numSlots),
+   nextFrame(0),
+   nextWrite(0),
+   shutdown(false)
+{
+    memset(&stats, 0, sizeof(Stats));
+
+    if(!fp)
+    {
+        return;
+    }
+
+    setvbuf(fp, fileBuffer.data(), _IOFBF, fileBuffer.size());
+
+    //Filled in as we go
+    int32_t numFrames = 0;
+    fwrite(&numFrames, sizeof(int32_t), 1, fp);
+
+    offsets.reserve(1 << 16);
+
+    for(size_t i = 0; i < slots.size(); i++)
+    {
+        slots[i].state = FREE;
+        slots[i].depth.resize(width * height);
+        slots[i].rgb.resize(width * height * 3);
+        slots[i].depthOut.resize(compressBound(width * height * sizeof(unsigned short)));
+        slots[i].imageOut.reserve(width * height);
+    }
+
+    for(int i = 0; i < std::max(numWorkers, 1); i++)
+    {
+        workers.push_back(std::thread(&LogWriter::workLoop, this));
+    }
+
+    writer = std::thread(&LogWriter::writeLoop, this);
+}
+
+LogWriter::~LogWriter()
+{
+    if(!fp)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutdown = true;
+        work.notify_all();
+        ready.notify_all();
+    }
+
+    for(size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+
+    writer.join();
+
+    const int32_t numFrames = offsets.size();
+
+    fwrite(offsets.data(), sizeof(int64_t), offsets.size(), fp);
+    fwrite(&numFrames, sizeof(int32_t), 1, fp);
+    fwrite(&INDEX_TAG, sizeof(int32_t), 1, fp);
+
+    writeCount();
+
+    fclose(fp);
+}
+
+bool LogWriter::isOpen()
+{
+    return fp != 0;
+}
+
+bool LogWriter::addFrame(const int64_t timestamp, const unsigned short * depth, const unsigned char * rgb)
+{
+    unsigned long long int frame;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        frame = nextFrame;
+
+        if(slots[frame % slots.size()].state != FREE)
+        {
+            stats.dropped++;
+            return false;
+        }
+    }
+
+    //Nobody else touches a free slot
+    Slot & slot = slots[frame % slots.size()];
+
+    slot.timestamp = timestamp;
+    memcpy(slot.depth.data(), depth, slot.depth.size() * sizeof(unsigned short));
+    memcpy(slot.rgb.data(), rgb, slot.rgb.size());
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    slot.state = QUEUED;
+    jobs.push_back(frame);
+    nextFrame++;
+
+    stats.queued = nextFrame - nextWrite;
+    stats.maxQueued = std::max(stats.maxQueued, stats.queued);
+
+    work.notify_one();
+
+    return true;
+}
+
+LogWriter::Stats LogWriter::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void LogWriter::workLoop()
+{
+    JPEGWriter jpeg(JPEG_QUALITY);
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while(true)
+    {
+        work.wait(lock, [this]{ return shutdown || !jobs.empty(); });
+
+        if(jobs.empty())
+        {
+            break;
+        }
+
+        Slot & slot = slots[jobs.front() % slots.size()];
+        jobs.pop_front();
+
+        lock.unlock();
+
+        encode(slot, jpeg);
+
+        lock.lock();
+
+        slot.state = ENCODED;
+
+        ready.notify_one();
+    }
+}
+
+void LogWriter::writeLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while(true)
+    {
+        ready.wait(lock, [this]{ return slots[nextWrite % slots.size()].state == ENCODED || (shutdown && nextWrite == nextFrame); });
+
+        if(slots[nextWrite % slots.size()].state != ENCODED)
+        {
+            break;
+        }
+
+        Slot & slot = slots[nextWrite % slots.size()];
+
+        lock.unlock();
+
+        const int32_t depthSize = slot.depthOut.size();
+        const int32_t imageSize = slot.imageOut.size();
+
+        offsets.push_back(ftell(fp));
+
+        fwrite(&slot.timestamp, sizeof(int64_t), 1, fp);
+        fwrite(&depthSize, sizeof(int32_t), 1, fp);
+        fwrite(&imageSize, sizeof(int32_t), 1, fp);
+        fwrite(slot.depthOut.data(), depthSize, 1, fp);
+        fwrite(slot.imageOut.data(), imageSize, 1, fp);
+
+        if(offsets.size() % COUNT_RATE == 0)
+        {
+            writeCount();
+        }
+
+        lock.lock();
+
+        slot.state = FREE;
+        nextWrite++;
+
+        stats.written++;
+        stats.bytes += sizeof(int64_t) + sizeof(int32_t) * 2 + depthSize + imageSize;
+        stats.queued = nextFrame - nextWrite;
+    }
+}
+
+void LogWriter::encode(Slot & slot, JPEGWriter & jpeg)
+{
+    uLongf depthSize = compressBound(slot.depth.size() * sizeof(unsigned short));
+    slot.depthOut.resize(depthSize);
+
+    compress2(slot.depthOut.data(), &depthSize, (const Bytef *)slot.depth.data(), slot.depth.size() * sizeof(unsigned short), Z_BEST_SPEED);
+
+    slot.depthOut.resize(depthSize);
+
+    jpeg.writeData(slot.rgb.data(), width, height, slot.imageOut);
+}
+
+void LogWriter::writeCount()
+{
+    const long end = ftell(fp);
+    const int32_t numFrames = offsets.size();
+
+    fseek(fp, 0, SEEK_SET);
+    fwrite(&numFrames, sizeof(int32_t), 1, fp);
+    fseek(fp, end, SEEK_SET);
+}
@@ -0,0 +1,137 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef LOGWRITER_H_
+#define LOGWRITER_H_
+
+#if (defined WIN32) && (defined FAR)
+#  undef FAR
+#endif
+#include <zlib.h>
+#include <stdio.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "JPEGWriter.h"
+
+/**
+ * Records frames to a .klg log (the format RawLogReader reads) without holding up the caller. Frames are copied
+ * into a fixed set of slots, depth is zlib compressed and colour JPEG encoded on a few worker threads and a writer
+ * thread puts them in the file in order through a large buffer. If every slot is still in flight the frame is
+ * dropped and counted.
+ *
+ * After the last frame comes an index, the file offset of every frame (int64_t), then the number of frames and
+ * INDEX_TAG (int32_t each). The frame count at the start is kept up to date every few seconds, so a log cut short
+ * still reads back up to there.
+ */
+class LogWriter
+{
+    public:
+        /**
+         * @param numWorkers threads compressing frames
+         * @param numSlots frames that can be in flight at once
+         */
+        LogWriter(const std::string & filename, const int width, const int height, const int numWorkers = 2, const int numSlots = 16);
+
+        /**
+         * Writes out everything still queued, then the index
+         */
+        virtual ~LogWriter();
+
+        bool isOpen();
+
+        /**
+         * Copies the frame in and queues it, rgb is stored so that RawLogReader gives back the same bytes
+         * @return false if it had to be dropped
+         */
+        bool addFrame(const int64_t timestamp, const unsigned short * depth, const unsigned char * rgb);
+
+        struct Stats
+        {
+            unsigned long long int written;
+            unsigned long long int dropped;
+            unsigned long long int bytes;
+            int queued;
+            int maxQueued;
+        };
+
+        Stats getStats();
+
+        static const int32_t INDEX_TAG = 0x49474c4b;
+
+    private:
+        enum SlotState
+        {
+            FREE,
+            QUEUED,
+            ENCODED
+        };
+
+        struct Slot
+        {
+            SlotState state;
+            int64_t timestamp;
+            std::vector<unsigned short> depth;
+            std::vector<unsigned char> rgb;
+            std::vector<Bytef> depthOut;
+            std::vector<unsigned char> imageOut;
+        };
+
+        void workLoop();
+        void writeLoop();
+
+        void encode(Slot & slot, JPEGWriter & jpeg);
+
+        void writeCount();
+
+        const int width;
+        const int height;
+
+        FILE * fp;
+        std::vector<char> fileBuffer;
+        std::vector<int64_t> offsets;
+
+        std::vector<Slot> slots;
+
+        //Guards everything below and the slot states
+        std::mutex mutex;
+        std::condition_variable work;
+        std::condition_variable ready;
+
+        //Next frame to queue and next one to write, slots are used in order
+        unsigned long long int nextFrame;
+        unsigned long long int nextWrite;
+        std::deque<unsigned long long int> jobs;
+        bool shutdown;
+
+        Stats stats;
+
+        std::vector<std::thread> workers;
+        std::thread writer;
+
+        static const int COUNT_RATE = 300;
+        static const int JPEG_QUALITY = 90;
+        static const size_t FILE_BUFFER = 8 << 20;
+};
+
+#endif /* LOGWRITER_H_ */
@@ -118,7 +118,6 @@ OpenNI2Interface::OpenNI2Interface(int inWidth, int inHeight, int fps)
 
                 assert(findMode(width, height, fps) && "Sorry, mode not supported!");
 
-                latestDepthIndex.assign(-1);
                 latestRgbIndex.assign(-1);
 
                 for(int i = 0; i < numBuffers; i++)
@@ -127,22 +126,16 @@ OpenNI2Interface::OpenNI2Interface(int inWidth, int inHeight, int fps)
                     rgbBuffers[i] = std::pair<uint8_t *, int64_t>(newImage, 0);
                 }
 
-                for(int i = 0; i < numBuffers; i++)
-                {
-                    uint8_t * newDepth = (uint8_t *)calloc(width * height * 2, sizeof(uint8_t));
-                    uint8_t * newImage = (uint8_t *)calloc(width * height * 3, sizeof(uint8_t));
-                    frameBuffers[i] = std::pair<std::pair<uint8_t *, uint8_t *>, int64_t>(std::pair<uint8_t *, uint8_t *>(newDepth, newImage), 0);
-                }
+                frames.reset(new FrameRing(width, height));
 
                 rgbCallback = new RGBCallback(lastRgbTime,
                                               latestRgbIndex,
                                               rgbBuffers);
 
                 depthCallback = new DepthCallback(lastDepthTime,
-                                                  latestDepthIndex,
                                                   latestRgbIndex,
                                                   rgbBuffers,
-                                                  frameBuffers);
+                                                  *frames);
 
                 depthStream.setMirroringEnabled(false);
                 rgbStream.setMirroringEnabled(false);
@@ -179,12 +172,6 @@ OpenNI2Interface::~OpenNI2Interface()
             free(rgbBuffers[i].first);
         }
 
-        for(int i = 0; i < numBuffers; i++)
-        {
-            free(frameBuffers[i].first.first);
-            free(frameBuffers[i].first.second);
-        }
-
         delete rgbCallback;
         delete depthCallback;
     }
@@ -95,15 +95,13 @@ class OpenNI2Interface : public CameraInterface
         {
             public:
                 DepthCallback(int64_t & lastDepthTime,
-                              ThreadMutexObject<int> & latestDepthIndex,
                               ThreadMutexObject<int> & latestRgbIndex,
                               std::pair<uint8_t *, int64_t> * rgbBuffers,
-                              std::pair<std::pair<uint8_t *, uint8_t *>, int64_t> * frameBuffers)
+                              FrameRing & frames)
                  : lastDepthTime(lastDepthTime),
-                   latestDepthIndex(latestDepthIndex),
                    latestRgbIndex(latestRgbIndex),
                    rgbBuffers(rgbBuffers),
-                   frameBuffers(frameBuffers)
+                   frames(frames)
                 {}
 
                 virtual ~DepthCallback() {}
@@ -115,12 +113,6 @@ class OpenNI2Interface : public CameraInterface
                     lastDepthTime = std::chrono::duration_cast<std::chrono::milliseconds>(
                       std::chrono::system_clock::now().time_since_epoch()).count();
 
-                    int bufferIndex = (latestDepthIndex.getValue() + 1) % numBuffers;
-
-                    memcpy(frameBuffers[bufferIndex].first.first, frame.getData(), frame.getWidth() * frame.getHeight() * 2);
-
-                    frameBuffers[bufferIndex].second = lastDepthTime;
-
                     int lastImageVal = latestRgbIndex.getValue();
 
                     if(lastImageVal == -1)
@@ -128,21 +120,31 @@ class OpenNI2Interface : public CameraInterface
                         return;
                     }
 
+                    FrameRing::Frame * slot = frames.claim();
+
+                    //Reader's holding on to everything, it'll skip ahead anyway
+                    if(!slot)
+                    {
+                        return;
+                    }
+
                     lastImageVal %= numBuffers;
 
-                    memcpy(frameBuffers[bufferIndex].first.second, rgbBuffers[lastImageVal].first, frame.getWidth() * frame.getHeight() * 3);
+                    memcpy(slot->depth, frame.getData(), frame.getWidth() * frame.getHeight() * 2);
+                    memcpy(slot->rgb, rgbBuffers[lastImageVal].first, frame.getWidth() * frame.getHeight() * 3);
+
+                    slot->timestamp = lastDepthTime;
 
-                    latestDepthIndex++;
+                    frames.publish();
                 }
 
             private:
                 openni::VideoFrameRef frame;
                 int64_t & lastDepthTime;
-                ThreadMutexObject<int> & latestDepthIndex;
                 ThreadMutexObject<int> & latestRgbIndex;
 
                 std::pair<uint8_t *, int64_t> * rgbBuffers;
-                std::pair<std::pair<uint8_t *, uint8_t *>, int64_t> * frameBuffers;
+                FrameRing & frames;
         };
 
     private:
@@ -0,0 +1,269 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "RVLCodec.h"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#endif
+
+//Length of the run of zero (or non-zero) pixels starting at p
+template<bool zero>
+static inline int runLength(const uint16_t * p, const uint16_t * end)
+{
+    const uint16_t * start = p;
+
+#if defined(__AVX2__)
+    const __m256i zeros = _mm256_setzero_si256();
+
+    while(end - p >= 16)
+    {
+        const int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)p), zeros));
+
+        if(mask != (zero ? -1 : 0))
+        {
+            break;
+        }
+
+        p += 16;
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128i zeros = _mm_setzero_si128();
+
+    while(end - p >= 8)
+    {
+        const int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)p), zeros));
+
+        if(mask != (zero ? 0xffff : 0))
+        {
+            break;
+        }
+
+        p += 8;
+    }
+#endif
+
+    while(p != end && (*p == 0) == zero)
+    {
+        p++;
+    }
+
+    return p - start;
+}
+
+class NibbleWriter
+{
+    public:
+        NibbleWriter(uint32_t * words)
+         : words(words),
+           start(words),
+           word(0),
+           nibbles(0)
+        {}
+
+        inline void write(uint32_t value)
+        {
+            do
+            {
+                uint32_t nibble = value & 0x7;
+
+                if(value >>= 3)
+                {
+                    nibble |= 0x8;
+                }
+
+                word = (word << 4) | nibble;
+
+                if(++nibbles == 8)
+                {
+                    *words++ = word;
+                    nibbles = 0;
+                    word = 0;
+                }
+            } while(value);
+        }
+
+        int finish()
+        {
+            if(nibbles)
+            {
+                *words++ = word << (4 * (8 - nibbles));
+            }
+
+            return (words - start) * sizeof(uint32_t);
+        }
+
+    private:
+        uint32_t * words;
+        uint32_t * start;
+        uint32_t word;
+        int nibbles;
+};
+
+class NibbleReader
+{
+    public:
+        NibbleReader(const uint32_t * words, const uint32_t * end)
+         : words(words),
+           end(end),
+           word(0),
+           nibbles(0)
+        {}
+
+        //Sets failed rather than reading past the end
+        inline uint32_t read(bool & failed)
+        {
+            //Most differences fit in one nibble
+            if(nibbles && !(word & 0x80000000))
+            {
+                const uint32_t value = (word >> 28) & 0x7;
+                word <<= 4;
+                nibbles--;
+                return value;
+            }
+
+            uint32_t nibble;
+            uint32_t value = 0;
+            int bits = 29;
+
+            do
+            {
+                if(!nibbles)
+                {
+                    if(words == end || bits < 0)
+                    {
+                        failed = true;
+                        return 0;
+                    }
+
+                    word = *words++;
+                    nibbles = 8;
+                }
+
+                nibble = word & 0xf0000000;
+                value |= (nibble << 1) >> bits;
+                word <<= 4;
+                nibbles--;
+                bits -= 3;
+            } while(nibble & 0x80000000);
+
+            return value;
+        }
+
+    private:
+        const uint32_t * words;
+        const uint32_t * end;
+        uint32_t word;
+        int nibbles;
+};
+
+int RVLCodec::bound(const int numPixels)
+{
+    //A difference takes at most 6 nibbles (17 bits zigzagged). A length n >= 1 takes at most n nibbles and a length
+    //of 0 (only a leading zero run or a trailing valid run) takes 1, so all the lengths together take at most
+    //numPixels + 2. That's 7 a pixel, over what raw depth takes but it's only the scratch size
+    const int64_t nibbles = (int64_t)numPixels * 7 + 2;
+
+    return (int)(((nibbles + 7) / 8 + 1) * sizeof(uint32_t));
+}
+
+void RVLCodec::compress(const uint16_t * depth, const int numPixels, std::vector<unsigned char> & out)
+{
+    out.resize(bound(numPixels));
+
+    NibbleWriter writer((uint32_t *)out.data());
+
+    const uint16_t * p = depth;
+    const uint16_t * end = depth + numPixels;
+
+    int previous = 0;
+
+    while(p != end)
+    {
+        const int zeros = runLength<true>(p, end);
+        writer.write(zeros);
+        p += zeros;
+
+        const int valid = runLength<false>(p, end);
+        writer.write(valid);
+
+        for(const uint16_t * runEnd = p + valid; p != runEnd; p++)
+        {
+            const int delta = *p - previous;
+            writer.write((delta << 1) ^ (delta >> 31));
+            previous = *p;
+        }
+    }
+
+    out.resize(writer.finish());
+}
+
+bool RVLCodec::decompress(const unsigned char * data, const int size, const int numPixels, uint16_t * depth)
+{
+    if(size % sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    NibbleReader reader((const uint32_t *)data, (const uint32_t *)(data + size));
+
+    bool failed = false;
+
+    uint16_t * p = depth;
+    uint16_t * end = depth + numPixels;
+
+    int previous = 0;
+
+    while(p != end)
+    {
+        const uint32_t zeros = reader.read(failed);
+
+        if(failed || zeros > (uint32_t)(end - p))
+        {
+            return false;
+        }
+
+        memset(p, 0, zeros * sizeof(uint16_t));
+        p += zeros;
+
+        const uint32_t valid = reader.read(failed);
+
+        if(failed || valid > (uint32_t)(end - p))
+        {
+            return false;
+        }
+
+        for(uint16_t * runEnd = p + valid; p != runEnd; p++)
+        {
+            const uint32_t positive = reader.read(failed);
+            previous += (int)(positive >> 1) ^ -(int)(positive & 1);
+            *p = previous;
+        }
+
+        if(failed)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,54 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef RVLCODEC_H_
+#define RVLCODEC_H_
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Lossless depth coding in the style of RVL (Wilson, "Fast Lossless Depth Image Compression", 2017). Depth is
+ * split into alternating runs of zero and valid pixels, valid pixels are stored as the zigzagged difference to the
+ * last valid one. Run lengths and differences are written as variable length nibbles, 3 bits of value and a
+ * continuation bit, packed eight to a 32-bit word.
+ *
+ * Runs are found 8 or 16 pixels at a time with SSE2 or AVX2 and zero runs are filled with memset on the way out,
+ * the rest is inherently sequential.
+ */
+class RVLCodec
+{
+    public:
+        /**
+         * Largest compressed size of numPixels of depth
+         */
+        static int bound(const int numPixels);
+
+        /**
+         * @param out resized to fit
+         */
+        static void compress(const uint16_t * depth, const int numPixels, std::vector<unsigned char> & out);
+
+        /**
+         * Inverse of compress, depth must have room for numPixels
+         * @return false if data is corrupt
+         */
+        static bool decompress(const unsigned char * data, const int size, const int numPixels, uint16_t * depth);
+};
+
+#endif /* RVLCODEC_H_ */
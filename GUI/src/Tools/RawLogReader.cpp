@@ -83,40 +83,49 @@ void RawLogReader::getCore()
         assert(tmp);
     }
 
-    if(depthSize == numPixels * 2)
+    //Depth and colour are independent, so decode them side by side
+    ThreadPool::getInstance().parallelFor(0, 2, 1, [&](const int start, const int end)
     {
-        memcpy(&decompressionBufferDepth[0], depthReadBuffer, numPixels * 2);
-    }
-    else
-    {
-        unsigned long decompLength = numPixels * 2;
-        uncompress(&decompressionBufferDepth[0], (unsigned long *)&decompLength, (const Bytef *)depthReadBuffer, depthSize);
-    }
-
-    if(imageSize == numPixels * 3)
-    {
-        memcpy(&decompressionBufferImage[0], imageReadBuffer, numPixels * 3);
-    }
-    else if(imageSize > 0)
-    {
-        jpeg.readData(imageReadBuffer, imageSize, (unsigned char *)&decompressionBufferImage[0]);
-    }
-    else
-    {
-        memset(&decompressionBufferImage[0], 0, numPixels * 3);
-    }
+        for(int task = start; task < end; task++)
+        {
+            if(task == 0)
+            {
+                if(depthSize == numPixels * 2)
+                {
+                    memcpy(&decompressionBufferDepth[0], depthReadBuffer, numPixels * 2);
+                }
+                else
+                {
+                    unsigned long decompLength = numPixels * 2;
+                    uncompress(&decompressionBufferDepth[0], (unsigned long *)&decompLength, (const Bytef *)depthReadBuffer, depthSize);
+                }
+            }
+            else
+            {
+                //Any flipping is done on the way into the buffer
+                if(imageSize == numPixels * 3 && flipColors)
+                {
+                    ChannelSwap::swapRedBlue(imageReadBuffer, &decompressionBufferImage[0], numPixels);
+                }
+                else if(imageSize == numPixels * 3)
+                {
+                    memcpy(&decompressionBufferImage[0], imageReadBuffer, numPixels * 3);
+                }
+                else if(imageSize > 0)
+                {
+                    jpeg.readData(imageReadBuffer, imageSize, (unsigned char *)&decompressionBufferImage[0], flipColors);
+                }
+                else
+                {
+                    memset(&decompressionBufferImage[0], 0, numPixels * 3);
+                }
+            }
+        }
+    });
 
     depth = (unsigned short *)decompressionBufferDepth;
     rgb = (unsigned char *)&decompressionBufferImage[0];
 
-    if(flipColors)
-    {
-        for(int i = 0; i < Resolution::getInstance().numPixels() * 3; i += 3)
-        {
-            std::swap(rgb[i + 0], rgb[i + 2]);
-        }
-    }
-
     currentFrame++;
 }
 
@@ -21,6 +21,7 @@
 
 #include <Utils/Resolution.h>
 #include <Utils/Stopwatch.h>
+#include <Utils/ThreadPool.h>
 #include <pangolin/utils/file_utils.h>
 
 #include "LogReader.h"
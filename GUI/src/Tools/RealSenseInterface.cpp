@@ -20,7 +20,6 @@ RealSenseInterface::RealSenseInterface(int inWidth,int inHeight,int inFps)
   dev->enable_stream(rs::stream::depth,width,height,rs::format::z16,fps);
   dev->enable_stream(rs::stream::color,width,height,rs::format::rgb8,fps);
 
-  latestDepthIndex.assign(-1);
   latestRgbIndex.assign(-1);
 
   for(int i = 0; i < numBuffers; i++)
@@ -29,12 +28,7 @@ RealSenseInterface::RealSenseInterface(int inWidth,int inHeight,int inFps)
     rgbBuffers[i] = std::pair<uint8_t *,int64_t>(newImage,0);
   }
 
-  for(int i = 0; i < numBuffers; i++)
-  {
-    uint8_t * newDepth = (uint8_t *)calloc(width * height * 2,sizeof(uint8_t));
-    uint8_t * newImage = (uint8_t *)calloc(width * height * 3,sizeof(uint8_t));
-    frameBuffers[i] = std::pair<std::pair<uint8_t *,uint8_t *>,int64_t>(std::pair<uint8_t *,uint8_t *>(newDepth,newImage),0);
-  }
+  frames.reset(new FrameRing(width,height));
 
   setAutoExposure(true);
   setAutoWhiteBalance(true);
@@ -44,10 +38,9 @@ RealSenseInterface::RealSenseInterface(int inWidth,int inHeight,int inFps)
     rgbBuffers);
 
   depthCallback = new DepthCallback(lastDepthTime,
-    latestDepthIndex,
     latestRgbIndex,
     rgbBuffers,
-    frameBuffers);
+    *frames);
 
   dev->set_frame_callback(rs::stream::depth,*depthCallback);
   dev->set_frame_callback(rs::stream::color,*rgbCallback);
@@ -66,12 +59,6 @@ RealSenseInterface::~RealSenseInterface()
       free(rgbBuffers[i].first);
     }
 
-    for(int i = 0; i < numBuffers; i++)
-    {
-      free(frameBuffers[i].first.first);
-      free(frameBuffers[i].first.second);
-    }
-
     delete rgbCallback;
     delete depthCallback;
   }
@@ -73,15 +73,13 @@ public:
   {
   public:
     DepthCallback(int64_t & lastDepthTime,
-      ThreadMutexObject<int> & latestDepthIndex,
       ThreadMutexObject<int> & latestRgbIndex,
       std::pair<uint8_t *,int64_t> * rgbBuffers,
-      std::pair<std::pair<uint8_t *,uint8_t *>,int64_t> * frameBuffers)
+      FrameRing & frames)
       : lastDepthTime(lastDepthTime),
-      latestDepthIndex(latestDepthIndex),
       latestRgbIndex(latestRgbIndex),
       rgbBuffers(rgbBuffers),
-      frameBuffers(frameBuffers)
+      frames(frames)
     {
     }
 
@@ -90,14 +88,6 @@ public:
       lastDepthTime = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::system_clock::now().time_since_epoch()).count();
 
-      int bufferIndex = (latestDepthIndex.getValue() + 1) % numBuffers;
-
-      // The multiplication by 2 is here because the depth is actually uint16_t
-      memcpy(frameBuffers[bufferIndex].first.first,frame.get_data(),
-        frame.get_width() * frame.get_height() * 2);
-
-      frameBuffers[bufferIndex].second = lastDepthTime;
-
       int lastImageVal = latestRgbIndex.getValue();
 
       if(lastImageVal == -1)
@@ -105,21 +95,34 @@ public:
         return;
       }
 
+      FrameRing::Frame * slot = frames.claim();
+
+      //Reader's holding on to everything, it'll skip ahead anyway
+      if(!slot)
+      {
+        return;
+      }
+
       lastImageVal %= numBuffers;
 
-      memcpy(frameBuffers[bufferIndex].first.second,rgbBuffers[lastImageVal].first,
+      // The multiplication by 2 is here because the depth is actually uint16_t
+      memcpy(slot->depth,frame.get_data(),
+        frame.get_width() * frame.get_height() * 2);
+
+      memcpy(slot->rgb,rgbBuffers[lastImageVal].first,
         frame.get_width() * frame.get_height() * 3);
 
-      latestDepthIndex++;
+      slot->timestamp = lastDepthTime;
+
+      frames.publish();
     }
 
   private:
     int64_t & lastDepthTime;
-    ThreadMutexObject<int> & latestDepthIndex;
     ThreadMutexObject<int> & latestRgbIndex;
 
     std::pair<uint8_t *,int64_t> * rgbBuffers;
-    std::pair<std::pair<uint8_t *,uint8_t *>,int64_t> * frameBuffers;
+    FrameRing & frames;
   };
 #endif
 
@@ -0,0 +1,124 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "ReplayInterface.h"
+
+#include <chrono>
+#include <cstring>
+
+ReplayInterface::ReplayInterface(LogReader * source, const float speed)
+ : source(source),
+   speed(speed),
+   done(false),
+   late(0),
+   stop(false)
+{
+    //Frames go out as recorded, whoever reads them does any flipping
+    source->flipColors = false;
+
+    frames.reset(new FrameRing(Resolution::getInstance().width(), Resolution::getInstance().height()));
+
+    if(ok())
+    {
+        producer = std::thread(&ReplayInterface::run, this);
+    }
+    else
+    {
+        done = true;
+    }
+}
+
+ReplayInterface::~ReplayInterface()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+        stopped.notify_all();
+    }
+
+    if(producer.joinable())
+    {
+        producer.join();
+    }
+}
+
+void ReplayInterface::run()
+{
+    std::chrono::steady_clock::time_point start;
+    const int numPixels = Resolution::getInstance().numPixels();
+
+    int64_t firstTimestamp = 0;
+    bool first = true;
+
+    while(source->hasMore())
+    {
+        source->getNext();
+
+        //The clock starts with the first frame
+        if(first)
+        {
+            start = std::chrono::steady_clock::now();
+            firstTimestamp = source->timestamp;
+            first = false;
+        }
+
+        if(speed > 0)
+        {
+            const std::chrono::steady_clock::time_point due = start + std::chrono::microseconds((int64_t)((source->timestamp - firstTimestamp) / speed));
+
+            //Allowing for the odd wakeup
+            if(std::chrono::steady_clock::now() > due + std::chrono::milliseconds(1))
+            {
+                late++;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+
+            if(stopped.wait_until(lock, due, [this]{ return stop; }))
+            {
+                break;
+            }
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if(stop)
+            {
+                break;
+            }
+        }
+
+        FrameRing::Frame * slot = frames->claim();
+
+        //Reader's holding on to everything, same as a live camera we lose this one
+        if(!slot)
+        {
+            continue;
+        }
+
+        memcpy(slot->depth, source->depth, numPixels * 2);
+        memcpy(slot->rgb, source->rgb, numPixels * 3);
+
+        slot->timestamp = source->timestamp;
+
+        frames->publish();
+    }
+
+    done = true;
+}
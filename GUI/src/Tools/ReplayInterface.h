@@ -0,0 +1,97 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef REPLAYINTERFACE_H_
+#define REPLAYINTERFACE_H_
+
+#include <Utils/Resolution.h>
+
+#include "CameraInterface.h"
+#include "LogReader.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * A camera that plays a log back in real time. A producer thread reads each frame and publishes it into the
+ * FrameRing at its recorded timestamp (microseconds, as in .klg logs), just like the OpenNI2 and RealSense
+ * callbacks do, so dropping, skipping and latency behave as they would live.
+ */
+class ReplayInterface : public CameraInterface
+{
+    public:
+        /**
+         * @param source read from start to end on the producer thread, owned from here on
+         * @param speed 2 plays back twice as fast, 0 or less as fast as it can be read
+         */
+        ReplayInterface(LogReader * source, const float speed = 1);
+
+        virtual ~ReplayInterface();
+
+        virtual bool ok()
+        {
+            return source->getNumFrames() > 0;
+        }
+
+        virtual std::string error()
+        {
+            return "Nothing to replay in " + source->getFile() + "\n";
+        }
+
+        virtual void setAutoExposure(bool value)
+        {
+
+        }
+
+        virtual void setAutoWhiteBalance(bool value)
+        {
+
+        }
+
+        virtual bool finished()
+        {
+            return done.load();
+        }
+
+        /**
+         * Frames that were read after they were due, because reading the log couldn't keep up
+         */
+        unsigned long long int getLate() const
+        {
+            return late.load();
+        }
+
+    private:
+        void run();
+
+        std::unique_ptr<LogReader> source;
+        const float speed;
+
+        std::atomic<bool> done;
+        std::atomic<unsigned long long int> late;
+
+        bool stop;
+        std::mutex mutex;
+        std::condition_variable stopped;
+
+        std::thread producer;
+};
+
+#endif /* REPLAYINTERFACE_H_ */
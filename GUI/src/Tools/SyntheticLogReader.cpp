@@ -0,0 +1,125 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "SyntheticLogReader.h"
+#include "ChannelSwap.h"
+
+#include <Utils/Parse.h>
+#include <Utils/ThreadPool.h>
+
+SyntheticLogReader::SyntheticLogReader(const SyntheticScene::Config & config, bool flipColors)
+ : LogReader(Parse::get().baseDir() + "synthetic_" + layoutName(config.layout), flipColors),
+   scene(config),
+   framesRead(0),
+   depthBuffer(numPixels),
+   rgbBuffer(numPixels * 3)
+{
+    assert(config.width == width && config.height == height);
+
+    numFrames = config.numFrames;
+    currentFrame = 0;
+}
+
+SyntheticLogReader::~SyntheticLogReader()
+{
+
+}
+
+void SyntheticLogReader::readFrame(const int frame)
+{
+    scene.render(frame, depthBuffer.data(), rgbBuffer.data());
+
+    timestamp = scene.getTimestamp(frame);
+    depth = depthBuffer.data();
+    rgb = rgbBuffer.data();
+
+    depthSize = numPixels * 2;
+    imageSize = numPixels * 3;
+
+    if(flipColors)
+    {
+        ThreadPool::getInstance().parallelFor(0, numPixels, 16384, [&](const int start, const int end)
+        {
+            ChannelSwap::swapRedBlue(rgb + start * 3, rgb + start * 3, end - start);
+        });
+    }
+
+    currentFrame++;
+}
+
+void SyntheticLogReader::getNext()
+{
+    readFrame(framesRead++);
+}
+
+void SyntheticLogReader::getBack()
+{
+    assert(framesRead > 0);
+
+    readFrame(--framesRead);
+}
+
+void SyntheticLogReader::fastForward(int frame)
+{
+    while(currentFrame < frame && hasMore())
+    {
+        framesRead++;
+        currentFrame++;
+    }
+}
+
+int SyntheticLogReader::getNumFrames()
+{
+    return numFrames;
+}
+
+bool SyntheticLogReader::hasMore()
+{
+    return currentFrame + 1 < numFrames;
+}
+
+void SyntheticLogReader::rewind()
+{
+    framesRead = 0;
+    currentFrame = 0;
+}
+
+bool SyntheticLogReader::rewound()
+{
+    return framesRead == 0;
+}
+
+const std::string SyntheticLogReader::getFile()
+{
+    return file;
+}
+
+void SyntheticLogReader::setAuto(bool value)
+{
+
+}
+
+const SyntheticScene & SyntheticLogReader::getScene()
+{
+    return scene;
+}
+
+std::string SyntheticLogReader::layoutName(const SyntheticScene::Layout & layout)
+{
+    return layout == SyntheticScene::ROOM ? "room" : layout == SyntheticScene::CORRIDOR ? "corridor" : "loop";
+}
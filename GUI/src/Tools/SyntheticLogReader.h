@@ -0,0 +1,76 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef SYNTHETICLOGREADER_H_
+#define SYNTHETICLOGREADER_H_
+
+#include <Utils/SyntheticScene.h>
+
+#include "LogReader.h"
+
+#include <cassert>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Renders frames of a SyntheticScene as they're read, so it behaves like a log of the scene that's
+ * numFrames long. Rendering is a lot slower than decoding, convert it to a chunked log first for timing runs.
+ */
+class SyntheticLogReader : public LogReader
+{
+    public:
+        SyntheticLogReader(const SyntheticScene::Config & config, bool flipColors);
+
+        virtual ~SyntheticLogReader();
+
+        void getNext();
+
+        void getBack();
+
+        int getNumFrames();
+
+        bool hasMore();
+
+        bool rewound();
+
+        void rewind();
+
+        void fastForward(int frame);
+
+        const std::string getFile();
+
+        void setAuto(bool value);
+
+        const SyntheticScene & getScene();
+
+        static std::string layoutName(const SyntheticScene::Layout & layout);
+
+    private:
+        void readFrame(const int frame);
+
+        SyntheticScene scene;
+
+        //Frames read so far, getBack steps back through them
+        int framesRead;
+
+        std::vector<unsigned short> depthBuffer;
+        std::vector<unsigned char> rgbBuffer;
+};
+
+#endif /* SYNTHETICLOGREADER_H_ */
@@ -0,0 +1,388 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#include "TUMLogReader.h"
+
+#include <png.h>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+//Reads 16-bit greyscale depth or anything that can be made 8-bit RGB (or BGR) into out, which must fit it
+static bool readPng(const std::string & filename, const int width, const int height, const bool depth, unsigned char * out, const bool bgr = false)
+{
+    FILE * fp = fopen(filename.c_str(), "rb");
+
+    if(!fp)
+    {
+        return false;
+    }
+
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+    png_infop info = png ? png_create_info_struct(png) : 0;
+
+    if(!info)
+    {
+        png_destroy_read_struct(&png, 0, 0);
+        fclose(fp);
+        return false;
+    }
+
+    const int bytesPerPixel = depth ? 2 : 3;
+
+    std::vector<png_bytep> rows(height);
+
+    for(int y = 0; y < height; y++)
+    {
+        rows[y] = out + y * width * bytesPerPixel;
+    }
+
+    if(setjmp(png_jmpbuf(png)))
+    {
+        png_destroy_read_struct(&png, &info, 0);
+        fclose(fp);
+        return false;
+    }
+
+    png_init_io(png, fp);
+    png_read_info(png, info);
+
+    const int bitDepth = png_get_bit_depth(png, info);
+    const int colorType = png_get_color_type(png, info);
+
+    bool good = (int)png_get_image_width(png, info) == width && (int)png_get_image_height(png, info) == height;
+
+    if(depth)
+    {
+        good = good && colorType == PNG_COLOR_TYPE_GRAY && bitDepth == 16;
+
+        //PNG is big endian
+        png_set_swap(png);
+    }
+    else
+    {
+        if(colorType == PNG_COLOR_TYPE_PALETTE)
+        {
+            png_set_palette_to_rgb(png);
+        }
+
+        if(colorType == PNG_COLOR_TYPE_GRAY || colorType == PNG_COLOR_TYPE_GRAY_ALPHA)
+        {
+            png_set_expand_gray_1_2_4_to_8(png);
+            png_set_gray_to_rgb(png);
+        }
+
+        if(bitDepth == 16)
+        {
+            png_set_strip_16(png);
+        }
+
+        if(colorType & PNG_COLOR_MASK_ALPHA)
+        {
+            png_set_strip_alpha(png);
+        }
+
+        if(bgr)
+        {
+            png_set_bgr(png);
+        }
+    }
+
+    png_read_update_info(png, info);
+
+    good = good && png_get_rowbytes(png, info) == (png_size_t)(width * bytesPerPixel);
+
+    if(good)
+    {
+        png_read_image(png, rows.data());
+        png_read_end(png, 0);
+    }
+
+    png_destroy_read_struct(&png, &info, 0);
+    fclose(fp);
+
+    return good;
+}
+
+TUMLogReader::TUMLogReader(std::string file, bool flipColors, const float depthScale, const double timeScale)
+ : LogReader(file, flipColors),
+   depthScale(depthScale),
+   framesRead(0),
+   slots(NUM_SLOTS),
+   flip(flipColors),
+   shutdown(false)
+{
+    const size_t slash = file.find_last_of("/\\");
+    const std::string directory = slash == std::string::npos ? "" : file.substr(0, slash + 1);
+
+    std::ifstream associations(file.c_str());
+    std::string line;
+
+    while(std::getline(associations, line))
+    {
+        std::istringstream tokens(line);
+
+        if(line.length() && line[0] == '#')
+        {
+            std::string comment, key;
+            float value;
+
+            if(tokens >> comment >> key >> value && key == "depth_scale")
+            {
+                this->depthScale = value;
+            }
+
+            continue;
+        }
+
+        double firstTime, secondTime;
+        std::string first, second;
+
+        if(!(tokens >> firstTime >> first >> secondTime >> second))
+        {
+            continue;
+        }
+
+        if(first.find("depth") != std::string::npos && second.find("depth") == std::string::npos)
+        {
+            std::swap(firstTime, secondTime);
+            std::swap(first, second);
+        }
+
+        //Stamped with the depth, as the loggers do
+        Frame frame;
+        frame.timestamp = (int64_t)(secondTime * timeScale + 0.5);
+        frame.rgb = directory + first;
+        frame.depth = directory + second;
+
+        frames.push_back(frame);
+    }
+
+    numFrames = frames.size();
+    currentFrame = 0;
+
+    std::cout << "Read " << numFrames << " frames from " << file << std::endl;
+
+    for(size_t i = 0; i < slots.size(); i++)
+    {
+        slots[i].frame = -1;
+        slots[i].ready = false;
+        slots[i].failed = false;
+        slots[i].flipped = false;
+        slots[i].depth.resize(numPixels);
+        slots[i].rgb.resize(numPixels * 3);
+    }
+
+    for(int i = 0; i < NUM_WORKERS; i++)
+    {
+        workers.push_back(std::thread(&TUMLogReader::decodeLoop, this));
+    }
+}
+
+TUMLogReader::~TUMLogReader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutdown = true;
+        work.notify_all();
+    }
+
+    for(size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+}
+
+bool TUMLogReader::decode(const Frame & frame, std::vector<unsigned short> & depth, std::vector<unsigned char> & rgb, const bool flipped)
+{
+    if(!readPng(frame.depth, width, height, true, (unsigned char *)depth.data()) ||
+       !readPng(frame.rgb, width, height, false, rgb.data(), flipped))
+    {
+        return false;
+    }
+
+    //Everything else works in millimetres
+    if(depthScale != 1000)
+    {
+        const float scale = 1000.0f / depthScale;
+
+        for(int i = 0; i < numPixels; i++)
+        {
+            depth[i] = (unsigned short)std::min(depth[i] * scale + 0.5f, 65535.0f);
+        }
+    }
+
+    return true;
+}
+
+void TUMLogReader::decodeLoop()
+{
+    std::vector<unsigned short> depth(numPixels);
+    std::vector<unsigned char> rgb(numPixels * 3);
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while(true)
+    {
+        work.wait(lock, [this]{ return shutdown || !jobs.empty(); });
+
+        if(shutdown)
+        {
+            break;
+        }
+
+        const int frame = jobs.front();
+        const bool flipped = flip;
+        jobs.pop_front();
+
+        //Seeked past it since
+        if(slots[frame % slots.size()].frame != frame)
+        {
+            continue;
+        }
+
+        lock.unlock();
+
+        const bool good = decode(frames[frame], depth, rgb, flipped);
+
+        lock.lock();
+
+        Slot & slot = slots[frame % slots.size()];
+
+        if(slot.frame == frame && !slot.ready)
+        {
+            slot.depth.swap(depth);
+            slot.rgb.swap(rgb);
+            slot.failed = !good;
+            slot.flipped = flipped;
+            slot.ready = true;
+
+            decoded.notify_all();
+        }
+    }
+}
+
+void TUMLogReader::readFrame(const int frame)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    //Flipped as they're decoded from now on
+    flip = flipColors;
+
+    //Keep the frames from here on decoding, after a seek that's all of them
+    for(int f = frame; f < std::min(frame + (int)slots.size(), numFrames); f++)
+    {
+        Slot & slot = slots[f % slots.size()];
+
+        if(slot.frame != f)
+        {
+            slot.frame = f;
+            slot.ready = false;
+            jobs.push_back(f);
+        }
+    }
+
+    work.notify_all();
+
+    Slot & slot = slots[frame % slots.size()];
+
+    decoded.wait(lock, [&slot]{ return slot.ready; });
+
+    if(slot.failed)
+    {
+        std::cout << "Couldn't read " << frames[frame].depth << " or " << frames[frame].rgb << std::endl;
+
+        std::fill(slot.depth.begin(), slot.depth.end(), 0);
+        std::fill(slot.rgb.begin(), slot.rgb.end(), 0);
+    }
+
+    //Ours until the next frame is read
+    timestamp = frames[frame].timestamp;
+    depth = slot.depth.data();
+    rgb = slot.rgb.data();
+
+    depthSize = numPixels * 2;
+    imageSize = numPixels * 3;
+
+    //Only if it was toggled since this frame was decoded
+    if(slot.flipped != flipColors)
+    {
+        ThreadPool::getInstance().parallelFor(0, numPixels, 16384, [&](const int start, const int end)
+        {
+            ChannelSwap::swapRedBlue(rgb + start * 3, rgb + start * 3, end - start);
+        });
+
+        slot.flipped = flipColors;
+    }
+
+    currentFrame++;
+}
+
+void TUMLogReader::getNext()
+{
+    readFrame(framesRead++);
+}
+
+void TUMLogReader::getBack()
+{
+    assert(framesRead > 0);
+
+    readFrame(--framesRead);
+}
+
+void TUMLogReader::fastForward(int frame)
+{
+    while(currentFrame < frame && hasMore())
+    {
+        framesRead++;
+        currentFrame++;
+    }
+}
+
+int TUMLogReader::getNumFrames()
+{
+    return numFrames;
+}
+
+bool TUMLogReader::hasMore()
+{
+    return currentFrame + 1 < numFrames;
+}
+
+void TUMLogReader::rewind()
+{
+    framesRead = 0;
+    currentFrame = 0;
+}
+
+bool TUMLogReader::rewound()
+{
+    return framesRead == 0;
+}
+
+const std::string TUMLogReader::getFile()
+{
+    return file;
+}
+
+void TUMLogReader::setAuto(bool value)
+{
+
+}
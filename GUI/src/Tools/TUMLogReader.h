@@ -0,0 +1,123 @@
+/*
+ * This file is part of ElasticFusion.
+ *
+ * Copyright (C) 2015 Imperial College London
+ * 
+ * The use of the code within this file and all code within files that 
+ * make up the software that is ElasticFusion is permitted for 
+ * non-commercial purposes only.  The full terms and conditions that 
+ * apply to the code within this file are detailed within the LICENSE.txt 
+ * file and at <http://www.imperial.ac.uk/dyson-robotics-lab/downloads/elastic-fusion/elastic-fusion-license/> 
+ * unless explicitly stated.  By downloading this file you agree to 
+ * comply with these terms.
+ *
+ * If you wish to use any of this code for commercial purposes then 
+ * please email researchcontracts.engineering@imperial.ac.uk.
+ *
+ */
+
+#ifndef TUMLOGREADER_H_
+#define TUMLOGREADER_H_
+
+#include <Utils/Resolution.h>
+#include <Utils/ThreadPool.h>
+
+#include "LogReader.h"
+
+#include <cassert>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * Reads TUM RGB-D / ICL-NUIM style datasets straight from their PNGs, given an association file with a
+ * "timestamp rgb.png timestamp depth.png" line per frame (either way round, whichever path mentions depth is
+ * depth). Paths are relative to the association file.
+ *
+ * The next few frames are decoded ahead on worker threads, seeking anywhere just starts decoding from there.
+ */
+class TUMLogReader : public LogReader
+{
+    public:
+        /**
+         * @param depthScale depth PNG units per metre (5000 for TUM and ICL-NUIM), a "# depth_scale <value>" line
+         * in the association file overrides it
+         * @param timeScale timestamps in the file are multiplied by this, 1000000 gives microseconds like .klg
+         */
+        TUMLogReader(std::string file, bool flipColors, const float depthScale = 5000, const double timeScale = 1000000);
+
+        virtual ~TUMLogReader();
+
+        void getNext();
+
+        void getBack();
+
+        int getNumFrames();
+
+        bool hasMore();
+
+        bool rewound();
+
+        void rewind();
+
+        void fastForward(int frame);
+
+        const std::string getFile();
+
+        void setAuto(bool value);
+
+    private:
+        struct Frame
+        {
+            int64_t timestamp;
+            std::string rgb;
+            std::string depth;
+        };
+
+        struct Slot
+        {
+            int frame;
+            bool ready;
+            bool failed;
+            bool flipped;
+            std::vector<unsigned short> depth;
+            std::vector<unsigned char> rgb;
+        };
+
+        void readFrame(const int frame);
+
+        void decodeLoop();
+
+        bool decode(const Frame & frame, std::vector<unsigned short> & depth, std::vector<unsigned char> & rgb, const bool flipped);
+
+        std::vector<Frame> frames;
+        float depthScale;
+
+        //Frames read so far, getBack steps back through them
+        int framesRead;
+
+        //Frame i is decoded into slots[i % slots.size()]
+        std::vector<Slot> slots;
+
+        //Guards the slots and everything below
+        std::mutex mutex;
+        std::condition_variable work;
+        std::condition_variable decoded;
+
+        std::deque<int> jobs;
+
+        //What flipColors was at the last read, red and blue are swapped by libpng
+        bool flip;
+        bool shutdown;
+
+        std::vector<std::thread> workers;
+
+        static const int NUM_SLOTS = 8;
+        static const int NUM_WORKERS = 3;
+};
+
+#endif /* TUMLOGREADER_H_ */